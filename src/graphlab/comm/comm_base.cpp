@@ -1,4 +1,5 @@
 #include <cstring>
+#include <cstdlib>
 #include <boost/bind.hpp>
 #include <graphlab/comm/comm_base.hpp>
 #include <graphlab/comm/mpi_comm.hpp>
@@ -30,6 +31,23 @@ comm_base* comm_base::create(const char* descriptor,
 }
 
 
+void comm_base::send_segments(int targetmachine,
+                              const std::vector<iovec>& segments,
+                              const boost::function<void(void)>& release) {
+  size_t length = 0;
+  for (size_t i = 0;i < segments.size(); ++i) length += segments[i].iov_len;
+  char* data = (char*)malloc(length);
+  char* ptr = data;
+  for (size_t i = 0;i < segments.size(); ++i) {
+    memcpy(ptr, segments[i].iov_base, segments[i].iov_len);
+    ptr += segments[i].iov_len;
+  }
+  // the segments are no longer needed once copied
+  if (release) release();
+  send_relinquish(targetmachine, data, length);
+}
+
+
 bool comm_base::register_receiver(
     const boost::function<void(int machine, const char* c, size_t len)>& receivefun,
     bool parallel) {
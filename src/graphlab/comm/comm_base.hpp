@@ -1,6 +1,8 @@
 #ifndef GRAPHLAB_COMM_COMM_BASE_HPP
 #define GRAPHLAB_COMM_COMM_BASE_HPP
 #include <cstring>
+#include <vector>
+#include <sys/uio.h>
 #include <boost/function.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
 namespace graphlab {
@@ -56,6 +58,20 @@ class comm_base {
    */ 
   virtual void send_relinquish(int targetmachine, void* data, size_t length) = 0;
 
+  /**
+   * Sends the concatenation of a list of buffers as a single message to a
+   * target machine. The buffers are not copied if the implementation can
+   * transmit them directly (e.g. with writev); they must then stay valid
+   * and unmodified until release is called. release may be an empty
+   * function. This function is thread-safe.
+   *
+   * \note A default implementation which copies the buffers and calls
+   * send_relinquish() is provided
+   */
+  virtual void send_segments(int targetmachine,
+                             const std::vector<iovec>& segments,
+                             const boost::function<void(void)>& release);
+
 
   /**
    * Flushes all communication issued prior to this call. Blocks
@@ -1,4 +1,5 @@
 #include <cassert>
+#include <cstdlib>
 #include <boost/bind.hpp>
 #include <graphlab/comm/comm_base.hpp>
 #include <graphlab/comm/comm_rpc.hpp>
@@ -14,6 +15,8 @@ comm_rpc::comm_rpc(comm_base* comm):
       true);
   _comm_has_efficient_send = comm->has_efficient_send();
   assert(ret);
+  _dispatch_table[REPLY_MESSAGE_ID] = 
+      boost::bind(&comm_rpc::reply_receiver, this, _1, _2, _3, _4);
 }
 
 
@@ -30,12 +33,32 @@ comm_rpc::~comm_rpc() {
 void comm_rpc::receiver(int machine, const char* c, size_t len) {
   assert(len >= 2);
   unsigned short message = *reinterpret_cast<const unsigned short*>(c);
+  if (message == TRACED_MESSAGE_ID) {
+    assert(len >= 2 + sizeof(uint64_t) + 2);
+    uint64_t request_id;
+    memcpy(&request_id, c + 2, sizeof(uint64_t));
+    trace_request_scope request(request_id);
+    trace_span span("comm_rpc::dispatch");
+    receiver(machine, c + 2 + sizeof(uint64_t), len - 2 - sizeof(uint64_t));
+    return;
+  }
   assert(_dispatch_table[message] != NULL); 
   _dispatch_table[message](this, machine, c + 2, len - 2);
 }
 
+void comm_rpc::reply_receiver(comm_rpc* comm, int source,
+                              const char* c, size_t len) {
+  assert(len >= sizeof(size_t));
+  promise<std::string>* reply =
+      reinterpret_cast<promise<std::string>*>(*reinterpret_cast<const size_t*>(c));
+  reply->set_value(std::string(c + sizeof(size_t), len - sizeof(size_t)));
+  delete reply;
+}
+
 void comm_rpc::register_handler(unsigned short message_id,
                                 const dispatch_function_type& function) {
+  assert(message_id != REPLY_MESSAGE_ID);
+  assert(message_id != TRACED_MESSAGE_ID);
   assert(_dispatch_table[message_id] == NULL);
   _dispatch_table[message_id] = function;
 }
@@ -50,14 +73,77 @@ void comm_rpc::send_message(int machine,
   free(newdata);
 }
 
+void comm_rpc::write_message_header(graphlab::oarchive& arc,
+                                    unsigned short message_id) {
+  uint64_t request_id = event_trace::current_request_id();
+  if (request_id != 0) {
+    arc << TRACED_MESSAGE_ID << request_id;
+  }
+  arc << message_id;
+}
+
 graphlab::oarchive* comm_rpc::prepare_message(unsigned short message_id) {
   graphlab::oarchive* arc = _pool.alloc();
   assert(arc->off == 0);
-  (*arc) << message_id;
+  write_message_header(*arc, message_id);
+  return arc;
+}
+
+graphlab::oarchive* comm_rpc::prepare_request(unsigned short message_id,
+                                              future<std::string>& reply) {
+  promise<std::string>* p = new promise<std::string>;
+  reply = p->get_future();
+  graphlab::oarchive* arc = prepare_message(message_id);
+  (*arc) << reinterpret_cast<size_t>(p);
+  return arc;
+}
+
+graphlab::oarchive* comm_rpc::prepare_reply(size_t request_handle) {
+  graphlab::oarchive* arc = prepare_message(REPLY_MESSAGE_ID);
+  (*arc) << request_handle;
   return arc;
 }
 
+graphlab::oarchive* comm_rpc::prepare_scatter_message(unsigned short message_id) {
+  graphlab::oarchive* arc =
+      new graphlab::oarchive(*(new std::vector<oarchive_segment>));
+  write_message_header(*arc, message_id);
+  return arc;
+}
+
+graphlab::oarchive* comm_rpc::prepare_scatter_reply(size_t request_handle) {
+  graphlab::oarchive* arc = prepare_scatter_message(REPLY_MESSAGE_ID);
+  (*arc) << request_handle;
+  return arc;
+}
+
+void comm_rpc::release_scatter_message(graphlab::oarchive* arc,
+                                       boost::function<void(void)> on_sent) {
+  free(arc->buf);
+  delete arc->segments;
+  delete arc;
+  if (on_sent) on_sent();
+}
+
+void comm_rpc::complete_message(int machine, graphlab::oarchive* arc,
+                                const boost::function<void(void)>& on_sent) {
+  if (arc->segments == NULL) {
+    complete_message(machine, arc);
+    if (on_sent) on_sent();
+    return;
+  }
+  std::vector<iovec> iov;
+  arc->gather(iov);
+  _comm->send_segments(machine, iov,
+                       boost::bind(&comm_rpc::release_scatter_message,
+                                   arc, on_sent));
+}
+
 void comm_rpc::complete_message(int machine, graphlab::oarchive* arc) {
+  if (arc->segments != NULL) {
+    complete_message(machine, arc, boost::function<void(void)>());
+    return;
+  }
   if (_comm_has_efficient_send) {
     // send is efficient. We maintain the buffer and do not give it up
     // to the comm
@@ -3,6 +3,8 @@
 #include <graphlab/comm/comm_base.hpp>
 #include <graphlab/util/lock_free_pool.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/parallel/future.hpp>
+#include <graphlab/util/event_trace.hpp>
 namespace graphlab {
 
 
@@ -14,6 +16,10 @@ namespace graphlab {
  * the message type. All message handling functions must support parallel 
  * calls.
  *
+ * Messages prepared by a thread which is in a traced request (see
+ * \ref trace_request_scope) carry the request id, and are handled
+ * within the same request, in a "comm_rpc::dispatch" span.
+ *
  * \note Due to a lack of locking in this implementation, it is important
  * to register ALL handlers before communication is performed. We will implement
  * a mechanism to support this if it becomes necessary.
@@ -36,8 +42,22 @@ class comm_rpc {
 
   void receiver(int machine, const char* c, size_t len);
 
+  void reply_receiver(comm_rpc* comm, int source, const char* c, size_t len);
+
   bool _comm_has_efficient_send;
  public:
+  /**
+   * Message id reserved for replies to requests made with
+   * \ref prepare_request. It may not be passed to register_handler.
+   */
+  static const unsigned short REPLY_MESSAGE_ID = 65535;
+
+  /**
+   * Message id reserved for the header of traced messages: it is followed
+   * by the request id and the actual message id.
+   */
+  static const unsigned short TRACED_MESSAGE_ID = 65534;
+
   /**
    * Constructs a rpc which is attached to a comm system.
    * The comm must not already have a receiver attached.
@@ -81,6 +101,66 @@ class comm_rpc {
    * arc must be an archive returned by prepare_message
    */
   void complete_message(int machine, graphlab::oarchive* arc); 
+
+  /**
+   * Like \ref prepare_message but for a message which expects a reply.
+   * reply is set to a future which will hold the serialized contents of
+   * the reply. The message is sent with \ref complete_message.
+   *
+   * The handler for message_id must first read a size_t request handle
+   * from the message, and answer by writing the reply into the archive
+   * returned by \ref prepare_reply(handle) and sending it back to the
+   * source machine with \ref complete_message.
+   *
+   * Together with \ref fiber_scheduler this allows remote reads to be
+   * written in straight-line style:
+   * \code
+   * future<std::string> reply;
+   * oarchive* oarc = rpc->prepare_request(WEIGHT_REQUEST, reply);
+   * (*oarc) << ids;
+   * rpc->complete_message(target, oarc);
+   * const std::string& r = fiber_scheduler::get(reply);
+   * iarchive iarc(r.c_str(), r.length());
+   * \endcode
+   */
+  graphlab::oarchive* prepare_request(unsigned short message_id,
+                                      future<std::string>& reply);
+
+  /**
+   * Returns an archive for the reply to the request with the given handle.
+   */
+  graphlab::oarchive* prepare_reply(size_t request_handle);
+
+  /**
+   * Like \ref prepare_message, but the archive is in scatter-gather mode:
+   * large strings and blobs (e.g. the graph_value fields of a batch of
+   * rows) are sent from where they are instead of being copied into the
+   * message. The message is sent with the three argument
+   * \ref complete_message, and the referenced buffers must not be
+   * modified or freed until its on_sent callback is called.
+   */
+  graphlab::oarchive* prepare_scatter_message(unsigned short message_id);
+
+  /**
+   * Scatter-gather version of \ref prepare_reply.
+   */
+  graphlab::oarchive* prepare_scatter_reply(size_t request_handle);
+
+  /**
+   * Sends out the message to the target machine, calling on_sent (which
+   * may be empty) once the buffers referenced by the archive are no
+   * longer needed. arc may be returned by any of the prepare functions.
+   */
+  void complete_message(int machine, graphlab::oarchive* arc,
+                        const boost::function<void(void)>& on_sent);
+
+ private:
+  /// Writes the message id, preceded by the trace header if traced
+  static void write_message_header(graphlab::oarchive& arc,
+                                   unsigned short message_id);
+
+  static void release_scatter_message(graphlab::oarchive* arc,
+                                      boost::function<void(void)> on_sent);
 };
 
 } // namespace graphlab
@@ -24,10 +24,27 @@
 #ifndef GRAPHLAB_RPC_CIRCULAR_IOVEC_BUFFER_HPP
 #define GRAPHLAB_RPC_CIRCULAR_IOVEC_BUFFER_HPP
 #include <vector>
+#include <cstdlib>
 #include <sys/socket.h>
+#include <boost/function.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/memory_accounting.hpp>
 
 namespace graphlab{
 namespace dc_impl {
+
+/**
+ * \ingroup rpc
+ * \internal
+ * Shared by the iovecs of a message whose memory is not owned by the comm
+ * layer (see dc_buffered_stream_send2::send_segments()). Instead of
+ * freeing those iovecs, the buffer drops a reference; the release function
+ * runs once all of them have been sent.
+ */
+struct iovec_release {
+  atomic<size_t> refcount;
+  boost::function<void(void)> release;
+};
  
 /**
  * \ingroup rpc
@@ -41,6 +58,7 @@ struct circular_iovec_buffer {
   inline circular_iovec_buffer(size_t len = 4096) {
     v.resize(4096);
     parallel_v.resize(4096);
+    owner.resize(4096, NULL);
     head = 0;
     tail = 0;
     numel = 0;
@@ -56,12 +74,15 @@ struct circular_iovec_buffer {
   
   /**
    * Writes an entry into the buffer, resizing the buffer if necessary.
-   * This buffer will take over all iovec pointers and free them when done
+   * This buffer will take over all iovec pointers and free them when done,
+   * unless rel is not NULL, in which case a reference to rel is dropped
+   * instead.
    */
-  inline void write(const iovec &entry) {
+  inline void write(const iovec &entry, iovec_release* rel = NULL) {
     if (numel == v.size()) {
       std::vector<struct iovec> newv(v.size() * 2);
       std::vector<struct iovec> new_parallel_v(v.size() * 2);
+      std::vector<iovec_release*> new_owner(v.size() * 2, NULL);
       size_t newi = 0;
       // copy to the new vector
       if (head < tail) {
@@ -69,6 +90,7 @@ struct circular_iovec_buffer {
         while(head < tail) {
           newv[newi] = v[head];
           new_parallel_v[newi] = parallel_v[head];
+          new_owner[newi] = owner[head];
           ++newi; ++head;
         }
       }
@@ -77,23 +99,27 @@ struct circular_iovec_buffer {
         while(head < numel) {
            newv[newi] = v[head];
            new_parallel_v[newi] = parallel_v[head];
+           new_owner[newi] = owner[head];
           ++newi; ++head;
         }
         head = 0;
         while(head < tail) {
           newv[newi] = v[head];
           new_parallel_v[newi] = parallel_v[head];
+          new_owner[newi] = owner[head];
           ++newi; ++head;
         }
       }
       v.swap(newv);
       parallel_v.swap(new_parallel_v);
+      owner.swap(new_owner);
       head = 0;
       tail = newi;
     }
     
     v[tail] = entry;
     parallel_v[tail] = entry;
+    owner[tail] = rel;
     tail = (tail + 1) & (v.size() - 1); ++numel;
   }
 
@@ -102,7 +128,18 @@ struct circular_iovec_buffer {
    * Erases a single iovec from the head and free the pointer
    */
   inline void erase_from_head_and_free() {
-    free(v[head].iov_base);
+    memory_accounting::add(memory_accounting::COMM_BUFFERS,
+                           -(ptrdiff_t)v[head].iov_len);
+    iovec_release* rel = owner[head];
+    if (rel == NULL) {
+      free(v[head].iov_base);
+    } else {
+      owner[head] = NULL;
+      if (rel->refcount.dec() == 0) {
+        if (rel->release) rel->release();
+        delete rel;
+      }
+    }
     head = (head + 1) & (v.size() - 1);
     --numel;
   }
@@ -138,6 +175,8 @@ struct circular_iovec_buffer {
 
   std::vector<struct iovec> v;
   std::vector<struct iovec> parallel_v;
+  // the release of each entry. NULL if the entry is freed.
+  std::vector<iovec_release*> owner;
   size_t head;
   size_t tail;
   size_t numel;
@@ -26,6 +26,8 @@
 #include <graphlab/comm/tcp/dc_buffered_stream_send2.hpp>
 #include <graphlab/comm/tcp/packet_header.hpp>
 #include <graphlab/comm/tcp/dc_tcp_comm.hpp>
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/util/memory_accounting.hpp>
 
 namespace graphlab {
 namespace dc_impl {
@@ -34,14 +36,17 @@ dc_buffered_stream_send2::dc_buffered_stream_send2(dc_tcp_comm* comm,
                                                    int target) : 
     comm(comm), procid(procid), target(target), writebuffer_totallen(0) {
   buffer[0].buf.resize(100000);
+  buffer[0].release.resize(100000, NULL);
   buffer[0].numel = 1;
   buffer[0].numbytes = 0;
   buffer[0].ref_count = 0;
   buffer[1].buf.resize(100000);
+  buffer[1].release.resize(100000, NULL);
   buffer[1].numel = 1;
   buffer[1].numbytes = 0;
   buffer[1].ref_count = 0;
   bufid = 0;
+  grow_to = 0;
   writebuffer_totallen.value = 0;
 }
 
@@ -84,8 +89,10 @@ dc_buffered_stream_send2::dc_buffered_stream_send2(dc_tcp_comm* comm,
         continue;
       }
       buffer[curid].buf[insertloc] = msg;
+      buffer[curid].release[insertloc] = NULL;
       buffer[curid].numbytes.inc(len);    
       writebuffer_totallen.inc(len);
+      memory_accounting::add(memory_accounting::COMM_BUFFERS, len);
       // decrement the reference count
       __sync_fetch_and_sub(&(buffer[curid].ref_count), 1);
       break;
@@ -146,8 +153,11 @@ dc_buffered_stream_send2::dc_buffered_stream_send2(dc_tcp_comm* comm,
       if (insertloc_ready == false) continue;
       buffer[curid].buf[insertloc] = header;
       buffer[curid].buf[insertloc + 1] = msg;
+      buffer[curid].release[insertloc] = NULL;
+      buffer[curid].release[insertloc + 1] = NULL;
       buffer[curid].numbytes.inc(len + sizeof(packet_hdr));    
       writebuffer_totallen.inc(len + sizeof(packet_hdr));
+      memory_accounting::add(memory_accounting::COMM_BUFFERS, len + sizeof(packet_hdr));
       // decrement the reference count
       __sync_fetch_and_sub(&(buffer[curid].ref_count), 1);
       break;
@@ -155,6 +165,93 @@ dc_buffered_stream_send2::dc_buffered_stream_send2(dc_tcp_comm* comm,
     
     if (insertloc >= 256) comm->trigger_send_timeout(target, false);
   }
+  void dc_buffered_stream_send2::send_segments(int target,
+                                               const std::vector<iovec>& segments,
+                                               const boost::function<void(void)>& release) {
+    size_t len = 0;
+    for (size_t i = 0;i < segments.size(); ++i) len += segments[i].iov_len;
+    bytessent.inc(len);
+    if (segments.empty()) {
+      if (release) release();
+      return;
+    }
+    // every segment holds a reference on the release
+    iovec_release* rel = new iovec_release;
+    rel->refcount.value = segments.size();
+    rel->release = release;
+
+    // build the packet header
+    packet_hdr* hdr = (packet_hdr*)malloc(sizeof(packet_hdr));
+    hdr->len = len; 
+    hdr->src = procid;
+    iovec header;
+    header.iov_base = (char*)hdr;
+    header.iov_len = sizeof(packet_hdr);
+    // the header and the segments occupy consecutive entries
+    const size_t numentries = segments.size() + 1;
+    size_t insertloc = 0;
+    while(1) {
+      size_t curid;
+      while(1) {
+        curid = bufid;
+        int32_t cref = buffer[curid].ref_count;
+        if (cref < 0 || 
+            !atomic_compare_and_swap(buffer[curid].ref_count, cref, cref + 1)) continue;
+
+        if (curid != bufid) {
+          __sync_fetch_and_sub(&(buffer[curid].ref_count), 1);
+        }
+        else {
+          break;
+        }
+        asm volatile("pause\n": : :"memory");
+      }
+      // a message must fit in an empty buffer, whose first entry is the
+      // block header. If it does not, have the buffers grown and retry.
+      if (numentries >= buffer[curid].buf.size()) {
+        size_t cur_grow_to = grow_to;
+        while (cur_grow_to <= numentries &&
+               !atomic_compare_and_swap(grow_to, cur_grow_to, numentries + 1)) {
+          cur_grow_to = grow_to;
+        }
+        __sync_fetch_and_sub(&(buffer[curid].ref_count), 1);
+        comm->trigger_send_timeout(target, false);
+        usleep(100);
+        continue;
+      }
+      bool insertloc_ready = false;
+      while(!insertloc_ready) {
+        insertloc = buffer[curid].numel;
+        // ooops out of buffer room. release the reference count, flush and retry
+        if (insertloc + numentries > buffer[curid].buf.size()) {
+          __sync_fetch_and_sub(&(buffer[curid].ref_count), 1);
+          insertloc_ready = false;
+          comm->trigger_send_timeout(target, false);
+          usleep(100);
+          break;
+        } else if (buffer[curid].numel.cas(insertloc, insertloc + numentries)) {
+          insertloc_ready = true;
+          break;
+        }
+      }
+      if (insertloc_ready == false) continue;
+      buffer[curid].buf[insertloc] = header;
+      buffer[curid].release[insertloc] = NULL;
+      for (size_t i = 0;i < segments.size(); ++i) {
+        buffer[curid].buf[insertloc + 1 + i] = segments[i];
+        buffer[curid].release[insertloc + 1 + i] = rel;
+      }
+      buffer[curid].numbytes.inc(len + sizeof(packet_hdr));    
+      writebuffer_totallen.inc(len + sizeof(packet_hdr));
+      memory_accounting::add(memory_accounting::COMM_BUFFERS, len + sizeof(packet_hdr));
+      // decrement the reference count
+      __sync_fetch_and_sub(&(buffer[curid].ref_count), 1);
+      break;
+    }
+    
+    if (insertloc + numentries >= 256) comm->trigger_send_timeout(target, false);
+  }
+
   void dc_buffered_stream_send2::flush() {
     comm->trigger_send_timeout(target, false);
     while(writebuffer_totallen.value) usleep(100);
@@ -168,7 +265,8 @@ dc_buffered_stream_send2::dc_buffered_stream_send2(dc_tcp_comm* comm,
   }
 
   size_t dc_buffered_stream_send2::get_outgoing_data(circular_iovec_buffer& outdata) {
-    if (writebuffer_totallen.value == 0) return 0;
+    if (writebuffer_totallen.value == 0 &&
+        grow_to <= buffer[bufid].buf.size()) return 0;
     
     // swap the buffer
     size_t curid = bufid;
@@ -192,6 +290,9 @@ dc_buffered_stream_send2::dc_buffered_stream_send2(dc_tcp_comm* comm,
       writebuffer_totallen.dec(sendlen);    
       block_header_type* blockheader = new block_header_type;
       (*blockheader) = sendlen;
+      // the queued bytes move to outdata, which frees them once sent
+      memory_accounting::add(memory_accounting::COMM_BUFFERS,
+                             sizeof(block_header_type));
       
       // fill the first msg block
       sendbuffer[0].iov_base = reinterpret_cast<void*>(blockheader);
@@ -199,18 +300,19 @@ dc_buffered_stream_send2::dc_buffered_stream_send2(dc_tcp_comm* comm,
       // give the buffer away
       for (size_t i = 0;i < numel; ++i) {
         real_send_len += sendbuffer[i].iov_len;
-        outdata.write(sendbuffer[i]);
+        outdata.write(sendbuffer[i], buffer[curid].release[i]);
       }
       // reset the buffer;
       buffer[curid].numbytes = 0;
       buffer[curid].numel = 1;
 
       if (buffull) {
-        sendbuffer.resize(2 * numel);
+        sendbuffer.resize(std::max(2 * numel, (size_t)grow_to));
       }
       else {
-        sendbuffer.resize(oldbsize);
+        sendbuffer.resize(std::max(oldbsize, (size_t)grow_to));
       }
+      buffer[curid].release.resize(sendbuffer.size(), NULL);
       __sync_fetch_and_add(&(buffer[curid].ref_count), 1);
       return real_send_len;
     }
@@ -218,6 +320,10 @@ dc_buffered_stream_send2::dc_buffered_stream_send2(dc_tcp_comm* comm,
       // reset the buffer;
       buffer[curid].numbytes = 0;
       buffer[curid].numel = 1;
+      if (grow_to > buffer[curid].buf.size()) {
+        buffer[curid].buf.resize(grow_to);
+        buffer[curid].release.resize(grow_to, NULL);
+      }
       __sync_fetch_and_add(&(buffer[curid].ref_count), 1);
       return 0;
     }
@@ -83,6 +83,13 @@ class dc_buffered_stream_send2{
   void copy_and_send_data(int target,
                           char* data, size_t len);
 
+  /** Sends the concatenation of the segments as one message without
+   copying them and without transferring control of the pointers.
+   The segments must stay valid until release is called, which happens
+   once all of them have been written to the socket. */
+  void send_segments(int target, const std::vector<iovec>& segments,
+                     const boost::function<void(void)>& release);
+
   size_t get_outgoing_data(circular_iovec_buffer& outdata);
   
   
@@ -106,12 +113,18 @@ class dc_buffered_stream_send2{
   
   struct buffer_and_refcount{
     std::vector<iovec> buf;
+    // release[i] is the release of buf[i]. NULL if buf[i] is freed.
+    std::vector<iovec_release*> release;
     atomic<size_t> numel;
     atomic<size_t> numbytes;
     volatile int32_t ref_count; // if negative, means it is sending
   };
   buffer_and_refcount buffer[2];
   size_t bufid;
+  // number of entries the buffers must have room for, raised by a
+  // message with more segments than fit in a buffer. The buffers are
+  // grown to it as they are swapped out by get_outgoing_data().
+  volatile size_t grow_to;
   
 
   atomic<size_t> bytessent; 
@@ -520,7 +520,7 @@ namespace graphlab {
             break;
           }
           else if (msglen > 0) {
-            comm->network_bytesreceived.inc(msglen);
+            comm->network_bytesreceived += msglen;
     #ifdef COMM_DEBUG
             logstream(LOG_INFO) << msglen << " bytes <-- "
                                 << sockinfo->id  << std::endl;
@@ -33,6 +33,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/reducer.hpp>
 #include <graphlab/comm/tcp/circular_iovec_buffer.hpp>
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/util/dense_bitset.hpp>
@@ -55,7 +56,7 @@ a collection of machines.
 class dc_tcp_comm {
  public:
    
-  DECLARE_TRACER(tcp_send_call);
+  DECLARE_HISTOGRAM_TRACER(tcp_send_call);
   
   inline dc_tcp_comm() {
     is_closed = true;
@@ -122,7 +123,7 @@ class dc_tcp_comm {
    * Returns the total number of bytes received
    */
   inline size_t network_bytes_received() const {
-    return network_bytesreceived.value;
+    return network_bytesreceived.value();
   }
  
   inline size_t send_queue_length() const {
@@ -221,7 +222,8 @@ class dc_tcp_comm {
 
   // counters
   atomic<size_t> network_bytessent;
-  atomic<size_t> network_bytesreceived;
+  // updated by all the receiving threads
+  reducer<size_t> network_bytesreceived;
 
   ////////////       Receiving Sockets      //////////////////////
   thread_group inthreads;
@@ -34,6 +34,10 @@ tcp_comm::tcp_comm(int* argc, char*** argv) {
   _last_receive_buffer_read_from = 0;
   _recv_queue.resize(_size);
   _recv_queue_lock.resize(_size);
+  _recv_overflow.resize(_size, 0);
+  _dispatch_sent.resize(_size, 0);
+  _dispatch_done.resize(_size, 0);
+  _overflow_mark.resize(_size, 0);
   _dispatch_running = false;
 // ---- now set up the comm system
 
@@ -74,11 +78,13 @@ tcp_comm::~tcp_comm() {
   if (_dispatch_running) {
     _dispatch_running = false;
     for (size_t i = 0;i < _num_threads; ++i) {
-      _thread_mutex[i].lock();
-      _thread_cond[i].signal();
-      _thread_mutex[i].unlock();
+      _dispatch_queue[i]->close();
     }
     _thread_group.join(); 
+    for (size_t i = 0;i < _num_threads; ++i) {
+      delete _dispatch_queue[i];
+    }
+    _dispatch_queue.clear();
   }
   mpi_tools::finalize();
 }
@@ -96,6 +102,12 @@ void tcp_comm::send_relinquish(int targetmachine, void* data, size_t length) {
 
 
 
+void tcp_comm::send_segments(int targetmachine,
+                             const std::vector<iovec>& segments,
+                             const boost::function<void(void)>& release) {
+ _senders[targetmachine]->send_segments(targetmachine, segments, release);
+}
+
 /** Receives a chunk of stuff */
 void tcp_comm::chunk_receive(int machine, char* buf, size_t len) {
   // ok now I have a chunk of packets
@@ -106,22 +118,29 @@ void tcp_comm::chunk_receive(int machine, char* buf, size_t len) {
   c->len = len;
   c->remaining_len = len;
   c->refcount = 0;
+  c->machine = machine;
+  memory_accounting::add(memory_accounting::COMM_BUFFERS, len);
+  // hand the chunk directly to the receiver thread, unless earlier chunks
+  // from the machine are waiting in _recv_queue. Never blocks: a slow
+  // receive function must not hold up the chunks of the other threads.
+  // Chunks from one machine arrive on one thread, which is the only one
+  // setting _recv_overflow[machine].
+  if (_dispatch_running && !_recv_overflow[machine] &&
+      _dispatch_queue[machine % _num_threads]->try_enqueue(c)) {
+    ++_dispatch_sent[machine];
+    return;
+  }
   _recv_queue_lock[machine].lock();
   _recv_queue[machine].push_back(c);
+  if (!_recv_overflow[machine]) _overflow_mark[machine] = _dispatch_sent[machine];
+  _recv_overflow[machine] = 1;
   _recv_queue_lock[machine].unlock();
-  // if we have receive threads running, we may need to wake one up
+  // a receiver may have been registered while we were queueing. If so
+  // wake its thread up to pick up the chunk. If the dispatch queue is
+  // full the thread is awake anyway.
+  __sync_synchronize();
   if (_dispatch_running) {
-    size_t target_thread = machine % _num_threads;
-    // now, this is ok. Because if this flag is not set, then
-    // we must be temporally ordered before the receiver thread's 2nd check
-    // having this allows me to not take the lock every time.
-    // Note that I still have to lock it to signal since I must be sure that
-    // the thread is actually waiting in the condition variable
-    if (_thread_trying_to_sleep[target_thread]) {
-      _thread_mutex[target_thread].lock();
-      _thread_cond[target_thread].signal();
-      _thread_mutex[target_thread].unlock();
-    }
+    _dispatch_queue[machine % _num_threads]->try_enqueue(NULL);
   }
 }
 
@@ -131,64 +150,71 @@ void tcp_comm::flush() {
   }
 }
 
-void tcp_comm::receiver_thread(size_t threadid) {
+void tcp_comm::dispatch_chunk(chunk* c) {
+  assert(c->remaining_len > 0);
+  while(1) {
+    size_t length;
+    void* retdata = advance_chunk(c, &length);
+    if (retdata != NULL) {
+      _receivefun(c->machine, (char*)retdata, length);
+    } else {
+      break;
+    }
+  }
+  delete c;
+}
 
-  _thread_mutex[threadid].lock(); 
-  while(_dispatch_running) {
-    // unlock the core mutex while I run stuff
-    _thread_mutex[threadid].unlock(); 
-    // get the queues I am in charge of and execute them
-    for (size_t i = threadid; i < (size_t)_size; i += _num_threads) {
-      // fast exit
-      if (_recv_queue[i].empty()) continue;
-      std::deque<chunk*> myqueue;
-      _recv_queue_lock[i].lock();
-      _recv_queue[i].swap(myqueue);
+bool tcp_comm::dispatch_recv_queue(size_t threadid) {
+  bool ret = false;
+  for (size_t i = threadid; i < (size_t)_size; i += _num_threads) {
+    // fast exit
+    if (_recv_queue[i].empty()) continue;
+    std::deque<chunk*> myqueue;
+    _recv_queue_lock[i].lock();
+    if (_dispatch_done[i] < _overflow_mark[i]) {
+      // earlier chunks from i are still in the dispatch queue
       _recv_queue_lock[i].unlock();
-
-      // now evaluate this queue
-      // now since I have exclusive access to this queue
-      // I don't need to worry about shared pointer and what not
-      // more efficient to go by pointers directly
-      while(!myqueue.empty()) {
-        // get the current head
-        chunk* curhead = myqueue.front();
-        assert(curhead->remaining_len > 0);
-        // try to read the chunk 
-        while(1) {
-          size_t length;
-          void* retdata = advance_chunk(curhead, &length);
-          if (retdata != NULL) {
-            _receivefun(i, (char*)retdata, length);
-          } else {
-            break;
-          }
-        }
-        myqueue.pop_front();
-        delete curhead;
-      }
+      continue;
     }
-    // lock the core mutex while I do one more sweep to make sure there is 
-    // nothing to do
-    _thread_mutex[threadid].lock(); 
-    _thread_trying_to_sleep[threadid] = true;
-    // force a memory fence here
-    asm volatile("mfence");
-    bool allempty = true;
-    for (size_t i = threadid; i < (size_t)_size; i += _num_threads) {
-      if (!_recv_queue[i].empty()) {
-        allempty = false;
+    _recv_queue[i].swap(myqueue);
+    // the next chunks from i may use the dispatch queue again: they are
+    // dispatched after these
+    _recv_overflow[i] = 0;
+    _recv_queue_lock[i].unlock();
+    ret = ret || !myqueue.empty();
+    while(!myqueue.empty()) {
+      dispatch_chunk(myqueue.front());
+      myqueue.pop_front();
+    }
+  }
+  return ret;
+}
+
+void tcp_comm::receiver_thread(size_t threadid) {
+  mpmc_queue<chunk*>& queue = *_dispatch_queue[threadid];
+  const size_t BATCH = 16;
+  chunk* batch[BATCH];
+  while(1) {
+    size_t n = queue.try_dequeue_bulk(batch, BATCH);
+    if (n == 0) {
+      if (dispatch_recv_queue(threadid)) continue;
+      n = queue.dequeue_bulk(batch, BATCH);
+      if (n == 0) {
+        // closed
+        dispatch_recv_queue(threadid);
         break;
       }
     }
-    // if there is really nothing to do, go to sleep
-    if (allempty) _thread_cond[threadid].wait(_thread_mutex[threadid]);
-    _thread_trying_to_sleep[threadid] = false;
-    // force a memory fence here
-    asm volatile("mfence");
-
+    for (size_t i = 0;i < n; ++i) {
+      if (batch[i] == NULL) continue;
+      size_t machine = batch[i]->machine;
+      dispatch_chunk(batch[i]);
+      ++_dispatch_done[machine];
+    }
+    // the overflow of a machine goes as soon as the chunks queued before
+    // it are dispatched, even if other machines keep the queue busy
+    dispatch_recv_queue(threadid);
   }
-  _thread_mutex[threadid].unlock(); 
 }
 
 bool tcp_comm::register_receiver(const boost::function<void(int machine, const char* c, size_t len)>& receivefun,
@@ -207,14 +233,16 @@ bool tcp_comm::register_receiver(const boost::function<void(int machine, const c
     _num_threads = 1;
   }
 
-  _thread_mutex.resize(_num_threads);
-  _thread_cond.resize(_num_threads);
-  _thread_trying_to_sleep.resize(_num_threads, false);
   for (size_t i = 0;i < _num_threads ; ++i) {
-    _thread_group.launch(boost::bind(&tcp_comm::receiver_thread, this, i));
+    _dispatch_queue.push_back(new mpmc_queue<chunk*>(DISPATCH_QUEUE_CAPACITY, true));
   }
+  // from here on incoming chunks go to the dispatch queues
   _dispatch_running = true;
+  __sync_synchronize();
   // start the receive threads
+  for (size_t i = 0;i < _num_threads ; ++i) {
+    _thread_group.launch(boost::bind(&tcp_comm::receiver_thread, this, i));
+  }
   return true;
 }
 
@@ -7,6 +7,8 @@
 #include <graphlab/comm/tcp/dc_tcp_comm.hpp>
 #include <graphlab/comm/tcp/dc_stream_receive.hpp>
 #include <graphlab/comm/tcp/dc_buffered_stream_send2.hpp>
+#include <graphlab/parallel/mpmc_queue.hpp>
+#include <graphlab/util/memory_accounting.hpp>
 namespace graphlab {
 
 /**
@@ -46,23 +48,54 @@ class tcp_comm:public comm_base {
      size_t len;
      size_t remaining_len;
      atomic<char> refcount;
-     chunk():base(NULL),cur(NULL),len(0),remaining_len(0),refcount(0) { }
+     int machine;
+     chunk():base(NULL),cur(NULL),len(0),remaining_len(0),refcount(0),
+             machine(0) { }
      ~chunk() {
-       if (base != NULL) free(base);
+       if (base != NULL) {
+         free(base);
+         memory_accounting::add(memory_accounting::COMM_BUFFERS, -(ptrdiff_t)len);
+       }
      }
    };
    // _recv_queue[i] are the messages coming from machine i
+   // which are waiting for receive(). Once a receiver is registered, 
+   // chunks go to the dispatch queues instead.
    std::vector<std::deque<chunk* > > _recv_queue;
    // this locks the recv_queue
    std::vector<mutex> _recv_queue_lock;
+   // _recv_overflow[i] is set (under _recv_queue_lock[i]) while chunks from
+   // machine i are in _recv_queue[i], so that the later chunks from i
+   // queue up behind them instead of overtaking them in the dispatch queue
+   std::vector<char> _recv_overflow;
+   // _dispatch_sent[i] counts the chunks from machine i put in the
+   // dispatch queue (by the thread receiving from i), _dispatch_done[i]
+   // those dispatched from it (by the receiver thread of i), and
+   // _overflow_mark[i] is _dispatch_sent[i] when _recv_overflow[i] was set.
+   // _recv_queue[i] may be dispatched once _dispatch_done[i] reaches the
+   // mark: the chunks from i before it are all dispatched.
+   std::vector<size_t> _dispatch_sent;
+   std::vector<size_t> _dispatch_done;
+   std::vector<size_t> _overflow_mark;
    /** Receives a chunk of stuff */
    void chunk_receive(int machine, char* buf, size_t len);
 
    // started if a receiver is registered
    void receiver_thread(size_t threadid);
-   std::vector<mutex> _thread_mutex;
-   std::vector<conditional> _thread_cond;
-   std::vector<char> _thread_trying_to_sleep;
+   // maximum number of chunks waiting for each receiver thread
+   static const size_t DISPATCH_QUEUE_CAPACITY = 4096;
+   // _dispatch_queue[t] holds the chunks for receiver thread t, i.e. from
+   // the machines i with i % _num_threads == t. When it is full, chunks
+   // overflow to _recv_queue, which the thread drains after every batch
+   // once the chunks before the overflow are dispatched (see
+   // _overflow_mark), so a busy dispatch queue does not starve it. A NULL
+   // entry only wakes the thread up.
+   std::vector<mpmc_queue<chunk*>*> _dispatch_queue;
+   // calls the receive function on all the messages in the chunk
+   void dispatch_chunk(chunk* c);
+   // dispatches the chunks in _recv_queue belonging to receiver thread t
+   // which may go without reordering. Returns true if there were any.
+   bool dispatch_recv_queue(size_t threadid);
    char* advance_chunk(chunk* c, size_t* recvlen);
    // received from a specific source machine
    void* receive(int sourcemachine, size_t* length);
@@ -86,6 +119,15 @@ class tcp_comm:public comm_base {
    */
   void send_relinquish(int targetmachine, void* data, size_t length);
 
+  /**
+   * Sends the concatenation of the segments without copying them.
+   * They are written to the socket directly and release is called
+   * once they have all been sent.
+   */
+  void send_segments(int targetmachine,
+                     const std::vector<iovec>& segments,
+                     const boost::function<void(void)>& release);
+
   /**
    * Flushes all communication issued prior to this call. Blocks
    * until all communication is complete.
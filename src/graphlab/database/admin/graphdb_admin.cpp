@@ -1,8 +1,10 @@
 #include <graphlab/database/admin/graphdb_admin.hpp>
 #include <graphlab/database/errno.hpp>
 #include <graphlab/database/query_message.hpp>
+#include <graphlab/util/event_trace.hpp>
 #include <fault/query_object_server_manager.hpp>
 #include <iostream>
+#include <fstream>
 
 namespace graphlab {
 
@@ -66,6 +68,65 @@ namespace graphlab {
        }
        return true;
      }
+     case STATS: {
+       QueryMessage qm(QueryMessage::ADMIN, QueryMessage::STATS);
+       std::vector<query_result> results;
+       qo.query_all(qm.message(), qm.length(), results);
+       bool success = true;
+       for (size_t i = 0; i < results.size(); ++i) {
+         if (results[i].get_status() != 0) {
+           logstream(LOG_ERROR) << glstrerr(ESRVUNREACH) << std::endl;
+           success = false;
+           continue;
+         }
+         std::string reply = results[i].get_reply();
+         iarchive iarc(reply.c_str(), reply.length());
+         int err = 0;
+         std::string stats;
+         iarc >> err;
+         if (err != 0) {
+           logstream(LOG_ERROR) << glstrerr(err) << std::endl;
+           success = false;
+           continue;
+         }
+         iarc >> stats;
+         std::cout << stats;
+       }
+       return success;
+     }
+     case TRACE: {
+       // trace start | trace stop | trace [output.json]
+       if (argc < 1) {
+         std::cout << "trace start, trace stop or trace [output json file]" << std::endl;
+         return false;
+       }
+       std::string arg(argv[0]);
+       int action = (arg == "start") ? QueryMessage::TRACE_START :
+                    (arg == "stop") ? QueryMessage::TRACE_STOP :
+                    QueryMessage::TRACE_COLLECT;
+       QueryMessage qm(QueryMessage::ADMIN, QueryMessage::TRACE);
+       qm << action;
+       std::vector<query_result> results;
+       qo.query_all(qm.message(), qm.length(), results);
+       // the events of all the shards make one timeline
+       std::vector<trace_record> records;
+       bool success = true;
+       for (size_t i = 0; i < results.size(); ++i) {
+         std::vector<trace_record> shard_records;
+         int error = qo.parse_reply(results[i], shard_records);
+         if (error != 0) {
+           success = false;
+           continue;
+         }
+         records.insert(records.end(), shard_records.begin(), shard_records.end());
+       }
+       if (action == QueryMessage::TRACE_COLLECT) {
+         std::ofstream fout(arg.c_str());
+         event_trace::write_chrome_trace(fout, records);
+         std::cout << records.size() << " events written to " << arg << std::endl;
+       }
+       return success;
+     }
      default: {
        logstream(LOG_WARNING) << glstrerr(EINVCMD) << std::endl;
        return false;
@@ -78,6 +139,10 @@ namespace graphlab {
       return START;
     } else if (str == "reset") {
       return RESET;
+    } else if (str == "stats") {
+      return STATS;
+    } else if (str == "trace") {
+      return TRACE;
     } else {
       return UNKNOWN;
     }
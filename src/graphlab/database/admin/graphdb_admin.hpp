@@ -8,6 +8,8 @@ namespace graphlab {
     enum cmd_type {
       START,
       RESET,
+      STATS,
+      TRACE,
       UNKNOWN,
     };
     
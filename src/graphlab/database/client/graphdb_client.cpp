@@ -6,6 +6,13 @@ namespace graphlab {
 
     QueryMessage::header header(QueryMessage::BADD, QueryMessage::EDGE);
     bool success = scatter_messages<edge_insert_descriptor, char>(header, edges, boost::bind(&graphdb_client::ein2shard, this, _1), NULL, errorcodes);
+    adj_filters_lock.writelock();
+    if (use_adj_filters) {
+      for (size_t i = 0; i < edges.size(); ++i) {
+        add_to_adjacency_filters(edges[i].src, edges[i].dest, ein2shard(edges[i]));
+      }
+    }
+    adj_filters_lock.unlock();
     
     // add mirrors
     mirror_table_type mirror_table = mirror_table_from_edges(edges);
@@ -108,6 +115,9 @@ namespace graphlab {
     qm << source << dest << data;
     graph_shard_id_t target = shard_manager.get_master(source, dest); 
     query_result future = queryobj.update(target, qm.message(), qm.length());
+    adj_filters_lock.writelock();
+    if (use_adj_filters) add_to_adjacency_filters(source, dest, target);
+    adj_filters_lock.unlock();
 
 
     std::vector<graph_shard_id_t> mirrors(target);
@@ -141,13 +151,24 @@ namespace graphlab {
   }
 
   int graphdb_client::get_vertex_adj(graph_vid_t vid, bool in_edges, vertex_adj_descriptor& out) {
-    QueryMessage qm(QueryMessage::GET, QueryMessage::VERTEXADJ);
-    qm << vid << in_edges;
-
     // // find the shards we need query about vid's adj 
     graph_shard_id_t master = shard_manager.get_master(vid);
     std::vector<graph_shard_id_t> spans; 
     shard_manager.get_neighbors(master, spans);
+    adj_filters_lock.readlock();
+    if (use_adj_filters) {
+      // skip the shards which definitely have no such edges of vid
+      std::vector<graph_shard_id_t> candidates;
+      for (size_t i = 0; i < spans.size(); ++i) {
+        if (adj_filters[in_edges][spans[i]].may_contain(vid)) candidates.push_back(spans[i]);
+      }
+      spans.swap(candidates);
+    }
+    adj_filters_lock.unlock();
+    if (spans.empty()) return 0;
+
+    QueryMessage qm(QueryMessage::GET, QueryMessage::VERTEXADJ);
+    qm << vid << in_edges;
 
     std::vector<query_result> futures;
     std::vector<int> errorcodes;
@@ -251,6 +272,63 @@ namespace graphlab {
   }
 
 
+  // --------------- Adjacency filters -----------------------
+  int graphdb_client::fetch_adjacency_filters() {
+    disable_adjacency_filters();
+    // fetched without the lock, and swapped in once complete
+    std::vector<bloom_filter> filters[2];
+    std::vector<graph_shard_id_t> shards;
+    for (size_t i = 0; i < shard_manager.num_shards(); ++i) shards.push_back(i);
+    for (size_t in_edges = 0; in_edges < 2; ++in_edges) {
+      QueryMessage qm(QueryMessage::GET, QueryMessage::VADJFILTER);
+      qm << bool(in_edges);
+      std::vector<query_result> futures;
+      queryobj.query_multi(shards, qm.message(), qm.length(), futures);
+      filters[in_edges].resize(shards.size());
+      for (size_t i = 0; i < futures.size(); ++i) {
+        int err = queryobj.parse_reply(futures[i], filters[in_edges][i]);
+        if (err != 0) return err;
+      }
+    }
+    adj_filters_lock.writelock();
+    adj_filters[0].swap(filters[0]);
+    adj_filters[1].swap(filters[1]);
+    use_adj_filters = true;
+    adj_filters_lock.unlock();
+    return 0;
+  }
+
+  void graphdb_client::disable_adjacency_filters() {
+    adj_filters_lock.writelock();
+    use_adj_filters = false;
+    adj_filters[0].clear();
+    adj_filters[1].clear();
+    adj_filters_lock.unlock();
+  }
+
+  void graphdb_client::add_to_adjacency_filters(graph_vid_t source, graph_vid_t target,
+                                                graph_shard_id_t shard) {
+    adj_filters[true][shard].insert(target);
+    adj_filters[false][shard].insert(source);
+  }
+
+  // --------------- Analytics -----------------------
+  int graphdb_client::get_connected_components(graph_components::label_vector& labels,
+                                               thread_pool& pool) {
+    std::vector<graph_shard_id_t> shards;
+    for (size_t i = 0; i < shard_manager.num_shards(); ++i) shards.push_back(i);
+    QueryMessage qm(QueryMessage::GET, QueryMessage::COMPONENTS);
+    std::vector<query_result> futures;
+    queryobj.query_multi(shards, qm.message(), qm.length(), futures);
+    std::vector<graph_components::label_vector> shard_labels(futures.size());
+    for (size_t i = 0; i < futures.size(); ++i) {
+      int err = queryobj.parse_reply(futures[i], shard_labels[i]);
+      if (err != 0) return err;
+    }
+    graph_components::merge(shard_labels, pool, labels);
+    return 0;
+  }
+
   // --------------- Helper functions -----------------------
   graph_shard_id_t graphdb_client::eid2shard(const graph_eid_t& eid) { 
     return split_eid(eid).first;
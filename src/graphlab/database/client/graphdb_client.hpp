@@ -6,6 +6,9 @@
 #include<graphlab/database/graph_shard_manager.hpp>
 #include<graphlab/database/graphdb_query_object.hpp>
 #include<graphlab/database/query_message.hpp>
+#include<graphlab/database/graph_components.hpp>
+#include<graphlab/util/bloom_filter.hpp>
+#include<graphlab/parallel/pthread_tools.hpp>
 #include<map>
 #include<set>
 
@@ -22,7 +25,8 @@ namespace graphlab {
 
    public:
      /// Creates server with empty fields.
-     graphdb_client(graphdb_config& config) : queryobj(config), shard_manager(config.get_nshards()) {} 
+     graphdb_client(graphdb_config& config) : queryobj(config), shard_manager(config.get_nshards()),
+                                              use_adj_filters(false) {} 
      virtual ~graphdb_client() {};
 
      // --------------------- Basic Queries ----------------------------
@@ -73,6 +77,36 @@ namespace graphlab {
      bool set_vertices(const std::vector<std::pair<graph_vid_t, graph_row> >& pairs,
                        std::vector<int>& errorcodes);
 
+     // --------------------- Adjacency Filters -----------------------------------------
+     /**
+      * Fetches from every shard a bloom filter of the vertices with in
+      * edges and one of the vertices with out edges in the shard. From
+      * then on, get_vertex_adj() only queries the shards whose filter may
+      * contain the vertex.
+      *
+      * Edges added through this client are added to the filters. Edges
+      * added by other clients are not seen until the filters are fetched
+      * again, so the filters are meant for read mostly phases, e.g. after
+      * ingress. Returns 0, or the error of the first shard which failed,
+      * in which case the filters are not used.
+      */
+     int fetch_adjacency_filters();
+
+     /// Queries all the neighbor shards in get_vertex_adj() again
+     void disable_adjacency_filters();
+
+     // --------------------- Analytics -----------------------------------------
+     /**
+      * Computes the connected components of the graph, ignoring the edge
+      * directions. Every shard labels its own vertices and edges in
+      * parallel, and the labels are merged here on pool. On return, labels
+      * holds one (vid, component) pair for every vertex, where a component
+      * is identified by its smallest vid. Returns 0, or the error of the
+      * first shard which failed.
+      */
+     int get_connected_components(graph_components::label_vector& labels,
+                                  thread_pool& pool);
+
    private:
      // ---------------------- Helper functions ---------------------------------------
      int add_vertex_mirror(graph_vid_t, const std::vector<graph_shard_id_t>& mirrors);
@@ -89,6 +123,9 @@ namespace graphlab {
                             std::vector<Tout>* out_values, std::vector<int>& errorcodes) {
 
        bool success = true;
+       // the queries to all the shards are one traced request
+       trace_request_scope request;
+       trace_span span(QueryMessage::qm_cmd_type_str[query_header.cmd]);
        typedef std::map<graph_shard_id_t, std::vector<size_t> >::iterator map_iter_type;
        // group values by the shard id
        std::map<graph_shard_id_t, std::vector<size_t> > shard2valueid; 
@@ -181,6 +218,17 @@ namespace graphlab {
    private:
      graphdb_query_object queryobj;
      graph_shard_manager shard_manager;
+
+     // adj_filters[in_edges][shard], used if use_adj_filters. Both are
+     // protected by adj_filters_lock: lookups take it for reading, and
+     // inserts, fetches and disabling for writing.
+     std::vector<bloom_filter> adj_filters[2];
+     bool use_adj_filters;
+     rwlock adj_filters_lock;
+
+     /// Inserts an edge into the filters. Requires the write lock.
+     void add_to_adjacency_filters(graph_vid_t source, graph_vid_t target,
+                                   graph_shard_id_t shard);
   };
 }
 #endif
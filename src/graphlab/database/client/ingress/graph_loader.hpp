@@ -3,6 +3,8 @@
 #include <graphlab/database/client/ingress/ingress_worker.hpp>
 #include <graphlab/database/graph_database.hpp>
 #include <graphlab/parallel/thread_pool.hpp>
+#include <graphlab/parallel/mpmc_queue.hpp>
+#include <graphlab/util/memory_accounting.hpp>
 
 #include <boost/bind.hpp>
 #include <string>
@@ -16,17 +18,42 @@ namespace graphlab {
      void load_from_posixfs(std::string prefix, const std::string& format);
 
    private:
+     /// A block of consecutive lines handed from the reader to a parser
+     struct line_chunk {
+       std::vector<std::string> lines;
+       std::string filename;
+       size_t line_count_begin;
+       /// total length of the lines, counted as INGRESS_BUFFERS while queued
+       size_t bytes;
+       line_chunk(): line_count_begin(0), bytes(0) { }
+     };
+
      /**
        \internal
        This internal function is used to load a single line from an input stream
+
+       The calling thread reads lines into chunks of max_buffer lines and
+       hands them to the parser threads of the pool through a bounded
+       queue. The reader blocks when the parsers fall behind, so at most
+       a few chunks are held in memory at any time. A parser which fails
+       closes the queue, so that the reader stops and the error is thrown
+       from here instead of the load hanging.
        */
      template<typename Fstream>
          bool load_from_stream(const std::string& filename, Fstream& fin, 
                                const std::string& format) {
            size_t linecount = 0;
-           std::vector< std::vector<std::string> > line_buffers;
-           std::vector<std::string> buffer;
-           buffer.reserve(max_buffer);
+           mpmc_queue<line_chunk*> chunks(2 * pool.size(), true);
+           volatile bool failed = false;
+           for (size_t i = 0; i < pool.size(); ++i) {
+             pool.launch(boost::bind(&graph_loader::parse_chunks, this, &chunks,
+                                     format, &failed));
+           }
+
+           line_chunk* chunk = new line_chunk;
+           chunk->filename = filename;
+           chunk->line_count_begin = 1;
+           chunk->lines.reserve(max_buffer);
 
            timer ti; ti.start();
            while(fin.good() && !fin.eof()) {
@@ -35,33 +62,70 @@ namespace graphlab {
              if(line.empty()) continue;
              if(fin.fail()) break;
 
-             buffer.push_back(line);
+             chunk->lines.push_back(line);
+             chunk->bytes += line.size();
              ++linecount;      
 
-             if (buffer.size() == max_buffer) {
-               // add a worker
-               line_buffers.push_back(std::vector<std::string>());
-               line_buffers.back().swap(buffer);
-               pool.launch(boost::bind(&graph_loader::process_lines, this, line_buffers.back(), format, filename, linecount-buffer.size()+1));
+             if (chunk->lines.size() == max_buffer) {
+               // hand the chunk to a parser
+               if (!hand_off(chunks, chunk)) { chunk = NULL; break; }
+               chunk = new line_chunk;
+               chunk->filename = filename;
+               chunk->line_count_begin = linecount + 1;
+               chunk->lines.reserve(max_buffer);
              }
            }
 
-           // add the last worker
-           line_buffers.push_back(std::vector<std::string>());
-           line_buffers.back().swap(buffer);
-           pool.launch(boost::bind(&graph_loader::process_lines, this, line_buffers.back(), format, filename, linecount-buffer.size()+1));
-           pool.join();
-           line_buffers.clear();
+           // hand off the last chunk
+           if (chunk != NULL) hand_off(chunks, chunk);
+           chunks.close();
+           try {
+             pool.join();
+           } catch (...) {
+             // the chunks the parsers left behind
+             while (chunks.try_dequeue(chunk)) release(chunk);
+             throw;
+           }
            return true;
          }
 
    private:
-     void process_lines(std::vector<std::string>& lines,
-                        const std::string& format,
-                        const std::string& fname,
-                        size_t line_count_begin) {
-       ingress_worker worker(client, format);
-       worker.process_lines(lines, fname, line_count_begin);
+     /// Queues a chunk for the parsers. Deletes it and returns false if the
+     /// queue was closed by a failed parser.
+     bool hand_off(mpmc_queue<line_chunk*>& chunks, line_chunk* chunk) {
+       memory_accounting::add(memory_accounting::INGRESS_BUFFERS, chunk->bytes);
+       if (chunks.enqueue(chunk)) return true;
+       release(chunk);
+       return false;
+     }
+
+     static void release(line_chunk* chunk) {
+       memory_accounting::add(memory_accounting::INGRESS_BUFFERS,
+                              -(ptrdiff_t)chunk->bytes);
+       delete chunk;
+     }
+
+     /// Parses chunks from the queue until it is closed and drained, or
+     /// until a parser fails
+     void parse_chunks(mpmc_queue<line_chunk*>* chunks,
+                       const std::string& format, volatile bool* failed) {
+       // the chunk being parsed, released if the parser fails
+       line_chunk* chunk = NULL;
+       try {
+         ingress_worker worker(client, format);
+         while (!*failed && chunks->dequeue(chunk)) {
+           worker.process_lines(chunk->lines, chunk->filename,
+                                chunk->line_count_begin);
+           release(chunk);
+           chunk = NULL;
+         }
+       } catch (...) {
+         if (chunk != NULL) release(chunk);
+         // stop the reader and the other parsers
+         *failed = true;
+         chunks->close();
+         throw;
+       }
      }
 
      graphdb_client* client;
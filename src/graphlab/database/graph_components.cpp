@@ -0,0 +1,138 @@
+#include <graphlab/database/graph_components.hpp>
+#include <graphlab/util/union_find.hpp>
+#include <graphlab/util/concurrent_hash_map.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <boost/bind.hpp>
+
+namespace graphlab {
+  namespace {
+    /**
+     * Maps the vertex ids to dense indices as they are seen, and merges
+     * the components of the edges added from any number of threads.
+     */
+    class component_labeler {
+     public:
+      /// max_vertices bounds the number of distinct vertices added
+      component_labeler(size_t max_vertices)
+          : vids(max_vertices), used(max_vertices), uf(max_vertices) {
+        index.reserve(max_vertices);
+        used.clear();
+      }
+
+      void add_edge(graph_vid_t source, graph_vid_t target) {
+        uf.merge(get_index(source), get_index(target));
+      }
+
+      void add_edge_range(const graph_shard* shard, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          std::pair<graph_vid_t, graph_vid_t> e = shard->edge(i);
+          add_edge(e.first, e.second);
+        }
+      }
+
+      void add_vertex_range(const graph_shard* shard, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) get_index(shard->vertex(i));
+      }
+
+      // a (vid, label) pair is an edge between the two
+      void add_label_range(const graph_components::label_vector* labels,
+                           size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          add_edge((*labels)[i].first, (*labels)[i].second);
+        }
+      }
+
+      void get_labels(thread_pool& pool, graph_components::label_vector& out) {
+        // the label of a component is its smallest vid, stored at its root
+        min_vid.assign(vids.size(), graph_vid_t(-1));
+        size_t nblocks = (vids.size() + BLOCK - 1) / BLOCK;
+        pool.parallel_for(0, nblocks, boost::bind(&component_labeler::min_vid_range, this, _1, _2));
+        // indices lost to a race in get_index() are unused: compact the rest
+        block_offset.resize(nblocks + 1);
+        block_offset[0] = 0;
+        for (size_t b = 0; b < nblocks; ++b) {
+          block_offset[b + 1] = block_offset[b] +
+              used.popcount(b * BLOCK, std::min((b + 1) * BLOCK, vids.size()));
+        }
+        out.resize(block_offset[nblocks]);
+        pool.parallel_for(0, nblocks, boost::bind(&component_labeler::emit_range, this, &out, _1, _2));
+      }
+
+     private:
+      static const size_t BLOCK = 4096;
+
+      concurrent_hash_map<graph_vid_t, size_t> index;
+      atomic<size_t> next_index;
+      // vids[i] is the vid of index i, valid if used[i]
+      std::vector<graph_vid_t> vids;
+      dense_bitset used;
+      concurrent_union_find<size_t> uf;
+      std::vector<graph_vid_t> min_vid;
+      std::vector<size_t> block_offset;
+
+      size_t get_index(graph_vid_t vid) {
+        size_t i;
+        if (index.find(vid, i)) return i;
+        i = next_index.inc_ret_last();
+        ASSERT_LT(i, vids.size());
+        if (index.insert(vid, i)) {
+          vids[i] = vid;
+          used.set_bit(i);
+          return i;
+        }
+        // another thread inserted vid first
+        index.find(vid, i);
+        return i;
+      }
+
+      void min_vid_range(size_t begin, size_t end) {
+        end = std::min(end * BLOCK, vids.size());
+        for (size_t i = begin * BLOCK; i < end; ++i) {
+          if (!used.get(i)) continue;
+          graph_vid_t& m = min_vid[uf.find(i)];
+          graph_vid_t cur = m;
+          while (vids[i] < cur && !atomic_compare_and_swap(m, cur, vids[i])) cur = m;
+        }
+      }
+
+      void emit_range(graph_components::label_vector* out, size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+          size_t pos = block_offset[b];
+          size_t last = std::min((b + 1) * BLOCK, vids.size());
+          for (size_t i = b * BLOCK; i < last; ++i) {
+            if (used.get(i)) (*out)[pos++] = std::make_pair(vids[i], min_vid[uf.find(i)]);
+          }
+        }
+      }
+    };
+  } // anonymous namespace
+
+  void graph_components::label_shard(const graph_shard& shard, thread_pool& pool,
+                                     label_vector& out) {
+    component_labeler labeler(shard.num_vertices() + 2 * shard.num_edges());
+    pool.parallel_for(0, shard.num_vertices(),
+                      boost::bind(&component_labeler::add_vertex_range, &labeler, &shard, _1, _2));
+    pool.parallel_for(0, shard.num_edges(),
+                      boost::bind(&component_labeler::add_edge_range, &labeler, &shard, _1, _2));
+    labeler.get_labels(pool, out);
+  }
+
+  void graph_components::merge(const std::vector<label_vector>& shard_labels,
+                               thread_pool& pool, label_vector& out) {
+    size_t total = 0;
+    for (size_t i = 0; i < shard_labels.size(); ++i) total += shard_labels[i].size();
+    component_labeler labeler(2 * total);
+    for (size_t i = 0; i < shard_labels.size(); ++i) {
+      pool.parallel_for(0, shard_labels[i].size(),
+                        boost::bind(&component_labeler::add_label_range, &labeler, &shard_labels[i], _1, _2));
+    }
+    labeler.get_labels(pool, out);
+  }
+
+  size_t graph_components::num_components(const label_vector& labels) {
+    size_t ret = 0;
+    for (size_t i = 0; i < labels.size(); ++i) ret += (labels[i].first == labels[i].second);
+    return ret;
+  }
+} // namespace graphlab
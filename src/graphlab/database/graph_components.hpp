@@ -0,0 +1,50 @@
+#ifndef GRAPHLAB_DATABASE_GRAPH_COMPONENTS_HPP
+#define GRAPHLAB_DATABASE_GRAPH_COMPONENTS_HPP
+#include <vector>
+#include <utility>
+#include <graphlab/database/basic_types.hpp>
+#include <graphlab/database/graph_shard.hpp>
+#include <graphlab/parallel/thread_pool.hpp>
+
+namespace graphlab {
+/**
+ * \ingroup group_graph_database
+ * Computes the connected components of the graph, ignoring the edge
+ * directions.
+ *
+ * Each shard labels the vertices it knows about (its vertices and the
+ * endpoints of its edges) using its own edges only: the edges are merged
+ * in parallel into a concurrent_union_find. The labels of a shard are a
+ * compact summary of its connectivity, with one pair per vertex, and the
+ * labels of all the shards are merged the same way into the components
+ * of the whole graph. A shard server computes the labels of its shard
+ * (GET COMPONENTS) and the client merges them, see
+ * graphdb_client::get_connected_components().
+ *
+ * The label of a component is its smallest vertex id, so the result
+ * does not depend on the order of the merges.
+ */
+class graph_components {
+ public:
+  /// A list of (vertex id, component label) pairs
+  typedef std::vector<std::pair<graph_vid_t, graph_vid_t> > label_vector;
+
+  /**
+   * Labels the vertices of the shard and the endpoints of its edges with
+   * the components of the subgraph made of the shard edges.
+   */
+  static void label_shard(const graph_shard& shard, thread_pool& pool,
+                          label_vector& out);
+
+  /**
+   * Combines the labels computed on several shards, which may share
+   * vertices, into the labels of the union of the shards.
+   */
+  static void merge(const std::vector<label_vector>& shard_labels,
+                    thread_pool& pool, label_vector& out);
+
+  /// Returns the number of components in labels
+  static size_t num_components(const label_vector& labels);
+};
+} // namespace graphlab
+#endif
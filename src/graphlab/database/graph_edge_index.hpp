@@ -69,7 +69,24 @@ namespace graphlab {
       outEdges.clear();
     }
 
+    /// Returns an estimate of the memory used by the index
+    size_t memory_bytes() const {
+      return map_bytes(inEdges) + map_bytes(outEdges);
+    }
+
    private:
+    typedef boost::unordered_map<graph_vid_t, std::vector<graph_leid_t> > edge_map;
+
+    // buckets, nodes (element, next pointer and hash) and edge lists
+    static size_t map_bytes(const edge_map& map) {
+      size_t ret = map.bucket_count() * sizeof(void*) +
+          map.size() * (sizeof(edge_map::value_type) + 2 * sizeof(void*));
+      for (edge_map::const_iterator iter = map.begin(); iter != map.end(); ++iter) {
+        ret += iter->second.capacity() * sizeof(graph_leid_t);
+      }
+      return ret;
+    }
+
     // A vector where each element is a map from vid to a list of in edge ids on a shard.
     boost::unordered_map<graph_vid_t, std::vector<graph_leid_t> > inEdges;
 
@@ -17,7 +17,9 @@ struct graph_field {
   std::string name;
   bool is_indexed;
   graph_datatypes_enum type;
-  // not used yet... TODO: check max_data_length for graph_value.
+  // For a DOUBLE_VEC_TYPE field, the number of elements of every non
+  // NULL value, or 0 if the values may have any number of elements.
+  // Ignored for the other types.
   size_t max_data_length; 
 
   inline graph_field() {}
@@ -25,6 +27,9 @@ struct graph_field {
   inline graph_field(std::string name, graph_datatypes_enum type) :
      name(name), is_indexed(false), type(type), max_data_length(0) {} 
 
+  inline graph_field(std::string name, graph_datatypes_enum type, size_t max_data_length) :
+     name(name), is_indexed(false), type(type), max_data_length(max_data_length) {} 
+
   inline void save(oarchive &oarc) const {
     oarc << name << is_indexed << type << max_data_length;
   }
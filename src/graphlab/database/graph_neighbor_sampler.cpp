@@ -0,0 +1,88 @@
+#include <graphlab/database/graph_neighbor_sampler.hpp>
+
+namespace graphlab {
+  namespace {
+    // weight of an edge from a numeric field, 0 otherwise
+    double field_weight(const graph_row* row, size_t fieldpos) {
+      const graph_value* val = fieldpos < row->num_fields() ? row->get_field(fieldpos) : NULL;
+      if (val == NULL || val->is_null()) return 0;
+      graph_double_t d;
+      if (val->get_double(&d)) return d > 0 ? d : 0;
+      graph_int_t i;
+      if (val->get_integer(&i)) return i > 0 ? (double)i : 0;
+      return 0;
+    }
+  } // anonymous namespace
+
+  void graph_neighbor_sampler::init(graph_shard& shard, bool in_edges, weighting w,
+                                    size_t weight_field) {
+    weights = w;
+    index.clear();
+    offsets.clear();
+    neighbors.clear();
+    prob.clear();
+    alias.clear();
+
+    // counting sort of the edges by their source (or target)
+    std::vector<size_t> degree;
+    boost::unordered_map<graph_vid_t, size_t> shard_degree;
+    for (size_t i = 0; i < shard.num_edges(); ++i) {
+      std::pair<graph_vid_t, graph_vid_t> e = shard.edge(i);
+      graph_vid_t from = in_edges ? e.second : e.first;
+      std::pair<boost::unordered_map<graph_vid_t, size_t>::iterator, bool> ins =
+          index.insert(std::make_pair(from, degree.size()));
+      if (ins.second) degree.push_back(0);
+      ++degree[ins.first->second];
+      if (w == NEIGHBOR_DEGREE) {
+        ++shard_degree[e.first];
+        ++shard_degree[e.second];
+      }
+    }
+    offsets.resize(degree.size() + 1);
+    offsets[0] = 0;
+    for (size_t i = 0; i < degree.size(); ++i) offsets[i + 1] = offsets[i] + degree[i];
+    neighbors.resize(shard.num_edges());
+    std::vector<double> edge_weights(w == UNIFORM ? 0 : shard.num_edges());
+    std::vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < shard.num_edges(); ++i) {
+      std::pair<graph_vid_t, graph_vid_t> e = shard.edge(i);
+      graph_vid_t from = in_edges ? e.second : e.first;
+      graph_vid_t to = in_edges ? e.first : e.second;
+      size_t p = pos[index[from]]++;
+      neighbors[p] = to;
+      if (w == NEIGHBOR_DEGREE) edge_weights[p] = shard_degree[to];
+      else if (w == EDGE_FIELD) edge_weights[p] = field_weight(shard.edge_data(i), weight_field);
+    }
+    if (w == UNIFORM) return;
+
+    prob.resize(neighbors.size());
+    alias.resize(neighbors.size());
+    for (size_t i = 0; i < degree.size(); ++i) {
+      size_t begin = offsets[i];
+      double sum = 0;
+      for (size_t j = begin; j < offsets[i + 1]; ++j) sum += edge_weights[j];
+      if (sum == 0) {
+        for (size_t j = begin; j < offsets[i + 1]; ++j) edge_weights[j] = 1;
+      }
+      random::alias_table::build(&edge_weights[begin], degree[i], &prob[begin], &alias[begin]);
+    }
+  }
+
+  size_t graph_neighbor_sampler::num_neighbors(graph_vid_t vid) const {
+    boost::unordered_map<graph_vid_t, size_t>::const_iterator iter = index.find(vid);
+    if (iter == index.end()) return 0;
+    return offsets[iter->second + 1] - offsets[iter->second];
+  }
+
+  size_t graph_neighbor_sampler::random_walk(graph_vid_t start, size_t length,
+                                             random::philox_stream& stream,
+                                             std::vector<graph_vid_t>& path) const {
+    path.push_back(start);
+    graph_vid_t cur = start;
+    for (size_t step = 0; step < length; ++step) {
+      if (!sample(cur, stream, cur)) return step;
+      path.push_back(cur);
+    }
+    return length;
+  }
+} // namespace graphlab
@@ -0,0 +1,90 @@
+#ifndef GRAPHLAB_DATABASE_GRAPH_NEIGHBOR_SAMPLER_HPP
+#define GRAPHLAB_DATABASE_GRAPH_NEIGHBOR_SAMPLER_HPP
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <graphlab/database/basic_types.hpp>
+#include <graphlab/database/graph_shard.hpp>
+#include <graphlab/util/random_stream.hpp>
+
+namespace graphlab {
+/**
+ * \ingroup group_graph_database
+ * Draws random neighbors of the vertices of a shard, for random walks and
+ * negative sampling.
+ *
+ * init() copies the adjacency of the shard into flat arrays (one range of
+ * neighbors per vertex) and builds one alias table per vertex over its
+ * neighbors, so a draw is O(1) whatever the degree. The neighbors can be
+ * weighted uniformly, by their degree in the shard, or by a numeric edge
+ * field. The sampler is a snapshot: edges added to the shard afterwards
+ * are not seen until init() is called again. Draws are const, and may
+ * run concurrently with one stream per thread.
+ */
+class graph_neighbor_sampler {
+ public:
+  enum weighting {
+    UNIFORM,          ///< all the neighbors are equally likely
+    NEIGHBOR_DEGREE,  ///< proportional to the number of edges of the neighbor in the shard
+    EDGE_FIELD        ///< proportional to a numeric field of the edge
+  };
+
+  graph_neighbor_sampler() : weights(UNIFORM) { }
+
+  /**
+   * Indexes the out neighbors of every vertex of the shard, or the in
+   * neighbors if in_edges. With EDGE_FIELD, the weight of an edge is its
+   * field at weight_field, and edges whose field is null or not numeric
+   * have weight 0. A vertex whose neighbors all have weight 0 gets
+   * uniform weights.
+   */
+  void init(graph_shard& shard, bool in_edges, weighting w = UNIFORM,
+            size_t weight_field = 0);
+
+  /// Returns the number of vertices with at least one neighbor
+  size_t num_vertices() const { return index.size(); }
+
+  /// Returns the number of neighbors of vid in the shard
+  size_t num_neighbors(graph_vid_t vid) const;
+
+  /**
+   * Stores a random neighbor of vid in out. Returns false if vid has no
+   * neighbor in the shard.
+   */
+  inline bool sample(graph_vid_t vid, random::philox_stream& stream, graph_vid_t& out) const {
+    boost::unordered_map<graph_vid_t, size_t>::const_iterator iter = index.find(vid);
+    if (iter == index.end()) return false;
+    out = sample_at(iter->second, stream.next());
+    return true;
+  }
+
+  /**
+   * Walks from start to a random neighbor length times, and appends the
+   * visited vertices, start included, to path. Stops early at a vertex
+   * without neighbors in the shard. Returns the number of steps taken.
+   */
+  size_t random_walk(graph_vid_t start, size_t length, random::philox_stream& stream,
+                     std::vector<graph_vid_t>& path) const;
+
+ private:
+  weighting weights;
+  // vid -> position of its range in offsets
+  boost::unordered_map<graph_vid_t, size_t> index;
+  // the neighbors of the i-th vertex are neighbors[offsets[i]..offsets[i+1])
+  std::vector<size_t> offsets;
+  std::vector<graph_vid_t> neighbors;
+  // the alias table of the i-th vertex, over the same range. alias is
+  // relative to the start of the range. Empty if UNIFORM.
+  std::vector<uint32_t> prob;
+  std::vector<uint32_t> alias;
+
+  inline graph_vid_t sample_at(size_t i, uint64_t bits) const {
+    size_t begin = offsets[i];
+    size_t n = offsets[i + 1] - begin;
+    if (weights == UNIFORM) {
+      return neighbors[begin + (size_t)(((bits & 0xFFFFFFFFULL) * n) >> 32)];
+    }
+    return neighbors[begin + random::alias_table::sample(&prob[begin], &alias[begin], n, bits)];
+  }
+};
+} // namespace graphlab
+#endif
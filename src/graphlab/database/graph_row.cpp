@@ -1,3 +1,5 @@
+#include <cstdlib>
+#include <cstring>
 #include <graphlab/database/graph_row.hpp>
 namespace graphlab {
   graph_row::graph_row(const std::vector<graph_field>& fields, bool is_vertex) : _is_vertex(is_vertex) {
@@ -11,6 +13,156 @@ namespace graphlab {
     graph_value v(field.type);
     _data.push_back(v);
   }
+
+  void graph_row::load(iarchive& iarc, graph_value_arena* arena) {
+    size_t nfields, count;
+    iarc >> _is_vertex >> nfields >> count;
+    ASSERT_EQ(nfields, count);
+    _data.resize(nfields);
+    for (size_t i = 0; i < nfields; ++i) _data[i].load(iarc, arena);
+  }
+
+namespace archive_detail {
+  // Rows are flushed to a stream archive in batches of about this many bytes.
+  static const size_t ROW_BATCH_BYTES = 64 * 1024;
+
+  template <typename T>
+  static inline void put(char*& dst, const T& t) {
+    memcpy(dst, &t, sizeof(T));
+    dst += sizeof(T);
+  }
+
+  /// Fails unless [src, end) holds at least len bytes
+  static inline void check_room(const char* src, const char* end, size_t len) {
+    ASSERT_LE(len, size_t(end - src));
+  }
+
+  template <typename T>
+  static inline void get(const char*& src, const char* end, T& t) {
+    check_room(src, end, sizeof(T));
+    memcpy(&t, src, sizeof(T));
+    src += sizeof(T);
+  }
+
+  // the smallest encoding of a field and of a row
+  static const size_t MIN_FIELD_BYTES =
+      sizeof(graph_datatypes_enum) + sizeof(bool) + sizeof(size_t);
+  static const size_t MIN_ROW_BYTES = sizeof(bool) + 2 * sizeof(size_t);
+
+  /**
+   * Encodes the row into dst in the format of graph_row::save().
+   * dst must have room for row.serialized_size() bytes.
+   */
+  static char* encode_row(char* dst, const graph_row& row) {
+    put(dst, row._is_vertex);
+    // the vector serializer writes the length twice
+    put(dst, row._data.size());
+    put(dst, row._data.size());
+    for (size_t i = 0; i < row._data.size(); ++i) {
+      const graph_value& v = row._data[i];
+      put(dst, v._type);
+      put(dst, v._null_value);
+      put(dst, v._len);
+      if (!v._null_value) {
+        memcpy(dst, v.bytes(), v._len);
+        dst += v._len;
+      }
+    }
+    return dst;
+  }
+
+  /// Encodes the row at the end of a memory backed archive.
+  static inline void append_row(oarchive& oarc, const graph_row& row) {
+    oarc.expand_buf(row.serialized_size());
+    oarc.off = encode_row(oarc.buf + oarc.off, row) - oarc.buf;
+  }
+
+  /**
+   * Decodes a row written by graph_row::save() out of [src, end). Returns
+   * the new position. Fails with an assertion if the row is truncated or
+   * its lengths are corrupt.
+   */
+  static const char* decode_row(const char* src, const char* end,
+                                graph_row& row, graph_value_arena* arena) {
+    size_t nfields, count;
+    get(src, end, row._is_vertex);
+    get(src, end, nfields);
+    get(src, end, count);
+    ASSERT_EQ(nfields, count);
+    ASSERT_LE(nfields, size_t(end - src) / MIN_FIELD_BYTES);
+    row._data.resize(nfields);
+    for (size_t i = 0; i < nfields; ++i) {
+      graph_value& v = row._data[i];
+      size_t len;
+      get(src, end, v._type);
+      get(src, end, v._null_value);
+      get(src, end, len);
+      if (!v._null_value) check_room(src, end, len);
+      if (v._null_value || is_scalar_graph_datatype(v._type)) {
+        v.free_data();
+        if (!v._null_value) {
+          ASSERT_LE(len, sizeof(v._data));
+          memcpy(&v._data, src, len);
+        }
+        v._len = len;
+      } else {
+        memcpy(v.reserve_bytes(len, arena), src, len);
+      }
+      if (!v._null_value) src += len;
+    }
+    return src;
+  }
+
+  void vector_serialize_impl<oarchive, graph_row, false>::exec(
+      oarchive& oarc, const std::vector<graph_row>& vec) {
+    oarc << size_t(vec.size()) << size_t(vec.size());
+    if (oarc.segments != NULL) {
+      // scatter-gather: let graph_value::save() reference the large values
+      for (size_t i = 0; i < vec.size(); ++i) oarc << vec[i];
+    } else if (oarc.out == NULL) {
+      for (size_t i = 0; i < vec.size(); ++i) append_row(oarc, vec[i]);
+    } else {
+      // encode into a scratch buffer and hand the stream large writes
+      oarchive scratch;
+      scratch.reserve(ROW_BATCH_BYTES);
+      for (size_t i = 0; i < vec.size(); ++i) {
+        append_row(scratch, vec[i]);
+        if (scratch.off >= ROW_BATCH_BYTES) {
+          oarc.write(scratch.buf, scratch.off);
+          scratch.off = 0;
+        }
+      }
+      if (scratch.off > 0) oarc.write(scratch.buf, scratch.off);
+      free(scratch.buf);
+    }
+  }
+
+  void vector_deserialize_impl<iarchive, graph_row, false>::exec(
+      iarchive& iarc, std::vector<graph_row>& vec) {
+    load_rows(iarc, vec, NULL);
+  }
+} // namespace archive_detail
+
+  void load_rows(iarchive& iarc, std::vector<graph_row>& rows, graph_value_arena* arena) {
+    size_t len, count;
+    iarc >> len >> count;
+    ASSERT_EQ(len, count);
+    rows.clear();
+    if (iarc.buf != NULL) {
+      ASSERT_LE(iarc.off, iarc.len);
+      const char* src = iarc.buf + iarc.off;
+      const char* end = iarc.buf + iarc.len;
+      ASSERT_LE(len, size_t(end - src) / archive_detail::MIN_ROW_BYTES);
+      rows.resize(len);
+      for (size_t i = 0; i < len; ++i) {
+        src = archive_detail::decode_row(src, end, rows[i], arena);
+      }
+      iarc.off = src - iarc.buf;
+    } else {
+      rows.resize(len);
+      for (size_t i = 0; i < len; ++i) rows[i].load(iarc, arena);
+    }
+  }
 } // namespace graphlab
 
 // out_row._database = _database;
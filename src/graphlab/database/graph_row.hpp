@@ -4,8 +4,10 @@
 #include <graphlab/database/basic_types.hpp>
 #include <graphlab/database/graph_field.hpp>
 #include <graphlab/database/graph_value.hpp>
+#include <graphlab/database/graph_value_arena.hpp>
 #include <graphlab/serialization/iarchive.hpp>
 #include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/serialization/vector.hpp>
 #include <graphlab/logger/assertions.hpp>
 
 namespace graphlab {
@@ -98,6 +100,30 @@ class graph_row {
       return NULL; 
   }
 
+  /**
+   * Returns the number of bytes written by save(). Used to size output
+   * buffers before serializing a batch of rows.
+   */
+  inline size_t serialized_size() const {
+    size_t ret = sizeof(bool) + 2 * sizeof(size_t);
+    for (size_t i = 0; i < _data.size(); ++i) {
+      ret += _data[i].serialized_size();
+    }
+    return ret;
+  }
+
+  /**
+   * Returns the number of bytes allocated for the fields of the row,
+   * besides the graph_row itself.
+   */
+  inline size_t heap_bytes() const {
+    size_t ret = _data.capacity() * sizeof(graph_value);
+    for (size_t i = 0; i < _data.size(); ++i) {
+      ret += _data[i].heap_bytes();
+    }
+    return ret;
+  }
+
   /**
    * Serialization interface. Save the values and associated state into oarchive.
    */
@@ -113,6 +139,12 @@ class graph_row {
     iarc >> _is_vertex >> _data;
   }
 
+  /**
+   * Loads the row, allocating its long strings / blobs from arena if it
+   * is not NULL. See graph_value_arena.
+   */
+  void load (iarchive& iarc, graph_value_arena* arena);
+
  private:
   
   /**
@@ -133,5 +165,33 @@ class graph_row {
     return strm;
   }
 };
+
+/**
+ * Loads an array of rows saved with <code>oarc << rows</code>, allocating
+ * the long strings / blobs from arena if it is not NULL.
+ */
+void load_rows(iarchive& iarc, std::vector<graph_row>& rows, graph_value_arena* arena);
+
+namespace archive_detail {
+  /**
+   * Batch encoder for arrays of rows (the vertex_data and edge_data columns
+   * of a shard). Each row is sized once and encoded directly into the
+   * archive buffer, instead of going through the archive once per field.
+   * The output is byte compatible with the generic vector serializer.
+   */
+  template <>
+  struct vector_serialize_impl<oarchive, graph_row, false> {
+    static void exec(oarchive& oarc, const std::vector<graph_row>& vec);
+  };
+
+  /**
+   * Batch decoder for arrays of rows. Decodes straight out of the archive
+   * buffer when reading from memory.
+   */
+  template <>
+  struct vector_deserialize_impl<iarchive, graph_row, false> {
+    static void exec(iarchive& iarc, std::vector<graph_row>& vec);
+  };
+} // namespace archive_detail
 } // namespace graphlab 
 #endif
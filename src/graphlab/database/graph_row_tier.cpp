@@ -0,0 +1,187 @@
+#include <cstdlib>
+#include <graphlab/database/graph_row_tier.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+  namespace {
+    // rows written with one bulk_set()
+    const size_t EVICTION_BATCH = 256;
+    // rows read with one bulk_get() by fetch_all()
+    const size_t FETCH_BATCH = 4096;
+
+    value_type serialize_row(const graph_row& row) {
+      oarchive oarc;
+      oarc << row;
+      value_type ret(oarc.buf, oarc.off);
+      free(oarc.buf);
+      return ret;
+    }
+  } // anonymous namespace
+
+  void graph_row_tier::init(kvstore_base& store, size_t memory_budget, double low_watermark) {
+    this->store = &store;
+    this->budget = memory_budget;
+    this->low_watermark = low_watermark;
+    clear();
+  }
+
+  void graph_row_tier::clear() {
+    vertex_state.clear();
+    edge_state.clear();
+    hand = 0;
+    counters = stats();
+    if (store != NULL) {
+      grow(false, shard->num_vertices());
+      grow(true, shard->num_edges());
+    }
+  }
+
+  void graph_row_tier::grow(bool is_edge, size_t size) {
+    std::vector<row_state>& states = is_edge ? edge_state : vertex_state;
+    size_t old_size = states.size();
+    states.resize(size);
+    for (size_t i = old_size; i < size; ++i) {
+      states[i].bytes = shard_row(is_edge, i)->heap_bytes();
+      counters.resident_bytes += states[i].bytes;
+      ++counters.resident_rows;
+    }
+  }
+
+  key_type graph_row_tier::row_key(bool is_edge, size_t pos) const {
+    ASSERT_LT(pos, uint64_t(1) << 47);
+    return ((key_type)shard->id() << 48) | ((key_type)is_edge << 47) | pos;
+  }
+
+  graph_row* graph_row_tier::access(bool is_edge, size_t pos) {
+    row_state& s = state(is_edge, pos);
+    if (!s.resident) {
+      std::vector<size_t> vertex_pos, edge_pos;
+      (is_edge ? edge_pos : vertex_pos).push_back(pos);
+      fetch(vertex_pos, edge_pos);
+    }
+    if (s.freq < 255) ++s.freq;
+    return shard_row(is_edge, pos);
+  }
+
+  void graph_row_tier::fetch(const std::vector<size_t>& vertex_pos,
+                             const std::vector<size_t>& edge_pos) {
+    if (store == NULL) return;
+    std::vector<key_type> keys;
+    std::vector<std::pair<bool, size_t> > rows;
+    for (size_t kind = 0; kind < 2; ++kind) {
+      bool is_edge = kind == 1;
+      const std::vector<size_t>& positions = is_edge ? edge_pos : vertex_pos;
+      for (size_t i = 0; i < positions.size(); ++i) {
+        row_state& s = state(is_edge, positions[i]);
+        if (s.resident) continue;
+        // resident from now on, so that duplicates are fetched once
+        s.resident = true;
+        keys.push_back(row_key(is_edge, positions[i]));
+        rows.push_back(std::make_pair(is_edge, positions[i]));
+      }
+    }
+    if (keys.empty()) return;
+
+    std::vector<std::pair<bool, value_type> > values = store->bulk_get(keys);
+    ++counters.fetch_batches;
+    for (size_t i = 0; i < rows.size(); ++i) {
+      ASSERT_MSG(values[i].first, "Row %llu is missing from the store",
+                 (unsigned long long)keys[i]);
+      graph_row* row = shard_row(rows[i].first, rows[i].second);
+      iarchive iarc(values[i].second.data(), values[i].second.size());
+      iarc >> *row;
+      row_state& s = state(rows[i].first, rows[i].second);
+      s.bytes = row->heap_bytes();
+      s.dirty = false;
+      counters.resident_bytes += s.bytes;
+      ++counters.resident_rows;
+      --counters.evicted_rows;
+      ++counters.fetches;
+    }
+  }
+
+  void graph_row_tier::fetch_all() {
+    if (store == NULL) return;
+    std::vector<size_t> positions, none;
+    for (size_t kind = 0; kind < 2; ++kind) {
+      bool is_edge = kind == 1;
+      const std::vector<row_state>& states = is_edge ? edge_state : vertex_state;
+      for (size_t i = 0; i < states.size(); ++i) {
+        if (!states[i].resident) positions.push_back(i);
+        if (positions.size() == FETCH_BATCH || (i + 1 == states.size() && !positions.empty())) {
+          if (is_edge) fetch(none, positions);
+          else fetch(positions, none);
+          positions.clear();
+        }
+      }
+    }
+  }
+
+  void graph_row_tier::mark_dirty(bool is_edge, size_t pos) {
+    if (store == NULL) return;
+    row_state& s = state(is_edge, pos);
+    ASSERT_TRUE(s.resident);
+    s.dirty = true;
+    size_t bytes = shard_row(is_edge, pos)->heap_bytes();
+    counters.resident_bytes += bytes;
+    counters.resident_bytes -= s.bytes;
+    s.bytes = bytes;
+  }
+
+  void graph_row_tier::mark_all_dirty(bool is_edge) {
+    if (store == NULL) return;
+    size_t size = is_edge ? shard->num_edges() : shard->num_vertices();
+    for (size_t i = 0; i < size; ++i) mark_dirty(is_edge, i);
+  }
+
+  void graph_row_tier::enforce_budget() {
+    if (store == NULL || counters.resident_bytes <= budget) return;
+    grow(false, shard->num_vertices());
+    grow(true, shard->num_edges());
+    const size_t target = (size_t)(budget * low_watermark);
+    std::vector<std::pair<key_type, value_type> > writes;
+    std::vector<graph_row*> victims;
+    while (counters.resident_bytes > target) {
+      if (hand >= vertex_state.size() + edge_state.size()) hand = 0;
+      bool is_edge = hand >= vertex_state.size();
+      size_t pos = is_edge ? hand - vertex_state.size() : hand;
+      ++hand;
+      row_state& s = is_edge ? edge_state[pos] : vertex_state[pos];
+      // the counters are halved at every pass, so this terminates
+      if (!s.resident || s.bytes == 0) continue;
+      if (s.freq > 0) {
+        s.freq >>= 1;
+        continue;
+      }
+      graph_row* row = shard_row(is_edge, pos);
+      if (s.dirty || !s.stored) {
+        writes.push_back(std::make_pair(row_key(is_edge, pos), serialize_row(*row)));
+        ++counters.writes;
+      }
+      victims.push_back(row);
+      counters.resident_bytes -= s.bytes;
+      --counters.resident_rows;
+      ++counters.evicted_rows;
+      ++counters.evictions;
+      s.bytes = 0;
+      s.resident = false;
+      s.dirty = false;
+      s.stored = true;
+      if (victims.size() == EVICTION_BATCH || counters.resident_bytes <= target) {
+        // the rows are released once the store has them
+        store->bulk_set(writes);
+        for (size_t i = 0; i < victims.size(); ++i) {
+          std::vector<graph_value>().swap(victims[i]->_data);
+        }
+        writes.clear();
+        victims.clear();
+      }
+    }
+  }
+
+  graph_row_tier::stats graph_row_tier::get_stats() const {
+    return counters;
+  }
+} // namespace graphlab
@@ -0,0 +1,143 @@
+#ifndef GRAPHLAB_DATABASE_GRAPH_ROW_TIER_HPP
+#define GRAPHLAB_DATABASE_GRAPH_ROW_TIER_HPP
+#include <vector>
+#include <graphlab/database/basic_types.hpp>
+#include <graphlab/database/graph_shard.hpp>
+#include <graphlab/database/kvstore_base.hpp>
+
+namespace graphlab {
+/**
+ * \ingroup group_graph_database
+ * Keeps the rows of a graph_shard within a memory budget, by evicting the
+ * cold rows to a kvstore_base and fetching them back on access.
+ *
+ * The columns and the indexes of the shard stay in memory: only the
+ * values of the rows are evicted, and an evicted row is left in the shard
+ * as an empty row. The budget counts the heap bytes of the resident rows
+ * (graph_row::heap_bytes()).
+ *
+ * Every access increments a saturating counter of the row. When the
+ * resident rows exceed the budget, enforce_budget() sweeps the rows like
+ * a clock, halving the counters it passes, and evicts the rows whose
+ * counter is 0 until the rows fit in low_watermark of the budget. So the
+ * rows accessed often since the last sweeps stay in memory. Evicted rows
+ * which were not modified since they were fetched are not written again.
+ *
+ * The pointers returned by vertex_row() and edge_row() are valid until
+ * the next call to enforce_budget(). The rows must be accessed through the
+ * tier: e.g. fetch_all() before saving the shard or scanning its rows
+ * directly. Like the shard, the tier is not thread safe.
+ *
+ * Rows are stored under the key (shard id, is edge, position), so several
+ * shards may share a store.
+ */
+class graph_row_tier {
+ public:
+  struct stats {
+    size_t resident_rows;
+    size_t resident_bytes;
+    size_t evicted_rows;
+    /// Rows read from the store
+    size_t fetches;
+    /// Calls to bulk_get() for them
+    size_t fetch_batches;
+    size_t evictions;
+    /// Evicted rows written to the store
+    size_t writes;
+    stats() : resident_rows(0), resident_bytes(0), evicted_rows(0), fetches(0),
+              fetch_batches(0), evictions(0), writes(0) { }
+  };
+
+  /// Creates a tier for the rows of shard, disabled until init()
+  explicit graph_row_tier(graph_shard& shard)
+      : shard(&shard), store(NULL), budget(0), low_watermark(0.9), hand(0) { }
+
+  /**
+   * Starts tiering the rows of the shard to store, which must outlive the
+   * tier. The rows already in the shard are resident and modified.
+   */
+  void init(kvstore_base& store, size_t memory_budget, double low_watermark = 0.9);
+
+  /// Returns true if init() was called
+  bool enabled() const { return store != NULL; }
+
+  /// Forgets all the rows. The rows in the store are overwritten as needed.
+  void clear();
+
+  /**
+   * Returns the data of the vertex at position pos of the shard, fetching
+   * it if it was evicted, and counts an access.
+   */
+  inline graph_row* vertex_row(size_t pos) {
+    if (store == NULL) return shard_row(false, pos);
+    return access(false, pos);
+  }
+
+  /// Like vertex_row(), for the edge at position pos
+  inline graph_row* edge_row(size_t pos) {
+    if (store == NULL) return shard_row(true, pos);
+    return access(true, pos);
+  }
+
+  /// Fetches the evicted rows among the given positions with one bulk_get()
+  void fetch(const std::vector<size_t>& vertex_pos, const std::vector<size_t>& edge_pos);
+
+  /// Fetches all the evicted rows
+  void fetch_all();
+
+  /**
+   * Records that the row was modified (or added to the shard: rows at
+   * positions the tier does not know yet are added).
+   */
+  void mark_dirty(bool is_edge, size_t pos);
+
+  /// Marks all the vertex (or edge) rows modified, e.g. after a schema change
+  void mark_all_dirty(bool is_edge);
+
+  /// Evicts the cold rows while the resident rows exceed the budget
+  void enforce_budget();
+
+  stats get_stats() const;
+
+ private:
+  struct row_state {
+    // number of heap bytes of the row, if resident
+    uint32_t bytes;
+    // access counter, halved by the sweeps
+    uint8_t freq;
+    bool resident;
+    // modified since the last write to the store
+    bool dirty;
+    // the store has a copy
+    bool stored;
+    row_state() : bytes(0), freq(0), resident(true), dirty(true), stored(false) { }
+  };
+
+  graph_shard* shard;
+  kvstore_base* store;
+  size_t budget;
+  double low_watermark;
+  std::vector<row_state> vertex_state;
+  std::vector<row_state> edge_state;
+  // position of the sweep over the vertex rows, then the edge rows
+  size_t hand;
+  stats counters;
+
+  inline graph_row* shard_row(bool is_edge, size_t pos) {
+    return is_edge ? shard->edge_data(pos) : shard->vertex_data(pos);
+  }
+
+  inline row_state& state(bool is_edge, size_t pos) {
+    std::vector<row_state>& states = is_edge ? edge_state : vertex_state;
+    if (pos >= states.size()) grow(is_edge, pos + 1);
+    return states[pos];
+  }
+
+  graph_row* access(bool is_edge, size_t pos);
+
+  void grow(bool is_edge, size_t size);
+
+  key_type row_key(bool is_edge, size_t pos) const;
+};
+} // namespace graphlab
+#endif
@@ -67,6 +67,20 @@ class graph_shard {
    */ 
   inline size_t num_edges() const { return shard_impl.edge.size(); }
 
+  /**
+   * Returns an estimate of the number of bytes of vertex and edge data
+   * held by the shard (see graph_shard_impl::serialized_size_estimate()).
+   */
+  inline size_t data_bytes() const { return shard_impl.serialized_size_estimate(); }
+
+  /**
+   * Adds the memory used by the shard to usage.
+   * See graph_shard_impl::memory_usage().
+   */
+  inline void memory_usage(memory_accounting::usage& usage) const {
+    shard_impl.memory_usage(usage);
+  }
+
   /**
    * Returns the ID of the vertex in the i'th position in this shard.
    * i must range from 0 to num_vertices() - 1 inclusive.
@@ -107,13 +121,22 @@ class graph_shard {
      return mirrors(pos);
    }
 
+   /**
+    * Fills pos with the position of the vertex with vid in this shard.
+    * Returns false if the vertex is not owned by this shard.
+    */
+   inline bool vertex_position(const graph_vid_t& vid, size_t& pos) const {
+     return shard_impl.vertex_index.find_index(vid, pos);
+   }
+
    /**
     * Returns the data of vertex with vid. Return NULL if there is no vertex 
     * data associated with vid in this shard.
     */
    inline graph_row* vertex_data_by_id (const graph_vid_t& vid) {
-     if (has_vertex(vid)) {
-       return vertex_data(shard_impl.vertex_index.get_index(vid));
+     size_t pos = 0;
+     if (shard_impl.vertex_index.find_index(vid, pos)) {
+       return vertex_data(pos);
      } else {
        return NULL;
      }
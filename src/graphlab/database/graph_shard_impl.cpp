@@ -27,15 +27,64 @@ namespace graphlab {
   }
 
   void graph_shard_impl::load(iarchive& iarc) {
+    // release the rows before the arena holding their data
+    vertex_data.clear();
+    edge_data.clear();
+    arena.clear();
     iarc >> shard_id;
     iarc >> vertex;
-    iarc >> vertex_data;
+    load_rows(iarc, vertex_data, &arena);
     iarc >> edgeid >> edge;
-    iarc >> edge_data;
+    load_rows(iarc, edge_data, &arena);
     iarc >> vertex_index >> edge_index >> vertex_mirrors;
   }
 
+  size_t graph_shard_impl::serialized_size_estimate() const {
+    size_t ret = sizeof(shard_id) + 16 * sizeof(size_t);
+    ret += vertex.size() * sizeof(graph_vid_t);
+    ret += edgeid.size() * sizeof(graph_eid_t);
+    ret += edge.size() * sizeof(std::pair<graph_vid_t, graph_vid_t>);
+    for (size_t i = 0; i < vertex_data.size(); ++i) {
+      ret += vertex_data[i].serialized_size();
+    }
+    for (size_t i = 0; i < edge_data.size(); ++i) {
+      ret += edge_data[i].serialized_size();
+    }
+    for (size_t i = 0; i < vertex_mirrors.size(); ++i) {
+      ret += sizeof(size_t) + vertex_mirrors[i].size() * sizeof(graph_shard_id_t);
+    }
+    return ret;
+  }
+
+  void graph_shard_impl::memory_usage(memory_accounting::usage& usage) const {
+    using namespace memory_accounting;
+    usage.bytes[SHARD_COLUMNS] += vertex.capacity() * sizeof(graph_vid_t)
+        + edgeid.capacity() * sizeof(graph_eid_t)
+        + edge.capacity() * sizeof(std::pair<graph_vid_t, graph_vid_t>);
+    size_t rows = (vertex_data.capacity() + edge_data.capacity()) * sizeof(graph_row);
+    for (size_t i = 0; i < vertex_data.size(); ++i) {
+      rows += vertex_data[i].heap_bytes();
+    }
+    for (size_t i = 0; i < edge_data.size(); ++i) {
+      rows += edge_data[i].heap_bytes();
+    }
+    rows += arena.memory_bytes();
+    usage.bytes[SHARD_ROWS] += rows;
+    usage.bytes[VERTEX_INDEX] += vertex_index.memory_bytes();
+    usage.bytes[EDGE_INDEX] += edge_index.memory_bytes();
+    // a bucket array and one node (value and two pointers) per element
+    size_t mirrors = vertex_mirrors.capacity()
+        * sizeof(boost::unordered_set<graph_shard_id_t>);
+    for (size_t i = 0; i < vertex_mirrors.size(); ++i) {
+      mirrors += vertex_mirrors[i].bucket_count() * sizeof(void*)
+          + vertex_mirrors[i].size() * (sizeof(graph_shard_id_t) + 2 * sizeof(void*));
+    }
+    usage.bytes[VERTEX_MIRRORS] += mirrors;
+  }
+
   void graph_shard_impl::save(oarchive& oarc) const {
+    // size the buffer once instead of doubling it through the columns
+    if (oarc.out == NULL) oarc.reserve(serialized_size_estimate());
     oarc << shard_id;
     oarc << vertex;
     oarc << vertex_data;
@@ -4,6 +4,7 @@
 #include <graphlab/database/graph_row.hpp>
 #include <graphlab/database/graph_vertex_index.hpp>
 #include <graphlab/database/graph_edge_index.hpp>
+#include <graphlab/util/memory_accounting.hpp>
 #include <boost/unordered_set.hpp>
 
 namespace graphlab {
@@ -47,6 +48,7 @@ struct graph_shard_impl {
     vertex_mirrors.clear();
     edge_index.clear();
     vertex_index.clear();
+    arena.clear();
   }
 
   /** 
@@ -101,12 +103,31 @@ struct graph_shard_impl {
    */ 
   std::vector<boost::unordered_set<graph_shard_id_t> > vertex_mirrors;
 
+  /**
+   * The long strings / blobs of the rows loaded by load(). Rows added or
+   * modified later allocate their own.
+   */
+  graph_value_arena arena;
+
 
 // ----------- Serialization API ----------------
   void save(oarchive& oarc) const;
   
   void load(iarchive& iarc);
 
+  /**
+   * Returns an estimate of the number of bytes written by save(): exact for
+   * the columns and rows, a lower bound for the indexes and mirror sets.
+   */
+  size_t serialized_size_estimate() const;
+
+  /**
+   * Adds the memory used by the shard to the SHARD_COLUMNS, SHARD_ROWS,
+   * VERTEX_INDEX, EDGE_INDEX and VERTEX_MIRRORS subsystems of usage.
+   * The sizes of the hash tables and of the allocations are estimated.
+   */
+  void memory_usage(memory_accounting::usage& usage) const;
+
   void deepcopy(graph_shard_impl& out) const;
   
 // ----------- Modification API -----------------
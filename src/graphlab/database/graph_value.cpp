@@ -1,11 +1,14 @@
 #include <graphlab/database/graph_value.hpp>
+#include <graphlab/database/graph_value_arena.hpp>
+#include <graphlab/database/graph_vector_ops.hpp>
 #include <cstring>
 #include <cstdlib>
 namespace graphlab {
   graph_value::graph_value(): 
       _len(sizeof(graph_int_t)), 
       _type(INT_TYPE), 
-      _null_value(true) {
+      _null_value(true),
+      _storage(INLINE_STORAGE) {
         memset(&_data, 0, sizeof(_data));
       }
 
@@ -14,29 +17,29 @@ namespace graphlab {
   }
 
   graph_value::graph_value(const graph_value& other) :
-      _len(other._len), _type(other._type), _null_value(other._null_value) {
-        if (is_scalar_graph_datatype(_type)) {
+      _len(other._len), _type(other._type), _null_value(other._null_value),
+      _storage(INLINE_STORAGE) {
+        if (other._storage == INLINE_STORAGE) {
           _data = other._data;
         } else {
+          // copies of arena values own their data
           _data.bytes = (char*) malloc(_len);
           memcpy(_data.bytes, other._data.bytes, _len);
+          _storage = HEAP_STORAGE;
         }
       }
 
   graph_value& graph_value::operator=(const graph_value& other) { 
-    _type = other._type;
-    _len = other._len;
-    _null_value = other._null_value;
-    if (is_scalar_graph_datatype(_type)) {
+    if (this == &other) return *this;
+    if (other._storage == INLINE_STORAGE) {
+      free_data();
       _data = other._data;
     } else {
-      if(_data.bytes != NULL) {
-        _data.bytes = (char*) realloc(_data.bytes, _len);
-      } else {
-        _data.bytes = (char*) malloc(_len);
-      }
-      memcpy(_data.bytes, other._data.bytes, _len);
+      memcpy(reserve_bytes(other._len), other._data.bytes, other._len);
     }
+    _type = other._type;
+    _len = other._len;
+    _null_value = other._null_value;
     return *this; 
   }
 
@@ -44,10 +47,12 @@ namespace graphlab {
   void graph_value::init(graph_datatypes_enum type) {
     _type = type; 
     _null_value = true;
+    _storage = INLINE_STORAGE;
     memset(&_data, 0, sizeof(_data));
     switch(type) {
      case STRING_TYPE:
-     case BLOB_TYPE: _len = 0;  break;
+     case BLOB_TYPE:
+     case DOUBLE_VEC_TYPE: _len = 0;  break;
      case DOUBLE_TYPE: _len = sizeof(graph_double_t); break;
      case INT_TYPE: _len =sizeof(graph_int_t); break;
      case VID_TYPE: _len =sizeof(graph_vid_t); break;
@@ -60,32 +65,45 @@ namespace graphlab {
   }
 
   void graph_value::free_data() {
-    if ((_type == STRING_TYPE || _type == BLOB_TYPE)) { 
-      if (_data.bytes != NULL) {
-        free(_data.bytes);
-        _data.bytes = NULL;
-        _len = 0;
-      }
+    if (_storage != INLINE_STORAGE) {
+      if (_storage == HEAP_STORAGE) free(_data.bytes);
+      // arena data is released with the arena
+      _data.bytes = NULL;
+      _storage = INLINE_STORAGE;
+      _len = 0;
+    }
+  }
+
+  char* graph_value::reserve_bytes(size_t len, graph_value_arena* arena) {
+    if (len <= INLINE_CAPACITY) {
+      free_data();
+    } else if (arena != NULL) {
+      free_data();
+      _data.bytes = arena->allocate(len);
+      _storage = ARENA_STORAGE;
+    } else if (_storage == HEAP_STORAGE) {
+      _data.bytes = (char*) realloc(_data.bytes, len);
+    } else {
+      _data.bytes = (char*) malloc(len);
+      _storage = HEAP_STORAGE;
     }
+    _len = len;
+    return bytes();
   }
 
   const void* graph_value::get_raw_pointer() const {
     if (is_null()) {
       return NULL;
-    } else if (is_scalar_graph_datatype(_type)) {
-      return reinterpret_cast<const void*>(&_data);
     } else {
-      return reinterpret_cast<const void*>(_data.bytes);
+      return reinterpret_cast<const void*>(bytes());
     }
   }
 
   void* graph_value::get_mutable_raw_pointer() {
     if (is_null()) {
       return NULL;
-    } else if (is_scalar_graph_datatype(_type)) {
-      return reinterpret_cast<void*>(&_data);
     } else {
-      return reinterpret_cast<void*>(_data.bytes);
+      return reinterpret_cast<void*>(bytes());
     }
   }
 
@@ -118,7 +136,7 @@ namespace graphlab {
 
   bool graph_value::get_string(graph_string_t* out_ret) const {
     if (type() == STRING_TYPE && !is_null()) {
-      out_ret->assign(_data.bytes, _len);
+      out_ret->assign(bytes(), _len);
       return true;
     } else { 
       return false;
@@ -127,7 +145,7 @@ namespace graphlab {
 
   bool graph_value::get_blob(graph_blob_t* out_ret) const {
     if (type() == BLOB_TYPE && !is_null()) {
-      out_ret->assign(_data.bytes, _len);
+      out_ret->assign(bytes(), _len);
       return true;
     } else { 
       return false;
@@ -136,7 +154,7 @@ namespace graphlab {
 
   bool graph_value::get_blob(size_t len, char* out_blob) const {
     if (type() == BLOB_TYPE && !is_null()) {
-      memcpy(out_blob, _data.bytes, std::min(len, data_length()));
+      memcpy(out_blob, bytes(), std::min(len, data_length()));
       return true;
     } else {
       return false;
@@ -147,9 +165,7 @@ namespace graphlab {
     if (_type != other._type) {
       return false;
     }
-    const char* data_ptr =  is_scalar_graph_datatype(_type) ? (const char*)(&other._data) : 
-        (const char*)(other._data.bytes);
-    return set_val(data_ptr, other._len, delta);
+    return set_val(other.bytes(), other._len, delta);
   }
 
   bool graph_value::set_val(const char* val, size_t length, bool delta) {
@@ -167,9 +183,20 @@ namespace graphlab {
      case VID_TYPE:
        return set_vid(*((graph_vid_t*)val));
      case STRING_TYPE:
-       return set_string(std::string(val, length));
+       set_bytes(val, length);
+       return true;
      case BLOB_TYPE:
        return set_blob(val, length);
+     case DOUBLE_VEC_TYPE:
+       if (length % sizeof(graph_double_t) != 0) return false;
+       if (reinterpret_cast<size_t>(val) % sizeof(graph_double_t) != 0) {
+         // e.g. straight out of an archive buffer
+         graph_d_vector_t aligned(length / sizeof(graph_double_t));
+         memcpy(&aligned[0], val, length);
+         return set_double_vec(aligned, delta);
+       }
+       return set_double_vec(reinterpret_cast<const graph_double_t*>(val),
+                             length / sizeof(graph_double_t), delta);
      default:
        return false;
     }
@@ -205,6 +232,26 @@ namespace graphlab {
        return set_string(val_str);
      case BLOB_TYPE:
        return set_blob(val_str.c_str(), val_str.size());
+     case DOUBLE_VEC_TYPE:
+       {
+         // elements separated by spaces or commas, optionally in brackets
+         graph_d_vector_t vec;
+         const char* pos = val_str.c_str();
+         while (true) {
+           while (*pos == ' ' || *pos == ',' || *pos == '[' || *pos == ']' ||
+                  *pos == '\t' || *pos == '\n') ++pos;
+           if (*pos == '\0') break;
+           char* end;
+           vec.push_back(strtod(pos, &end));
+           if (end == pos) {
+             logstream(LOG_ERROR) << "Unable to cast "
+                                  << val_str << " to graph_d_vector_t" << std::endl;
+             return false;
+           }
+           pos = end;
+         }
+         return set_double_vec(vec, delta);
+       }
      default:
        return false;
     }
@@ -251,16 +298,7 @@ namespace graphlab {
 
   bool graph_value::set_string(const graph_string_t& val){
     if (type() == STRING_TYPE) {
-      // if we need to resize.
-      _null_value = false;
-      if (val.length() != _len) {
-        _len = val.length();
-        _data.bytes = reinterpret_cast<char*>(realloc(_data.bytes, _len));
-        memcpy(_data.bytes, val.c_str(), _len);
-      }
-      else if (memcmp(_data.bytes, val.c_str(), _len) != 0) {
-        memcpy(_data.bytes, val.c_str(), _len);
-      }
+      set_bytes(val.c_str(), val.length());
       return true;
     } else {
       return false;
@@ -273,22 +311,77 @@ namespace graphlab {
 
   bool graph_value::set_blob(const char* val, size_t length) {
     if (type() == BLOB_TYPE) {
-      // if we need to resize.
-      _null_value = false;
-      if (length != _len) {
-        _len = length;
-        _data.bytes = reinterpret_cast<char*>(realloc(_data.bytes, _len));
-        memcpy(_data.bytes, val, _len);
-      } else {
-        if (val != _data.bytes) 
-          memcpy(_data.bytes, val, _len);
-      } 
+      set_bytes(val, length);
       return true;
     } else {
       return false;
     }
   }
 
+  void graph_value::set_bytes(const char* val, size_t length) {
+    char* dst;
+    if (_storage != INLINE_STORAGE && length == _len) {
+      // overwrite the heap or arena data in place
+      dst = _data.bytes;
+    } else {
+      dst = reserve_bytes(length);
+    }
+    if (dst != val) memcpy(dst, val, length);
+    _null_value = false;
+  }
+
+  bool graph_value::get_double_vec(graph_d_vector_t* out_ret) const {
+    if (type() == DOUBLE_VEC_TYPE && !is_null()) {
+      out_ret->assign(vec_data(), vec_data() + vec_dim());
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  bool graph_value::set_double_vec(const graph_d_vector_t& val, bool is_delta) {
+    return set_double_vec(val.empty() ? NULL : &val[0], val.size(), is_delta);
+  }
+
+  bool graph_value::set_double_vec(const graph_double_t* val, size_t dim, bool is_delta) {
+    if (type() != DOUBLE_VEC_TYPE) {
+      return false;
+    }
+    if (is_delta && !is_null()) {
+      if (dim != vec_dim()) return false;
+      vector_ops::axpy(1, val, vec_data(), dim);
+    } else {
+      set_bytes(reinterpret_cast<const char*>(val), dim * sizeof(graph_double_t));
+    }
+    return true;
+  }
+
+  bool graph_value::axpy(graph_double_t alpha, const graph_value& x) {
+    if (type() != DOUBLE_VEC_TYPE || x.type() != DOUBLE_VEC_TYPE ||
+        is_null() || x.is_null() || vec_dim() != x.vec_dim()) {
+      return false;
+    }
+    vector_ops::axpy(alpha, x.vec_data(), vec_data(), vec_dim());
+    return true;
+  }
+
+  bool graph_value::dot(const graph_value& other, graph_double_t* out_ret) const {
+    if (type() != DOUBLE_VEC_TYPE || other.type() != DOUBLE_VEC_TYPE ||
+        is_null() || other.is_null() || vec_dim() != other.vec_dim()) {
+      return false;
+    }
+    (*out_ret) = vector_ops::dot(vec_data(), other.vec_data(), vec_dim());
+    return true;
+  }
+
+  bool graph_value::norm(graph_double_t* out_ret) const {
+    if (type() != DOUBLE_VEC_TYPE || is_null()) {
+      return false;
+    }
+    (*out_ret) = vector_ops::norm(vec_data(), vec_dim());
+    return true;
+  }
+
   void graph_value::diff(const graph_value& other, graph_value& out_delta) {
     out_delta = *this;
     if (is_scalar_graph_datatype(_type) && (_type == other._type)) {
@@ -297,6 +390,9 @@ namespace graphlab {
        case DOUBLE_TYPE: out_delta._data.double_value -= other._data.double_value; break;
        default: break;
       }
+    } else if (_type == DOUBLE_VEC_TYPE && other._type == DOUBLE_VEC_TYPE &&
+               !_null_value && !other._null_value && vec_dim() == other.vec_dim()) {
+      vector_ops::sub(vec_data(), other.vec_data(), out_delta.vec_data(), vec_dim());
     }
   }
 } // namespace graphlab
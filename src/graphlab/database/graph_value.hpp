@@ -8,6 +8,8 @@
 #include <cstdlib>
 #include <cstring>
 namespace graphlab {
+class graph_value_arena;
+
 /**
  * \ingroup group_graph_database
  * This struct stores the value in a single field in a single vertex/edge 
@@ -41,18 +43,30 @@ class graph_value {
   ~graph_value();
 
  public:
+  /// Strings / blobs / double vectors of up to this many bytes are stored in the value itself
+  static const size_t INLINE_CAPACITY = 16;
+
   union value_union_type {
     graph_vid_t vid_value;
     graph_int_t int_value;
     graph_double_t double_value;
     char* bytes;
+    char inline_bytes[INLINE_CAPACITY];
+  };
+
+  /// Where the data of a string / blob / double vector is stored. Scalars are INLINE_STORAGE.
+  enum storage_enum {
+    INLINE_STORAGE,   ///< in _data.inline_bytes
+    HEAP_STORAGE,     ///< in _data.bytes, allocated with malloc
+    ARENA_STORAGE     ///< in _data.bytes, allocated from a graph_value_arena
   };
 
-  /**  the primary storage is a union between the scalar types and a 
-   *   void* pointer. If the data is a string / blob, the "bytes" field
-   *   is used and it contains a pointer to the actual data and \ref _len 
+  /**  the primary storage is a union between the scalar types, a short
+   *   inline buffer and a char* pointer. If the data is a string / blob of
+   *   at most INLINE_CAPACITY bytes, it is stored in "inline_bytes".
+   *   Otherwise the "bytes" field points to the actual data, and \ref _len
    *   is the length of the data. The destructor automatically frees the
-   *   the data if the datatype is is a string / blob.
+   *   the data if it is on the heap. Use bytes() to read the data.
    */
   value_union_type _data;
  
@@ -69,10 +83,32 @@ class graph_value {
   /// If true, this is a null value and the data field is ignored
   bool _null_value;
 
-  
+  /// A storage_enum
+  uint8_t _storage;
+
   /// Frees the data pointer resetting it to NULL if it is a string / blob.
   void free_data();
 
+  /**
+   * Makes room for len bytes of string / blob data, inline if they fit,
+   * else in arena if not NULL, else on the heap. Sets the length to len
+   * and returns the data, whose previous contents are lost.
+   */
+  char* reserve_bytes(size_t len, graph_value_arena* arena = NULL);
+
+  /// Sets the data of a string / blob to the length bytes at val
+  void set_bytes(const char* val, size_t length);
+
+  /// Returns the data of a string / blob (or the bytes of a scalar)
+  inline const char* bytes() const {
+    return _storage == INLINE_STORAGE ? _data.inline_bytes : _data.bytes;
+  }
+
+  /// Mutable version of bytes()
+  inline char* bytes() {
+    return _storage == INLINE_STORAGE ? _data.inline_bytes : _data.bytes;
+  }
+
   /** The number of bytes needed to represent the data. If a scalar type,
    *  this is the number of bytes needed to represent the scalar type. Otherwise,
    *  for a string/blob, this ithe length of the data. Note that a 0 length
@@ -199,6 +235,62 @@ class graph_value {
    */
   bool set_blob(const char* val, size_t length);
 
+  /// Returns the number of elements of a double vector
+  inline size_t vec_dim() const {
+    return _len / sizeof(graph_double_t);
+  }
+
+  /**
+   * Returns the elements of a double vector, stored contiguously and
+   * aligned for graph_double_t. Valid until the value is resized.
+   */
+  inline const graph_double_t* vec_data() const {
+    return reinterpret_cast<const graph_double_t*>(bytes());
+  }
+
+  /// Mutable version of vec_data()
+  inline graph_double_t* vec_data() {
+    return reinterpret_cast<graph_double_t*>(bytes());
+  }
+
+  /**
+   * Returns the value as a double vector in the out_ret argument.
+   * Returns true on success. Returns false if the data
+   * is not a double vector type, or the data is NULL.
+   */
+  bool get_double_vec(graph_d_vector_t* out_ret) const;
+
+  /**
+   * Sets the value of a double vector field to the provided argument, or
+   * adds the argument to it if is_delta is true (a delta to a NULL value
+   * sets it). Returns true on success. Returns false if the data
+   * is not a double vector type, or the dimension of a delta differs.
+   */
+  bool set_double_vec(const graph_d_vector_t& val, bool is_delta = false);
+
+  /// Like set_double_vec(), for the dim elements at val
+  bool set_double_vec(const graph_double_t* val, size_t dim, bool is_delta = false);
+
+  /**
+   * Adds alpha * x to a double vector (this += alpha * x). Returns false
+   * if either value is not a double vector, is NULL, or if the dimensions
+   * differ.
+   */
+  bool axpy(graph_double_t alpha, const graph_value& x);
+
+  /**
+   * Returns the dot product of two double vectors in the out_ret argument.
+   * Returns false if either value is not a double vector, is NULL, or if
+   * the dimensions differ.
+   */
+  bool dot(const graph_value& other, graph_double_t* out_ret) const;
+
+  /**
+   * Returns the euclidean norm of a double vector in the out_ret argument.
+   * Returns false if the value is not a double vector or is NULL.
+   */
+  bool norm(graph_double_t* out_ret) const;
+
   /**
    * Sets the value field to the provided argument based on the type and delta commit flag.
    * Returns true on success. Returns false if the data
@@ -220,9 +312,26 @@ class graph_value {
    */
   bool set_val(const std::string& val_str, bool delta = false);
 
-  // Subtract other's value from this. Only have effect on scalar type values.
+  // Subtract other's value from this. Only have effect on scalar and double
+  // vector type values.
   void diff(const graph_value& other, graph_value& out_delta);
 
+  /**
+   * Returns the number of bytes written by save().
+   */
+  inline size_t serialized_size() const {
+    return sizeof(graph_datatypes_enum) + sizeof(bool) + sizeof(size_t) +
+        (_null_value ? 0 : _len);
+  }
+
+  /**
+   * Returns the number of bytes allocated for the value, besides the
+   * graph_value itself.
+   */
+  inline size_t heap_bytes() const {
+    return _storage == HEAP_STORAGE ? _len : 0;
+  }
+
   /**
    * Serialization interface. 
    */
@@ -232,7 +341,7 @@ class graph_value {
       if (is_scalar_graph_datatype(_type)) {
         oarc.write((char*)(&_data), _len);
       } else {
-        oarc.write(_data.bytes, _len);
+        oarc.write_ref(bytes(), _len);
       }
     }
   }
@@ -241,19 +350,26 @@ class graph_value {
    * Serialization interface.
    */
   inline void load(iarchive& iarc) {
-    iarc >> _type >> _null_value >> _len;
-     if (!_null_value) {
-       if (is_scalar_graph_datatype(_type)) {
-          iarc.read((char*)(&_data), _len);
-       } else {
-         if (_data.bytes == NULL) {
-            _data.bytes = (char*)malloc(_len);
-         } else {
-            _data.bytes = (char*)realloc(_data.bytes, _len);
-         }
-          iarc.read(_data.bytes, _len);
-       }
-     }
+    load(iarc, NULL);
+  }
+
+  /**
+   * Loads the value, allocating a long string / blob from arena if it is
+   * not NULL.
+   */
+  inline void load(iarchive& iarc, graph_value_arena* arena) {
+    size_t len;
+    iarc >> _type >> _null_value >> len;
+    if (_null_value || is_scalar_graph_datatype(_type)) {
+      free_data();
+      if (!_null_value) {
+        ASSERT_LE(len, sizeof(_data));
+        iarc.read((char*)(&_data), len);
+      }
+      _len = len;
+    } else {
+      iarc.read(reserve_bytes(len, arena), len);
+    }
   }
 
  private:
@@ -267,7 +383,15 @@ class graph_value {
        case VID_TYPE: value_str = boost::lexical_cast<std::string> (v._data.vid_value); break;
        case INT_TYPE: value_str = boost::lexical_cast<std::string> (v._data.int_value); break;
        case DOUBLE_TYPE: value_str = boost::lexical_cast<std::string> (v._data.double_value); break;
-       case STRING_TYPE: value_str = std::string(v._data.bytes); break; 
+       case DOUBLE_VEC_TYPE:
+         value_str = "[";
+         for (size_t i = 0; i < v.vec_dim(); ++i) {
+           if (i > 0) value_str += ", ";
+           value_str += boost::lexical_cast<std::string>(v.vec_data()[i]);
+         }
+         value_str += "]";
+         break;
+       case STRING_TYPE: value_str = std::string(v.bytes(), v._len); break; 
        default: value_str = "***";
       }
     }
@@ -0,0 +1,79 @@
+#ifndef GRAPHLAB_DATABASE_GRAPH_VALUE_ARENA_HPP
+#define GRAPHLAB_DATABASE_GRAPH_VALUE_ARENA_HPP
+#include <vector>
+#include <cstdlib>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+/**
+ * \ingroup group_graph_database
+ * Bump allocator for the bytes of long string / blob values.
+ *
+ * A shard loads the bytes of its long values into its arena instead of
+ * allocating each one on the heap. The bytes stay allocated until clear():
+ * a value releasing arena bytes (because it is destroyed, resized or
+ * evicted) leaves them in the arena, and copies of a value always own
+ * their bytes. The values allocated from an arena must not be used after
+ * it is cleared or destroyed.
+ *
+ * \note
+ *  This object is not thread safe and may not be copied.
+ */
+class graph_value_arena {
+ public:
+  /// Creates an empty arena allocating blocks of block_size bytes
+  explicit graph_value_arena(size_t block_size = 256 * 1024)
+      : block_size(block_size), cur(NULL), remaining(0), allocated(0) { }
+
+  inline ~graph_value_arena() { clear(); }
+
+  /// Returns len bytes, aligned for doubles, which stay valid until clear()
+  inline char* allocate(size_t len) {
+    len = (len + sizeof(double) - 1) & ~(sizeof(double) - 1);
+    if (len > remaining) {
+      // large values get a block of their own, so that the current block
+      // is not wasted
+      if (len > block_size / 4) return new_block(len);
+      cur = new_block(block_size);
+      remaining = block_size;
+    }
+    char* ret = cur;
+    cur += len;
+    remaining -= len;
+    return ret;
+  }
+
+  /// Frees all the bytes allocated
+  inline void clear() {
+    for (size_t i = 0; i < blocks.size(); ++i) free(blocks[i]);
+    std::vector<char*>().swap(blocks);
+    cur = NULL;
+    remaining = 0;
+    allocated = 0;
+  }
+
+  /// Returns the number of bytes of the blocks
+  inline size_t memory_bytes() const {
+    return allocated + blocks.capacity() * sizeof(char*);
+  }
+
+ private:
+  size_t block_size;
+  std::vector<char*> blocks;
+  char* cur;
+  size_t remaining;
+  size_t allocated;
+
+  inline char* new_block(size_t len) {
+    char* block = (char*)malloc(len);
+    ASSERT_TRUE(block != NULL);
+    blocks.push_back(block);
+    allocated += len;
+    return block;
+  }
+
+  graph_value_arena(const graph_value_arena&);
+  graph_value_arena& operator=(const graph_value_arena&);
+};
+} // namespace graphlab
+#endif
@@ -0,0 +1,66 @@
+#ifndef GRAPHLAB_DATABASE_GRAPH_VECTOR_OPS_HPP
+#define GRAPHLAB_DATABASE_GRAPH_VECTOR_OPS_HPP
+#include <cmath>
+#include <cstddef>
+#include <graphlab/database/basic_types.hpp>
+
+namespace graphlab {
+/**
+ * \ingroup group_graph_database
+ * Dense kernels on arrays of graph_double_t, used by the DOUBLE_VEC_TYPE
+ * values. The loops work on restrict pointers with independent
+ * accumulators, so that the compiler vectorizes them with the widest
+ * instructions of -march (a single running sum can not be reordered
+ * without -ffast-math).
+ */
+namespace vector_ops {
+  /// Returns the dot product of a and b
+  inline graph_double_t dot(const graph_double_t* __restrict a,
+                            const graph_double_t* __restrict b, size_t n) {
+    graph_double_t s0 = 0, s1 = 0, s2 = 0, s3 = 0, s4 = 0, s5 = 0, s6 = 0, s7 = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      s0 += a[i] * b[i];
+      s1 += a[i + 1] * b[i + 1];
+      s2 += a[i + 2] * b[i + 2];
+      s3 += a[i + 3] * b[i + 3];
+      s4 += a[i + 4] * b[i + 4];
+      s5 += a[i + 5] * b[i + 5];
+      s6 += a[i + 6] * b[i + 6];
+      s7 += a[i + 7] * b[i + 7];
+    }
+    for (; i < n; ++i) s0 += a[i] * b[i];
+    return ((s0 + s4) + (s1 + s5)) + ((s2 + s6) + (s3 + s7));
+  }
+
+  /// Returns the euclidean norm of a
+  inline graph_double_t norm(const graph_double_t* a, size_t n) {
+    return std::sqrt(dot(a, a, n));
+  }
+
+  /// x *= alpha
+  inline void scale(graph_double_t alpha, graph_double_t* x, size_t n) {
+    for (size_t i = 0; i < n; ++i) x[i] *= alpha;
+  }
+
+  /// y += alpha * x, for x and y which do not overlap
+  inline void axpy_disjoint(graph_double_t alpha, const graph_double_t* __restrict x,
+                            graph_double_t* __restrict y, size_t n) {
+    for (size_t i = 0; i < n; ++i) y[i] += alpha * x[i];
+  }
+
+  /// y += alpha * x. x and y are the same array or do not overlap.
+  inline void axpy(graph_double_t alpha, const graph_double_t* x,
+                   graph_double_t* y, size_t n) {
+    if (x == y) scale(1 + alpha, y, n);
+    else axpy_disjoint(alpha, x, y, n);
+  }
+
+  /// out = a - b. out may be a or b.
+  inline void sub(const graph_double_t* a, const graph_double_t* b,
+                  graph_double_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = a[i] - b[i];
+  }
+} // namespace vector_ops
+} // namespace graphlab
+#endif
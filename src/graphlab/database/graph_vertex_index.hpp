@@ -16,6 +16,9 @@ namespace graphlab {
    * This class provide lookup for the vertex locations in a shard. 
    * The primary key is the vid. TODO: add support for secondary keys specified in the 
    * <code>graph_field</code>.
+   *
+   * Like the shard columns, the index takes a single writer, or
+   * concurrent readers, so lookups take no lock.
    */
   class graph_vertex_index {
    public:
@@ -31,6 +34,15 @@ namespace graphlab {
        return index_map.find(vid)->second;
      }
 
+     // Fills in the index of a vertex in a shard. Returns false if the
+     // vertex does not exist.
+     inline bool find_index (graph_vid_t vid, size_t& pos) const {
+       boost::unordered_map<graph_vid_t, size_t>::const_iterator iter = index_map.find(vid);
+       if (iter == index_map.end()) return false;
+       pos = iter->second;
+       return true;
+     }
+
      // Update the index by adding a vertex
      inline bool add_vertex(graph_vid_t vid, graph_row* value, size_t pos) {
        if (has_vertex(vid)) {
@@ -57,6 +69,13 @@ namespace graphlab {
        index_map.clear();
      }
 
+     /// Returns an estimate of the memory used by the index: the buckets
+     /// and the nodes (element, next pointer and hash)
+     inline size_t memory_bytes() const {
+       return index_map.bucket_count() * sizeof(void*) + index_map.size() *
+           (sizeof(std::pair<const graph_vid_t, size_t>) + 2 * sizeof(void*));
+     }
+
      inline void save (oarchive& oarc) const {
        oarc << index_map;
      }
@@ -15,6 +15,14 @@ namespace graphlab {
    **/
   class graphdb_query_object {
    public:
+    /**
+     * The reply of a shard, from libfault. It can only be waited on: it
+     * has no completion callback, so it is not wrapped in a
+     * graphlab::future (see parallel/future.hpp), which would take a
+     * blocked thread per query in flight. Once the replies are delivered
+     * by a callback, query() and update() should fulfill a promise from
+     * it and return its future.
+     */
     typedef libfault::query_object_client::query_result query_result;
 
     graphdb_query_object (const graphdb_config& config);
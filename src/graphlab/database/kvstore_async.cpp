@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <boost/bind.hpp>
+
+#include <graphlab/database/kvstore_async.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+namespace {
+  enum queue_kind { GET_QUEUE, SET_QUEUE, TASK_QUEUE, NUM_QUEUES };
+
+  // the errors of the store are returned through the futures
+  void run_bulk_get(kvstore_base* store, std::vector<key_type> keys,
+                    boost::shared_ptr<boost::promise<std::vector<kvstore_async::get_result> > > p) {
+    try {
+      p->set_value(store->bulk_get(keys));
+    } catch (...) {
+      p->set_exception(boost::current_exception());
+    }
+  }
+
+  void run_range_get(kvstore_base* store, key_type key_lo, key_type key_hi,
+                     boost::shared_ptr<boost::promise<std::vector<value_type> > > p) {
+    try {
+      p->set_value(store->range_get(key_lo, key_hi));
+    } catch (...) {
+      p->set_exception(boost::current_exception());
+    }
+  }
+
+  template <typename T>
+  boost::unique_future<T> move_future(boost::unique_future<T>& f) {
+    return boost::unique_future<T>(boost::detail::thread_move_t<boost::unique_future<T> >(f));
+  }
+} // anonymous namespace
+
+kvstore_async::kvstore_async(kvstore_base& store, const kvstore_base::async_options& opts)
+    : store(store), opts(opts), queued(0), running(0), setting(false),
+      stopping(false), next_queue(0) {
+  ASSERT_GT(opts.num_workers, 0);
+  ASSERT_GT(opts.max_batch, 0);
+  for (size_t i = 0; i < opts.num_workers; ++i) {
+    workers.launch(boost::bind(&kvstore_async::worker_loop, this));
+  }
+}
+
+kvstore_async::~kvstore_async() {
+  lock.lock();
+  stopping = true;
+  work.broadcast();
+  lock.unlock();
+  workers.join();
+}
+
+void kvstore_async::wait_for_space() {
+  while (queued >= opts.max_pending) progress.wait(lock);
+  ++queued;
+  ++counters.requests;
+}
+
+void kvstore_async::set(const key_type key, const value_type& value) {
+  lock.lock();
+  wait_for_space();
+  sets.push_back(std::make_pair(key, value));
+  work.signal();
+  lock.unlock();
+}
+
+boost::unique_future<kvstore_async::get_result> kvstore_async::get(const key_type key) {
+  get_promise p(new boost::promise<get_result>());
+  boost::unique_future<get_result> result(p->get_future());
+  lock.lock();
+  wait_for_space();
+  gets.push_back(std::make_pair(key, p));
+  work.signal();
+  lock.unlock();
+  return move_future(result);
+}
+
+void kvstore_async::push_task(const boost::function<void (void)>& task) {
+  lock.lock();
+  wait_for_space();
+  tasks.push_back(task);
+  work.signal();
+  lock.unlock();
+}
+
+boost::unique_future<std::vector<kvstore_async::get_result> >
+kvstore_async::bulk_get(const std::vector<key_type>& keys) {
+  boost::shared_ptr<boost::promise<std::vector<get_result> > >
+      p(new boost::promise<std::vector<get_result> >());
+  boost::unique_future<std::vector<get_result> > result(p->get_future());
+  push_task(boost::bind(run_bulk_get, &store, keys, p));
+  return move_future(result);
+}
+
+boost::unique_future<std::vector<value_type> >
+kvstore_async::range_get(const key_type key_lo, const key_type key_hi) {
+  boost::shared_ptr<boost::promise<std::vector<value_type> > >
+      p(new boost::promise<std::vector<value_type> >());
+  boost::unique_future<std::vector<value_type> > result(p->get_future());
+  push_task(boost::bind(run_range_get, &store, key_lo, key_hi, p));
+  return move_future(result);
+}
+
+void kvstore_async::wait() {
+  lock.lock();
+  while (queued > 0 || running > 0) progress.wait(lock);
+  lock.unlock();
+}
+
+kvstore_async::stats kvstore_async::get_stats() {
+  lock.lock();
+  stats ret = counters;
+  lock.unlock();
+  return ret;
+}
+
+void kvstore_async::worker_loop() {
+  lock.lock();
+  while (true) {
+    size_t kind = NUM_QUEUES;
+    for (size_t i = 0; i < NUM_QUEUES && kind == NUM_QUEUES; ++i) {
+      size_t k = (next_queue + i) % NUM_QUEUES;
+      if ((k == GET_QUEUE && !gets.empty()) ||
+          (k == SET_QUEUE && !sets.empty() && !setting) ||
+          (k == TASK_QUEUE && !tasks.empty())) {
+        kind = k;
+      }
+    }
+    if (kind == NUM_QUEUES) {
+      // the queued sets, if any, are left to the worker applying sets
+      if (stopping && gets.empty() && tasks.empty() && (sets.empty() || setting)) break;
+      work.wait(lock);
+      continue;
+    }
+    next_queue = (kind + 1) % NUM_QUEUES;
+    ++counters.batches;
+
+    size_t n;
+    if (kind == GET_QUEUE) {
+      n = std::min(gets.size(), opts.max_batch);
+      std::vector<key_type> keys(n);
+      std::vector<get_promise> promises(n);
+      for (size_t i = 0; i < n; ++i) {
+        keys[i] = gets.front().first;
+        promises[i] = gets.front().second;
+        gets.pop_front();
+      }
+      queued -= n;
+      running += n;
+      progress.broadcast();
+      lock.unlock();
+      try {
+        std::vector<get_result> values = store.bulk_get(keys);
+        for (size_t i = 0; i < n; ++i) promises[i]->set_value(values[i]);
+      } catch (...) {
+        boost::exception_ptr error = boost::current_exception();
+        for (size_t i = 0; i < n; ++i) promises[i]->set_exception(error);
+      }
+      lock.lock();
+    } else if (kind == SET_QUEUE) {
+      n = std::min(sets.size(), opts.max_batch);
+      std::vector<std::pair<key_type, value_type> > batch(n);
+      for (size_t i = 0; i < n; ++i) {
+        batch[i].first = sets.front().first;
+        batch[i].second.swap(sets.front().second);
+        sets.pop_front();
+      }
+      setting = true;
+      queued -= n;
+      running += n;
+      progress.broadcast();
+      lock.unlock();
+      bool failed = false;
+      try {
+        store.bulk_set(batch);
+      } catch (...) {
+        // the sets have no future to return the error to
+        logstream(LOG_ERROR) << "Failed to apply " << n << " background sets" << std::endl;
+        failed = true;
+      }
+      lock.lock();
+      if (failed) counters.failed_sets += n;
+      setting = false;
+      if (!sets.empty() || stopping) work.broadcast();
+    } else {
+      n = 1;
+      boost::function<void (void)> task = tasks.front();
+      tasks.pop_front();
+      --queued;
+      ++running;
+      progress.broadcast();
+      lock.unlock();
+      try {
+        task();
+      } catch (...) {
+        logstream(LOG_ERROR) << "A background request failed" << std::endl;
+      }
+      lock.lock();
+    }
+    running -= n;
+    if (queued == 0 && running == 0) progress.broadcast();
+  }
+  lock.unlock();
+}
+
+}
@@ -0,0 +1,102 @@
+#ifndef GRAPHLAB_DATABASE_KVSTORE_ASYNC_HPP
+#define GRAPHLAB_DATABASE_KVSTORE_ASYNC_HPP
+
+#include <deque>
+#include <vector>
+#include <utility>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <graphlab/database/kvstore_base.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+namespace graphlab {
+
+/**
+ * \ingroup group_graph_database
+ * Runs the background requests of a kvstore on a fixed pool of worker
+ * threads, instead of one thread per request.
+ *
+ * Requests wait in a bounded queue: a caller blocks while
+ * kvstore_base::async_options::max_pending requests are queued, so a fast
+ * producer cannot outrun the store. Concurrent get() and set() calls are
+ * coalesced: a worker takes up to async_options::max_batch queued gets
+ * (or sets) at once, and issues them as one bulk_get() (or bulk_set()) on
+ * the store.
+ *
+ * Sets are applied in the order they were queued. Other requests are not
+ * ordered relative to each other or to the sets: call wait() before
+ * reading a key written with set().
+ *
+ * An exception thrown by the store is set on the futures of the requests
+ * of the call, and a worker keeps running after it. Failed sets are
+ * logged, and counted in stats::failed_sets.
+ */
+class kvstore_async {
+public:
+  typedef std::pair<bool, value_type> get_result;
+
+  struct stats {
+    /// Requests queued
+    size_t requests;
+    /// Calls to the store made for them
+    size_t batches;
+    /// Sets lost because the store threw
+    size_t failed_sets;
+    stats() : requests(0), batches(0), failed_sets(0) { }
+  };
+
+  /// Starts the workers, which call store
+  kvstore_async(kvstore_base& store, const kvstore_base::async_options& opts);
+
+  /// Finishes the queued requests, then stops the workers
+  ~kvstore_async();
+
+  void set(const key_type key, const value_type& value);
+
+  boost::unique_future<get_result> get(const key_type key);
+
+  boost::unique_future<std::vector<get_result> > bulk_get(const std::vector<key_type>& keys);
+
+  boost::unique_future<std::vector<value_type> > range_get(const key_type key_lo,
+                                                            const key_type key_hi);
+
+  /// Blocks until no request is queued or running
+  void wait();
+
+  stats get_stats();
+
+private:
+  typedef boost::shared_ptr<boost::promise<get_result> > get_promise;
+
+  kvstore_base& store;
+  kvstore_base::async_options opts;
+
+  mutex lock;
+  // signals the workers that there are requests
+  conditional work;
+  // signals the callers that requests were taken or finished
+  conditional progress;
+
+  std::deque<std::pair<key_type, get_promise> > gets;
+  std::deque<std::pair<key_type, value_type> > sets;
+  // the bulk and range gets, which are not batched
+  std::deque<boost::function<void (void)> > tasks;
+  size_t queued;
+  size_t running;
+  // a worker is applying sets: the others leave the sets alone
+  bool setting;
+  bool stopping;
+  // the queue to look at first, so that none of them starves
+  size_t next_queue;
+  stats counters;
+  thread_group workers;
+
+  void wait_for_space();
+  void push_task(const boost::function<void (void)>& task);
+  void worker_loop();
+};
+
+}
+
+#endif
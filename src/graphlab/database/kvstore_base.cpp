@@ -0,0 +1,55 @@
+#include <graphlab/database/kvstore_base.hpp>
+#include <graphlab/database/kvstore_async.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+kvstore_base::kvstore_base() : _async(NULL) { }
+
+kvstore_base::~kvstore_base() {
+  stop_background_requests();
+}
+
+void kvstore_base::set_async_options(const async_options &opts) {
+  boost::lock_guard<boost::mutex> guard(_async_lock);
+  ASSERT_MSG(_async == NULL, "The background requests have already started");
+  _async_opts = opts;
+}
+
+kvstore_async &kvstore_base::async() {
+  boost::lock_guard<boost::mutex> guard(_async_lock);
+  if (_async == NULL) _async = new kvstore_async(*this, _async_opts);
+  return *_async;
+}
+
+void kvstore_base::stop_background_requests() {
+  kvstore_async *async;
+  {
+    boost::lock_guard<boost::mutex> guard(_async_lock);
+    async = _async;
+    _async = NULL;
+  }
+  delete async;
+}
+
+void kvstore_base::wait_background() {
+  async().wait();
+}
+
+void kvstore_base::background_set(const key_type key, const value_type &value) {
+  async().set(key, value);
+}
+
+boost::unique_future<std::pair<bool, value_type> > kvstore_base::background_get(const key_type key) {
+  return async().get(key);
+}
+
+boost::unique_future<std::vector<std::pair<bool, value_type> > > kvstore_base::background_bulk_get(const std::vector<key_type> &keys) {
+  return async().bulk_get(keys);
+}
+
+boost::unique_future<std::vector<value_type> > kvstore_base::background_range_get(const key_type key_lo, const key_type key_hi) {
+  return async().range_get(key_lo, key_hi);
+}
+
+}
@@ -22,14 +22,39 @@ namespace graphlab {
 typedef uint64_t key_type;
 typedef std::string value_type;
 
+class kvstore_async;
+
+/**
+ * The interface of the key value stores. The background_* functions queue
+ * requests to a pool of worker threads (see kvstore_async), created on the
+ * first of them. A derived class must call stop_background_requests()
+ * first in its destructor, since the workers call its functions.
+ */
 class kvstore_base {
 public:
+  struct async_options {
+    /// Number of worker threads. Should be 1 if the store is not thread safe.
+    size_t num_workers;
+    /// Number of queued requests above which the background_* calls block
+    size_t max_pending;
+    /// Maximum number of gets (or sets) coalesced into one bulk call
+    size_t max_batch;
+    async_options() : num_workers(4), max_pending(4096), max_batch(256) { }
+  };
+
+  kvstore_base();
+  virtual ~kvstore_base();
+
   virtual void set(const key_type key, const value_type &value) = 0;
-  virtual void background_set(const key_type key, const value_type &value) {
-    boost::thread t(&kvstore_base::set, this, key, value);
-    t.detach();
+
+  virtual void bulk_set(const std::vector<std::pair<key_type, value_type> > &pairs) {
+    for (size_t i = 0; i < pairs.size(); ++i) {
+      set(pairs[i].first, pairs[i].second);
+    }
   }
 
+  virtual void background_set(const key_type key, const value_type &value);
+
   virtual bool get(const key_type key, value_type &value) = 0;
 
   virtual std::vector<std::pair<bool, value_type> > bulk_get(const std::vector<key_type> &keys) {
@@ -45,34 +70,23 @@ public:
 
   virtual std::vector<value_type> range_get(const key_type key_lo, const key_type key_hi) = 0;
 
-  virtual std::pair<bool, value_type> background_get_thread(const key_type key) = 0;
-
-  virtual boost::unique_future<std::pair<bool,value_type> > background_get(const key_type key) {
-    boost::packaged_task<std::pair<bool, value_type> > pt(boost::bind(&kvstore_base::background_get_thread, this, key));
-    boost::detail::thread_move_t<boost::unique_future<std::pair<bool, value_type> > > result = pt.get_future();
-    boost::thread t(boost::move(pt));
-    t.detach();
-
-    return boost::unique_future<std::pair<bool, value_type> >(result);
+  virtual std::pair<bool, value_type> background_get_thread(const key_type key) {
+    std::pair<bool, value_type> result;
+    result.first = get(key, result.second);
+    return result;
   }
 
-  virtual boost::unique_future<std::vector<std::pair<bool, value_type> > > background_bulk_get(const std::vector<key_type> &keys) {
-    boost::packaged_task<std::vector<std::pair<bool, value_type> > > pt(boost::bind(&kvstore_base::bulk_get, this, keys));
-    boost::detail::thread_move_t<boost::unique_future<std::vector<std::pair<bool, value_type> > > > result = pt.get_future();
-    boost::thread t(boost::move(pt));
-    t.detach();
+  virtual boost::unique_future<std::pair<bool,value_type> > background_get(const key_type key);
 
-    return boost::unique_future<std::vector<std::pair<bool, value_type> > >(result);
-  }
+  virtual boost::unique_future<std::vector<std::pair<bool, value_type> > > background_bulk_get(const std::vector<key_type> &keys);
 
-  virtual boost::unique_future<std::vector<value_type> > background_range_get(const key_type key_lo, const key_type key_hi) {
-    boost::packaged_task<std::vector<value_type> > pt(boost::bind(&kvstore_base::range_get, this, key_lo, key_hi));
-    boost::detail::thread_move_t<boost::unique_future<std::vector<value_type> > > result = pt.get_future();
-    boost::thread t(boost::move(pt));
-    t.detach();
+  virtual boost::unique_future<std::vector<value_type> > background_range_get(const key_type key_lo, const key_type key_hi);
 
-    return boost::unique_future<std::vector<value_type> >(result);
-  }
+  /// Blocks until the background requests made so far are done
+  void wait_background();
+
+  /// Sets the worker pool of the background requests. Must be called before the first one.
+  void set_async_options(const async_options &opts);
 
   virtual void remove_all() = 0;
 //  virtual void remove(const key_type key) = 0;
@@ -81,6 +95,17 @@ public:
 //  virtual void background_range_remove(const key_type key_low, const key_type key_hi) = 0;
 //  virtual void bulk_remove(const std::vector<key_type> &keys) = 0;
 //  virtual void background_bulk_remove(const std::vector<key_type> &keys) = 0;
+
+protected:
+  /// Finishes the background requests and stops their workers
+  void stop_background_requests();
+
+private:
+  async_options _async_opts;
+  kvstore_async *_async;
+  boost::mutex _async_lock;
+
+  kvstore_async &async();
 };
 
 }
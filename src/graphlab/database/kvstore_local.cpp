@@ -0,0 +1,874 @@
+#include <graphlab/database/kvstore_local.hpp>
+#include <graphlab/util/bloom_filter.hpp>
+#include <graphlab/util/fs_util.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <boost/bind.hpp>
+
+namespace graphlab {
+
+namespace {
+  // version 2 has the checksums of the blocks in the index
+  const uint64_t TABLE_MAGIC = 0x6b767374626c3032ULL;
+  // key, type, value length
+  const size_t RECORD_HEADER = 8 + 1 + 4;
+  // a log record is a checksum of the record which follows it
+  const size_t LOG_HEADER = 4 + RECORD_HEADER;
+  // index offset, index entries, filter offset, filter size, records, magic
+  const size_t FOOTER_WORDS = 6;
+  // the tables of a compaction are at most this many times larger than
+  // the smallest of them
+  const size_t COMPACTION_SIZE_RATIO = 2;
+
+  uint32_t checksum(const char* data, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+      h ^= (unsigned char)data[i];
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  void append_record(std::string& out, key_type key, bool live, const value_type& value) {
+    uint32_t len = live ? value.size() : 0;
+    out.append((const char*)&key, sizeof(key));
+    out.push_back(live ? 1 : 0);
+    out.append((const char*)&len, sizeof(len));
+    if (live) out.append(value);
+  }
+
+  // appends a record preceded by its checksum
+  void append_log_record(std::string& out, key_type key, bool live, const value_type& value) {
+    size_t start = out.size();
+    out.append(4, '\0');
+    append_record(out, key, live, value);
+    uint32_t sum = checksum(out.data() + start + 4, out.size() - start - 4);
+    memcpy(&out[start], &sum, sizeof(sum));
+  }
+
+  void write_all(int fd, const char* data, size_t len, const std::string& path) {
+    while (len > 0) {
+      ssize_t ret = ::write(fd, data, len);
+      if (ret < 0 && errno == EINTR) continue;
+      ASSERT_MSG(ret > 0, "Failed to write %s: %s", path.c_str(), strerror(errno));
+      data += ret;
+      len -= ret;
+    }
+  }
+
+  void read_all(int fd, char* data, size_t len, uint64_t offset, const std::string& path) {
+    while (len > 0) {
+      ssize_t ret = ::pread(fd, data, len, offset);
+      if (ret < 0 && errno == EINTR) continue;
+      ASSERT_MSG(ret > 0, "Failed to read %s: %s", path.c_str(),
+                 ret == 0 ? "unexpected end of file" : strerror(errno));
+      data += ret;
+      len -= ret;
+      offset += ret;
+    }
+  }
+
+  void sync_file(int fd, const std::string& path) {
+    ASSERT_MSG(fdatasync(fd) == 0, "Failed to sync %s: %s", path.c_str(), strerror(errno));
+  }
+
+  // makes the files created, renamed or deleted in dir durable
+  void sync_directory(const std::string& dir) {
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    ASSERT_MSG(fd >= 0, "Failed to open %s: %s", dir.c_str(), strerror(errno));
+    int ret = fsync(fd);
+    close(fd);
+    ASSERT_MSG(ret == 0, "Failed to sync %s: %s", dir.c_str(), strerror(errno));
+  }
+
+  // the number of a file named by file_name(), or -1
+  int64_t file_number(const std::string& name) {
+    char* end;
+    unsigned long long n = strtoull(name.c_str(), &end, 10);
+    if (end == name.c_str() || *end != '.') return -1;
+    return (int64_t)n;
+  }
+} // anonymous namespace
+
+/**
+ * The records of one block of a table, sorted by key.
+ */
+struct kvstore_block {
+  std::string data;
+  std::vector<key_type> keys;
+  // offsets[i] is the position of the header of the i-th record in data
+  std::vector<uint32_t> offsets;
+
+  void parse() {
+    size_t pos = 0;
+    while (pos + RECORD_HEADER <= data.size()) {
+      key_type key;
+      uint32_t len;
+      memcpy(&key, &data[pos], sizeof(key));
+      memcpy(&len, &data[pos + 9], sizeof(len));
+      keys.push_back(key);
+      offsets.push_back(pos);
+      pos += RECORD_HEADER + len;
+    }
+    ASSERT_EQ(pos, data.size());
+  }
+
+  size_t size() const { return keys.size(); }
+
+  /// Returns the position of the first key not less than key
+  size_t lower_bound(key_type key) const {
+    return std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+  }
+
+  bool live(size_t i) const { return data[offsets[i] + 8] != 0; }
+
+  void value(size_t i, value_type& out) const {
+    uint32_t len;
+    memcpy(&len, &data[offsets[i] + 9], sizeof(len));
+    out.assign(data, offsets[i] + RECORD_HEADER, len);
+  }
+};
+
+size_t kvstore_local::block_size::operator()(const block_id&, const block_ptr& block) const {
+  return sizeof(kvstore_block) + block->data.size() +
+      block->keys.size() * (sizeof(key_type) + sizeof(uint32_t));
+}
+
+/**
+ * An immutable table file: the blocks of records sorted by key, the index
+ * of the blocks, the bloom filter of the keys and a footer. Only the index
+ * and the filter are kept in memory. The file is deleted with the last
+ * reference to a table which is obsolete.
+ */
+class kvstore_table {
+ public:
+  struct index_entry {
+    key_type first;
+    key_type last;
+    uint64_t offset;
+    uint64_t size;
+    // checksum() of the block
+    uint64_t checksum;
+  };
+
+  // set once the table is replaced by a compaction or remove_all()
+  bool obsolete;
+
+  kvstore_table(const std::string& path, uint64_t id)
+      : obsolete(false), path(path), id(id) {
+    fd = open(path.c_str(), O_RDONLY);
+    ASSERT_MSG(fd >= 0, "Failed to open %s: %s", path.c_str(), strerror(errno));
+    struct stat st;
+    ASSERT_EQ(fstat(fd, &st), 0);
+    ASSERT_MSG((size_t)st.st_size >= FOOTER_WORDS * sizeof(uint64_t),
+               "%s is not a table", path.c_str());
+    uint64_t footer[FOOTER_WORDS];
+    read_all(fd, (char*)footer, sizeof(footer), st.st_size - sizeof(footer), path);
+    ASSERT_MSG(footer[5] == TABLE_MAGIC, "%s is not a table", path.c_str());
+    index.resize(footer[1]);
+    if (!index.empty()) {
+      read_all(fd, (char*)&index[0], index.size() * sizeof(index_entry), footer[0], path);
+    }
+    std::string buf(footer[3], '\0');
+    if (!buf.empty()) read_all(fd, &buf[0], buf.size(), footer[2], path);
+    iarchive iarc(buf.data(), buf.size());
+    iarc >> filter;
+    records = footer[4];
+    bytes = st.st_size;
+  }
+
+  ~kvstore_table() {
+    close(fd);
+    if (obsolete) unlink(path.c_str());
+  }
+
+  uint64_t table_id() const { return id; }
+
+  size_t num_records() const { return records; }
+
+  /// Returns the size of the file
+  uint64_t file_bytes() const { return bytes; }
+
+  size_t num_blocks() const { return index.size(); }
+
+  /// Returns the first block whose last key is not less than key
+  size_t seek_block(key_type key) const {
+    size_t lo = 0, hi = index.size();
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (index[mid].last < key) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+  /// Returns the block which may hold key, or num_blocks()
+  size_t find_block(key_type key) const {
+    if (!filter.may_contain(key)) return index.size();
+    size_t i = seek_block(key);
+    if (i < index.size() && index[i].first <= key) return i;
+    return index.size();
+  }
+
+  /// Reads block i through the cache, or directly if cache is NULL
+  kvstore_local::block_ptr read_block(size_t i, kvstore_local::block_cache* cache) const {
+    kvstore_local::block_id bid(id, i);
+    kvstore_local::block_ptr ret;
+    if (cache != NULL && cache->get(bid, ret)) return ret;
+    kvstore_block* block = new kvstore_block;
+    ret.reset(block);
+    block->data.resize(index[i].size);
+    read_all(fd, &block->data[0], block->data.size(), index[i].offset, path);
+    ASSERT_MSG(checksum(block->data.data(), block->data.size()) == index[i].checksum,
+               "Corrupt block %llu of %s", (unsigned long long)i, path.c_str());
+    block->parse();
+    if (cache != NULL) cache->put(bid, ret);
+    return ret;
+  }
+
+  /**
+   * Looks up key. Returns false if the table does not have it, otherwise
+   * sets live, and value if live.
+   */
+  bool get(key_type key, bool& live, value_type& value,
+           kvstore_local::block_cache* cache) const {
+    size_t b = find_block(key);
+    if (b == index.size()) return false;
+    kvstore_local::block_ptr block = read_block(b, cache);
+    size_t pos = block->lower_bound(key);
+    if (pos == block->size() || block->keys[pos] != key) return false;
+    live = block->live(pos);
+    if (live) block->value(pos, value);
+    return true;
+  }
+
+ private:
+  std::string path;
+  uint64_t id;
+  int fd;
+  std::vector<index_entry> index;
+  bloom_filter filter;
+  size_t records;
+  uint64_t bytes;
+};
+
+namespace {
+  /**
+   * Writes the records of a table, in increasing key order.
+   */
+  class table_writer {
+   public:
+    table_writer(const std::string& path, size_t block_bytes, size_t expected_records)
+        : path(path), block_bytes(block_bytes), filter(expected_records + 1),
+          offset(0), records(0) {
+      fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      ASSERT_MSG(fd >= 0, "Failed to create %s: %s", path.c_str(), strerror(errno));
+    }
+
+    void add(key_type key, bool live, const value_type& value) {
+      if (block.empty()) current.first = key;
+      current.last = key;
+      append_record(block, key, live, value);
+      filter.insert(key);
+      ++records;
+      if (block.size() >= block_bytes) finish_block();
+    }
+
+    size_t num_records() const { return records; }
+
+    /// Writes the index, the filter and the footer, and syncs the file
+    void finish() {
+      finish_block();
+      uint64_t footer[FOOTER_WORDS];
+      footer[0] = offset;
+      footer[1] = index.size();
+      if (!index.empty()) {
+        write_all(fd, (const char*)&index[0], index.size() * sizeof(index[0]), path);
+      }
+      offset += index.size() * sizeof(index[0]);
+      oarchive oarc;
+      oarc << filter;
+      footer[2] = offset;
+      footer[3] = oarc.off;
+      write_all(fd, oarc.buf, oarc.off, path);
+      free(oarc.buf);
+      footer[4] = records;
+      footer[5] = TABLE_MAGIC;
+      write_all(fd, (const char*)footer, sizeof(footer), path);
+      sync_file(fd, path);
+      close(fd);
+    }
+
+   private:
+    std::string path;
+    size_t block_bytes;
+    int fd;
+    std::string block;
+    kvstore_table::index_entry current;
+    std::vector<kvstore_table::index_entry> index;
+    bloom_filter filter;
+    uint64_t offset;
+    size_t records;
+
+    void finish_block() {
+      if (block.empty()) return;
+      write_all(fd, block.data(), block.size(), path);
+      current.offset = offset;
+      current.size = block.size();
+      current.checksum = checksum(block.data(), block.size());
+      index.push_back(current);
+      offset += block.size();
+      block.clear();
+    }
+  };
+
+  /**
+   * Iterates over the records of a table from a key, without the cache
+   * so that a scan does not evict the blocks of the point lookups.
+   */
+  class table_cursor {
+   public:
+    table_cursor(const kvstore_table* table, key_type from)
+        : table(table), blk(table->seek_block(from)), pos(0) {
+      load();
+      if (block) {
+        pos = block->lower_bound(from);
+        if (pos == block->size()) next_block();
+      }
+    }
+
+    bool valid() const { return block.get() != NULL; }
+    key_type key() const { return block->keys[pos]; }
+    bool live() const { return block->live(pos); }
+    void value(value_type& out) const { block->value(pos, out); }
+
+    void next() {
+      if (++pos == block->size()) next_block();
+    }
+
+   private:
+    const kvstore_table* table;
+    size_t blk;
+    size_t pos;
+    kvstore_local::block_ptr block;
+
+    void load() {
+      if (blk < table->num_blocks()) block = table->read_block(blk, NULL);
+      else block.reset();
+    }
+
+    void next_block() {
+      ++blk;
+      pos = 0;
+      load();
+    }
+  };
+} // anonymous namespace
+
+
+kvstore_local::kvstore_local(const std::string& dir, const options& opts)
+    : dir(dir), opts(opts),
+      cache(opts.cache_bytes, 0, true, opts.block_bytes + sizeof(kvstore_block)),
+      mem(new memtable_type), mem_bytes(0), log_fd(-1), next_file(1),
+      compaction_requested(false), compacting(false), compactions_done(0),
+      stopping(false) {
+  open_directory();
+  start_background();
+}
+
+kvstore_local::~kvstore_local() {
+  stop_background_requests();
+  // the memtable stays in its log, and is recovered on the next open
+  stop_background();
+  if (log_fd >= 0) close(log_fd);
+}
+
+std::string kvstore_local::file_name(uint64_t number, const char* suffix) const {
+  char name[32];
+  snprintf(name, sizeof(name), "/%06llu%s", (unsigned long long)number, suffix);
+  return dir + name;
+}
+
+void kvstore_local::open_directory() {
+  int ret = mkdir(dir.c_str(), 0755);
+  ASSERT_MSG(ret == 0 || errno == EEXIST, "Failed to create %s: %s",
+             dir.c_str(), strerror(errno));
+
+  // the live tables are the ones of the manifest
+  std::set<uint64_t> live;
+  std::ifstream manifest((dir + "/MANIFEST").c_str());
+  std::string word;
+  uint64_t number;
+  while (manifest >> word >> number) {
+    if (word == "next_file") next_file = number;
+    else if (word == "table") live.insert(number);
+  }
+  for (std::set<uint64_t>::iterator i = live.begin(); i != live.end(); ++i) {
+    tables.push_back(table_ptr(new kvstore_table(file_name(*i, ".sst"), *i)));
+  }
+
+  // tables which were being written or deleted
+  std::vector<std::string> files;
+  fs_util::list_files_with_suffix(dir, ".sst", files);
+  for (size_t i = 0; i < files.size(); ++i) {
+    int64_t n = file_number(files[i]);
+    if (n < 0) continue;
+    next_file = std::max(next_file, (uint64_t)n + 1);
+    if (live.count(n) == 0) unlink((dir + "/" + files[i]).c_str());
+  }
+
+  // the logs of the memtables which were not written to a table
+  files.clear();
+  fs_util::list_files_with_suffix(dir, ".log", files);
+  std::vector<uint64_t> logs;
+  for (size_t i = 0; i < files.size(); ++i) {
+    int64_t n = file_number(files[i]);
+    if (n >= 0) logs.push_back(n);
+  }
+  std::sort(logs.begin(), logs.end());
+  for (size_t i = 0; i < logs.size(); ++i) {
+    next_file = std::max(next_file, logs[i] + 1);
+    replay_log(logs[i]);
+    mem_logs.push_back(logs[i]);
+  }
+
+  lock.lock();
+  start_log();
+  write_manifest();
+  lock.unlock();
+}
+
+void kvstore_local::replay_log(uint64_t number) {
+  std::string path = file_name(number, ".log");
+  std::ifstream in(path.c_str(), std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  size_t pos = 0;
+  // stops at the first torn or corrupt record: the writes after it were lost
+  while (pos + LOG_HEADER <= data.size()) {
+    uint32_t sum, len;
+    key_type key;
+    memcpy(&sum, &data[pos], sizeof(sum));
+    memcpy(&key, &data[pos + 4], sizeof(key));
+    memcpy(&len, &data[pos + 13], sizeof(len));
+    if (pos + LOG_HEADER + len > data.size() ||
+        checksum(&data[pos + 4], RECORD_HEADER + len) != sum) {
+      logstream(LOG_WARNING) << "Ignoring the end of " << path << " from offset "
+                             << pos << std::endl;
+      break;
+    }
+    bool live = data[pos + 12] != 0;
+    (*mem)[key] = std::make_pair(live, data.substr(pos + LOG_HEADER, len));
+    mem_bytes += RECORD_HEADER + len;
+    pos += LOG_HEADER + len;
+  }
+}
+
+void kvstore_local::start_log() {
+  if (log_fd >= 0) close(log_fd);
+  uint64_t number = next_file++;
+  std::string path = file_name(number, ".log");
+  log_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  ASSERT_MSG(log_fd >= 0, "Failed to create %s: %s", path.c_str(), strerror(errno));
+  mem_logs.push_back(number);
+}
+
+void kvstore_local::write_manifest() {
+  std::string path = dir + "/MANIFEST";
+  std::string tmp = path + ".tmp";
+  FILE* f = fopen(tmp.c_str(), "w");
+  ASSERT_MSG(f != NULL, "Failed to create %s: %s", tmp.c_str(), strerror(errno));
+  fprintf(f, "next_file %llu\n", (unsigned long long)next_file);
+  for (size_t i = 0; i < tables.size(); ++i) {
+    fprintf(f, "table %llu\n", (unsigned long long)tables[i]->table_id());
+  }
+  ASSERT_EQ(fflush(f), 0);
+  sync_file(fileno(f), tmp);
+  fclose(f);
+  ASSERT_MSG(rename(tmp.c_str(), path.c_str()) == 0, "Failed to rename %s: %s",
+             tmp.c_str(), strerror(errno));
+  // the rename, and the tables of the manifest, are durable only with
+  // the directory
+  sync_directory(dir);
+}
+
+void kvstore_local::set(const key_type key, const value_type &value) {
+  write(key, true, value);
+}
+
+void kvstore_local::remove(const key_type key) {
+  write(key, false, value_type());
+}
+
+void kvstore_local::write(const key_type key, bool live, const value_type& value) {
+  std::string record;
+  append_log_record(record, key, live, value);
+  apply(record, 1);
+}
+
+void kvstore_local::bulk_set(const std::vector<std::pair<key_type, value_type> > &pairs) {
+  std::string records;
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    append_log_record(records, pairs[i].first, true, pairs[i].second);
+  }
+  apply(records, pairs.size());
+}
+
+void kvstore_local::apply(const std::string& records, size_t count) {
+  lock.lock();
+  write_all(log_fd, records.data(), records.size(), file_name(mem_logs.back(), ".log"));
+  if (opts.sync_writes) sync_file(log_fd, file_name(mem_logs.back(), ".log"));
+  // the records are well formed: no need to check them as in replay_log()
+  size_t pos = 0;
+  for (size_t i = 0; i < count; ++i) {
+    key_type key;
+    uint32_t len;
+    memcpy(&key, &records[pos + 4], sizeof(key));
+    memcpy(&len, &records[pos + 13], sizeof(len));
+    std::pair<bool, value_type>& entry = (*mem)[key];
+    entry.first = records[pos + 12] != 0;
+    entry.second.assign(records, pos + LOG_HEADER, len);
+    pos += LOG_HEADER + len;
+  }
+  mem_bytes += records.size();
+  if (mem_bytes >= opts.memtable_bytes) rotate_memtable();
+  lock.unlock();
+}
+
+void kvstore_local::rotate_memtable() {
+  // the writers wait while the previous memtable is being written
+  while (imm) cond.wait(lock);
+  imm = mem;
+  imm_logs.swap(mem_logs);
+  mem_logs.clear();
+  mem.reset(new memtable_type);
+  mem_bytes = 0;
+  start_log();
+  cond.broadcast();
+}
+
+bool kvstore_local::get(const key_type key, value_type &value) {
+  lock.lock();
+  const memtable_type* memtables[2] = {mem.get(), imm.get()};
+  for (size_t i = 0; i < 2; ++i) {
+    if (memtables[i] == NULL) continue;
+    memtable_type::const_iterator iter = memtables[i]->find(key);
+    if (iter != memtables[i]->end()) {
+      bool live = iter->second.first;
+      if (live) value = iter->second.second;
+      lock.unlock();
+      return live;
+    }
+  }
+  std::vector<table_ptr> snapshot(tables);
+  lock.unlock();
+
+  for (size_t i = snapshot.size(); i > 0; --i) {
+    bool live;
+    if (snapshot[i - 1]->get(key, live, value, &cache)) return live;
+  }
+  return false;
+}
+
+std::vector<std::pair<bool, value_type> >
+kvstore_local::bulk_get(const std::vector<key_type> &keys) {
+  std::vector<std::pair<bool, value_type> > result(keys.size());
+  std::vector<bool> found(keys.size(), false);
+  // visit the keys in order, so the keys of a block are looked up together
+  std::vector<std::pair<key_type, size_t> > order(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) order[i] = std::make_pair(keys[i], i);
+  std::sort(order.begin(), order.end());
+
+  lock.lock();
+  const memtable_type* memtables[2] = {mem.get(), imm.get()};
+  for (size_t m = 0; m < 2; ++m) {
+    if (memtables[m] == NULL) continue;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (found[i]) continue;
+      memtable_type::const_iterator iter = memtables[m]->find(keys[i]);
+      if (iter == memtables[m]->end()) continue;
+      found[i] = true;
+      result[i].first = iter->second.first;
+      if (iter->second.first) result[i].second = iter->second.second;
+    }
+  }
+  std::vector<table_ptr> snapshot(tables);
+  lock.unlock();
+
+  for (size_t t = snapshot.size(); t > 0; --t) {
+    const kvstore_table* table = snapshot[t - 1].get();
+    block_ptr block;
+    size_t current = table->num_blocks();
+    for (size_t i = 0; i < order.size(); ++i) {
+      size_t k = order[i].second;
+      if (found[k]) continue;
+      size_t b = table->find_block(order[i].first);
+      if (b == table->num_blocks()) continue;
+      if (b != current) {
+        block = table->read_block(b, &cache);
+        current = b;
+      }
+      size_t pos = block->lower_bound(order[i].first);
+      if (pos == block->size() || block->keys[pos] != order[i].first) continue;
+      found[k] = true;
+      result[k].first = block->live(pos);
+      if (result[k].first) block->value(pos, result[k].second);
+    }
+  }
+  return result;
+}
+
+void kvstore_local::range_get(const key_type key_lo, const key_type key_hi,
+                              std::vector<std::pair<key_type, value_type> >& out) {
+  if (key_lo >= key_hi) return;
+  // the memtable changes after the lock is released, so its range is copied
+  memtable_type merged;
+  lock.lock();
+  memtable_type newest(mem->lower_bound(key_lo), mem->lower_bound(key_hi));
+  boost::shared_ptr<memtable_type> frozen = imm;
+  std::vector<table_ptr> snapshot(tables);
+  lock.unlock();
+
+  // apply the sources from the oldest to the newest
+  value_type value;
+  for (size_t t = 0; t < snapshot.size(); ++t) {
+    for (table_cursor cursor(snapshot[t].get(), key_lo);
+         cursor.valid() && cursor.key() < key_hi; cursor.next()) {
+      std::pair<bool, value_type>& entry = merged[cursor.key()];
+      entry.first = cursor.live();
+      if (entry.first) cursor.value(entry.second);
+      else entry.second.clear();
+    }
+  }
+  if (frozen) {
+    for (memtable_type::const_iterator iter = frozen->lower_bound(key_lo);
+         iter != frozen->end() && iter->first < key_hi; ++iter) {
+      merged[iter->first] = iter->second;
+    }
+  }
+  for (memtable_type::const_iterator iter = newest.begin(); iter != newest.end(); ++iter) {
+    merged[iter->first] = iter->second;
+  }
+  for (memtable_type::const_iterator iter = merged.begin(); iter != merged.end(); ++iter) {
+    if (iter->second.first) out.push_back(std::make_pair(iter->first, iter->second.second));
+  }
+}
+
+std::vector<value_type> kvstore_local::range_get(const key_type key_lo, const key_type key_hi) {
+  std::vector<std::pair<key_type, value_type> > pairs;
+  range_get(key_lo, key_hi, pairs);
+  std::vector<value_type> result(pairs.size());
+  for (size_t i = 0; i < pairs.size(); ++i) result[i].swap(pairs[i].second);
+  return result;
+}
+
+std::pair<bool, value_type> kvstore_local::background_get_thread(const key_type key) {
+  std::pair<bool, value_type> result;
+  result.first = get(key, result.second);
+  return result;
+}
+
+void kvstore_local::flush() {
+  lock.lock();
+  if (!mem->empty()) rotate_memtable();
+  while (imm) cond.wait(lock);
+  lock.unlock();
+}
+
+void kvstore_local::compact() {
+  flush();
+  lock.lock();
+  // a compaction in progress may have started without the last table
+  size_t target = compactions_done + (compacting ? 2 : 1);
+  compaction_requested = true;
+  cond.broadcast();
+  while (compactions_done < target) cond.wait(lock);
+  lock.unlock();
+}
+
+size_t kvstore_local::num_tables() {
+  lock.lock();
+  size_t ret = tables.size();
+  lock.unlock();
+  return ret;
+}
+
+void kvstore_local::remove_all() {
+  lock.lock();
+  // the background thread must not be writing a table meanwhile
+  while (imm || compacting) cond.wait(lock);
+  for (size_t i = 0; i < tables.size(); ++i) tables[i]->obsolete = true;
+  tables.clear();
+  mem->clear();
+  mem_bytes = 0;
+  std::vector<uint64_t> logs;
+  logs.swap(mem_logs);
+  start_log();
+  write_manifest();
+  lock.unlock();
+  for (size_t i = 0; i < logs.size(); ++i) unlink(file_name(logs[i], ".log").c_str());
+  cache.clear();
+}
+
+void kvstore_local::start_background() {
+  background.launch(boost::bind(&kvstore_local::background_loop, this));
+}
+
+void kvstore_local::stop_background() {
+  lock.lock();
+  stopping = true;
+  cond.broadcast();
+  lock.unlock();
+  background.join();
+}
+
+bool kvstore_local::pick_compaction(size_t& begin, size_t& end) const {
+  // the newest run of at least compaction_trigger consecutive tables of
+  // similar sizes. Each merge makes a table about compaction_trigger times
+  // larger, so a record is rewritten once per size tier instead of at
+  // every compaction.
+  size_t trigger = std::max(opts.compaction_trigger, (size_t)2);
+  for (end = tables.size(); end >= trigger; --end) {
+    uint64_t smallest = tables[end - 1]->file_bytes();
+    uint64_t largest = smallest;
+    for (begin = end - 1; begin > 0; --begin) {
+      uint64_t bytes = tables[begin - 1]->file_bytes();
+      uint64_t lo = std::min(smallest, bytes), hi = std::max(largest, bytes);
+      if (hi > lo * COMPACTION_SIZE_RATIO) break;
+      smallest = lo;
+      largest = hi;
+    }
+    if (end - begin >= trigger) return true;
+  }
+  return false;
+}
+
+void kvstore_local::background_loop() {
+  lock.lock();
+  while (true) {
+    size_t begin, end;
+    if (imm) {
+      boost::shared_ptr<memtable_type> memtable = imm;
+      std::vector<uint64_t> logs = imm_logs;
+      lock.unlock();
+      flush_imm(memtable, logs);
+      lock.lock();
+    } else if (compaction_requested) {
+      compaction_requested = false;
+      if (tables.size() > 1) {
+        compacting = true;
+        lock.unlock();
+        run_compaction(0, tables.size());
+        lock.lock();
+        compacting = false;
+      }
+      ++compactions_done;
+      cond.broadcast();
+    } else if (!stopping && pick_compaction(begin, end)) {
+      compacting = true;
+      lock.unlock();
+      run_compaction(begin, end);
+      lock.lock();
+      compacting = false;
+      ++compactions_done;
+      cond.broadcast();
+    } else if (stopping) {
+      break;
+    } else {
+      cond.wait(lock);
+    }
+  }
+  lock.unlock();
+}
+
+void kvstore_local::flush_imm(boost::shared_ptr<memtable_type> memtable,
+                              std::vector<uint64_t> logs) {
+  lock.lock();
+  uint64_t number = next_file++;
+  lock.unlock();
+
+  std::string path = file_name(number, ".sst");
+  table_writer writer(path, opts.block_bytes, memtable->size());
+  for (memtable_type::const_iterator iter = memtable->begin(); iter != memtable->end(); ++iter) {
+    writer.add(iter->first, iter->second.first, iter->second.second);
+  }
+  writer.finish();
+  table_ptr table(new kvstore_table(path, number));
+
+  lock.lock();
+  tables.push_back(table);
+  imm.reset();
+  imm_logs.clear();
+  write_manifest();
+  cond.broadcast();
+  lock.unlock();
+  // the manifest has the table, so its logs are not needed anymore
+  for (size_t i = 0; i < logs.size(); ++i) unlink(file_name(logs[i], ".log").c_str());
+}
+
+void kvstore_local::run_compaction(size_t begin, size_t end) {
+  lock.lock();
+  // flushes only append tables, so these stay at the same positions
+  std::vector<table_ptr> inputs(tables.begin() + begin, tables.begin() + end);
+  uint64_t number = next_file++;
+  lock.unlock();
+
+  size_t expected = 0;
+  std::vector<table_cursor> cursors;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    expected += inputs[i]->num_records();
+    cursors.push_back(table_cursor(inputs[i].get(), 0));
+  }
+
+  std::string path = file_name(number, ".sst");
+  table_writer writer(path, opts.block_bytes, expected);
+  value_type value;
+  while (true) {
+    // the smallest key, from the newest table which has it
+    size_t newest = cursors.size();
+    for (size_t i = 0; i < cursors.size(); ++i) {
+      if (cursors[i].valid() &&
+          (newest == cursors.size() || cursors[i].key() <= cursors[newest].key())) {
+        newest = i;
+      }
+    }
+    if (newest == cursors.size()) break;
+    key_type key = cursors[newest].key();
+    // removed keys can be dropped only if no older table has them
+    if (cursors[newest].live()) {
+      cursors[newest].value(value);
+      writer.add(key, true, value);
+    } else if (begin > 0) {
+      writer.add(key, false, value_type());
+    }
+    for (size_t i = 0; i < cursors.size(); ++i) {
+      if (cursors[i].valid() && cursors[i].key() == key) cursors[i].next();
+    }
+  }
+  writer.finish();
+  table_ptr merged;
+  if (writer.num_records() > 0) merged.reset(new kvstore_table(path, number));
+  else unlink(path.c_str());
+
+  lock.lock();
+  std::vector<table_ptr> next(tables.begin(), tables.begin() + begin);
+  if (merged) next.push_back(merged);
+  next.insert(next.end(), tables.begin() + end, tables.end());
+  for (size_t i = 0; i < inputs.size(); ++i) inputs[i]->obsolete = true;
+  tables.swap(next);
+  write_manifest();
+  lock.unlock();
+}
+
+}
@@ -0,0 +1,166 @@
+#ifndef GRAPHLAB_DATABASE_KVSTORE_LOCAL_HPP
+#define GRAPHLAB_DATABASE_KVSTORE_LOCAL_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <boost/shared_ptr.hpp>
+
+#include <graphlab/database/kvstore_base.hpp>
+#include <graphlab/util/concurrent_cache.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+namespace graphlab {
+
+class kvstore_table;
+struct kvstore_block;
+
+/**
+ * \ingroup group_graph_database
+ * An embedded key value store in a local directory, which needs no
+ * external service. It is a log structured merge tree:
+ *
+ * \li Writes are appended to a log, and applied to a sorted in memory
+ *     table (the memtable).
+ * \li When the memtable is larger than options::memtable_bytes, it is
+ *     written by a background thread to an immutable sorted table file,
+ *     made of blocks of about options::block_bytes, a block index and a
+ *     bloom filter of the keys. The log is then deleted.
+ * \li When there are options::compaction_trigger consecutive tables of
+ *     similar sizes, the background thread merges them into one, dropping
+ *     the overwritten values, and the removed keys if the oldest table is
+ *     merged. The tables thus form size tiers, and a record is rewritten
+ *     about once per tier.
+ *
+ * A get() looks up the memtables, then the tables from the newest to the
+ * oldest, skipping the tables whose bloom filter excludes the key, and
+ * reads at most one block per table. Blocks are kept in a shared block
+ * cache of options::cache_bytes. bulk_get() sorts the keys and reads each
+ * block once for all the keys it holds. range_get() returns the values of
+ * the keys in [key_lo, key_hi), in key order.
+ *
+ * The store is thread safe. Writes are durable once the operating system
+ * has them, unless options::sync_writes also syncs the log to the disk on
+ * every write. The log records and the table blocks have checksums: a
+ * read of a corrupt block fails, and a log is replayed up to its first
+ * corrupt record. The contents are recovered from the tables and the logs
+ * when a store is opened again on the same directory, which must not be
+ * opened by two stores at once.
+ */
+class kvstore_local: public kvstore_base {
+public:
+  struct options {
+    /// Size of the memtable which triggers a flush to a table
+    size_t memtable_bytes;
+    /// Target size of the blocks of the tables
+    size_t block_bytes;
+    /// Size of the block cache
+    size_t cache_bytes;
+    /// Number of tables of similar sizes which triggers a compaction
+    size_t compaction_trigger;
+    /// Sync the log to the disk on every write
+    bool sync_writes;
+    options() : memtable_bytes(4 << 20), block_bytes(4096), cache_bytes(64 << 20),
+                compaction_trigger(4), sync_writes(false) { }
+  };
+
+  /// Opens the store in directory dir, creating it if needed
+  kvstore_local(const std::string& dir, const options& opts = options());
+  virtual ~kvstore_local();
+
+  virtual void set(const key_type key, const value_type &value);
+
+  /// Sets all the pairs with one write to the log
+  virtual void bulk_set(const std::vector<std::pair<key_type, value_type> > &pairs);
+
+  /// Removes key from the store
+  void remove(const key_type key);
+
+  virtual bool get(const key_type key, value_type &value);
+
+  virtual std::vector<std::pair<bool, value_type> > bulk_get(const std::vector<key_type> &keys);
+
+  virtual std::vector<value_type> range_get(const key_type key_lo, const key_type key_hi);
+
+  /// Like range_get(), with the keys
+  void range_get(const key_type key_lo, const key_type key_hi,
+                 std::vector<std::pair<key_type, value_type> >& out);
+
+  std::pair<bool, value_type> background_get_thread(const key_type key);
+
+  virtual void remove_all();
+
+  /// Writes the memtable to a table, and returns when it is written
+  void flush();
+
+  /// Flushes, then merges all the tables into one, and returns when done
+  void compact();
+
+  /// Returns the number of tables on disk
+  size_t num_tables();
+
+  /// Returns the hit statistics of the block cache
+  cache_stats block_cache_stats() const { return cache.stats(); }
+
+  /// (table id, block number)
+  typedef std::pair<uint64_t, uint64_t> block_id;
+  typedef boost::shared_ptr<const kvstore_block> block_ptr;
+
+  struct block_size {
+    size_t operator()(const block_id&, const block_ptr& block) const;
+  };
+  typedef concurrent_cache<block_id, block_ptr, block_size> block_cache;
+
+private:
+  // key -> (true, value), or (false, "") for a removed key
+  typedef std::map<key_type, std::pair<bool, value_type> > memtable_type;
+  typedef boost::shared_ptr<kvstore_table> table_ptr;
+
+  std::string dir;
+  options opts;
+  block_cache cache;
+
+  // protects all the members below
+  mutex lock;
+  // signals the background thread, and the waits for it
+  conditional cond;
+
+  boost::shared_ptr<memtable_type> mem;
+  size_t mem_bytes;
+  // the memtable being written to a table, if any
+  boost::shared_ptr<memtable_type> imm;
+  // the tables from the oldest to the newest
+  std::vector<table_ptr> tables;
+
+  // the log of the memtable, and the logs whose contents are in imm
+  int log_fd;
+  std::vector<uint64_t> mem_logs;
+  std::vector<uint64_t> imm_logs;
+
+  uint64_t next_file;
+  bool compaction_requested;
+  bool compacting;
+  size_t compactions_done;
+  bool stopping;
+  thread background;
+
+  void write(const key_type key, bool live, const value_type& value);
+  void apply(const std::string& records, size_t count);
+  void rotate_memtable();
+  void start_log();
+  void replay_log(uint64_t number);
+  void write_manifest();
+  void open_directory();
+  void background_loop();
+  void flush_imm(boost::shared_ptr<memtable_type> memtable, std::vector<uint64_t> logs);
+  bool pick_compaction(size_t& begin, size_t& end) const;
+  void run_compaction(size_t begin, size_t end);
+  void start_background();
+  void stop_background();
+  std::string file_name(uint64_t number, const char* suffix) const;
+};
+
+}
+
+#endif
@@ -5,6 +5,7 @@
  *      Author: svilen
  */
 
+#include <map>
 #include <memory>
 
 #include <graphlab/database/kvstore_mongodb.hpp>
@@ -27,10 +28,17 @@ kvstore_mongodb::kvstore_mongodb(std::string addr, int port, std::string ns) : _
   std::string error_msg;
   ASSERT_TRUE(_conn.connect(mongo::HostAndPort(addr, port), error_msg));
   _conn.createCollection(_ns);
+
+  // one connection, which is not thread safe
+  async_options opts;
+  opts.num_workers = 1;
+  set_async_options(opts);
+
   printf("MongoDB connection open\n");
 }
 
 kvstore_mongodb::~kvstore_mongodb() {
+  stop_background_requests();
   printf("MongoDB connection closed\n");
 }
 
@@ -54,6 +62,29 @@ bool kvstore_mongodb::get(const key_type key, value_type &value) {
   return true;
 }
 
+std::vector<std::pair<bool, value_type> > kvstore_mongodb::bulk_get(const std::vector<key_type> &keys) {
+  mongo::BSONArrayBuilder key_array;
+  BOOST_FOREACH(key_type key, keys) {
+    key_array.append((long long) key);
+  }
+  mongo::BSONObj query = BSON(mongodb_keyattr_name << BSON("$in" << key_array.arr()));
+
+  std::map<key_type, value_type> found;
+  std::auto_ptr<mongo::DBClientCursor> cursor = _conn.query(_ns, query);
+  while (cursor->more()) {
+    mongo::BSONObj obj = cursor->next();
+    found[(key_type) obj.getField(mongodb_keyattr_name).numberLong()] = obj.getStringField(mongodb_valueattr_name);
+  }
+
+  std::vector<std::pair<bool, value_type> > result(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    std::map<key_type, value_type>::const_iterator iter = found.find(keys[i]);
+    result[i].first = (iter != found.end());
+    if (result[i].first) result[i].second = iter->second;
+  }
+  return result;
+}
+
 std::vector<value_type> kvstore_mongodb::range_get(const key_type key_lo, const key_type key_hi) {
   mongo::BSONObj query = BSON(mongodb_keyattr_name << mongo::GTE << (long long) key_lo << mongo::LT << (long long) key_hi);
   std::vector<value_type> result;
@@ -27,6 +27,7 @@ public:
   virtual void set(const key_type key, const value_type &value);
 
   virtual bool get(const key_type key, value_type &value);
+  virtual std::vector<std::pair<bool, value_type> > bulk_get(const std::vector<key_type> &keys);
   virtual std::vector<value_type> range_get(const key_type key_lo, const key_type key_hi);
 
   std::pair<bool, value_type> background_get_thread(const key_type key);
@@ -5,6 +5,8 @@
  *      Author: svilen
  */
 
+#include <algorithm>
+
 #include <graphlab/database/kvstore_mysql.hpp>
 #include <graphlab/logger/assertions.hpp>
 
@@ -58,10 +60,16 @@ kvstore_mysql::kvstore_mysql() {
   _table = _dict->getTable(mysql_table_name.c_str());
   ASSERT_TRUE(_table != NULL);
 
+  // one connection, which is not thread safe
+  async_options opts;
+  opts.num_workers = 1;
+  set_async_options(opts);
+
   printf("MySQL connection open\n");
 }
 
 kvstore_mysql::~kvstore_mysql() {
+  stop_background_requests();
   delete _mysql;
   _mysql = NULL;
   delete _ndb;
@@ -89,6 +97,29 @@ void kvstore_mysql::set(const key_type key, const value_type &value) {
   _ndb->closeTransaction(trans);
 }
 
+void kvstore_mysql::bulk_set(const std::vector<std::pair<key_type, value_type> > &pairs) {
+  for (size_t begin = 0; begin < pairs.size(); begin += mysql_batch_size) {
+    size_t end = std::min(pairs.size(), begin + mysql_batch_size);
+    NdbTransaction *trans = _ndb->startTransaction();
+    ASSERT_TRUE(trans != NULL);
+
+    for (size_t i = begin; i < end; ++i) {
+      NdbOperation *op = trans->getNdbOperation(_table);
+      ASSERT_TRUE(op != NULL);
+
+      op->writeTuple();
+      op->equal(mysql_keyattr_name, (int) pairs[i].first);
+      NdbBlob *blob_handle = op->getBlobHandle(mysql_valueattr_name);
+      blob_handle->setValue((void *) pairs[i].second.data(), (Uint32) pairs[i].second.length());
+    }
+
+    int trans_result = trans->execute(NdbTransaction::Commit);
+    ASSERT_FALSE(trans_result == -1);
+
+    _ndb->closeTransaction(trans);
+  }
+}
+
 bool kvstore_mysql::get(const key_type key, value_type &value) {
   NdbTransaction *trans = _ndb->startTransaction();
   ASSERT_TRUE(trans != NULL);
@@ -119,6 +150,48 @@ bool kvstore_mysql::get(const key_type key, value_type &value) {
   return found;
 }
 
+std::vector<std::pair<bool, value_type> > kvstore_mysql::bulk_get(const std::vector<key_type> &keys) {
+  std::vector<std::pair<bool, value_type> > result(keys.size());
+
+  for (size_t begin = 0; begin < keys.size(); begin += mysql_batch_size) {
+    size_t end = std::min(keys.size(), begin + mysql_batch_size);
+    NdbTransaction *trans = _ndb->startTransaction();
+    ASSERT_TRUE(trans != NULL);
+
+    std::vector<NdbIndexOperation *> ops(end - begin);
+    std::vector<NdbBlob *> blob_handles(end - begin);
+    char *blob_data = (char *) malloc((end - begin) * mysql_max_blob_size);
+    for (size_t i = begin; i < end; ++i) {
+      NdbIndexOperation *op = trans->getNdbIndexOperation(mysql_index_name.c_str(), mysql_table_name.c_str());
+      ASSERT_TRUE(op != NULL);
+
+      op->readTuple();
+      op->equal(mysql_keyattr_name, (int) keys[i]);
+      blob_handles[i - begin] = op->getBlobHandle(mysql_valueattr_name);
+      blob_handles[i - begin]->getValue(blob_data + (i - begin) * mysql_max_blob_size, mysql_max_blob_size);
+      ops[i - begin] = op;
+    }
+
+    // a missing key only fails its own operation
+    int trans_result = trans->execute(NdbTransaction::NoCommit, NdbOperation::AO_IgnoreError);
+    ASSERT_FALSE(trans_result == -1);
+
+    for (size_t i = begin; i < end; ++i) {
+      result[i].first = (ops[i - begin]->getNdbError().classification == NdbError::NoError);
+      if (result[i].first) {
+        Uint64 blob_size;
+        blob_handles[i - begin]->getLength(blob_size);
+        result[i].second = std::string(blob_data + (i - begin) * mysql_max_blob_size, blob_size);
+      }
+    }
+
+    free(blob_data);
+    _ndb->closeTransaction(trans);
+  }
+
+  return result;
+}
+
 std::vector<value_type> kvstore_mysql::range_get(const key_type key_lo, const key_type key_hi) {
   std::vector<value_type> result;
 
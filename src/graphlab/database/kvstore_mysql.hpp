@@ -16,6 +16,8 @@
 namespace graphlab {
 
 const int mysql_max_blob_size = 65535;
+// operations per transaction in bulk_get() and bulk_set()
+const size_t mysql_batch_size = 64;
 
 class kvstore_mysql: public kvstore_base {
 public:
@@ -23,8 +25,10 @@ public:
   virtual ~kvstore_mysql();
 
   virtual void set(const key_type key, const value_type &value);
+  virtual void bulk_set(const std::vector<std::pair<key_type, value_type> > &pairs);
 
   virtual bool get(const key_type key, value_type &value);
+  virtual std::vector<std::pair<bool, value_type> > bulk_get(const std::vector<key_type> &keys);
   virtual std::vector<value_type> range_get(const key_type key_lo, const key_type key_hi);
 
   std::pair<bool, value_type> background_get_thread(const key_type key);
@@ -6,20 +6,23 @@ namespace graphlab {
 
   const char* QueryMessage::qm_obj_type_str[NUM_OBJ_TYPE] = {
     "vertex", "edge", "vertex_adj", "vertex_mirror", "shard",
-    "num_vertices", "num_edges", "vertex_field", "edge_field", "reset", "undefined"
+    "num_vertices", "num_edges", "vertex_field", "edge_field", "reset", "stats", "trace",
+    "vertex_adj_filter", "components", "undefined"
   };
 
-  QueryMessage::QueryMessage(header h) : h(h), iarc(NULL) {
-    oarc << h.cmd << h.obj;
+  QueryMessage::QueryMessage(header h) : h(h),
+      request_id(event_trace::current_request_id()), iarc(NULL) {
+    oarc << h.cmd << h.obj << request_id;
   }
 
-  QueryMessage::QueryMessage(qm_cmd_type cmd, qm_obj_type obj) : h(cmd, obj), iarc(NULL) {
-    oarc << cmd << obj;
+  QueryMessage::QueryMessage(qm_cmd_type cmd, qm_obj_type obj) : h(cmd, obj),
+      request_id(event_trace::current_request_id()), iarc(NULL) {
+    oarc << cmd << obj << request_id;
   }
 
   QueryMessage::QueryMessage(char* msg, size_t len) { 
     iarc = new iarchive(msg, len);
-    *iarc >> h.cmd >> h.obj;
+    *iarc >> h.cmd >> h.obj >> request_id;
   }
 
   QueryMessage::~QueryMessage() {
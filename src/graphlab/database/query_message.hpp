@@ -2,12 +2,17 @@
 #define GRAPHLAB_DATABASE_QUERY_MESSAGE_HPP
 #include<graphlab/serialization/iarchive.hpp>
 #include<graphlab/serialization/oarchive.hpp>
+#include<graphlab/util/event_trace.hpp>
 namespace graphlab {
   /**
    * This class defines the query message protocol from 
    * <code>graphdb_client</code> to <code>graphdb_server</code>
    * It supports serialization and deserialized.
    *
+   * The message carries the request id of the sending thread (see
+   * \ref trace_request_scope), so that the spans recorded by the server
+   * belong to the client request which caused them.
+   *
    * Send query example: 
    *  QueryMessage qm(cmd, objective);
    *  qm << arg0 << arg1 << arg2... ;
@@ -41,12 +46,17 @@ namespace graphlab {
      enum qm_obj_type{ 
        VERTEX, EDGE, VERTEXADJ, VMIRROR, SHARD, 
        NVERTS, NEDGES, VFIELD, EFIELD, 
-       RESET,
+       RESET, STATS, TRACE, VADJFILTER, COMPONENTS,
        UNDEFINED
      };
 
+     /// Payload of ADMIN TRACE requests
+     enum trace_action {
+       TRACE_START, TRACE_STOP, TRACE_COLLECT
+     };
+
      static const size_t NUM_CMD_TYPE = 7;
-     static const size_t NUM_OBJ_TYPE = 11;
+     static const size_t NUM_OBJ_TYPE = 15;
 
      static const char* qm_cmd_type_str[NUM_CMD_TYPE]; 
 
@@ -94,6 +104,9 @@ namespace graphlab {
 
      inline header get_header() { return h; }
 
+     /// Returns the trace request id of the message. 0 if there is none.
+     inline uint64_t get_request_id() { return request_id; }
+
      /// Deserialize the argument from the message;
      template<typename T>
      QueryMessage& operator>>(T& value) {
@@ -102,6 +115,7 @@ namespace graphlab {
      }
    private:
     header h;
+    uint64_t request_id;
     oarchive oarc;
     iarchive* iarc;
   }; // end of class
@@ -6,27 +6,46 @@
 namespace graphlab {
 
   void graph_shard_server::clear() {
+    tier_scope scope(*this);
     shard.clear();
+    tier.clear();
     vertex_fields.clear();
     edge_fields.clear();
   }
 
   // -------------------- Query API -----------------------
+  // The public functions which access the tier hold a tier_scope
+
   // Read API
   int graph_shard_server::graph_shard_server::get_vertex(graph_vid_t vid, graph_row& out) {
-    if (!shard.has_vertex(vid)) {
+    tier_scope scope(*this);
+    int err = get_vertex_row(vid, out);
+    tier.enforce_budget();
+    return err;
+  }
+
+  int graph_shard_server::get_edge(graph_eid_t eid, graph_row& out) {
+    tier_scope scope(*this);
+    int err = get_edge_row(eid, out);
+    tier.enforce_budget();
+    return err;
+  }
+
+  int graph_shard_server::get_vertex_row(graph_vid_t vid, graph_row& out) {
+    graph_row* row = vertex_row(vid);
+    if (row == NULL) {
       return EINVID;
     }
-    out = *shard.vertex_data_by_id(vid);
+    out = *row;
     return 0;
   }
 
-  int graph_shard_server::get_edge(graph_eid_t eid, graph_row& out) {
+  int graph_shard_server::get_edge_row(graph_eid_t eid, graph_row& out) {
     std::pair<graph_shard_id_t, graph_leid_t> pair = split_eid(eid);
     if (pair.first != shard.id() || pair.second >= shard.num_edges()) {
       return EINVID;
     }
-    out = *shard.edge_data(pair.second);
+    out = *tier.edge_row(pair.second);
     return 0;
   }
 
@@ -50,73 +69,149 @@ namespace graphlab {
     return 0;
   }
 
+  void graph_shard_server::get_vertex_adj_filter(bool in_edges, bloom_filter& out) {
+    // sized by the number of edges, an upper bound of the number of
+    // vertices, with room for the edges the clients add to their copies
+    out = bloom_filter(shard.num_edges() + 1024);
+    for (size_t i = 0; i < shard.num_edges(); ++i) {
+      const std::pair<graph_vid_t, graph_vid_t> e = shard.edge(i);
+      out.insert(in_edges ? e.second : e.first);
+    }
+  }
+
+  void graph_shard_server::get_components(thread_pool& pool,
+                                          graph_components::label_vector& out) {
+    graph_components::label_shard(shard, pool, out);
+  }
+
   // Write API
   int graph_shard_server::set_vertex(const graph_vid_t vid, const graph_row& data) {
-    return set_data_helper(shard.vertex_data_by_id(vid), data);
+    tier_scope scope(*this);
+    int err = set_vertex_row(vid, data);
+    tier.enforce_budget();
+    return err;
   }
 
   int graph_shard_server::set_edge(const graph_eid_t eid, const graph_row& data) {
+    tier_scope scope(*this);
+    int err = set_edge_row(eid, data);
+    tier.enforce_budget();
+    return err;
+  }
+
+  int graph_shard_server::set_vertex_row(const graph_vid_t vid, const graph_row& data) {
+    size_t pos;
+    if (!shard.vertex_position(vid, pos)) {
+      return EINVID;
+    }
+    int err = set_data_helper(tier.vertex_row(pos), data);
+    if (err == 0) tier.mark_dirty(false, pos);
+    return err;
+  }
+
+  int graph_shard_server::set_edge_row(const graph_eid_t eid, const graph_row& data) {
     std::pair<graph_shard_id_t, graph_leid_t> pair = split_eid(eid);
-    if (pair.first != shard.id()) {
+    if (pair.first != shard.id() || pair.second >= shard.num_edges()) {
       return EINVID;
     }
-    return set_data_helper(shard.edge_data(pair.second), data);
+    int err = set_data_helper(tier.edge_row(pair.second), data);
+    if (err == 0) tier.mark_dirty(true, pair.second);
+    return err;
+  }
+
+  void graph_shard_server::prefetch_vertices(const std::vector<graph_vid_t>& vids) {
+    if (!tier.enabled()) return;
+    std::vector<size_t> positions, none;
+    size_t pos;
+    for (size_t i = 0; i < vids.size(); ++i) {
+      if (shard.vertex_position(vids[i], pos)) positions.push_back(pos);
+    }
+    tier.fetch(positions, none);
+  }
+
+  void graph_shard_server::prefetch_edges(const std::vector<graph_eid_t>& eids) {
+    if (!tier.enabled()) return;
+    std::vector<size_t> positions, none;
+    for (size_t i = 0; i < eids.size(); ++i) {
+      std::pair<graph_shard_id_t, graph_leid_t> pair = split_eid(eids[i]);
+      if (pair.first == shard.id() && pair.second < shard.num_edges()) {
+        positions.push_back(pair.second);
+      }
+    }
+    tier.fetch(none, positions);
   }
 
   // ------------------- Batch Query API -------------------- 
   bool graph_shard_server::get_vertices(const std::vector<graph_vid_t>& vids,
                                         std::vector<graph_row>& out,
                                         std::vector<int>& errorcodes) {
+    tier_scope scope(*this);
     out.resize(vids.size());
     bool success = true;
     out.resize(vids.size());
+    prefetch_vertices(vids);
     for (size_t i = 0; i < vids.size(); ++i) {
-      int err = get_vertex(vids[i], out[i]);
+      int err = get_vertex_row(vids[i], out[i]);
       errorcodes.push_back(err);
       success &= (err == 0);
     }
+    tier.enforce_budget();
     return success;
   }
 
   bool graph_shard_server::get_edges(const std::vector<graph_eid_t>& eids,
                                      std::vector<graph_row>& out,
                                      std::vector<int>& errorcodes) {
+    tier_scope scope(*this);
     out.resize(eids.size());
     bool success = true;
     out.resize(eids.size());
+    prefetch_edges(eids);
     for (size_t i = 0; i < eids.size(); ++i) {
-      int err = get_edge(eids[i], out[i]);
+      int err = get_edge_row(eids[i], out[i]);
       errorcodes.push_back(err);
       success &= (err == 0);
     }
+    tier.enforce_budget();
     return success;
   }
 
    // Write API
   bool graph_shard_server::set_vertices(const std::vector<std::pair<graph_vid_t, graph_row> >& pairs,
                                         std::vector<int>& errorcodes) {
+    tier_scope scope(*this);
     bool success = true;
+    std::vector<graph_vid_t> vids(pairs.size());
+    for (size_t i = 0; i < pairs.size(); ++i) vids[i] = pairs[i].first;
+    prefetch_vertices(vids);
     for (size_t i = 0; i < pairs.size(); ++i) {
-      int err = set_vertex(pairs[i].first, pairs[i].second);
+      int err = set_vertex_row(pairs[i].first, pairs[i].second);
       errorcodes.push_back(err);
       success &= (err == 0);
     }
+    tier.enforce_budget();
     return success;
   }
   
   bool graph_shard_server::set_edges(const std::vector<std::pair<graph_eid_t, graph_row> >& pairs,
                                      std::vector<int>& errorcodes) {
+    tier_scope scope(*this);
     bool success = true;
+    std::vector<graph_eid_t> eids(pairs.size());
+    for (size_t i = 0; i < pairs.size(); ++i) eids[i] = pairs[i].first;
+    prefetch_edges(eids);
     for (size_t i = 0; i < pairs.size(); i++) {
-      int err = set_edge(pairs[i].first, pairs[i].second);
+      int err = set_edge_row(pairs[i].first, pairs[i].second);
       errorcodes.push_back(err);
       success &= (err == 0);
     }
+    tier.enforce_budget();
     return success;
   }
   
   // -------- Data Schema API ---------------------
   int graph_shard_server::add_vertex_field(const graph_field& field) {
+    tier_scope scope(*this);
     if (find_vertex_field(field.name.c_str()) >= 0) {
       return EDUP;
     } else {
@@ -128,6 +223,7 @@ namespace graphlab {
   }
 
   int graph_shard_server::add_edge_field(const graph_field& field) {
+    tier_scope scope(*this);
     if (find_edge_field(field.name.c_str()) >= 0) {
       return EDUP;
     } else {
@@ -141,21 +237,27 @@ namespace graphlab {
 
   // -------- Modification API --------------
   int graph_shard_server::add_vertex(graph_vid_t vid, const graph_row& data) {
+    tier_scope scope(*this);
     int errorcode = 0;
-    if (shard.has_vertex(vid)) { // vertex has already been inserted 
-        graph_row* row =  shard.vertex_data_by_id(vid);
+    size_t pos;
+    if (!check_vector_dims(data)) {
+      errorcode = EINVTYPE;
+    } else if (shard.vertex_position(vid, pos)) { // vertex has already been inserted 
+        graph_row* row = tier.vertex_row(pos);
         if (row->is_null()) { // existing vertex has no value, update with new value
           *row = data;
+          tier.mark_dirty(false, pos);
         } else { // existing vertex has value, cannot overwrite, return false
           errorcode = EDUP;
         }
     } else {
       if (data.is_vertex()) {
-        shard.add_vertex(vid, data);
+        tier.mark_dirty(false, shard.add_vertex(vid, data));
       } else {
         errorcode = EINVTYPE;
       }
     }
+    tier.enforce_budget();
     if (errorcode != 0) {
       logstream(LOG_WARNING) << "Error code: " << errorcode << ". " << glstrerr(errorcode) 
                            << ": (" << vid << ":" << data << ") " << std::endl;
@@ -164,8 +266,10 @@ namespace graphlab {
   }
 
   int graph_shard_server::add_edge(graph_vid_t source, graph_vid_t target, const graph_row& data) {
-    if (data.is_edge()) {
-      shard.add_edge(source, target, data);
+    tier_scope scope(*this);
+    if (data.is_edge() && check_vector_dims(data)) {
+      tier.mark_dirty(true, shard.add_edge(source, target, data));
+      tier.enforce_budget();
       return 0;
     } else {
       logstream(LOG_WARNING) << glstrerr(EINVTYPE) 
@@ -211,10 +315,11 @@ namespace graphlab {
    * Add shard_id to the vertex mirror list. Assuming the vertex to be updated is stored in a local shard.
    */
   int graph_shard_server::add_vertex_mirror(graph_vid_t vid, const std::vector<graph_shard_id_t>& mirrors) {
+    tier_scope scope(*this);
     int errorcode = 0;
     if (!shard.has_vertex(vid)) { 
       graph_row empty_row;
-      shard.add_vertex(vid, empty_row);
+      tier.mark_dirty(false, shard.add_vertex(vid, empty_row));
     }
     for (size_t i = 0; i < mirrors.size(); i++) {
       shard.add_vertex_mirror(vid, mirrors[i]);
@@ -231,9 +336,24 @@ namespace graphlab {
         return EINVTYPE;
       }
     }
+    if (!check_vector_dims(data)) return EINVTYPE;
     for (size_t i = 0; i < data.num_fields(); i++) {
       *old_data->get_field(i) = *data.get_field(i);
     }
     return 0;
   }
+
+  bool graph_shard_server::check_vector_dims(const graph_row& data) const {
+    const std::vector<graph_field>& fields = data.is_vertex() ? vertex_fields : edge_fields;
+    for (size_t i = 0; i < data.num_fields() && i < fields.size(); ++i) {
+      const graph_value* value = data.get_field(i);
+      // a NULL value clears the field, so its dimension does not matter
+      if (fields[i].type == DOUBLE_VEC_TYPE && fields[i].max_data_length > 0 &&
+          value->type() == DOUBLE_VEC_TYPE && !value->is_null() &&
+          value->vec_dim() != fields[i].max_data_length) {
+        return false;
+      }
+    }
+    return true;
+  }
 } // end of namespace
@@ -1,6 +1,11 @@
 #ifndef GRAPHLAB_DATABASE_GRAPH_SHARD_SERVER_HPP
 #define GRAPHLAB_DATABASE_GRAPH_SHARD_SERVER_HPP
 #include <graphlab/database/graph_database.hpp>
+#include <graphlab/database/graph_components.hpp>
+#include <graphlab/database/graph_row_tier.hpp>
+#include <graphlab/database/kvstore_base.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/bloom_filter.hpp>
 namespace graphlab {
   class graph_shard_server : public graph_database {
    public:
@@ -11,13 +16,13 @@ namespace graphlab {
 
    public:
      /// Creates server with empty fields.
-     graph_shard_server(graph_shard_id_t shardid) : shard(shardid) { }
+     graph_shard_server(graph_shard_id_t shardid) : shard(shardid), tier(shard) { }
 
      /// Creates a server with fields and shard id.
      graph_shard_server(graph_shard_id_t shardid,
                         const std::vector<graph_field>& vertex_fields,
                         const std::vector<graph_field>& edge_fields) : 
-         shard(shardid), vertex_fields(vertex_fields), edge_fields(edge_fields) { }
+         shard(shardid), vertex_fields(vertex_fields), edge_fields(edge_fields), tier(shard) { }
 
 
       ~graph_shard_server() {};
@@ -26,6 +31,19 @@ namespace graphlab {
   // --------------------- Basic Queries ----------------------------
   uint64_t num_vertices() { return shard.num_vertices(); }
   uint64_t num_edges() { return shard.num_edges(); }
+  graph_shard_id_t id() const { return shard.id(); }
+
+  /// See graph_shard::data_bytes(). Holds the tier lock: evictions free rows.
+  size_t data_bytes() const {
+    tier_scope scope(*this);
+    return shard.data_bytes();
+  }
+
+  /// See graph_shard::memory_usage(), under the tier lock
+  void memory_usage(memory_accounting::usage& usage) const {
+    tier_scope scope(*this);
+    shard.memory_usage(usage);
+  }
   const std::vector<graph_field> get_vertex_fields() { return vertex_fields; }
   const std::vector<graph_field> get_edge_fields() { return edge_fields; }
 
@@ -54,6 +72,19 @@ namespace graphlab {
    int get_edge(graph_eid_t eid, graph_row& out);
    int get_vertex_adj(graph_vid_t vid, bool in_edges, vertex_adj_descriptor& out);
 
+   /**
+    * Fills out with the vertices which have in edges (or out edges) in
+    * this shard, i.e. the vertices for which get_vertex_adj() is not empty.
+    */
+   void get_vertex_adj_filter(bool in_edges, bloom_filter& out);
+
+   /**
+    * Labels the vertices of this shard and the endpoints of its edges with
+    * the connected components of the shard edges, computed on pool.
+    * See graph_components.
+    */
+   void get_components(thread_pool& pool, graph_components::label_vector& out);
+
   // Write API
    int set_vertex(graph_vid_t vid, const graph_row& data);
    int set_edge(graph_eid_t eid, const graph_row& data);
@@ -72,6 +103,35 @@ namespace graphlab {
    bool set_edges (const std::vector< std::pair<graph_eid_t, graph_row> >& pairs,
                    std::vector<int>& errorcodes);
 
+  // --------------------- Tiered Storage -----------------------------------------
+   /**
+    * Keeps the vertex and edge rows of the shard within memory_budget
+    * bytes, evicting the least accessed ones to store and fetching them
+    * back on access. The batch queries fetch their rows with one
+    * bulk_get(). See graph_row_tier.
+    *
+    * The rows must then be read through this server: get_shard() sees
+    * the evicted rows as empty until fetch_all_rows() is called.
+    *
+    * Even the reads update the tier, so once it is enabled the queries
+    * and updates of the server run one at a time. Must be called before
+    * the server is accessed concurrently.
+    */
+   void enable_tiering(kvstore_base& store, size_t memory_budget) {
+     tier.init(store, memory_budget);
+   }
+
+   /// Fetches all the evicted rows, e.g. before saving the shard
+   void fetch_all_rows() {
+     tier_scope scope(*this);
+     tier.fetch_all();
+   }
+
+   graph_row_tier::stats get_tier_stats() const {
+     tier_scope scope(*this);
+     return tier.get_stats();
+   }
+
   // --------------------- Internal functions --------------------------------
    graph_shard& get_shard() { return shard; }
 
@@ -80,23 +140,67 @@ namespace graphlab {
    bool add_vertex_mirrors(const std::vector<mirror_insert_descriptor>& vid_mirror_pairs, std::vector<int>& errorcodes);
  
    private:
+     // Holds tier_lock in a scope, if tiering is enabled
+     class tier_scope {
+      public:
+       explicit tier_scope(const graph_shard_server& server)
+           : lock(server.tier.enabled() ? &server.tier_lock : NULL) {
+         if (lock != NULL) lock->lock();
+       }
+       ~tier_scope() { if (lock != NULL) lock->unlock(); }
+      private:
+       mutex* lock;
+     };
+
      // --------------------- Helper functions -----------------------------------
      // Batch transform vertices 
      template<typename TransformFun> 
          void transform_vertices(TransformFun fun) {
-           for (size_t i =0; i < shard.num_vertices(); ++i) {
-             fun(*(shard.vertex_data(i)));
-           }
+           transform_rows(false, fun);
          };
 
      // Batch transform edges 
      template<typename TransformFun> 
          void transform_edges(TransformFun fun) {
-           for (size_t i = 0; i < shard.num_edges(); ++i) {
-             fun(*(shard.edge_data(i)));
+           transform_rows(true, fun);
+         };
+
+     // Batch transform rows, a chunk of evicted rows at a time
+     template<typename TransformFun> 
+         void transform_rows(bool is_edge, TransformFun fun) {
+           const size_t chunk = 4096;
+           size_t n = is_edge ? shard.num_edges() : shard.num_vertices();
+           std::vector<size_t> positions, none;
+           for (size_t begin = 0; begin < n; begin += chunk) {
+             positions.clear();
+             for (size_t i = begin; i < std::min(n, begin + chunk); ++i) positions.push_back(i);
+             if (is_edge) tier.fetch(none, positions);
+             else tier.fetch(positions, none);
+             for (size_t i = 0; i < positions.size(); ++i) {
+               fun(*(is_edge ? shard.edge_data(positions[i]) : shard.vertex_data(positions[i])));
+               tier.mark_dirty(is_edge, positions[i]);
+             }
+             tier.enforce_budget();
            }
          };
 
+    // The data of the vertex, fetched if evicted, or NULL
+    inline graph_row* vertex_row(graph_vid_t vid) {
+      size_t pos;
+      if (!shard.vertex_position(vid, pos)) return NULL;
+      return tier.vertex_row(pos);
+    }
+
+    // Reads and writes without enforcing the memory budget, for the batches
+    int get_vertex_row(graph_vid_t vid, graph_row& out);
+    int get_edge_row(graph_eid_t eid, graph_row& out);
+    int set_vertex_row(graph_vid_t vid, const graph_row& data);
+    int set_edge_row(graph_eid_t eid, const graph_row& data);
+
+    // Fetches the rows of the given vertices or edges with one bulk_get()
+    void prefetch_vertices(const std::vector<graph_vid_t>& vids);
+    void prefetch_edges(const std::vector<graph_eid_t>& eids);
+
     inline void add_field_helper(graph_row& row, graph_field& field) { 
       row.add_field(field); 
     }
@@ -112,10 +216,16 @@ namespace graphlab {
 
     int set_data_helper(graph_row* old_data, const graph_row& data);
 
+    // False if a vector of data does not have the dimension of its field
+    bool check_vector_dims(const graph_row& data) const;
+
    private:
      graph_shard shard;
      std::vector<graph_field> vertex_fields;
      std::vector<graph_field> edge_fields;
+     graph_row_tier tier;
+     // serializes the accesses to the tier
+     mutable mutex tier_lock;
   };
 }// end of name space
 #endif
@@ -1,6 +1,10 @@
 #include <graphlab/database/server/graphdb_server.hpp>
 #include <graphlab/serialization/iarchive.hpp>
 #include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/memory_accounting.hpp>
+#include <boost/lexical_cast.hpp>
+#include <sstream>
 
 namespace graphlab {
      typedef graph_database::vertex_adj_descriptor vertex_adj_descriptor;
@@ -10,13 +14,11 @@ namespace graphlab {
 
   // ------------------ Server Query and Update interface ----------------------------
   bool graphdb_server::update(char* msg, size_t msglen, char** outreply, size_t *outreplylen) {
-    logstream(LOG_EMPH) << "Update Request. "; 
+    // per request counters are kept in stats (see the ADMIN STATS query)
     oarchive oarc;
-    bool success = process(msg, msglen, oarc);
-    if (success) {
-      logstream(LOG_EMPH) << "Success." << std::endl;
-    } else {
-      logstream(LOG_WARNING) << "Failure." << std::endl; 
+    bool success = process_on_shard_node(msg, msglen, oarc);
+    if (!success) {
+      logger_ratelimit(10, LOG_WARNING, "Update Request. Failure.");
     }
     *outreply = oarc.buf;
     *outreplylen = oarc.off;
@@ -24,23 +26,60 @@ namespace graphlab {
   }
 
   void graphdb_server::query(char* msg, size_t msglen, char** outreply, size_t *outreplylen) {
-    logstream(LOG_EMPH) << "Query Request. "; 
     oarchive oarc;
-    bool success = process(msg, msglen, oarc);
-    if (success) {
-      logstream(LOG_EMPH) << "Success." << std::endl;
-    } else {
-      logstream(LOG_WARNING) << "Failure." << std::endl; 
+    bool success = process_on_shard_node(msg, msglen, oarc);
+    if (!success) {
+      logger_ratelimit(10, LOG_WARNING, "Query Request. Failure.");
     }
     *outreply = oarc.buf;
     *outreplylen = oarc.off;
   }
 
+  // node + 1 the calling thread is pinned to, 0 if not pinned
+  static __thread size_t pinned_node = 0;
+
+  bool graphdb_server::process_on_shard_node(char* msg, size_t msglen, 
+                                             oarchive& oarc) {
+    if (numa_enabled && pinned_node != numa_node + 1) {
+      if (!numa_tools::pin_current_thread(numa_node)) {
+        logstream_once(LOG_WARNING) << "Unable to pin the request thread to NUMA node "
+                                    << numa_node << std::endl;
+      }
+      pinned_node = numa_node + 1;
+    }
+    return process(msg, msglen, oarc);
+  }
+
   bool graphdb_server::process(char* msg, size_t msglen, oarchive& oarc) {
+    unsigned long long start = rdtsc();
+    size_t start_off = oarc.off;
     QueryMessage qm(msg, msglen);
     QueryMessage::header header = qm.get_header();
-    logstream(LOG_EMPH) << header << std::endl;
+    // the header comes from the wire
+    const char* cmd_str = header.cmd < QueryMessage::NUM_CMD_TYPE ?
+        QueryMessage::qm_cmd_type_str[header.cmd] : "invalid";
+    const char* obj_str = header.obj < QueryMessage::NUM_OBJ_TYPE ?
+        QueryMessage::qm_obj_type_str[header.obj] : "invalid";
+    bool success;
+    {
+      trace_request_scope request(qm.get_request_id());
+      trace_span span(cmd_str);
+      success = dispatch(qm, oarc);
+    }
+    unsigned long long ticks = rdtsc() - start;
+    stats.record_request(header, success, msglen, oarc.off - start_off, ticks);
+    // LOG_EMPH so that the sample is emitted with the default OUTPUTLEVEL.
+    // Silenced at runtime with global_logger().set_log_level(LOG_WARNING).
+    logger_sampled(1024, LOG_EMPH,
+                   "cmd=%s obj=%s request_id=%llx bytes_in=%lu bytes_out=%lu ticks=%llu success=%d",
+                   cmd_str, obj_str, (unsigned long long)qm.get_request_id(),
+                   (unsigned long)msglen, (unsigned long)(oarc.off - start_off),
+                   ticks, (int)success);
+    return success;
+  }
 
+  bool graphdb_server::dispatch(QueryMessage& qm, oarchive& oarc) {
+    QueryMessage::header header = qm.get_header();
     switch (header.cmd) {
      case QueryMessage::GET: return (process_get(qm, oarc) == 0);
      case QueryMessage::SET: return (process_set(qm, oarc) == 0);
@@ -125,6 +164,22 @@ namespace graphlab {
        if (errorcode == 0) oarc << data;
        break;
      }
+     case QueryMessage::VADJFILTER: {
+       bool in_edges;
+       qm >> in_edges;
+       bloom_filter filter;
+       server.get_vertex_adj_filter(in_edges, filter);
+       errorcode = 0;
+       oarc << errorcode << filter;
+       break;
+     }
+     case QueryMessage::COMPONENTS: {
+       graph_components::label_vector labels;
+       server.get_components(numa_thread_pools::get_instance().pool(numa_node), labels);
+       errorcode = 0;
+       oarc << errorcode << labels;
+       break;
+     }
      case QueryMessage::VFIELD: {
        errorcode = 0;
        oarc << 0 << (server.get_vertex_fields());
@@ -182,18 +237,21 @@ namespace graphlab {
      case QueryMessage::VERTEX:  {
        std::vector<vertex_insert_descriptor> in;
        qm >> in;
+       stats.record_batch(h, in.size());
        success = server.add_vertices(in, errorcodes);
        break;
      }
      case QueryMessage::EDGE: {
        std::vector<edge_insert_descriptor> in;
        qm >> in;
+       stats.record_batch(h, in.size());
        success = server.add_edges(in, errorcodes);
        break;
      }
      case QueryMessage::VMIRROR: {
        std::vector<mirror_insert_descriptor> in;
        qm >> in;
+       stats.record_batch(h, in.size());
        success = server.add_vertex_mirrors(in, errorcodes);
        break;
      }
@@ -216,6 +274,7 @@ namespace graphlab {
        std::vector<graph_vid_t> in;
        std::vector<graph_row> out;
        qm >> in;
+       stats.record_batch(h, in.size());
        success = server.get_vertices(in, out, errorcodes);
        oarc << success << out;
        break;
@@ -224,6 +283,7 @@ namespace graphlab {
        std::vector<graph_eid_t> in;
        std::vector<graph_row> out;
        qm >> in;
+       stats.record_batch(h, in.size());
        success = server.get_edges(in, out, errorcodes);
        oarc << success << out;
        break;
@@ -244,12 +304,14 @@ namespace graphlab {
      case QueryMessage::VERTEX:  {
        std::vector< std::pair<graph_vid_t, graph_row> > in;
        qm >> in;
+       stats.record_batch(h, in.size());
        success = server.set_vertices(in, errorcodes);
        break;
      }
      case QueryMessage::EDGE: {
        std::vector< std::pair<graph_eid_t, graph_row> > in;
        qm >> in;
+       stats.record_batch(h, in.size());
        success = server.set_edges(in, errorcodes);
        break;
      }
@@ -268,6 +330,48 @@ namespace graphlab {
       case QueryMessage::RESET:
         server.clear();
         return 0;
+      case QueryMessage::STATS: {
+        std::stringstream strm;
+        std::string label = "shard=\"" +
+            boost::lexical_cast<std::string>(server.id()) + "\"";
+        stats.print(strm, label);
+        strm << "graphdb_shard_vertices{" << label << "} "
+             << server.num_vertices() << "\n";
+        strm << "graphdb_shard_edges{" << label << "} "
+             << server.num_edges() << "\n";
+        strm << "graphdb_shard_data_bytes{" << label << "} "
+             << server.data_bytes() << "\n";
+        memory_accounting::usage usage = memory_accounting::counted();
+        server.memory_usage(usage);
+        usage.print(strm, "graphdb_memory_bytes", label);
+        strm << "graphdb_process_max_rss_bytes{" << label << "} "
+             << memory_info::rusage_maxrss() << "\n";
+        if (memory_info::available()) {
+          strm << "graphdb_process_allocated_bytes{" << label << "} "
+               << memory_info::allocated_bytes() << "\n";
+        }
+        oarc << 0 << strm.str();
+        return 0;
+      }
+      case QueryMessage::TRACE: {
+        int action;
+        qm >> action;
+        event_trace& trace = global_event_trace();
+        std::vector<trace_record> records;
+        if (action == QueryMessage::TRACE_START) {
+          trace.clear();
+          trace.enable(true);
+        } else if (action == QueryMessage::TRACE_STOP) {
+          trace.enable(false);
+        } else if (action == QueryMessage::TRACE_COLLECT) {
+          trace.collect(records, server.id());
+        } else {
+          oarc << EINVHEAD;
+          return EINVHEAD;
+        }
+        oarc << 0 << records;
+        return 0;
+      }
       default:
         oarc << false << EINVHEAD; 
         return EINVHEAD;
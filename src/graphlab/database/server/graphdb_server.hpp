@@ -1,8 +1,10 @@
 #ifndef GRAPHLAB_DATABASE_GRAPHDB_SERVER_HPP
 #define GRAPHLAB_DATABASE_GRAPHDB_SERVER_HPP
 #include <graphlab/database/server/graph_shard_server.hpp>
+#include <graphlab/database/server/graphdb_server_stats.hpp>
 #include <graphlab/database/query_message.hpp>
 #include <graphlab/database/errno.hpp>
+#include <graphlab/parallel/numa_tools.hpp>
 
 #include <fault/query_object.hpp>
 
@@ -12,7 +14,9 @@ class graphdb_server : public libfault::query_object {
 
 public:
   graphdb_server(size_t shardid, bool is_master = true) 
-      : server(shardid), is_master(is_master) {}
+      : server(shardid), is_master(is_master),
+        numa_node(numa_tools::partition_to_node(shardid)),
+        numa_enabled(numa_tools::num_nodes() > 1) {}
 
   virtual ~graphdb_server() { }
 
@@ -25,14 +29,36 @@ public:
     is_master = true;
   }
 
+  /**
+   * Keeps the rows of the shard within memory_budget bytes, evicting the
+   * others to store. See graph_shard_server::enable_tiering(). The config
+   * file has no tiering option: the process creating the server calls
+   * this before the server receives requests.
+   */
+  void enable_tiering(kvstore_base& store, size_t memory_budget) {
+    server.enable_tiering(store, memory_budget);
+  }
+
   void serialize(char** outbuf, size_t *outbuflen) { }
 
   void deserialize(const char* buf, size_t buflen) { }
 
  private:
 
+  /// Processes a request and records its statistics
   bool process(char* msg, size_t msglen, oarchive& oarc);
 
+  bool dispatch(QueryMessage& qm, oarchive& oarc);
+
+  /**
+   * Runs process() on the calling thread, after pinning the thread to the
+   * NUMA node owning this shard the first time it serves a request. Shard
+   * memory is then accessed (and allocated, by first touch) from the local
+   * node without handing each request to another thread. Does not pin on
+   * machines with a single node.
+   */
+  bool process_on_shard_node(char* msg, size_t msglen, oarchive& oarc);
+
   int process_get(QueryMessage& qm, oarchive& oarc);
   int process_set(QueryMessage& qm, oarchive& oarc);
   int process_add(QueryMessage& qm, oarchive& oarc);
@@ -48,8 +74,12 @@ public:
 
  private:
   graphlab::graph_shard_server server;
+  graphdb_server_stats stats;
   bool is_master;
   size_t counter;
+  // NUMA node owning the shard
+  size_t numa_node;
+  bool numa_enabled;
 };
 } // end of namespace
 #endif
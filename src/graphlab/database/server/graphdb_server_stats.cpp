@@ -0,0 +1,105 @@
+#include <graphlab/database/server/graphdb_server_stats.hpp>
+#include <graphlab/util/timer.hpp>
+
+namespace graphlab {
+
+  graphdb_server_stats::counters&
+  graphdb_server_stats::counters::operator+=(const counters& other) {
+    requests += other.requests;
+    failures += other.failures;
+    bytes_in += other.bytes_in;
+    bytes_out += other.bytes_out;
+    items += other.items;
+    return *this;
+  }
+
+  graphdb_server_stats::graphdb_server_stats() {
+    stats.resize(QueryMessage::NUM_CMD_TYPE * QueryMessage::NUM_OBJ_TYPE);
+    for (size_t i = 0; i < stats.size(); ++i) {
+      stats[i] = new command_stats;
+    }
+  }
+
+  graphdb_server_stats::~graphdb_server_stats() {
+    for (size_t i = 0; i < stats.size(); ++i) {
+      delete stats[i];
+    }
+  }
+
+  graphdb_server_stats::command_stats*
+  graphdb_server_stats::get(const QueryMessage::header& h) const {
+    // the header comes from the wire
+    size_t cmd = h.cmd, obj = h.obj;
+    if (cmd >= QueryMessage::NUM_CMD_TYPE || obj >= QueryMessage::NUM_OBJ_TYPE) {
+      return NULL;
+    }
+    return stats[cmd * QueryMessage::NUM_OBJ_TYPE + obj];
+  }
+
+  void graphdb_server_stats::record_request(const QueryMessage::header& h,
+                                            bool success,
+                                            size_t bytes_in, size_t bytes_out,
+                                            unsigned long long ticks) {
+    command_stats* s = get(h);
+    if (s == NULL) return;
+    counters c;
+    c.requests = 1;
+    c.failures = !success;
+    c.bytes_in = bytes_in;
+    c.bytes_out = bytes_out;
+    s->totals += c;
+    s->latency.incorporate(ticks);
+  }
+
+  void graphdb_server_stats::record_batch(const QueryMessage::header& h,
+                                          size_t items) {
+    command_stats* s = get(h);
+    if (s == NULL) return;
+    counters c;
+    c.items = items;
+    s->totals += c;
+    s->batch_size.incorporate(items);
+  }
+
+  void graphdb_server_stats::print(std::ostream& out,
+                                   const std::string& labels) const {
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    const char* quantile_str[] = {"0.5", "0.9", "0.99", "0.999"};
+    double ticks_per_us = estimate_ticks_per_second() / 1e6;
+    for (size_t cmd = 0; cmd < QueryMessage::NUM_CMD_TYPE; ++cmd) {
+      for (size_t obj = 0; obj < QueryMessage::NUM_OBJ_TYPE; ++obj) {
+        const command_stats& s = *stats[cmd * QueryMessage::NUM_OBJ_TYPE + obj];
+        counters c = s.totals.value();
+        if (c.requests == 0) continue;
+        std::string l = std::string("{cmd=\"") + QueryMessage::qm_cmd_type_str[cmd]
+            + "\",obj=\"" + QueryMessage::qm_obj_type_str[obj] + "\""
+            + (labels.empty() ? "" : ",") + labels;
+        out << "graphdb_requests" << l << "} " << c.requests << "\n";
+        out << "graphdb_failures" << l << "} " << c.failures << "\n";
+        out << "graphdb_bytes_in" << l << "} " << c.bytes_in << "\n";
+        out << "graphdb_bytes_out" << l << "} " << c.bytes_out << "\n";
+        for (size_t i = 0; i < 4; ++i) {
+          out << "graphdb_latency_us" << l << ",quantile=\"" << quantile_str[i]
+              << "\"} " << s.latency.percentile(quantiles[i]) / ticks_per_us << "\n";
+        }
+        out << "graphdb_latency_us_max" << l << "} "
+            << s.latency.maximum() / ticks_per_us << "\n";
+        if (c.items > 0) {
+          out << "graphdb_batch_items" << l << "} " << c.items << "\n";
+          for (size_t i = 0; i < 4; ++i) {
+            out << "graphdb_batch_size" << l << ",quantile=\"" << quantile_str[i]
+                << "\"} " << s.batch_size.percentile(quantiles[i]) << "\n";
+          }
+        }
+      }
+    }
+  }
+
+  void graphdb_server_stats::clear() {
+    for (size_t i = 0; i < stats.size(); ++i) {
+      stats[i]->totals.clear();
+      stats[i]->latency.clear();
+      stats[i]->batch_size.clear();
+    }
+  }
+} // namespace graphlab
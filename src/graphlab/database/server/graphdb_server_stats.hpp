@@ -0,0 +1,89 @@
+#ifndef GRAPHLAB_DATABASE_GRAPHDB_SERVER_STATS_HPP
+#define GRAPHLAB_DATABASE_GRAPHDB_SERVER_STATS_HPP
+#include <iostream>
+#include <vector>
+#include <graphlab/database/query_message.hpp>
+#include <graphlab/parallel/reducer.hpp>
+#include <graphlab/util/tracepoint.hpp>
+
+namespace graphlab {
+
+/**
+ * \ingroup group_graph_database
+ * Request statistics of a graphdb_server, kept per command and object
+ * type (e.g. "batch_get edge"): request, failure and byte counts, the
+ * number of items in batch requests, and histograms of the batch sizes
+ * and of the processing latency.
+ *
+ * Recording is safe from any thread and does not contend: counters are
+ * \ref reducer "reducers" and the histograms are per-thread
+ * \ref trace_histogram "trace_histograms".
+ *
+ * The statistics are reported by print() as one "name{labels} value"
+ * line per metric, which is returned by the ADMIN STATS query.
+ *
+ * Memory: each command has two histograms, and a histogram slot holds
+ * trace_histogram::NUM_BUCKETS (1920) counters, i.e. about 15KB. A slot
+ * is allocated the first time a thread of its index records into it, so
+ * a command costs up to 2 * 2 * cpu_count * 15KB (about 1MB with 16
+ * cpus), and only the commands which receive requests cost that much.
+ */
+class graphdb_server_stats {
+ public:
+  graphdb_server_stats();
+
+  ~graphdb_server_stats();
+
+  /**
+   * Records a processed request: the size of the request and of the
+   * reply, and the processing time in rdtsc ticks.
+   */
+  void record_request(const QueryMessage::header& h, bool success,
+                      size_t bytes_in, size_t bytes_out,
+                      unsigned long long ticks);
+
+  /**
+   * Records the number of items (vertices, edges, ...) in a batch request.
+   */
+  void record_batch(const QueryMessage::header& h, size_t items);
+
+  /**
+   * Writes the statistics of the commands which received requests, with
+   * the given extra labels (e.g. "shard=\"3\"") added to each line.
+   */
+  void print(std::ostream& out, const std::string& labels = "") const;
+
+  /// Resets all the statistics
+  void clear();
+
+ private:
+  struct counters {
+    size_t requests;
+    size_t failures;
+    size_t bytes_in;
+    size_t bytes_out;
+    size_t items;
+    counters(int = 0): requests(0), failures(0), bytes_in(0),
+                       bytes_out(0), items(0) { }
+    counters& operator+=(const counters& other);
+  };
+
+  struct command_stats {
+    reducer<counters> totals;
+    trace_histogram latency;
+    trace_histogram batch_size;
+    command_stats(): latency("", "", false), batch_size("", "", false) { }
+  };
+
+  /// stats[cmd * NUM_OBJ_TYPE + obj]. NULL for invalid headers.
+  command_stats* get(const QueryMessage::header& h) const;
+
+  std::vector<command_stats*> stats;
+
+  // not copyable
+  graphdb_server_stats(const graphdb_server_stats&);
+  graphdb_server_stats& operator=(const graphdb_server_stats&);
+};
+
+} // namespace graphlab
+#endif
@@ -7,6 +7,7 @@
 #include <graphlab/database/graph_edge.hpp>
 #include <graphlab/database/graph_shard.hpp>
 #include <graphlab/database/graph_database.hpp>
+#include <graphlab/database/graph_components.hpp>
 #include <graphlab/macros_def.hpp>
 namespace graphlab {
   /**
@@ -153,6 +154,20 @@ namespace graphlab {
       }
     }
 
+    /**
+     * Computes the connected components of the graph, ignoring the edge
+     * directions: the shards are labeled one after the other, each in
+     * parallel on pool, and their labels are merged.
+     * See graph_components.
+     */
+    void connected_components(thread_pool& pool, graph_components::label_vector& out) {
+      std::vector<graph_components::label_vector> shard_labels(shard_list.size());
+      for (size_t i = 0; i < shard_list.size(); i++) {
+        graph_components::label_shard(*get_shard(shard_list[i]), pool, shard_labels[i]);
+      }
+      graph_components::merge(shard_labels, pool, out);
+    }
+
     // -------- Fine grained API ------------
     inline size_t num_in_edges(graph_vid_t vid, graph_shard_id_t shardid) {
       graph_shard* shard = get_shard(shardid);
@@ -27,7 +27,9 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 #include <pthread.h>
+#include <sys/time.h>
 
 file_logger& global_logger() {
   static file_logger l;
@@ -43,6 +45,11 @@ void streambuffdestructor(void* v){
   delete t;
 }
 
+void logbuffdestructor(void* v){
+  global_logger().release_buffer(
+      reinterpret_cast<logger_impl::logbuff_tls_entry*>(v));
+}
+
 const char* messages[] = {  "DEBUG:    ",
                             "INFO:     ",
                             "INFO:     ",
@@ -56,16 +63,27 @@ file_logger::file_logger() {
   log_to_console = true;
   log_level = LOG_EMPH;
   pthread_mutex_init(&mut, NULL);
+  pthread_mutex_init(&buffers_mut, NULL);
   pthread_key_create(&streambuffkey, streambuffdestructor);
+  pthread_key_create(&logbuffkey, logbuffdestructor);
 }
 
 file_logger::~file_logger() {
+  // threads which are still running may lose the lines they log later
+  pthread_mutex_lock(&buffers_mut);
+  for (size_t i = 0;i < logbuffers.size(); ++i) {
+    pthread_mutex_lock(&logbuffers[i]->lock);
+    write_buffer(logbuffers[i], LOG_INFO);
+    pthread_mutex_unlock(&logbuffers[i]->lock);
+  }
+  pthread_mutex_unlock(&buffers_mut);
   if (fout.good()) {
     fout.flush();
     fout.close();
   }
 
   pthread_mutex_destroy(&mut);
+  pthread_mutex_destroy(&buffers_mut);
 }
 
 bool file_logger::set_log_file(std::string file) {
@@ -266,3 +284,113 @@ file_logger& file_logger::start_stream(int lineloglevel,const char* file,
   return *this;
 }
 
+
+
+bool logger_impl::rate_limit_state::allow(size_t per_second,
+                                          size_t* suppressed_out) {
+  // + 1 so that the zero initialized state starts a new second
+  size_t now = graphlab::timer::approx_time_millis() / 1000 + 1;
+  size_t prev = second;
+  if (prev != now && __sync_bool_compare_and_swap(&second, prev, now)) {
+    count = 0;
+  }
+  if (__sync_fetch_and_add(&count, 1) >= per_second) {
+    __sync_fetch_and_add(&suppressed, 1);
+    return false;
+  }
+  *suppressed_out = __sync_lock_test_and_set(&suppressed, 0);
+  return true;
+}
+
+
+logger_impl::logbuff_tls_entry* file_logger::get_log_buffer() {
+  logger_impl::logbuff_tls_entry* entry =
+        reinterpret_cast<logger_impl::logbuff_tls_entry*>(
+                              pthread_getspecific(logbuffkey));
+  if (entry == NULL) {
+    entry = new logger_impl::logbuff_tls_entry;
+    entry->len = 0;
+    pthread_mutex_init(&entry->lock, NULL);
+    pthread_setspecific(logbuffkey, entry);
+    pthread_mutex_lock(&buffers_mut);
+    logbuffers.push_back(entry);
+    pthread_mutex_unlock(&buffers_mut);
+  }
+  return entry;
+}
+
+void file_logger::write_buffer(logger_impl::logbuff_tls_entry* entry,
+                               int lineloglevel) {
+  if (entry->len > 0) {
+    _lograw(lineloglevel, entry->buffer, (int)entry->len);
+    entry->len = 0;
+  }
+}
+
+// snprintf returns the untruncated length. Returns the length written.
+static size_t written_length(int ret, size_t maxlen) {
+  if (ret < 0) return 0;
+  return std::min(size_t(ret), maxlen - 1);
+}
+
+void file_logger::_logbuffered(int lineloglevel,const char* file,
+                               const char* function, int line,
+                               size_t suppressed, const char* fmt, va_list ap) {
+  if (lineloglevel < 0 || lineloglevel > LOG_FATAL ||
+      lineloglevel < log_level) return;
+  logger_impl::logbuff_tls_entry* entry = get_log_buffer();
+  pthread_mutex_lock(&entry->lock);
+  // warnings are written out immediately, on their own so that they
+  // keep their color
+  bool immediate = lineloglevel >= LOG_WARNING;
+  if (immediate ||
+      entry->len + logger_impl::LOG_LINE_SIZE > logger_impl::LOG_BUFFER_SIZE) {
+    write_buffer(entry, LOG_INFO);
+  }
+  file = ((strrchr(file, '/') ? : file- 1) + 1);
+  timeval tv;
+  gettimeofday(&tv, NULL);
+
+  // leave room for the newline
+  const size_t maxlen = logger_impl::LOG_LINE_SIZE - 1;
+  char* str = entry->buffer + entry->len;
+  size_t len = written_length(snprintf(str, maxlen, "%s%s(%s:%d) %ld.%06ld: ",
+                                       messages[lineloglevel], file, function,
+                                       line, (long)tv.tv_sec, (long)tv.tv_usec),
+                              maxlen);
+  len += written_length(vsnprintf(str + len, maxlen - len, fmt, ap),
+                        maxlen - len);
+  if (suppressed > 0) {
+    len += written_length(snprintf(str + len, maxlen - len,
+                                   " (%lu similar messages suppressed)",
+                                   (unsigned long)suppressed),
+                          maxlen - len);
+  }
+  str[len++] = '\n';
+  entry->len += len;
+  if (immediate) write_buffer(entry, lineloglevel);
+  pthread_mutex_unlock(&entry->lock);
+}
+
+void file_logger::flush_buffer() {
+  logger_impl::logbuff_tls_entry* entry =
+        reinterpret_cast<logger_impl::logbuff_tls_entry*>(
+                              pthread_getspecific(logbuffkey));
+  if (entry != NULL) {
+    pthread_mutex_lock(&entry->lock);
+    write_buffer(entry, LOG_INFO);
+    pthread_mutex_unlock(&entry->lock);
+  }
+}
+
+void file_logger::release_buffer(logger_impl::logbuff_tls_entry* entry) {
+  pthread_mutex_lock(&entry->lock);
+  write_buffer(entry, LOG_INFO);
+  pthread_mutex_unlock(&entry->lock);
+  pthread_mutex_lock(&buffers_mut);
+  logbuffers.erase(std::remove(logbuffers.begin(), logbuffers.end(), entry),
+                   logbuffers.end());
+  pthread_mutex_unlock(&buffers_mut);
+  pthread_mutex_destroy(&entry->lock);
+  delete entry;
+}
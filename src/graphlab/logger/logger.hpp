@@ -35,7 +35,20 @@
  *
  * The difference between the hard level and the soft level is that the
  * soft level can be changed at runtime, while the hard level optimizes away
- * logging calls at compile time.
+ * logging calls at compile time. The hard level can be set with
+ * -DOUTPUTLEVEL=n (cmake -DOUTPUTLEVEL=n).
+ *
+ * For hot code paths (e.g. once per request), use the buffered calls
+ * logger_buffered(), logger_sampled() and logger_ratelimit(). These format
+ * into a per thread buffer while holding that buffer's own mutex. No other
+ * thread takes it, except the logger destructor flushing the buffers of
+ * the threads still running, so the lock is uncontended and the calls do
+ * not serialize with each other nor with the unbuffered calls. The buffer
+ * is written out when it is full, when a LOG_WARNING or higher is logged,
+ * on global_logger().flush_buffer(), and when the thread exits. Their
+ * arguments are not evaluated if the level is below either output level.
+ * Since the buffers of different threads are written out of order, each
+ * buffered line carries a time stamp.
  */
 
 #ifndef GRAPHLAB_LOG_LOG_HPP
@@ -46,6 +59,7 @@
 #include <cassert>
 #include <cstring>
 #include <cstdarg>
+#include <vector>
 #include <pthread.h>
 #include <graphlab/util/timer.hpp>
 /**
@@ -105,6 +119,10 @@
 #define logger_ontick(sec,lvl,fmt,...)
 #define logstream_ontick(sec, lvl) null_stream()
 
+#define logger_buffered(lvl,fmt,...)
+#define logger_sampled(n,lvl,fmt,...)
+#define logger_ratelimit(per_sec,lvl,fmt,...)
+
 #else
 
 #define logger(lvl,fmt,...)                 \
@@ -157,7 +175,45 @@
   &(log_stream_dispatch<(lvl >= OUTPUTLEVEL)>::exec(lvl,__FILE__, __func__ ,__LINE__, print_now) ); \
 }))
 
-  
+/**
+ * \def logger_buffered(lvl,fmt,...)
+ *    Same as logger(), but formats into the per thread log buffer.
+ */
+#define logger_buffered(lvl,fmt,...)                 \
+do {    \
+  if (lvl >= OUTPUTLEVEL && lvl >= global_logger().get_log_level()) {   \
+    log_buffered_dispatch<(lvl >= OUTPUTLEVEL)>::exec(lvl,__FILE__, __func__ ,__LINE__,0,fmt,##__VA_ARGS__); \
+  }  \
+} while(0)
+
+/**
+ * \def logger_sampled(n,lvl,fmt,...)
+ *    Buffered logging of one in every n calls from this line.
+ */
+#define logger_sampled(n,lvl,fmt,...)                 \
+do {    \
+  static size_t __sample_ctr__ = 0;    \
+  if (lvl >= OUTPUTLEVEL && lvl >= global_logger().get_log_level() &&   \
+      __sync_fetch_and_add(&__sample_ctr__, 1) % (n) == 0) {   \
+    log_buffered_dispatch<(lvl >= OUTPUTLEVEL)>::exec(lvl,__FILE__, __func__ ,__LINE__,0,fmt,##__VA_ARGS__); \
+  }  \
+} while(0)
+
+/**
+ * \def logger_ratelimit(per_sec,lvl,fmt,...)
+ *    Buffered logging of at most per_sec calls per second from this line.
+ *    The next logged line reports how many calls were dropped.
+ */
+#define logger_ratelimit(per_sec,lvl,fmt,...)                 \
+do {    \
+  static logger_impl::rate_limit_state __rate__ = {0, 0, 0};    \
+  size_t __suppressed__ = 0;    \
+  if (lvl >= OUTPUTLEVEL && lvl >= global_logger().get_log_level() &&   \
+      __rate__.allow(per_sec, &__suppressed__)) {   \
+    log_buffered_dispatch<(lvl >= OUTPUTLEVEL)>::exec(lvl,__FILE__, __func__ ,__LINE__,__suppressed__,fmt,##__VA_ARGS__); \
+  }  \
+} while(0)
+
 #endif
 
 namespace logger_impl {
@@ -165,6 +221,35 @@ struct streambuff_tls_entry {
   std::stringstream streambuffer;
   bool streamactive;
 };
+
+/// Size of the per thread buffer of the buffered logging calls
+const size_t LOG_BUFFER_SIZE = 16384;
+/// Longest line written by the buffered logging calls. Longer lines are cut.
+const size_t LOG_LINE_SIZE = 1024;
+
+struct logbuff_tls_entry {
+  char buffer[LOG_BUFFER_SIZE];
+  size_t len;
+  // held by the owning thread while it appends, and by ~file_logger()
+  // while it flushes the buffers of the threads still running
+  pthread_mutex_t lock;
+};
+
+/**
+ * Per call site state of logger_ratelimit(). It is a POD which is
+ * statically zero initialized, so it needs no guarded construction.
+ */
+struct rate_limit_state {
+  volatile size_t second;
+  volatile size_t count;
+  volatile size_t suppressed;
+
+  /**
+   * Returns true if the call may log. If it does, suppressed_out is
+   * set to the number of calls dropped since the last logged one.
+   */
+  bool allow(size_t per_second, size_t* suppressed_out);
+};
 }
 
 
@@ -298,6 +383,21 @@ class file_logger{
                 
   void _lograw(int loglevel, const char* buf, int len);
 
+  /**
+   * Formats the message into the calling thread's log buffer. This
+   * function should not be used directly. Use logger_buffered(),
+   * logger_sampled() or logger_ratelimit().
+   * If suppressed is non zero, the line reports that many dropped calls.
+   */
+  void _logbuffered(int loglevel,const char* file,const char* function,
+                    int line, size_t suppressed, const char* fmt, va_list arg);
+
+  /// Writes out the calling thread's log buffer
+  void flush_buffer();
+
+  /// Writes out and frees a thread's log buffer. Called on thread exit.
+  void release_buffer(logger_impl::logbuff_tls_entry* entry);
+
   void stream_flush() {
     // get the stream buffer
     logger_impl::streambuff_tls_entry* streambufentry = reinterpret_cast<logger_impl::streambuff_tls_entry*>(
@@ -317,6 +417,12 @@ class file_logger{
   std::string log_file;
   
   pthread_key_t streambuffkey;
+  pthread_key_t logbuffkey;
+  // all the thread log buffers. The key destructor does not run for the
+  // main thread, so the remaining ones are written out by ~file_logger().
+  // Protected by buffers_mut, which is taken before the buffer locks.
+  std::vector<logger_impl::logbuff_tls_entry*> logbuffers;
+  pthread_mutex_t buffers_mut;
   
   int streamloglevel;
   pthread_mutex_t mut;
@@ -324,6 +430,8 @@ class file_logger{
   bool log_to_console;
   int log_level;
 
+  logger_impl::logbuff_tls_entry* get_log_buffer();
+  void write_buffer(logger_impl::logbuff_tls_entry* entry, int loglevel);
 };
 
 
@@ -361,6 +469,30 @@ struct null_stream {
 };
 
 
+/**
+Same as log_dispatch, for the buffered logging calls
+*/
+template <bool dostuff>
+struct log_buffered_dispatch {};
+
+template <>
+struct log_buffered_dispatch<true> {
+  inline static void exec(int loglevel,const char* file,const char* function,
+                int line, size_t suppressed, const char* fmt, ... ) {
+  va_list argp;
+	va_start(argp, fmt);
+	global_logger()._logbuffered(loglevel, file, function, line, suppressed, fmt, argp);
+	va_end(argp);
+  }
+};
+
+template <>
+struct log_buffered_dispatch<false> {
+  inline static void exec(int loglevel,const char* file,const char* function,
+                int line, size_t suppressed, const char* fmt, ... ) {}
+};
+
+
 template <bool dostuff>
 struct log_stream_dispatch {};
 
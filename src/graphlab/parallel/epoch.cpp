@@ -0,0 +1,213 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <graphlab/parallel/epoch.hpp>
+#include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  epoch_manager::epoch_manager(size_t retire_threshold):
+      global_epoch(0), records(NULL), retire_threshold(retire_threshold) {
+    pthread_key_create(&record_key, &epoch_manager::release_record);
+  }
+
+
+  epoch_manager::~epoch_manager() {
+    // stop the thread exit callbacks from touching the records
+    pthread_key_delete(record_key);
+    thread_record* rec = records;
+    while (rec != NULL) {
+      ASSERT_MSG(!rec->active, "epoch_manager destroyed inside a guard");
+      for (size_t i = 0;i < 3; ++i) free_list(rec->limbo[i]);
+      thread_record* next = rec->next;
+      delete rec;
+      rec = next;
+    }
+    for (size_t i = 0;i < orphans.size(); ++i) free_list(orphans[i]);
+  }
+
+
+  epoch_manager::thread_record* epoch_manager::get_record() {
+    thread_record* rec = 
+      reinterpret_cast<thread_record*>(pthread_getspecific(record_key));
+    if (rec != NULL) return rec;
+    // reuse the record of an exited thread if there is one
+    for (rec = records; rec != NULL; rec = rec->next) {
+      if (!rec->in_use && 
+          atomic_compare_and_swap(rec->in_use, false, true)) break;
+    }
+    if (rec == NULL) {
+      rec = new thread_record;
+      rec->manager = this;
+      do {
+        rec->next = records;
+      } while(!atomic_compare_and_swap(records, rec->next, rec));
+    }
+    pthread_setspecific(record_key, rec);
+    return rec;
+  }
+
+
+  void epoch_manager::release_record(void* ptr) {
+    thread_record* rec = reinterpret_cast<thread_record*>(ptr);
+    epoch_manager* manager = rec->manager;
+    // hand the objects which could not be freed yet to the manager
+    manager->orphan_lock.lock();
+    for (size_t i = 0;i < 3; ++i) {
+      if (!rec->limbo[i].objects.empty()) {
+        manager->orphans.push_back(limbo_list());
+        manager->orphans.back().epoch = rec->limbo[i].epoch;
+        manager->orphans.back().objects.swap(rec->limbo[i].objects);
+      }
+    }
+    manager->orphan_lock.unlock();
+    rec->num_retired = 0;
+    rec->nesting = 0;
+    rec->active = false;
+    __sync_synchronize();
+    rec->in_use = false;
+  }
+
+
+  void epoch_manager::enter() {
+    thread_record* rec = get_record();
+    if (rec->nesting++ > 0) return;
+    rec->local_epoch = global_epoch;
+    rec->active = true;
+    // the announcement must be visible before any shared pointer is read
+    __sync_synchronize();
+  }
+
+
+  void epoch_manager::exit() {
+    thread_record* rec = get_record();
+    ASSERT_GT(rec->nesting, 0);
+    if (--rec->nesting > 0) return;
+    // all the reads of the critical section complete before this store
+    asm volatile("" : : : "memory");
+    rec->active = false;
+  }
+
+
+  bool epoch_manager::in_critical_section() {
+    return get_record()->nesting > 0;
+  }
+
+
+  bool epoch_manager::try_advance() {
+    __sync_synchronize();
+    size_t e = global_epoch;
+    for (thread_record* rec = records; rec != NULL; rec = rec->next) {
+      if (rec->in_use && rec->active && rec->local_epoch != e) return false;
+    }
+    atomic_compare_and_swap(global_epoch, e, e + 1);
+    return true;
+  }
+
+
+  void epoch_manager::free_list(limbo_list& list) {
+    for (size_t i = 0;i < list.objects.size(); ++i) {
+      list.objects[i].deleter(list.objects[i].ptr);
+    }
+    list.objects.clear();
+  }
+
+
+  void epoch_manager::free_expired(thread_record* rec, size_t epoch) {
+    rec->num_retired = 0;
+    for (size_t i = 0;i < 3; ++i) {
+      limbo_list& list = rec->limbo[i];
+      // objects retired in epoch e may still be referenced by guards
+      // which entered in epoch e - 1 or e. Those have all exited by
+      // the time the global epoch reaches e + 2.
+      if (!list.objects.empty() && list.epoch + 2 <= epoch) free_list(list);
+      rec->num_retired += list.objects.size();
+    }
+  }
+
+
+  void epoch_manager::free_orphans(size_t epoch) {
+    if (orphans.empty() || !orphan_lock.try_lock()) return;
+    std::vector<limbo_list> expired;
+    size_t j = 0;
+    for (size_t i = 0;i < orphans.size(); ++i) {
+      if (orphans[i].epoch + 2 <= epoch) {
+        expired.push_back(limbo_list());
+        expired.back().objects.swap(orphans[i].objects);
+      } else {
+        if (i != j) {
+          orphans[j].epoch = orphans[i].epoch;
+          orphans[j].objects.swap(orphans[i].objects);
+        }
+        ++j;
+      }
+    }
+    orphans.resize(j);
+    orphan_lock.unlock();
+    for (size_t i = 0;i < expired.size(); ++i) free_list(expired[i]);
+  }
+
+
+  void epoch_manager::retire(void* ptr, deleter_type deleter) {
+    thread_record* rec = get_record();
+    // the unlink of ptr must be ordered before the epoch read
+    __sync_synchronize();
+    size_t e = global_epoch;
+    limbo_list& list = rec->limbo[e % 3];
+    if (list.epoch != e) {
+      // the list holds objects from epoch e - 3 or earlier, which are safe
+      rec->num_retired -= list.objects.size();
+      free_list(list);
+      list.epoch = e;
+    }
+    list.objects.push_back(retired_object(ptr, deleter));
+    ++rec->num_retired;
+    if (rec->num_retired >= retire_threshold) {
+      try_advance();
+      size_t epoch = global_epoch;
+      free_expired(rec, epoch);
+      free_orphans(epoch);
+    }
+  }
+
+
+  void epoch_manager::reclaim() {
+    thread_record* rec = get_record();
+    ASSERT_EQ(rec->nesting, 0);
+    // two advances make everything retired so far safe, if no one
+    // else is inside a guard
+    for (size_t i = 0;i < 3; ++i) {
+      if (!try_advance()) break;
+    }
+    size_t epoch = global_epoch;
+    free_expired(rec, epoch);
+    free_orphans(epoch);
+  }
+
+
+  size_t epoch_manager::num_pending() {
+    return get_record()->num_retired;
+  }
+
+} // namespace graphlab
@@ -0,0 +1,203 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_PARALLEL_EPOCH_HPP
+#define GRAPHLAB_PARALLEL_EPOCH_HPP
+#include <pthread.h>
+#include <vector>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * Epoch based memory reclamation.
+   *
+   * Lock free structures cannot free a node as soon as it is unlinked,
+   * since concurrent readers may still hold a pointer to it. The
+   * epoch_manager defers the free until every thread which could have
+   * seen the node has left its critical section:
+   *
+   * - Readers and writers wrap every access to the shared structure in an
+   *   epoch_manager::guard (or enter()/exit()). Pointers obtained inside a
+   *   guard must not be used after it ends.
+   * - A writer which unlinks a node calls retire(node) instead of deleting
+   *   it. The node is freed once the global epoch has advanced twice,
+   *   at which point no guard which could have observed it is still open.
+   *
+   * \code
+   * epoch_manager epochs;
+   *
+   * // reader
+   * {
+   *   epoch_manager::guard g(epochs);
+   *   node* n = head;
+   *   ... read n ...
+   * }
+   *
+   * // writer
+   * {
+   *   epoch_manager::guard g(epochs);
+   *   node* n = head;
+   *   if (atomic_compare_and_swap(head, n, n->next)) epochs.retire(n);
+   * }
+   * \endcode
+   *
+   * Each thread keeps its own retire lists, so retire() does not touch
+   * shared state. Once a thread has retired retire_threshold objects it
+   * tries to advance the global epoch and frees its lists in a batch.
+   * Entering and leaving a guard costs one fence. Guards may be nested.
+   *
+   * A thread blocked inside a guard stops reclamation (but not progress)
+   * for everyone, so guards should be short. Objects retired by threads
+   * which exit are handed to the manager and freed by other threads or
+   * by the destructor. The manager must outlive all threads using it.
+   */
+  class epoch_manager {
+   public:
+    typedef void (*deleter_type)(void*);
+
+   private:
+    struct retired_object {
+      void* ptr;
+      deleter_type deleter;
+      retired_object(void* ptr, deleter_type deleter):
+          ptr(ptr), deleter(deleter) { }
+    };
+
+    struct limbo_list {
+      size_t epoch;
+      std::vector<retired_object> objects;
+      limbo_list(): epoch(0) { }
+    };
+
+    /// Per thread state. Records are never freed before the manager.
+    struct thread_record {
+      volatile size_t local_epoch;
+      volatile bool active;
+      size_t nesting;
+      volatile bool in_use;
+      epoch_manager* manager;
+      thread_record* next;
+      // objects retired during the 3 most recent epochs seen by the thread
+      limbo_list limbo[3];
+      size_t num_retired;
+      char __pad__[64];
+      thread_record(): local_epoch(0), active(false), nesting(0),
+                       in_use(true), manager(NULL), next(NULL),
+                       num_retired(0) { }
+    };
+
+    volatile size_t global_epoch;
+    char __pad0__[64 - sizeof(size_t)];
+    // lock free list of all the thread records
+    thread_record* volatile records;
+    pthread_key_t record_key;
+    size_t retire_threshold;
+
+    // objects left behind by exited threads
+    mutex orphan_lock;
+    std::vector<limbo_list> orphans;
+
+    // not copyable
+    epoch_manager(const epoch_manager&);
+    epoch_manager& operator=(const epoch_manager&);
+
+    thread_record* get_record();
+    static void release_record(void* rec);
+    bool try_advance();
+    void free_expired(thread_record* rec, size_t epoch);
+    void free_orphans(size_t epoch);
+    static void free_list(limbo_list& list);
+
+    template <typename T>
+    static void delete_object(void* ptr) {
+      delete reinterpret_cast<T*>(ptr);
+    }
+
+   public:
+    /**
+     * Creates an epoch manager. Each thread attempts reclamation after
+     * retiring retire_threshold objects.
+     */
+    explicit epoch_manager(size_t retire_threshold = 64);
+
+    /**
+     * Frees all the retired objects. There must not be any thread inside
+     * a guard.
+     */
+    ~epoch_manager();
+
+    /// Enters a critical section. May be nested.
+    void enter();
+
+    /// Leaves a critical section.
+    void exit();
+
+    /// Returns true if the calling thread is inside a critical section
+    bool in_critical_section();
+
+    /**
+     * Schedules ptr to be freed with deleter(ptr) once no thread can hold
+     * a reference to it. ptr must already be unreachable from the shared
+     * structure.
+     */
+    void retire(void* ptr, deleter_type deleter);
+
+    /// Schedules ptr to be freed with delete once it is safe
+    template <typename T>
+    void retire(T* ptr) {
+      retire(reinterpret_cast<void*>(ptr), &epoch_manager::delete_object<T>);
+    }
+
+    /**
+     * Tries to advance the epoch and frees the calling thread's retired
+     * objects which have become safe. If no other thread is inside a
+     * guard, all of the calling thread's objects are freed.
+     * Must not be called inside a guard.
+     */
+    void reclaim();
+
+    /// Returns the number of objects retired by the calling thread and not
+    /// yet freed
+    size_t num_pending();
+
+    /// Returns the current global epoch
+    size_t current_epoch() const { return global_epoch; }
+
+    /// Scoped critical section
+    class guard {
+     private:
+      epoch_manager& manager;
+      guard(const guard&);
+      guard& operator=(const guard&);
+     public:
+      explicit guard(epoch_manager& manager): manager(manager) {
+        manager.enter();
+      }
+      ~guard() { manager.exit(); }
+    };
+  }; // end of epoch_manager
+
+} // namespace graphlab
+#endif
@@ -0,0 +1,223 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <graphlab/parallel/fiber_scheduler.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  // ===================================================================>
+  // Thread local pointer to the worker of the calling thread
+  struct fiber_scheduler_keys {
+    pthread_key_t WORKER_KEY;
+    fiber_scheduler_keys() : WORKER_KEY(0) {
+      pthread_key_create(&WORKER_KEY, NULL);
+    }
+  };
+  static pthread_key_t get_fiber_worker_key() {
+    static fiber_scheduler_keys keys;
+    return keys.WORKER_KEY;
+  }
+  // This forces get_fiber_worker_key to be called prior to main.
+  static pthread_key_t __unused_init_fiber_worker_key__(get_fiber_worker_key());
+  // ===================================================================>
+
+
+  fiber_scheduler::fiber_scheduler(size_t nworkers, size_t stacksize):
+      num_fibers(0), alive(true) {
+    ASSERT_GT(nworkers, 0);
+    // round the stack up to a whole number of pages
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    this->stacksize = ((stacksize + pagesize - 1) / pagesize) * pagesize;
+    workers.resize(nworkers);
+    for (size_t i = 0;i < nworkers; ++i) {
+      workers[i].owner = this;
+      workers[i].current = NULL;
+      threads.launch(boost::bind(&fiber_scheduler::worker_loop, this, i));
+    }
+  }
+
+  fiber_scheduler::~fiber_scheduler() {
+    lock.lock();
+    while (num_fibers > 0) join_cond.wait(lock);
+    alive = false;
+    ready_cond.broadcast();
+    lock.unlock();
+    threads.join();
+    while (!exceptions.empty()) {
+      logstream(LOG_ERROR)
+        << "Unexpected exception caught in fiber scheduler destructor: "
+        << exceptions.front() << std::endl;
+      exceptions.pop();
+    }
+  }
+
+
+  void fiber_scheduler::launch(const boost::function<void (void)>& fn) {
+    fiber* f = new fiber;
+    // the stack is preceded by a guard page so that overflows fault
+    // instead of silently corrupting the neighbouring stack
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    void* mem = mmap(NULL, stacksize + pagesize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_MSG(mem != MAP_FAILED, "Unable to allocate fiber stack");
+    mprotect(mem, pagesize, PROT_NONE);
+    f->stack = reinterpret_cast<char*>(mem);
+    f->stacksize = stacksize + pagesize;
+    f->fn = fn;
+    f->owner = this;
+    f->finished = false;
+
+    getcontext(&f->context);
+    f->context.uc_stack.ss_sp = f->stack + pagesize;
+    f->context.uc_stack.ss_size = stacksize;
+    f->context.uc_link = NULL;
+    // makecontext only passes int arguments. Split the pointer.
+    uint64_t ptr = reinterpret_cast<uint64_t>(f);
+    makecontext(&f->context, (void (*)())(fiber_scheduler::trampoline), 2,
+                int(ptr >> 32), int(ptr & 0xFFFFFFFF));
+
+    lock.lock();
+    ++num_fibers;
+    lock.unlock();
+    schedule(f);
+  }
+
+
+  void fiber_scheduler::join() {
+    lock.lock();
+    while (num_fibers > 0 && exceptions.empty()) join_cond.wait(lock);
+    if (!exceptions.empty()) {
+      const char* ex = exceptions.front();
+      exceptions.pop();
+      lock.unlock();
+      throw(ex);
+    }
+    lock.unlock();
+  }
+
+
+  size_t fiber_scheduler::num_active() {
+    lock.lock();
+    size_t ret = num_fibers;
+    lock.unlock();
+    return ret;
+  }
+
+
+  fiber_scheduler::worker* fiber_scheduler::current_worker() {
+    return reinterpret_cast<worker*>(pthread_getspecific(get_fiber_worker_key()));
+  }
+
+
+  bool fiber_scheduler::in_fiber() {
+    worker* w = current_worker();
+    return w != NULL && w->current != NULL;
+  }
+
+
+  void fiber_scheduler::yield() {
+    worker* w = current_worker();
+    if (w == NULL || w->current == NULL) return;
+    suspend(boost::bind(&fiber_scheduler::schedule, w->owner, w->current));
+  }
+
+
+  void fiber_scheduler::suspend(const boost::function<void (void)>& after_switch) {
+    worker* w = current_worker();
+    fiber* f = w->current;
+    w->after_switch = after_switch;
+    swapcontext(&f->context, &w->scheduler_context);
+    // resumed. possibly on a different worker.
+  }
+
+
+  void fiber_scheduler::schedule(fiber* f) {
+    lock.lock();
+    ready.push_back(f);
+    ready_cond.signal();
+    lock.unlock();
+  }
+
+
+  void fiber_scheduler::destroy_fiber(fiber* f) {
+    munmap(f->stack, f->stacksize);
+    delete f;
+    lock.lock();
+    --num_fibers;
+    if (num_fibers == 0) join_cond.broadcast();
+    lock.unlock();
+  }
+
+
+  void fiber_scheduler::trampoline(int ptr_hi, int ptr_lo) {
+    uint64_t ptr = (uint64_t(uint32_t(ptr_hi)) << 32) | uint32_t(ptr_lo);
+    fiber* f = reinterpret_cast<fiber*>(ptr);
+    try {
+      f->fn();
+    } catch (const char* c) {
+      f->owner->lock.lock();
+      f->owner->exceptions.push(c);
+      f->owner->join_cond.broadcast();
+      f->owner->lock.unlock();
+    }
+    f->fn = NULL;
+    f->finished = true;
+    // the fiber may have migrated, so look up the current worker again
+    worker* w = current_worker();
+    setcontext(&w->scheduler_context);
+  }
+
+
+  void fiber_scheduler::worker_loop(size_t id) {
+    worker* self = &workers[id];
+    pthread_setspecific(get_fiber_worker_key(), self);
+    while(1) {
+      lock.lock();
+      while (ready.empty() && alive) ready_cond.wait(lock);
+      if (ready.empty()) {
+        lock.unlock();
+        break;
+      }
+      fiber* f = ready.front();
+      ready.pop_front();
+      lock.unlock();
+
+      self->current = f;
+      swapcontext(&self->scheduler_context, &f->context);
+      self->current = NULL;
+      if (f->finished) {
+        destroy_fiber(f);
+      } else if (self->after_switch) {
+        boost::function<void (void)> fn;
+        fn.swap(self->after_switch);
+        fn();
+      }
+    }
+    pthread_setspecific(get_fiber_worker_key(), NULL);
+  }
+
+} // namespace graphlab
@@ -0,0 +1,178 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_PARALLEL_FIBER_SCHEDULER_HPP
+#define GRAPHLAB_PARALLEL_FIBER_SCHEDULER_HPP
+#include <ucontext.h>
+#include <deque>
+#include <queue>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/future.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * A user-level scheduler of lightweight stackful tasks ("fibers").
+   *
+   * A small number of worker pthreads run a large number of fibers, each
+   * with its own small stack. A fiber which waits on a \ref future through
+   * fiber_scheduler::wait() is suspended and the worker moves on to another
+   * fiber; the fiber is resumed (possibly on another worker) once the
+   * future is fulfilled. This lets code issue remote requests in a
+   * straight-line style while keeping thousands of requests in flight:
+   *
+   * \code
+   * void lookup(comm_rpc* rpc, size_t id) {
+   *   future<std::string> reply;
+   *   oarchive* oarc = rpc->prepare_request(LOOKUP, reply);
+   *   (*oarc) << id;
+   *   rpc->complete_message(id % rpc->get_comm()->size(), oarc);
+   *   const std::string& value = fiber_scheduler::get(reply);
+   *   ...
+   * }
+   *
+   * fiber_scheduler sched(4);
+   * for (size_t i = 0;i < 10000; ++i) sched.launch(boost::bind(lookup, rpc, i));
+   * sched.join();
+   * \endcode
+   *
+   * This provides the same programming model as qthreads (see
+   * qthread_sgd) without the external dependency. Context switches are
+   * performed with swapcontext() and happen only when a fiber blocks or
+   * yields; there is no preemption.
+   *
+   * const char* exceptions thrown by fibers are forwarded to join().
+   * The scheduler is also an \ref executor, so async() and future::then()
+   * can run work as fibers.
+   */
+  class fiber_scheduler: public executor {
+   private:
+    struct fiber {
+      ucontext_t context;
+      char* stack;
+      size_t stacksize;
+      boost::function<void (void)> fn;
+      fiber_scheduler* owner;
+      bool finished;
+    };
+
+    struct worker {
+      fiber_scheduler* owner;
+      ucontext_t scheduler_context;
+      fiber* current;
+      // run by the worker once the current fiber has been switched out
+      boost::function<void (void)> after_switch;
+    };
+
+    size_t stacksize;
+    std::vector<worker> workers;
+    thread_group threads;
+
+    mutex lock;
+    conditional ready_cond;
+    conditional join_cond;
+    std::deque<fiber*> ready;
+    std::queue<const char*> exceptions;
+    size_t num_fibers;
+    bool alive;
+
+    // not copyable
+    fiber_scheduler(const fiber_scheduler&);
+    fiber_scheduler& operator=(const fiber_scheduler&);
+
+    static worker* current_worker();
+    static void trampoline(int ptr_hi, int ptr_lo);
+    void worker_loop(size_t id);
+    void schedule(fiber* f);
+    void destroy_fiber(fiber* f);
+    static void suspend(const boost::function<void (void)>& after_switch);
+
+    template <typename T>
+    static void resume_on_ready(future<T> f, fiber* fib) {
+      f.on_ready(boost::bind(&fiber_scheduler::schedule, fib->owner, fib));
+    }
+
+   public:
+    /**
+     * Creates a scheduler with nworkers worker threads. Each fiber
+     * gets a stack of stacksize bytes.
+     */
+    fiber_scheduler(size_t nworkers = thread::cpu_count(),
+                    size_t stacksize = 64 * 1024);
+
+    /// Waits for all fibers to complete and stops the workers
+    ~fiber_scheduler();
+
+    /// Creates a new fiber running fn
+    void launch(const boost::function<void (void)>& fn);
+
+    /// Same as launch(). Runs fn as a fiber.
+    void execute(const boost::function<void (void)>& fn) { launch(fn); }
+
+    /**
+     * Waits for all fibers to complete. const char* exceptions thrown
+     * by fibers are rethrown here, one per call.
+     */
+    void join();
+
+    /// Returns the number of fibers which have not completed
+    size_t num_active();
+
+    /// Returns true if the caller is running inside a fiber
+    static bool in_fiber();
+
+    /**
+     * Lets other ready fibers run. Does nothing if not called from a fiber.
+     */
+    static void yield();
+
+    /**
+     * Waits for a future. Inside a fiber, suspends the fiber until the
+     * future is ready. Otherwise, blocks the calling thread.
+     */
+    template <typename T>
+    static void wait(const future<T>& f) {
+      if (f.is_ready()) return;
+      worker* w = current_worker();
+      if (w == NULL || w->current == NULL) {
+        f.wait();
+        return;
+      }
+      // the continuation is registered only once this fiber's context
+      // has been saved, so it is safe for it to resume the fiber at once
+      suspend(boost::bind(&fiber_scheduler::resume_on_ready<T>,
+                          f, w->current));
+    }
+
+    /// Waits for a future and returns its value. Throws the error if any.
+    template <typename T>
+    static const T& get(const future<T>& f) {
+      wait(f);
+      return f.get();
+    }
+  };
+
+} // namespace graphlab
+#endif
@@ -0,0 +1,395 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_PARALLEL_FUTURE_HPP
+#define GRAPHLAB_PARALLEL_FUTURE_HPP
+
+#include <vector>
+#include <utility>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/thread_pool.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * An executor runs functions on behalf of a future continuation
+   * or of async(). Implementations decide where the function runs.
+   */
+  class executor {
+   public:
+    virtual ~executor() { }
+    /// Runs fn, possibly asynchronously.
+    virtual void execute(const boost::function<void (void)>& fn) = 0;
+  };
+
+  /**
+   * \ingroup util
+   * Runs functions immediately in the calling thread.
+   */
+  class inline_executor: public executor {
+   public:
+    void execute(const boost::function<void (void)>& fn) { fn(); }
+  };
+
+  /**
+   * \ingroup util
+   * Runs functions as tasks of a thread_pool.
+   */
+  class thread_pool_executor: public executor {
+   private:
+    thread_pool& pool;
+   public:
+    thread_pool_executor(thread_pool& pool): pool(pool) { }
+    void execute(const boost::function<void (void)>& fn) { pool.launch(fn); }
+  };
+
+
+  template <typename T> class future;
+  template <typename T> class promise;
+
+  namespace future_impl {
+    /// The state shared between a promise and its futures
+    template <typename T>
+    struct shared_state {
+      mutex lock;
+      conditional cond;
+      volatile bool ready;
+      T value;
+      const char* error;
+      std::vector<boost::function<void (void)> > callbacks;
+
+      shared_state(): ready(false), error(NULL) { }
+
+      /// Registers a callback to run once the state is ready.
+      /// Runs it immediately if it is already ready.
+      void on_ready(const boost::function<void (void)>& fn) {
+        lock.lock();
+        if (!ready) {
+          callbacks.push_back(fn);
+          lock.unlock();
+          return;
+        }
+        lock.unlock();
+        fn();
+      }
+
+      /// Marks the state as ready and runs the callbacks.
+      /// The value or error must be filled in first.
+      void complete() {
+        std::vector<boost::function<void (void)> > torun;
+        lock.lock();
+        ASSERT_MSG(!ready, "promise fulfilled twice");
+        ready = true;
+        torun.swap(callbacks);
+        cond.broadcast();
+        lock.unlock();
+        // callbacks run outside of the lock
+        for (size_t i = 0;i < torun.size(); ++i) torun[i]();
+      }
+
+      void wait() {
+        if (ready) return;
+        lock.lock();
+        while (!ready) cond.wait(lock);
+        lock.unlock();
+      }
+    };
+  } // namespace future_impl
+
+
+  /**
+   * \ingroup util
+   * The read end of an asynchronous result.
+   *
+   * A future is a cheap, copyable handle to a value which will be
+   * provided later through the matching \ref promise. Continuations
+   * can be attached with then(), and groups of futures combined with
+   * when_all() and when_any(), so that asynchronous pipelines can be
+   * composed without blocking a thread per outstanding operation.
+   *
+   * Errors are propagated as const char* (the same convention as
+   * \ref thread_pool and \ref thread_group): get() throws the error
+   * and continuations of a failed future are skipped, forwarding the
+   * error to the future they return.
+   *
+   * For operations without a result use future<graphlab::empty>.
+   *
+   * \code
+   * int twice(const int& i) { return 2 * i; }
+   *
+   * promise<int> p;
+   * future<int> f = p.get_future().then<int>(twice);
+   * p.set_value(21);
+   * f.get(); // 42
+   * \endcode
+   *
+   * wait() and get() block the calling pthread. Code running inside
+   * qthreads should use qthread_wait() (qthread_executor.hpp) instead.
+   */
+  template <typename T>
+  class future {
+   private:
+    typedef future_impl::shared_state<T> state_type;
+    boost::shared_ptr<state_type> state;
+
+    template <typename R>
+    static void apply_continuation(boost::shared_ptr<state_type> source,
+                                   boost::function<R (const T&)> fn,
+                                   promise<R> result) {
+      if (source->error != NULL) {
+        result.set_error(source->error);
+        return;
+      }
+      R ret;
+      try {
+        ret = fn(source->value);
+      } catch (const char* err) {
+        result.set_error(err);
+        return;
+      }
+      result.set_value(ret);
+    }
+
+    template <typename R>
+    static void dispatch_continuation(boost::shared_ptr<state_type> source,
+                                      boost::function<R (const T&)> fn,
+                                      promise<R> result,
+                                      executor* exec) {
+      if (exec == NULL) {
+        apply_continuation<R>(source, fn, result);
+      } else {
+        exec->execute(boost::bind(&future<T>::template apply_continuation<R>,
+                                  source, fn, result));
+      }
+    }
+
+    friend class promise<T>;
+    explicit future(const boost::shared_ptr<state_type>& state): state(state) { }
+
+   public:
+    /// Creates an invalid future. Only assignment and valid() may be used.
+    future() { }
+
+    /// Returns true if this future is attached to a promise
+    bool valid() const { return state.get() != NULL; }
+
+    /// Returns true if the value (or an error) is available
+    bool is_ready() const { return state->ready; }
+
+    /// Returns true if the future is ready and holds an error
+    bool has_error() const { return state->ready && state->error != NULL; }
+
+    /// Blocks until the future is ready
+    void wait() const { state->wait(); }
+
+    /// Waits and returns the value. Throws the error if there is one.
+    const T& get() const {
+      state->wait();
+      if (state->error != NULL) throw(state->error);
+      return state->value;
+    }
+
+    /// Waits and returns the error, or NULL if there is none.
+    const char* get_error() const {
+      state->wait();
+      return state->error;
+    }
+
+    /**
+     * Registers fn to be called once the future is ready. fn runs in
+     * the thread which fulfills the promise, or immediately in the
+     * calling thread if the future is already ready. fn should be short;
+     * use then() with an executor for real work.
+     */
+    void on_ready(const boost::function<void (void)>& fn) const {
+      state->on_ready(fn);
+    }
+
+    /**
+     * Returns a future for fn applied to the value of this future.
+     * fn is run on exec, or inline by the thread completing this future
+     * if exec is NULL. If this future fails, fn is not called and the
+     * error is forwarded. The result type has to be given explicitly:
+     * \code
+     * future<size_t> len = str_future.then<size_t>(string_length);
+     * \endcode
+     */
+    template <typename R>
+    future<R> then(const boost::function<R (const T&)>& fn,
+                   executor* exec = NULL) const {
+      promise<R> result;
+      state->on_ready(boost::bind(&future<T>::template dispatch_continuation<R>,
+                                  state, fn, result, exec));
+      return result.get_future();
+    }
+  }; // end of future
+
+
+  /**
+   * \ingroup util
+   * The write end of an asynchronous result. Copies of a promise refer
+   * to the same result. Exactly one of set_value() or set_error() must be
+   * called exactly once.
+   */
+  template <typename T>
+  class promise {
+   private:
+    typedef future_impl::shared_state<T> state_type;
+    boost::shared_ptr<state_type> state;
+   public:
+    promise(): state(new state_type) { }
+
+    /// Returns a future attached to this promise
+    future<T> get_future() const { return future<T>(state); }
+
+    /// Provides the value and runs the continuations
+    void set_value(const T& value) {
+      state->value = value;
+      state->complete();
+    }
+
+    /// Fails the promise and runs the continuations
+    void set_error(const char* error) {
+      state->error = error;
+      state->complete();
+    }
+  }; // end of promise
+
+
+  /// Returns a future which is already ready with the given value
+  template <typename T>
+  future<T> make_ready_future(const T& value) {
+    promise<T> p;
+    p.set_value(value);
+    return p.get_future();
+  }
+
+
+  namespace future_impl {
+    template <typename T>
+    void run_async(boost::function<T (void)> fn, promise<T> result) {
+      T ret;
+      try {
+        ret = fn();
+      } catch (const char* err) {
+        result.set_error(err);
+        return;
+      }
+      result.set_value(ret);
+    }
+
+    template <typename T>
+    struct when_all_state {
+      std::vector<future<T> > inputs;
+      atomic<size_t> remaining;
+      promise<std::vector<T> > result;
+    };
+
+    template <typename T>
+    void when_all_callback(boost::shared_ptr<when_all_state<T> > s) {
+      if (s->remaining.dec() > 0) return;
+      std::vector<T> values(s->inputs.size());
+      for (size_t i = 0;i < s->inputs.size(); ++i) {
+        const char* err = s->inputs[i].get_error();
+        if (err != NULL) {
+          s->result.set_error(err);
+          return;
+        }
+        values[i] = s->inputs[i].get();
+      }
+      s->result.set_value(values);
+    }
+
+    template <typename T>
+    struct when_any_state {
+      std::vector<future<T> > inputs;
+      atomic<size_t> fired;
+      promise<std::pair<size_t, T> > result;
+    };
+
+    template <typename T>
+    void when_any_callback(boost::shared_ptr<when_any_state<T> > s, size_t idx) {
+      // only the first input to complete fulfills the result
+      if (s->fired.inc_ret_last() != 0) return;
+      const char* err = s->inputs[idx].get_error();
+      if (err != NULL) s->result.set_error(err);
+      else s->result.set_value(std::make_pair(idx, s->inputs[idx].get()));
+    }
+  } // namespace future_impl
+
+
+  /**
+   * Runs fn on exec and returns a future for its result.
+   * The result type has to be given explicitly: async<int>(exec, fn).
+   */
+  template <typename T>
+  future<T> async(executor& exec, const boost::function<T (void)>& fn) {
+    promise<T> result;
+    exec.execute(boost::bind(future_impl::run_async<T>, fn, result));
+    return result.get_future();
+  }
+
+  /**
+   * Returns a future which becomes ready once all the input futures are
+   * ready, holding their values in order. If any input fails, the result
+   * fails with the first error (in input order).
+   */
+  template <typename T>
+  future<std::vector<T> > when_all(const std::vector<future<T> >& inputs) {
+    if (inputs.empty()) return make_ready_future(std::vector<T>());
+    boost::shared_ptr<future_impl::when_all_state<T> >
+        s(new future_impl::when_all_state<T>);
+    s->inputs = inputs;
+    s->remaining.value = inputs.size();
+    future<std::vector<T> > ret = s->result.get_future();
+    for (size_t i = 0;i < inputs.size(); ++i) {
+      inputs[i].on_ready(boost::bind(future_impl::when_all_callback<T>, s));
+    }
+    return ret;
+  }
+
+  /**
+   * Returns a future which becomes ready as soon as one of the input
+   * futures is ready, holding the index and value of that input.
+   * inputs must not be empty.
+   */
+  template <typename T>
+  future<std::pair<size_t, T> > when_any(const std::vector<future<T> >& inputs) {
+    ASSERT_GT(inputs.size(), 0);
+    boost::shared_ptr<future_impl::when_any_state<T> >
+        s(new future_impl::when_any_state<T>);
+    s->inputs = inputs;
+    future<std::pair<size_t, T> > ret = s->result.get_future();
+    for (size_t i = 0;i < inputs.size(); ++i) {
+      inputs[i].on_ready(boost::bind(future_impl::when_any_callback<T>, s, i));
+    }
+    return ret;
+  }
+
+} // namespace graphlab
+#endif
@@ -0,0 +1,342 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_PARALLEL_MPMC_QUEUE_HPP
+#define GRAPHLAB_PARALLEL_MPMC_QUEUE_HPP
+
+#include <stdint.h>
+#include <climits>
+#include <sched.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+/**
+ * \ingroup util
+ * Bounded lock free multi-producer multi-consumer queue.
+ *
+ * Adapted from Dmitry Vyukov's bounded MPMC queue. The queue is a ring of
+ * cells, each tagged with a sequence number which tells producers and
+ * consumers whether the cell is free for a given lap around the ring.
+ * Producers and consumers only contend on the enqueue and dequeue
+ * positions (one CAS per operation, or per batch for the bulk calls), and
+ * these sit on separate cache lines.
+ *
+ * try_enqueue() / try_dequeue() and the bulk variants never block. If the
+ * queue is constructed with blocking = true, enqueue() and dequeue() sleep
+ * (on a futex on Linux) while the queue is full or empty. Blocking costs
+ * one memory fence per operation to pair producers with sleeping
+ * consumers, so it is opt-in. close() wakes up all the sleepers; after
+ * close() blocking dequeues return false once the queue is drained.
+ *
+ * The fences assume the x86 memory model.
+ */
+template <typename T>
+class mpmc_queue {
+ private:
+  struct cell {
+    volatile size_t sequence;
+    T data;
+  };
+
+  cell* buffer;
+  size_t mask;
+  bool blocking;
+  volatile bool closed;
+  char __pad0__[64];
+  volatile size_t enqueue_pos;
+  char __pad1__[64 - sizeof(size_t)];
+  volatile size_t dequeue_pos;
+  char __pad2__[64 - sizeof(size_t)];
+  // futex words and the number of threads sleeping on them
+  volatile int not_empty_seq;
+  volatile int empty_waiters;
+  volatile int not_full_seq;
+  volatile int full_waiters;
+
+  // not copyable
+  mpmc_queue(const mpmc_queue&);
+  mpmc_queue& operator=(const mpmc_queue&);
+
+  static inline void compiler_barrier() {
+    asm volatile("" : : : "memory");
+  }
+
+  static inline void backoff(size_t& spins) {
+    if (++spins < 64) {
+      asm volatile("pause\n": : :"memory");
+    } else {
+      sched_yield();
+      spins = 0;
+    }
+  }
+
+  static inline void futex_wait(volatile int* addr, int val) {
+#ifdef __linux__
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+    if (*addr == val) usleep(100);
+#endif
+  }
+
+  static inline void futex_wake_all(volatile int* addr) {
+#ifdef __linux__
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+  }
+
+  // wakes sleepers on (seq, waiters) if there are any
+  static inline void notify(volatile int* seq, volatile int* waiters) {
+    // pairs with the fence in wait_for(): either the sleeper sees the
+    // change to the queue, or we see the sleeper
+    __sync_synchronize();
+    if (*waiters > 0) {
+      __sync_fetch_and_add(seq, 1);
+      futex_wake_all(seq);
+    }
+  }
+
+  inline void notify_not_empty() {
+    if (blocking) notify(&not_empty_seq, &empty_waiters);
+  }
+  inline void notify_not_full() {
+    if (blocking) notify(&not_full_seq, &full_waiters);
+  }
+
+ public:
+  /**
+   * Creates a queue holding at least capacity elements (rounded up to a
+   * power of two). If blocking is true, enqueue() and dequeue() may be
+   * used.
+   */
+  explicit mpmc_queue(size_t capacity, bool blocking = false):
+      blocking(blocking), closed(false), enqueue_pos(0), dequeue_pos(0),
+      not_empty_seq(0), empty_waiters(0), not_full_seq(0), full_waiters(0) {
+    size_t n = 2;
+    while (n < capacity) n *= 2;
+    buffer = new cell[n];
+    mask = n - 1;
+    for (size_t i = 0;i < n; ++i) buffer[i].sequence = i;
+  }
+
+  ~mpmc_queue() {
+    delete [] buffer;
+  }
+
+  /// Returns the number of elements the queue can hold
+  inline size_t capacity() const { return mask + 1; }
+
+  /// Returns the approximate number of elements in the queue
+  inline size_t size() const {
+    size_t d = dequeue_pos;
+    compiler_barrier();
+    size_t e = enqueue_pos;
+    return e > d ? e - d : 0;
+  }
+
+  /// Returns true if the queue appears empty. Only a hint when concurrent.
+  inline bool empty() const { return size() == 0; }
+
+  /// Inserts an element. Returns false if the queue is full.
+  bool try_enqueue(const T& elem) {
+    cell* c;
+    size_t pos = enqueue_pos;
+    while(1) {
+      c = &buffer[pos & mask];
+      size_t seq = c->sequence;
+      intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+      if (dif == 0) {
+        if (atomic_compare_and_swap(enqueue_pos, pos, pos + 1)) break;
+        pos = enqueue_pos;
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos;
+      }
+    }
+    c->data = elem;
+    compiler_barrier();
+    c->sequence = pos + 1;
+    notify_not_empty();
+    return true;
+  }
+
+  /// Removes an element into elem. Returns false if the queue is empty.
+  bool try_dequeue(T& elem) {
+    cell* c;
+    size_t pos = dequeue_pos;
+    while(1) {
+      c = &buffer[pos & mask];
+      size_t seq = c->sequence;
+      intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (dif == 0) {
+        if (atomic_compare_and_swap(dequeue_pos, pos, pos + 1)) break;
+        pos = dequeue_pos;
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos;
+      }
+    }
+    elem = c->data;
+    compiler_barrier();
+    c->sequence = pos + mask + 1;
+    notify_not_full();
+    return true;
+  }
+
+  /**
+   * Inserts up to n elements from elems with a single reservation.
+   * Returns the number inserted, which is less than n if the queue
+   * does not have room.
+   */
+  size_t try_enqueue_bulk(const T* elems, size_t n) {
+    size_t pos, count;
+    while(1) {
+      // read the dequeue position first so that d <= pos. d may be
+      // stale, so pos - d never underestimates the used space
+      size_t d = dequeue_pos;
+      compiler_barrier();
+      pos = enqueue_pos;
+      size_t used = pos - d;
+      size_t room = used < capacity() ? capacity() - used : 0;
+      count = n < room ? n : room;
+      if (count == 0) return 0;
+      if (atomic_compare_and_swap(enqueue_pos, pos, pos + count)) break;
+    }
+    for (size_t i = 0;i < count; ++i) {
+      cell* c = &buffer[(pos + i) & mask];
+      // the cell may still be being read by a consumer from the last lap
+      size_t spins = 0;
+      while (c->sequence != pos + i) backoff(spins);
+      c->data = elems[i];
+      compiler_barrier();
+      c->sequence = pos + i + 1;
+    }
+    notify_not_empty();
+    return count;
+  }
+
+  /**
+   * Removes up to n elements into elems with a single reservation.
+   * Returns the number removed.
+   */
+  size_t try_dequeue_bulk(T* elems, size_t n) {
+    size_t pos, count;
+    while(1) {
+      pos = dequeue_pos;
+      compiler_barrier();
+      size_t e = enqueue_pos;
+      size_t avail = e > pos ? e - pos : 0;
+      count = n < avail ? n : avail;
+      if (count == 0) return 0;
+      if (atomic_compare_and_swap(dequeue_pos, pos, pos + count)) break;
+    }
+    for (size_t i = 0;i < count; ++i) {
+      cell* c = &buffer[(pos + i) & mask];
+      // the cell may still be being written by a producer
+      size_t spins = 0;
+      while (c->sequence != pos + i + 1) backoff(spins);
+      elems[i] = c->data;
+      compiler_barrier();
+      c->sequence = pos + i + mask + 1;
+    }
+    notify_not_full();
+    return count;
+  }
+
+  /**
+   * Inserts an element, sleeping while the queue is full.
+   * Returns false (without inserting) if the queue is closed.
+   * Requires a blocking queue.
+   */
+  bool enqueue(const T& elem) {
+    ASSERT_TRUE(blocking);
+    while(1) {
+      if (closed) return false;
+      if (try_enqueue(elem)) return true;
+      int seq = not_full_seq;
+      __sync_fetch_and_add(&full_waiters, 1);
+      __sync_synchronize();
+      bool ret = try_enqueue(elem);
+      if (!ret && !closed) futex_wait(&not_full_seq, seq);
+      __sync_fetch_and_sub(&full_waiters, 1);
+      if (ret) return true;
+    }
+  }
+
+  /**
+   * Removes an element, sleeping while the queue is empty.
+   * Returns false if the queue is closed and empty.
+   * Requires a blocking queue.
+   */
+  bool dequeue(T& elem) {
+    return dequeue_bulk(&elem, 1) == 1;
+  }
+
+  /**
+   * Removes up to n elements, sleeping while the queue is empty.
+   * Returns the number removed, which is 0 only if the queue is closed
+   * and empty. Requires a blocking queue.
+   */
+  size_t dequeue_bulk(T* elems, size_t n) {
+    ASSERT_TRUE(blocking);
+    while(1) {
+      size_t ret = try_dequeue_bulk(elems, n);
+      if (ret > 0) return ret;
+      if (closed) return try_dequeue_bulk(elems, n);
+      int seq = not_empty_seq;
+      __sync_fetch_and_add(&empty_waiters, 1);
+      __sync_synchronize();
+      ret = try_dequeue_bulk(elems, n);
+      if (ret == 0 && !closed) futex_wait(&not_empty_seq, seq);
+      __sync_fetch_and_sub(&empty_waiters, 1);
+      if (ret > 0) return ret;
+    }
+  }
+
+  /**
+   * Closes the queue. Sleeping producers return false, sleeping consumers
+   * drain the remaining elements and then return.
+   */
+  void close() {
+    closed = true;
+    __sync_synchronize();
+    __sync_fetch_and_add(&not_empty_seq, 1);
+    __sync_fetch_and_add(&not_full_seq, 1);
+    futex_wake_all(&not_empty_seq);
+    futex_wake_all(&not_full_seq);
+  }
+
+  /// Returns true if close() has been called
+  inline bool is_closed() const { return closed; }
+}; // end of mpmc_queue
+
+} // namespace graphlab
+#endif
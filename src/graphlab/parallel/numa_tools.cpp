@@ -0,0 +1,221 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <unistd.h>
+#include <sched.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/numa_tools.hpp>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+  namespace numa_tools {
+
+    void parse_cpulist(const std::string& str, std::vector<size_t>& cpus) {
+      std::stringstream strm(str);
+      std::string range;
+      while(std::getline(strm, range, ',')) {
+        if (range.empty()) continue;
+        size_t begin = 0, end = 0;
+        int nread = sscanf(range.c_str(), "%zu-%zu", &begin, &end);
+        if (nread == 1) end = begin;
+        else if (nread != 2) continue;
+        for (size_t c = begin; c <= end; ++c) cpus.push_back(c);
+      }
+    }
+
+    std::vector<std::vector<size_t> > discover_nodes(const std::string& node_dir,
+                                                     size_t ncpus) {
+      std::vector<std::vector<size_t> > node_cpus;
+      // node ids are not necessarily contiguous, but in practice are.
+      // stop at the first missing node.
+      for (size_t n = 0; ; ++n) {
+        std::stringstream fname;
+        fname << node_dir << "/node" << n << "/cpulist";
+        std::ifstream fin(fname.str().c_str());
+        if (!fin.good()) break;
+        std::string line;
+        std::getline(fin, line);
+        std::vector<size_t> cpus;
+        parse_cpulist(line, cpus);
+        node_cpus.push_back(cpus);
+      }
+      // drop memory-only nodes from the end
+      while(!node_cpus.empty() && node_cpus.back().empty()) {
+        node_cpus.pop_back();
+      }
+      if (node_cpus.empty()) {
+        // no numa information. one node with every cpu
+        node_cpus.resize(1);
+        for (size_t i = 0;i < std::max<size_t>(ncpus, 1); ++i) node_cpus[0].push_back(i);
+      }
+      return node_cpus;
+    }
+
+    namespace {
+      struct topology {
+        // cpus of each node
+        std::vector<std::vector<size_t> > node_cpus;
+        // node of each cpu
+        std::vector<size_t> cpu_node;
+
+        topology() {
+#ifdef __linux__
+          node_cpus = discover_nodes("/sys/devices/system/node", thread::cpu_count());
+#else
+          node_cpus = discover_nodes("", thread::cpu_count());
+#endif
+          for (size_t n = 0;n < node_cpus.size(); ++n) {
+            for (size_t i = 0;i < node_cpus[n].size(); ++i) {
+              size_t cpu = node_cpus[n][i];
+              if (cpu >= cpu_node.size()) cpu_node.resize(cpu + 1, 0);
+              cpu_node[cpu] = n;
+            }
+          }
+        }
+      };
+
+      topology& get_topology() {
+        static topology topo;
+        return topo;
+      }
+    } // anonymous namespace
+
+
+    size_t num_nodes() {
+      return get_topology().node_cpus.size();
+    }
+
+    const std::vector<size_t>& node_cpus(size_t node) {
+      return get_topology().node_cpus[node % num_nodes()];
+    }
+
+    size_t cpu_to_node(size_t cpu) {
+      const std::vector<size_t>& cpu_node = get_topology().cpu_node;
+      return cpu < cpu_node.size() ? cpu_node[cpu] : 0;
+    }
+
+    size_t current_node() {
+#ifdef __linux__
+      int cpu = sched_getcpu();
+      if (cpu >= 0) return cpu_to_node(cpu);
+#endif
+      return 0;
+    }
+
+    bool pin_current_thread(size_t node) {
+#ifdef HAS_SET_AFFINITY
+      const std::vector<size_t>& cpus = node_cpus(node);
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      for (size_t i = 0;i < cpus.size(); ++i) {
+        CPU_SET(cpus[i] % CPU_SETSIZE, &cpu_set);
+      }
+      return pthread_setaffinity_np(pthread_self(), 
+                                    sizeof(cpu_set), &cpu_set) == 0;
+#else
+      return false;
+#endif
+    }
+  } // namespace numa_tools
+
+
+
+  numa_thread_pools::numa_thread_pools(size_t threads_per_node) {
+    size_t nnodes = numa_tools::num_nodes();
+    for (size_t n = 0;n < nnodes; ++n) {
+      const std::vector<size_t>& cpus = numa_tools::node_cpus(n);
+      size_t nthreads = threads_per_node;
+      if (nthreads == 0) nthreads = std::max<size_t>(cpus.size(), 1);
+      // only pin when there is more than one node to choose from
+      if (nnodes > 1) pools.push_back(new thread_pool(nthreads, cpus));
+      else pools.push_back(new thread_pool(nthreads));
+    }
+  }
+
+  numa_thread_pools::~numa_thread_pools() {
+    for (size_t i = 0;i < pools.size(); ++i) delete pools[i];
+  }
+
+  void numa_thread_pools::launch(size_t node, 
+                                 const boost::function<void (void)>& fn) {
+    pool(node).launch(fn);
+  }
+
+  namespace {
+    struct run_on_node_state {
+      const boost::function<void (void)>* fn;
+      const char* error;
+      bool done;
+      mutex mut;
+      conditional cond;
+    };
+
+    void run_on_node_task(run_on_node_state* state) {
+      const char* error = NULL;
+      try {
+        (*state->fn)();
+      } catch (const char* ex) {
+        error = ex;
+      }
+      state->mut.lock();
+      state->error = error;
+      state->done = true;
+      state->cond.signal();
+      state->mut.unlock();
+    }
+  }
+
+  void numa_thread_pools::run_on_node(size_t node, 
+                                      const boost::function<void (void)>& fn) {
+    thread_pool& p = pool(node);
+    if (pools.size() == 1 || p.is_pool_thread()) {
+      fn();
+      return;
+    }
+    run_on_node_state state;
+    state.fn = &fn;
+    state.error = NULL;
+    state.done = false;
+    p.launch(boost::bind(run_on_node_task, &state));
+    state.mut.lock();
+    while (!state.done) state.cond.wait(state.mut);
+    state.mut.unlock();
+    if (state.error != NULL) throw(state.error);
+  }
+
+  void numa_thread_pools::join() {
+    for (size_t i = 0;i < pools.size(); ++i) pools[i]->join();
+  }
+
+  numa_thread_pools& numa_thread_pools::get_instance() {
+    static numa_thread_pools instance;
+    return instance;
+  }
+
+} // namespace graphlab
@@ -0,0 +1,155 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_NUMA_TOOLS_HPP
+#define GRAPHLAB_NUMA_TOOLS_HPP
+
+#include <vector>
+#include <string>
+#include <boost/function.hpp>
+#include <graphlab/parallel/thread_pool.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * Functions for discovering the NUMA topology of the machine and
+   * for placing threads and memory on particular NUMA nodes.
+   *
+   * The topology is read once from /sys/devices/system/node. On systems
+   * without NUMA support (or non-Linux systems) the machine is reported
+   * as a single node containing every cpu, and pinning degrades to
+   * ordinary thread launches. Memory is placed by the kernel's first
+   * touch policy: data allocated and first written by a thread pinned to
+   * a node lives on that node.
+   */
+  namespace numa_tools {
+
+    /**
+     * Returns the number of NUMA nodes on this machine. Always at least 1.
+     */
+    size_t num_nodes();
+
+    /**
+     * Returns the ids of the cpus belonging to the given node.
+     */
+    const std::vector<size_t>& node_cpus(size_t node);
+
+    /**
+     * Returns the node owning the given cpu. Unknown cpus map to node 0.
+     */
+    size_t cpu_to_node(size_t cpu);
+
+    /**
+     * Returns the node of the cpu the calling thread is currently
+     * running on.
+     */
+    size_t current_node();
+
+    /**
+     * Restricts the calling thread to the cpus of the given node.
+     * Returns false if the affinity could not be set.
+     */
+    bool pin_current_thread(size_t node);
+
+    /**
+     * Parses a cpulist of the form "0-7,16-23" (the format of
+     * /sys/devices/system/node/node<n>/cpulist), appending the cpus to
+     * cpus. Malformed ranges are skipped.
+     */
+    void parse_cpulist(const std::string& str, std::vector<size_t>& cpus);
+
+    /**
+     * Reads the cpus of each node from the node<n>/cpulist files of
+     * node_dir. If node_dir has no nodes (no NUMA support, or not Linux)
+     * a single node with cpus [0, ncpus) is returned. Trailing nodes
+     * without cpus are dropped.
+     */
+    std::vector<std::vector<size_t> > discover_nodes(const std::string& node_dir,
+                                                     size_t ncpus);
+
+    /**
+     * Returns the node owning a shard (or any other partition id).
+     * Partitions are striped across the nodes.
+     */
+    inline size_t partition_to_node(size_t partition) {
+      return partition % num_nodes();
+    }
+  } // namespace numa_tools
+
+
+  /**
+   * \ingroup util
+   * A collection of thread pools, one per NUMA node, with every thread
+   * of a pool pinned to the cpus of its node. Work which touches memory
+   * owned by a node (for instance a shard whose storage was allocated
+   * on that node) can be routed to that node's pool, and memory
+   * allocated by such work is placed on the node by the first-touch
+   * policy.
+   */
+  class numa_thread_pools {
+   private:
+    std::vector<thread_pool*> pools;
+
+    // not copyable
+    numa_thread_pools(const numa_thread_pools&);
+    numa_thread_pools& operator=(const numa_thread_pools&);
+   public:
+    /**
+     * Creates one pool per node. If threads_per_node is 0, each pool has
+     * as many threads as its node has cpus.
+     */
+    numa_thread_pools(size_t threads_per_node = 0);
+
+    ~numa_thread_pools();
+
+    /// Returns the number of pools (equal to the number of nodes)
+    inline size_t size() const { return pools.size(); }
+
+    /// Returns the pool of the given node
+    inline thread_pool& pool(size_t node) { return *pools[node % pools.size()]; }
+
+    /// Launches a task on a thread of the given node
+    void launch(size_t node, const boost::function<void (void)>& fn);
+
+    /**
+     * Runs fn on a thread of the given node and waits for it to complete.
+     * A const char* exception thrown by fn is rethrown in the caller.
+     * If the caller is itself a thread of the node's pool, fn is run
+     * inline.
+     */
+    void run_on_node(size_t node, const boost::function<void (void)>& fn);
+
+    /// Waits for all tasks on all nodes. Exceptions are forwarded.
+    void join();
+
+    /**
+     * Returns a process wide instance. The instance is created on first
+     * use.
+     */
+    static numa_thread_pools& get_instance();
+  };
+
+} // namespace graphlab
+#endif
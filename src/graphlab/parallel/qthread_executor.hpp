@@ -0,0 +1,77 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_PARALLEL_QTHREAD_EXECUTOR_HPP
+#define GRAPHLAB_PARALLEL_QTHREAD_EXECUTOR_HPP
+#include <qthread.h>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/qthread_tools.hpp>
+#include <graphlab/parallel/future.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * Runs functions as qthreads of a \ref qthread_group.
+   * qthread_tools::init() must have been called.
+   */
+  class qthread_executor: public executor {
+   private:
+    qthread_group& group;
+   public:
+    qthread_executor(qthread_group& group): group(group) { }
+    void execute(const boost::function<void (void)>& fn) { group.launch(fn); }
+  };
+
+  namespace future_impl {
+    inline void qthread_fill_feb(aligned_t* feb) {
+      qthread_fill(feb);
+    }
+  } // namespace future_impl
+
+  /**
+   * Waits for a future from inside a qthread. Unlike future::wait(), which
+   * blocks the underlying worker pthread, this suspends only the calling
+   * qthread on a full/empty bit, so the worker can run other qthreads
+   * while the result is outstanding.
+   */
+  template <typename T>
+  void qthread_wait(const future<T>& f) {
+    if (f.is_ready()) return;
+    aligned_t feb;
+    qthread_empty(&feb);
+    f.on_ready(boost::bind(future_impl::qthread_fill_feb, &feb));
+    qthread_readFF(NULL, &feb);
+  }
+
+  /**
+   * Waits for a future from inside a qthread and returns its value.
+   * Throws the error if the future failed.
+   */
+  template <typename T>
+  const T& qthread_get(const future<T>& f) {
+    qthread_wait(f);
+    return f.get();
+  }
+
+} // namespace graphlab
+#endif
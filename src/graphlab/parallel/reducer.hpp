@@ -0,0 +1,190 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_PARALLEL_REDUCER_HPP
+#define GRAPHLAB_PARALLEL_REDUCER_HPP
+#include <pthread.h>
+#include <vector>
+#include <limits>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/cache_line_pad.hpp>
+
+namespace graphlab {
+
+  /// Reduction operation for \ref reducer computing a sum
+  template <typename T>
+  struct reducer_sum {
+    static T identity() { return T(0); }
+    static void combine(T& acc, const T& val) { acc += val; }
+  };
+
+  /// Reduction operation for \ref reducer computing a minimum
+  template <typename T>
+  struct reducer_min {
+    static T identity() {
+      return std::numeric_limits<T>::has_infinity ?
+          std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+    }
+    static void combine(T& acc, const T& val) { if (val < acc) acc = val; }
+  };
+
+  /// Reduction operation for \ref reducer computing a maximum
+  template <typename T>
+  struct reducer_max {
+    static T identity() {
+      return std::numeric_limits<T>::has_infinity ?
+          -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::min();
+    }
+    static void combine(T& acc, const T& val) { if (val > acc) acc = val; }
+  };
+
+
+  namespace reducer_impl {
+    /**
+     * Returns a small integer identifying the calling thread, assigned on
+     * first use. Used to spread threads over the reducer slots.
+     *
+     * Indices are never recycled: a process creating threads over and over
+     * keeps getting new, growing indices. Users must map them onto a fixed
+     * number of slots (as reducer does, by masking) rather than index an
+     * array by them.
+     */
+    inline size_t thread_index() {
+      struct key_holder {
+        pthread_key_t key;
+        key_holder() { pthread_key_create(&key, NULL); }
+      };
+      static key_holder holder;
+      static atomic<size_t> next_index;
+      size_t idx = reinterpret_cast<size_t>(pthread_getspecific(holder.key));
+      if (idx == 0) {
+        idx = next_index.inc();
+        pthread_setspecific(holder.key, reinterpret_cast<void*>(idx));
+      }
+      return idx - 1;
+    }
+  } // namespace reducer_impl
+
+
+  /**
+   * \ingroup util
+   * A contention free accumulator for global aggregates and counters.
+   *
+   * Every thread accumulates into its own cache line padded slot, so
+   * concurrent updates never bounce a shared cache line as a single
+   * atomic<T> (and in particular the CAS loop of atomic<double>) does.
+   * Slots are merged only when the value is read, which makes reads
+   * O(number of slots): use it for values written often and read rarely.
+   *
+   * Op defines the monoid: a static identity() and a static
+   * combine(T& acc, const T& val) which must be associative and
+   * commutative. reducer_sum, reducer_min and reducer_max are provided.
+   *
+   * \code
+   * reducer<double> loss;                         // sum
+   * reducer<size_t, reducer_max<size_t> > peak;   // max
+   * loss += 0.5;             // from any thread
+   * peak.reduce(queue_len);
+   * double total = loss.value();
+   * \endcode
+   *
+   * If there are more threads than slots, threads share slots; each slot
+   * is guarded by a spinlock which is uncontended in the common case.
+   */
+  template <typename T, typename Op = reducer_sum<T> >
+  class reducer {
+   private:
+    struct slot {
+      simple_spinlock lock;
+      T value;
+      slot(): value(Op::identity()) { }
+    };
+    std::vector<cache_line_pad<slot> > slots;
+    size_t mask;
+
+    // not copyable
+    reducer(const reducer&);
+    reducer& operator=(const reducer&);
+
+   public:
+    /**
+     * Creates a reducer with at least num_slots slots (rounded up to a power
+     * of two). If num_slots is 0, two slots per cpu are used.
+     */
+    explicit reducer(size_t num_slots = 0) {
+      if (num_slots == 0) num_slots = 2 * thread::cpu_count();
+      size_t n = 1;
+      while (n < num_slots) n *= 2;
+      slots.resize(n);
+      mask = n - 1;
+    }
+
+    /// Combines val into the calling thread's slot
+    inline void reduce(const T& val) {
+      slot& s = slots[reducer_impl::thread_index() & mask].value;
+      s.lock.lock();
+      Op::combine(s.value, val);
+      s.lock.unlock();
+    }
+
+    /// Same as reduce(val)
+    inline reducer& operator+=(const T& val) {
+      reduce(val);
+      return *this;
+    }
+
+    /// Returns the combination of all the slots
+    T value() const {
+      T ret = Op::identity();
+      for (size_t i = 0;i < slots.size(); ++i) {
+        const slot& s = slots[i].value;
+        s.lock.lock();
+        Op::combine(ret, s.value);
+        s.lock.unlock();
+      }
+      return ret;
+    }
+
+    operator T() const { return value(); }
+
+    /// Resets all the slots to the identity
+    void clear() {
+      for (size_t i = 0;i < slots.size(); ++i) {
+        slot& s = slots[i].value;
+        s.lock.lock();
+        s.value = Op::identity();
+        s.lock.unlock();
+      }
+    }
+
+    /// Same as clear() followed by reduce(val)
+    reducer& operator=(const T& val) {
+      clear();
+      reduce(val);
+      return *this;
+    }
+  }; // end of reducer
+
+} // namespace graphlab
+#endif
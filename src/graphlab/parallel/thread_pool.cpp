@@ -22,45 +22,57 @@
 
 
 
+#include <sched.h>
 #include <graphlab/parallel/thread_pool.hpp>
 #include <graphlab/logger/assertions.hpp>
 
 namespace graphlab {
 
+  // Thread local pointer to the worker_state of the calling thread ======>
+  struct thread_pool_keys {
+    pthread_key_t WORKER_KEY;
+    thread_pool_keys() : WORKER_KEY(0) {
+      pthread_key_create(&WORKER_KEY, NULL);
+    }
+  };
+  static pthread_key_t get_worker_key() {
+    static thread_pool_keys keys;
+    return keys.WORKER_KEY;
+  }
+  // This forces get_worker_key to be called prior to main.
+  static pthread_key_t __unused_init_worker_key__(get_worker_key());
+  // ===================================================================>
+
 
   thread_pool::thread_pool(size_t nthreads, bool affinity) {
     waiting_on_join = false;
-    tasks_inserted = 0;
-    tasks_completed = 0;
+    num_sleeping = 0;
+    alive = true;
     cpu_affinity = affinity;
     pool_size = nthreads;
     spawn_thread_group();
   } // end of thread_pool
 
 
+  thread_pool::thread_pool(size_t nthreads, const std::vector<size_t>& cpus) {
+    waiting_on_join = false;
+    num_sleeping = 0;
+    alive = true;
+    cpu_affinity = !cpus.empty();
+    cpu_list = cpus;
+    pool_size = nthreads;
+    spawn_thread_group();
+  } // end of thread_pool
+
+
   void thread_pool::resize(size_t nthreads) {
     // if the current pool size does not equal the requested number of
     // threads shut the pool down and startup with correct number of
     // threads.  \todo: If the pool size is too small just add
     // additional threads rather than destroying the pool
     if(nthreads != pool_size) {
+      destroy_all_threads();
       pool_size = nthreads;
-
-      // stop the queue from blocking
-      spawn_queue.stop_blocking();
-    
-      // join the threads in the thread group
-      while(true) {
-        try {
-          threads.join(); break;
-        } catch (const char* error_str) {
-          // this should not be possible!
-          logstream(LOG_FATAL) 
-            << "Unexpected exception caught in thread pool destructor: " 
-            << error_str << std::endl;
-        }
-      }
-      spawn_queue.start_blocking();
       spawn_thread_group();
     }
   } // end of set_nthreads
@@ -73,14 +85,25 @@ namespace graphlab {
      Creates the thread group
   */
   void thread_pool::spawn_thread_group() {
+    ASSERT_GT(pool_size, 0);
+    alive = true;
+    workers.resize(pool_size);
+    for (size_t i = 0;i < pool_size; ++i) {
+      workers[i] = new worker_state(this, i);
+    }
     size_t ncpus = thread::cpu_count();
     // start all the threads if CPU affinity is set
     for (size_t i = 0;i < pool_size; ++i) {
-      if (cpu_affinity) {
-        threads.launch(boost::bind(&thread_pool::wait_for_task, this), i % ncpus);
+      if (cpu_affinity && !cpu_list.empty()) {
+        threads.launch(boost::bind(&thread_pool::wait_for_task, this, i), 
+                       cpu_list[i % cpu_list.size()]);
+      }
+      else if (cpu_affinity) {
+        threads.launch(boost::bind(&thread_pool::wait_for_task, this, i), 
+                       i % ncpus);
       }
       else {
-        threads.launch(boost::bind(&thread_pool::wait_for_task, this));
+        threads.launch(boost::bind(&thread_pool::wait_for_task, this, i));
       }
     }
   } // end of spawn_thread_group
@@ -88,9 +111,12 @@ namespace graphlab {
 
   void thread_pool::destroy_all_threads() {
     // wait for all execution to complete
-    spawn_queue.wait_until_empty();
-    // kill the queue
-    spawn_queue.stop_blocking();
+    wait_for_pending();
+    // wake everyone up and tell them to quit
+    idle_mut.lock();
+    alive = false;
+    idle_cond.broadcast();
+    idle_mut.unlock();
   
     // join the threads in the thread group
     while(1) {
@@ -106,86 +132,263 @@ namespace graphlab {
         ASSERT_TRUE(false);
       }
     }
+    for (size_t i = 0;i < workers.size(); ++i) delete workers[i];
+    workers.clear();
   } // end of destroy_all_threads
 
   void thread_pool::set_cpu_affinity(bool affinity) {
     if (affinity != cpu_affinity) {
+      destroy_all_threads();
       cpu_affinity = affinity;
-      // stop the queue from blocking
-      spawn_queue.stop_blocking();
-    
-      // join the threads in the thread group
-      while(1) {
-        try {
-          threads.join(); break;
-        } catch (const char* c) {
-          // this should not be possible!
-          logstream(LOG_FATAL) 
-            << "Unexpected exception caught in thread pool destructor: " 
-            << c << std::endl;
-          // ASSERT_TRUE(false); // unnecessary
-        }
-      }
-      spawn_queue.start_blocking();
+      if (!affinity) cpu_list.clear();
       spawn_thread_group();
     }
   } // end of set_cpu_affinity
 
-      
-  void thread_pool::wait_for_task() {
-    while(1) {
-      std::pair<std::pair<boost::function<void (void)>, int>, bool> queue_entry;
-      // pop from the queue
-      queue_entry = spawn_queue.dequeue();
-      if (queue_entry.second) {
-        // try to run the function. remember to put it in a try catch
-        try {
-          int virtual_thread_id = queue_entry.first.second;
-          size_t cur_thread_id = thread::thread_id();
-          if (virtual_thread_id != -1) {
-            thread::set_thread_id(virtual_thread_id);
-          }
-          queue_entry.first.first();
-          thread::set_thread_id(cur_thread_id);
-        } catch(const char* ex) {
-          // if an exception was raised, put it in the exception queue
-          mut.lock();
-          exception_queue.push(ex);
-          event_condition.signal();
-          mut.unlock();
-        }
-      
+
+  thread_pool::worker_state* thread_pool::current_worker() {
+    worker_state* w = 
+      reinterpret_cast<worker_state*>(pthread_getspecific(get_worker_key()));
+    if (w != NULL && w->pool == this) return w;
+    return NULL;
+  }
+
+
+  thread_pool::task* thread_pool::steal_task(worker_state* self) {
+    const size_t n = workers.size();
+    size_t start;
+    if (self != NULL) {
+      // xorshift to pick a random victim
+      self->rng ^= self->rng << 13;
+      self->rng ^= self->rng >> 7;
+      self->rng ^= self->rng << 17;
+      start = self->rng % n;
+    } else {
+      start = next_inbox.value.inc_ret_last() % n;
+    }
+    for (size_t i = 0;i < n; ++i) {
+      worker_state* victim = workers[(start + i) % n];
+      if (victim == self) continue;
+      task* t = victim->local.steal();
+      if (t != NULL) return t;
+      t = take_from_inbox(victim);
+      if (t != NULL) return t;
+    }
+    return NULL;
+  }
+
+
+  thread_pool::task* thread_pool::take_from_inbox(worker_state* w) {
+    task* t = NULL;
+    if (w->inbox.try_dequeue(t)) return t;
+    if (w->overflow_size > 0) {
+      w->overflow_lock.lock();
+      if (!w->overflow.empty()) {
+        t = w->overflow.front();
+        w->overflow.pop_front();
+        w->overflow_size = w->overflow.size();
+      }
+      w->overflow_lock.unlock();
+    }
+    return t;
+  }
+
+
+  thread_pool::task* thread_pool::find_task(worker_state* self) {
+    task* t = self->local.pop();
+    if (t != NULL) return t;
+    t = take_from_inbox(self);
+    if (t != NULL) return t;
+    // a few rounds of stealing before giving up
+    for (size_t i = 0;i < 4; ++i) {
+      t = steal_task(self);
+      if (t != NULL) return t;
+      asm volatile("pause\n": : :"memory");
+    }
+    return NULL;
+  }
+
+
+  bool thread_pool::has_pending_work() {
+    for (size_t i = 0;i < workers.size(); ++i) {
+      if (!workers[i]->local.empty() || !workers[i]->inbox.empty() ||
+          workers[i]->overflow_size > 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+
+  void thread_pool::wake_one() {
+    // pairs with the increment of num_sleeping in wait_for_task: either
+    // the sleeper sees the new task, or we see the sleeper.
+    __sync_synchronize();
+    if (num_sleeping > 0) {
+      idle_mut.lock();
+      idle_cond.signal();
+      idle_mut.unlock();
+    }
+  }
+
+
+  void thread_pool::run_task(task* t) {
+    // try to run the function. remember to put it in a try catch
+    try {
+      int virtual_thread_id = t->virtual_threadid;
+      size_t cur_thread_id = thread::thread_id();
+      if (virtual_thread_id != -1) {
+        thread::set_thread_id(virtual_thread_id);
+      }
+      t->fn();
+      thread::set_thread_id(cur_thread_id);
+    } catch(const char* ex) {
+      // if an exception was raised, put it in the exception queue
+      mut.lock();
+      exception_queue.push(ex);
+      event_condition.signal();
+      mut.unlock();
+    }
+    delete t;
+
+    if (tasks_pending.value.dec() == 0) {
+      // the waiting on join flag just prevents me from 
+      // signaling every time the pool drains, which could be very
+      // very often
+      if (waiting_on_join) {
         mut.lock();
-        tasks_completed++;
-        // the waiting on join flag just prevents me from 
-        // signaling every time completed == inserted. Which could be very
-        // very often
-        if (waiting_on_join && 
-            tasks_completed == tasks_inserted) event_condition.signal();
+        event_condition.signal();
         mut.unlock();
       }
-      else {
-        // quit if the queue is dead
-        break;
+    }
+  }
+
+      
+  void thread_pool::wait_for_task(size_t worker_id) {
+    worker_state* self = workers[worker_id];
+    pthread_setspecific(get_worker_key(), self);
+    while(1) {
+      task* t = find_task(self);
+      if (t != NULL) {
+        run_task(t);
+        continue;
       }
+      // nothing to do. go to sleep
+      idle_mut.lock();
+      __sync_fetch_and_add(&num_sleeping, 1);
+      while (alive && !has_pending_work()) idle_cond.wait(idle_mut);
+      __sync_fetch_and_sub(&num_sleeping, 1);
+      bool quit = !alive && !has_pending_work();
+      idle_mut.unlock();
+      // quit if the pool is dead
+      if (quit) break;
     }
+    pthread_setspecific(get_worker_key(), NULL);
   } // end of wait_for_task
 
+
   void thread_pool::launch(const boost::function<void (void)> &spawn_function, 
                            int thread_id) {
+    task* t = new task(spawn_function, thread_id);
+    tasks_pending.value.inc();
+    worker_state* self = current_worker();
+    if (self != NULL) {
+      self->local.push(t);
+    } else {
+      worker_state* target = 
+        workers[next_inbox.value.inc_ret_last() % workers.size()];
+      if (!target->inbox.try_enqueue(t)) {
+        target->overflow_lock.lock();
+        target->overflow.push_back(t);
+        target->overflow_size = target->overflow.size();
+        target->overflow_lock.unlock();
+      }
+    }
+    wake_one();
+  }
+
+
+  void thread_pool::run_range(parallel_for_state* state, 
+                              size_t begin, size_t end) {
+    // split off the upper half until the range is small enough
+    while (end - begin > state->grain) {
+      size_t mid = begin + (end - begin) / 2;
+      state->remaining.inc();
+      launch(boost::bind(&thread_pool::run_range, this, state, mid, end));
+      end = mid;
+    }
+    try {
+      state->fn(begin, end);
+    } catch (const char* ex) {
+      // read by the caller once it observes done under the same lock
+      state->mut.lock();
+      state->error = ex;
+      state->mut.unlock();
+    }
+    if (state->remaining.dec() == 0) {
+      // the caller may only release the state once it observes done
+      // under the lock
+      state->mut.lock();
+      state->done = true;
+      state->cond.signal();
+      state->mut.unlock();
+    }
+  }
+
+
+  void thread_pool::parallel_for(size_t begin, size_t end,
+                                 const boost::function<void (size_t, size_t)>& fn,
+                                 size_t grain) {
+    if (begin >= end) return;
+    parallel_for_state state;
+    state.fn = fn;
+    state.grain = grain;
+    if (state.grain == 0) {
+      state.grain = std::max<size_t>((end - begin) / (8 * pool_size), 1);
+    }
+    state.remaining.value = 1;
+    state.error = NULL;
+    state.done = false;
+    run_range(&state, begin, end);
+
+    // help out while waiting for the remaining sub-ranges
+    worker_state* self = current_worker();
+    while(1) {
+      if (state.remaining.value > 0) {
+        task* t = (self != NULL) ? find_task(self) : steal_task(NULL);
+        if (t != NULL) {
+          run_task(t);
+          continue;
+        }
+      }
+      state.mut.lock();
+      if (!state.done) state.cond.timedwait_ms(state.mut, 1);
+      bool finished = state.done;
+      const char* error = state.error;
+      state.mut.unlock();
+      if (finished) {
+        if (error != NULL) throw(error);
+        break;
+      }
+    }
+  }
+
+
+  void thread_pool::wait_for_pending() {
     mut.lock();
-    tasks_inserted++;
-    spawn_queue.enqueue(std::make_pair(spawn_function, thread_id));
+    waiting_on_join = true;
+    __sync_synchronize();
+    while (tasks_pending.value.value > 0) event_condition.wait(mut);
+    waiting_on_join = false;
     mut.unlock();
   }
 
+
   void thread_pool::join() {
-    std::pair<bool, bool> eventret;
-    // first we wait for the queue to empty
-    spawn_queue.wait_until_empty();
-  
     mut.lock();
     waiting_on_join = true;
+    // pairs with the decrement in run_task
+    __sync_synchronize();
     while(1) {
       // check the exception queue. 
       if (!exception_queue.empty()) {
@@ -198,7 +401,7 @@ namespace graphlab {
         throw(ex);
       }
       // nothing to throw, check if all tasks were completed
-      if (tasks_completed == tasks_inserted) {
+      if (tasks_pending.value.value == 0) {
         // yup
         break;
       }
@@ -27,9 +27,13 @@
 #ifndef GRAPHLAB_THREAD_POOL_HPP
 #define GRAPHLAB_THREAD_POOL_HPP
 
+#include <deque>
 #include <boost/bind.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
-#include <graphlab/util/blocking_queue.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/cache_line_pad.hpp>
+#include <graphlab/parallel/work_stealing_deque.hpp>
+#include <graphlab/parallel/mpmc_queue.hpp>
 
 namespace graphlab {
 
@@ -43,6 +47,13 @@ namespace graphlab {
    * through the "launch" function, threads are woken up to perform the
    * tasks. 
    *
+   * Internally each thread owns a work stealing deque. Tasks launched
+   * from within a task running in the pool are pushed onto the local
+   * deque of the launching thread, and tasks launched from outside the
+   * pool are spread round-robin across per-thread lock free inboxes.
+   * Idle threads steal from the other threads, so there is no single
+   * queue lock on the task path.
+   *
    * The thread_pool object performs limited exception forwarding.
    * exception throws within a thread of type const char* will be caught
    * and forwarded to the join() function.
@@ -55,40 +66,118 @@ namespace graphlab {
    */
   class thread_pool {
   private:
+    // number of externally launched tasks each inbox holds before
+    // spilling to its overflow list
+    static const size_t INBOX_CAPACITY = 1024;
+
+    struct task {
+      boost::function<void (void)> fn;
+      int virtual_threadid;
+      task(const boost::function<void (void)>& fn, int virtual_threadid):
+          fn(fn), virtual_threadid(virtual_threadid) { }
+    };
+
+    /// Per thread state. Padded so that workers do not false share.
+    struct worker_state {
+      thread_pool* pool;
+      size_t id;
+      size_t rng;
+      work_stealing_deque<task> local;
+      // tasks launched from outside the pool
+      mpmc_queue<task*> inbox;
+      // used only when the inbox is full
+      simple_spinlock overflow_lock;
+      std::deque<task*> overflow;
+      volatile size_t overflow_size;
+      char __pad__[64];
+      worker_state(thread_pool* pool, size_t id):
+          pool(pool), id(id), rng(id * 2654435761u + 1),
+          inbox(INBOX_CAPACITY), overflow_size(0) { }
+    };
+
+    /// Shared state of a single parallel_for call
+    struct parallel_for_state {
+      boost::function<void (size_t, size_t)> fn;
+      size_t grain;
+      atomic<size_t> remaining;
+      const char* error;  // protected by mut, like done
+      bool done;
+      mutex mut;
+      conditional cond;
+    };
 
     thread_group threads;
-    blocking_queue<std::pair<boost::function<void (void)>, int> > spawn_queue;
+    std::vector<worker_state*> workers;
     size_t pool_size;
-      
-    // protects the exception queue, and the task counters
+    bool alive;
+
+    // number of tasks launched but not yet completed
+    cache_line_pad<atomic<size_t> > tasks_pending;
+    // round robin counter for tasks launched from outside the pool
+    cache_line_pad<atomic<size_t> > next_inbox;
+
+    // protects the exception queue and the join wakeup
     mutex mut;
     conditional event_condition;  // to wake up the joining thread
     std::queue<const char*> exception_queue;
-    size_t tasks_inserted;
-    size_t tasks_completed;
-    bool waiting_on_join; // true if a thread is waiting in join
+    volatile bool waiting_on_join; // true if a thread is waiting in join
+
+    // idle threads sleep here
+    mutex idle_mut;
+    conditional idle_cond;
+    volatile size_t num_sleeping;
 
     bool cpu_affinity;
+    // if non-empty, thread i is pinned to cpu_list[i % cpu_list.size()]
+    std::vector<size_t> cpu_list;
     // not implemented
     thread_pool& operator=(const thread_pool &thrgrp);
     thread_pool(const thread_pool&);
       
     /**
-       Called by each thread. Loops around a queue of tasks.
+       Called by each thread. Runs tasks from its own deque, its inbox,
+       and steals from the other threads. Sleeps when there is no work.
     */
-    void wait_for_task();
+    void wait_for_task(size_t worker_id);
 
     /**
        Creates all the threads in the thread pool.
-       Resets the task and exception queue
     */
     void spawn_thread_group();
       
     /**
-       Destroys the thread pool.
-       Also destroys the task queue
+       Waits for all outstanding tasks and destroys the threads.
     */
     void destroy_all_threads();
+
+    /// Returns the worker state of the calling thread if it belongs
+    /// to this pool. NULL otherwise.
+    worker_state* current_worker();
+
+    /// Finds a task to run. Returns NULL if none could be found.
+    task* find_task(worker_state* self);
+
+    /// Tries to steal a task from any worker
+    task* steal_task(worker_state* self);
+
+    /// Takes a task from the inbox (or overflow) of w. NULL if empty.
+    task* take_from_inbox(worker_state* w);
+
+    /// Returns true if any deque or inbox appears non-empty
+    bool has_pending_work();
+
+    /// Executes a task and releases it
+    void run_task(task* t);
+
+    /// Blocks until tasks_pending is 0. Does not consume exceptions.
+    void wait_for_pending();
+
+    /// Wakes up a sleeping thread if there is one
+    void wake_one();
+
+    /// Task body used by parallel_for
+    void run_range(parallel_for_state* state, size_t begin, size_t end);
+
   public:
       
     /* Initializes a thread pool with nthreads. 
@@ -96,9 +185,16 @@ namespace graphlab {
      * the available cores on the system. 
      */
     thread_pool(size_t nthreads = 2, bool affinity = false);
+
+    /* Initializes a thread pool with nthreads, where thread i is pinned
+     * to cpus[i % cpus.size()]. Used to confine a pool to the cpus of
+     * one NUMA node. 
+     */
+    thread_pool(size_t nthreads, const std::vector<size_t>& cpus);
     
     /**
-     * Set the number of threads in the queue
+     * Set the number of threads in the queue.
+     * Waits for all outstanding tasks to complete first.
      */
     void resize(size_t nthreads);
     
@@ -121,25 +217,48 @@ namespace graphlab {
        Gets the CPU affinity.
     */
     bool get_cpu_affinity() { return cpu_affinity; };
+
+    /**
+       Returns true if the calling thread is one of the threads of this pool.
+    */
+    bool is_pool_thread() { return current_worker() != NULL; }
   
     /** 
-     * Launch a single thread which calls spawn_function. If affinity
+     * Launch a single task which calls spawn_function. If affinity
      * is set on construction of the thread_pool, the thread handling the
      * function will be locked on to one particular CPU.
      *
+     * If called from a task running inside this pool, the new task is
+     * pushed onto the calling thread's own deque and will be run by it
+     * unless stolen by an idle thread.
+     *
      * If virtual_threadid is set, the target thread will appear to have
      * thread ID equal to the requested thread ID
      */
     void launch(const boost::function<void (void)> &spawn_function, 
                 int virtual_threadid = -1);
-  
+
+    /**
+     * Calls fn(b, e) over disjoint sub-ranges [b, e) covering [begin, end)
+     * in parallel, and returns once all sub-ranges have completed.
+     * The range is split recursively until a sub-range has at most
+     * grain elements. If grain is 0, a grain which produces roughly
+     * 8 sub-ranges per thread is used.
+     *
+     * The calling thread helps execute tasks while waiting, so
+     * parallel_for may be called from within a task of the same pool.
+     * A const char* exception thrown by fn is rethrown here.
+     */
+    void parallel_for(size_t begin, size_t end,
+                      const boost::function<void (size_t, size_t)>& fn,
+                      size_t grain = 0);
   
     /** Waits for all threads to become free. const char* exceptions
         thrown by threads are forwarded to the join() function.
         Once this function returns normally, the queue is empty.
       
         Note that this function may not return if producers continually insert
-        tasks through launch. 
+        tasks through launch. Must not be called from within a task.
     */
     void join();
       
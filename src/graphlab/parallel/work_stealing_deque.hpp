@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_PARALLEL_WORK_STEALING_DEQUE_HPP
+#define GRAPHLAB_PARALLEL_WORK_STEALING_DEQUE_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <graphlab/parallel/atomic_ops.hpp>
+
+namespace graphlab {
+
+/**
+ * \ingroup util
+ * Lock free work stealing deque of pointers.
+ *
+ * Adapted from
+ * "Dynamic Circular Work-Stealing Deque",
+ * David Chase and Yossi Lev, SPAA 2005.
+ *
+ * Only the owning thread may call push() and pop(), which operate on the
+ * bottom of the deque. Any thread may call steal() which takes from the
+ * top. The deque grows as needed; old buffers are retained until the deque
+ * is destroyed since a concurrent thief may still be reading from them.
+ *
+ * The fences assume the x86 memory model (stores are not reordered with
+ * other stores, loads are not reordered with other loads).
+ */
+template <typename T>
+class work_stealing_deque {
+ private:
+  struct circular_array {
+    size_t log_size;
+    T** segment;
+
+    circular_array(size_t log_size): log_size(log_size) {
+      segment = new T*[size()];
+    }
+    ~circular_array() { delete [] segment; }
+
+    inline int64_t size() const { return int64_t(1) << log_size; }
+    inline T* get(int64_t i) const { return segment[i & (size() - 1)]; }
+    inline void put(int64_t i, T* t) { segment[i & (size() - 1)] = t; }
+
+    circular_array* grow(int64_t b, int64_t t) const {
+      circular_array* a = new circular_array(log_size + 1);
+      for (int64_t i = t; i < b; ++i) a->put(i, get(i));
+      return a;
+    }
+  };
+
+  volatile int64_t top;
+  char __pad0__[64 - sizeof(int64_t)];
+  volatile int64_t bottom;
+  char __pad1__[64 - sizeof(int64_t)];
+  circular_array* volatile array;
+  // buffers replaced by grow(). Only touched by the owner.
+  std::vector<circular_array*> retired;
+
+  // not copyable
+  work_stealing_deque(const work_stealing_deque&);
+  work_stealing_deque& operator=(const work_stealing_deque&);
+
+  static inline void compiler_barrier() {
+    asm volatile("" : : : "memory");
+  }
+
+ public:
+  work_stealing_deque(size_t initial_log_size = 8): top(0), bottom(0) {
+    array = new circular_array(initial_log_size);
+  }
+
+  ~work_stealing_deque() {
+    delete array;
+    for (size_t i = 0;i < retired.size(); ++i) delete retired[i];
+  }
+
+  /// Pushes to the bottom of the deque. Must only be called by the owner.
+  void push(T* t) {
+    int64_t b = bottom;
+    int64_t tp = top;
+    circular_array* a = array;
+    if (b - tp > a->size() - 1) {
+      retired.push_back(a);
+      a = a->grow(b, tp);
+      compiler_barrier();
+      array = a;
+    }
+    a->put(b, t);
+    compiler_barrier();
+    bottom = b + 1;
+  }
+
+  /**
+   * Pops from the bottom of the deque. Must only be called by the owner.
+   * Returns NULL if the deque is empty.
+   */
+  T* pop() {
+    int64_t b = bottom - 1;
+    circular_array* a = array;
+    bottom = b;
+    // the store to bottom must be visible before top is read
+    __sync_synchronize();
+    int64_t t = top;
+    if (b < t) {
+      bottom = t;
+      return NULL;
+    }
+    T* ret = a->get(b);
+    if (b > t) return ret;
+    // last element. race against thieves for it
+    if (!atomic_compare_and_swap(top, t, t + 1)) ret = NULL;
+    bottom = t + 1;
+    return ret;
+  }
+
+  /**
+   * Takes from the top of the deque. May be called by any thread.
+   * Returns NULL if the deque is empty or if the steal lost a race
+   * with another thief or the owner.
+   */
+  T* steal() {
+    int64_t t = top;
+    compiler_barrier();
+    int64_t b = bottom;
+    if (t >= b) return NULL;
+    circular_array* a = array;
+    T* ret = a->get(t);
+    if (!atomic_compare_and_swap(top, t, t + 1)) return NULL;
+    return ret;
+  }
+
+  /// Returns true if the deque appears empty. Only a hint when concurrent.
+  inline bool empty() const {
+    return bottom <= top;
+  }
+
+  /// Returns the approximate number of elements in the deque
+  inline size_t size() const {
+    int64_t s = bottom - top;
+    return s > 0 ? size_t(s) : 0;
+  }
+}; // end of work_stealing_deque
+
+} // namespace graphlab
+#endif
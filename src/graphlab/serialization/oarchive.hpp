@@ -32,6 +32,8 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <sys/uio.h>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/serialization/is_pod.hpp>
 #include <graphlab/serialization/has_save.hpp>
@@ -83,18 +85,47 @@ namespace graphlab {
    * To use this class, include 
    * graphlab/serialization/serialization_includes.hpp 
    */
+  /**
+   * \ingroup group_serialization
+   * An external buffer referenced by an oarchive in scatter-gather mode.
+   * The "len" bytes at "data" logically follow the first "off" bytes
+   * of the archive buffer.
+   */
+  struct oarchive_segment {
+    size_t off;
+    const char* data;
+    size_t len;
+  };
+
   class oarchive{
   public:
     std::ostream* out;
     char* buf;
     size_t off;
     size_t len;
+    /**
+     * If not NULL, the archive is in scatter-gather mode: write_ref() of
+     * at least min_ref_len bytes records a reference to the caller's
+     * buffer here instead of copying it. See gather().
+     */
+    std::vector<oarchive_segment>* segments;
+    size_t min_ref_len;
+
     /// constructor. Takes a generic std::ostream object
     inline oarchive(std::ostream& outstream)
-      : out(&outstream),buf(NULL),off(0),len(0) {}
+      : out(&outstream),buf(NULL),off(0),len(0),segments(NULL),min_ref_len(0) {}
 
     inline oarchive(void)
-      : out(NULL),buf(NULL),off(0),len(0) {}
+      : out(NULL),buf(NULL),off(0),len(0),segments(NULL),min_ref_len(0) {}
+
+    /**
+     * Constructs a scatter-gather archive. Writes through write_ref() of
+     * min_ref_len bytes or more are recorded in segs without copying;
+     * those buffers must stay valid and unmodified until the gathered
+     * output has been consumed.
+     */
+    inline oarchive(std::vector<oarchive_segment>& segs, size_t min_ref_len = 1024)
+      : out(NULL),buf(NULL),off(0),len(0),segments(&segs),min_ref_len(min_ref_len) {}
 
     inline void expand_buf(size_t s) {
         if (off + s > len) {
@@ -102,6 +133,20 @@ namespace graphlab {
           buf = (char*)realloc(buf, len);
         }
      }
+
+    /**
+     * Makes room for at least "s" more bytes in the buffer so that a
+     * sequence of writes whose total size is known up front (for instance
+     * from a size estimate pass) costs a single reallocation.
+     * Has no effect when writing to a stream.
+     */
+    inline void reserve(size_t s) {
+      if (out == NULL && off + s > len) {
+        len = off + s;
+        buf = (char*)realloc(buf, len);
+      }
+    }
+
     /** Directly writes "s" bytes from the memory location
      * pointed to by "c" into the stream.
      */
@@ -114,6 +159,55 @@ namespace graphlab {
         out->write(c, s);
       }
     }
+    /**
+     * Like write(), but in scatter-gather mode a large buffer is referenced
+     * instead of copied. Use for payloads which outlive the archive
+     * output, such as the bytes of a string or blob value.
+     */
+    inline void write_ref(const char* c, size_t s) {
+      if (segments != NULL && s >= min_ref_len) {
+        oarchive_segment seg;
+        seg.off = off; seg.data = c; seg.len = s;
+        segments->push_back(seg);
+      } else {
+        write(c, s);
+      }
+    }
+
+    /// The total number of bytes written, including referenced segments
+    inline size_t total_length() const {
+      size_t ret = off;
+      if (segments != NULL) {
+        for (size_t i = 0; i < segments->size(); ++i) ret += (*segments)[i].len;
+      }
+      return ret;
+    }
+
+    /**
+     * Appends the archive contents to iov in order: runs of the archive
+     * buffer interleaved with the referenced segments. The iovecs point
+     * into buf, so the archive must not be written to while they are in use.
+     */
+    inline void gather(std::vector<iovec>& iov) const {
+      size_t pos = 0;
+      size_t nsegs = segments == NULL ? 0 : segments->size();
+      for (size_t i = 0; i < nsegs; ++i) {
+        const oarchive_segment& seg = (*segments)[i];
+        if (seg.len == 0) continue;
+        if (seg.off > pos) {
+          iovec v; v.iov_base = buf + pos; v.iov_len = seg.off - pos;
+          iov.push_back(v);
+          pos = seg.off;
+        }
+        iovec v; v.iov_base = const_cast<char*>(seg.data); v.iov_len = seg.len;
+        iov.push_back(v);
+      }
+      if (off > pos) {
+        iovec v; v.iov_base = buf + pos; v.iov_len = off - pos;
+        iov.push_back(v);
+      }
+    }
+
     template <typename T>
     inline void direct_assign(const T t) {
       if (out == NULL) {
@@ -178,6 +272,14 @@ namespace graphlab {
       oarc->direct_assign(t);
     }
 
+    inline void reserve(size_t s) {
+      oarc->reserve(s);
+    }
+
+    inline void write_ref(const char* c, size_t s) {
+      oarc->write_ref(c, s);
+    }
+
     inline bool fail() {
       return oarc->fail();
     }
@@ -98,6 +98,61 @@ namespace graphlab {
       }
     };
 
+
+    /**
+     * True if a std::pair<T, U> is laid out in memory exactly as the pair
+     * serializer writes it: two PODs back to back with no padding. An array
+     * of such pairs can then be copied in a single block while remaining
+     * byte compatible with the element by element format.
+     */
+    template <typename T, typename U>
+    struct is_packed_pod_pair {
+      BOOST_STATIC_CONSTANT(bool, value =
+                            (gl_is_pod_or_scaler<T>::value &&
+                             gl_is_pod_or_scaler<U>::value &&
+                             sizeof(std::pair<T, U>) == sizeof(T) + sizeof(U)));
+    };
+
+    /// Vector of pairs. Single copy if the pair is packed (e.g. an edge list)
+    template <typename OutArcType, typename T, typename U>
+    struct vector_serialize_impl<OutArcType, std::pair<T, U>, false > {
+      static void exec(OutArcType& oarc, const std::vector<std::pair<T, U> >& vec) {
+        oarc << size_t(vec.size());
+        if (is_packed_pod_pair<T, U>::value) {
+          // serialize_iterator repeats the element count
+          oarc << size_t(vec.size());
+          if (!vec.empty()) {
+            oarc.write(reinterpret_cast<const char*>(&(vec[0])),
+                       sizeof(std::pair<T, U>) * vec.size());
+          }
+        } else {
+          serialize_iterator(oarc, vec.begin(), vec.end());
+        }
+      }
+    };
+
+    /// Vector of pairs. Single copy if the pair is packed (e.g. an edge list)
+    template <typename InArcType, typename T, typename U>
+    struct vector_deserialize_impl<InArcType, std::pair<T, U>, false > {
+      static void exec(InArcType& iarc, std::vector<std::pair<T, U> >& vec){
+        size_t len;
+        iarc >> len;
+        vec.clear();
+        if (is_packed_pod_pair<T, U>::value) {
+          size_t count;
+          iarc >> count;
+          ASSERT_EQ(len, count);
+          vec.resize(len);
+          if (len > 0) {
+            iarc.read(reinterpret_cast<char*>(&(vec[0])),
+                      sizeof(std::pair<T, U>) * len);
+          }
+        } else {
+          vec.reserve(len);
+          deserialize_iterator<InArcType, std::pair<T, U> >(iarc, std::inserter(vec, vec.end()));
+        }
+      }
+    };
     
     
     /**
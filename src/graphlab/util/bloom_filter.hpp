@@ -23,12 +23,20 @@
 
 #ifndef BLOOM_FILTER_HPP
 #define BLOOM_FILTER_HPP
+#include <stdint.h>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <new>
 #include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/logger/assertions.hpp>
 
 template <size_t len, size_t probes>
 class fixed_bloom_filter {
  private:
-  fixed_dense_bitset<len> bits;
+  graphlab::fixed_dense_bitset<len> bits;
  public:
   inline fixed_bloom_filter() { }
   
@@ -53,4 +61,162 @@ class fixed_bloom_filter {
 
 };
 
+namespace graphlab {
+
+/**
+ * \ingroup util
+ * A bloom filter over 64 bit keys, sized at runtime.
+ *
+ * The filter is blocked: a key hashes to one 64 byte block (a cache
+ * line, the blocks are cache line aligned) and sets num_probes bits
+ * inside it, so insert() and may_contain() touch a single cache line.
+ * This costs a slightly higher false positive rate than an unblocked
+ * filter of the same size (about 1% at 10 bits per element instead of
+ * 0.8%).
+ *
+ * Filters with the same geometry (same number of blocks and probes, e.g.
+ * built with the same constructor arguments) can be merged, giving the
+ * filter of the union of their keys. Filters are serializable, e.g. for
+ * a shard to publish the set of vertices it holds.
+ *
+ * insert() is not thread safe. may_contain() is safe as long as no
+ * thread inserts.
+ */
+class bloom_filter {
+ public:
+  static const size_t BLOCK_BITS = 512;
+  static const size_t BLOCK_WORDS = BLOCK_BITS / 64;
+
+  /**
+   * Creates a filter for expected_elements keys with bits_per_element
+   * bits each. The number of probes is chosen to minimize the false
+   * positive rate at that load.
+   */
+  explicit bloom_filter(size_t expected_elements = 0,
+                        double bits_per_element = 10)
+      : words(NULL), num_blocks(0), num_probes(0) {
+    size_t bits = size_t(std::ceil(expected_elements * bits_per_element));
+    size_t probes = size_t(bits_per_element * 0.693 + 0.5);
+    resize((bits + BLOCK_BITS - 1) / BLOCK_BITS, std::max<size_t>(probes, 1));
+  }
+
+  bloom_filter(const bloom_filter& other)
+      : words(NULL), num_blocks(0), num_probes(0) {
+    *this = other;
+  }
+
+  bloom_filter& operator=(const bloom_filter& other) {
+    if (this != &other) {
+      resize(other.num_blocks, other.num_probes);
+      memcpy(words, other.words, size_bytes());
+    }
+    return *this;
+  }
+
+  ~bloom_filter() { free(words); }
+
+  inline void insert(uint64_t key) {
+    uint64_t h = mix(key);
+    uint64_t* block = words + block_of(h) * BLOCK_WORDS;
+    uint64_t g = h * 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0;i < num_probes; ++i) {
+      size_t bit = probe(g, i);
+      block[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+  }
+
+  /// Returns false if the key was definitely not inserted
+  inline bool may_contain(uint64_t key) const {
+    uint64_t h = mix(key);
+    const uint64_t* block = words + block_of(h) * BLOCK_WORDS;
+    uint64_t g = h * 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0;i < num_probes; ++i) {
+      size_t bit = probe(g, i);
+      if ((block[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) return false;
+    }
+    return true;
+  }
+
+  /**
+   * Adds the keys of other to this filter. Both filters must have the
+   * same number of blocks and probes.
+   */
+  void merge(const bloom_filter& other) {
+    ASSERT_EQ(num_blocks, other.num_blocks);
+    ASSERT_EQ(num_probes, other.num_probes);
+    for (size_t i = 0;i < num_blocks * BLOCK_WORDS; ++i) words[i] |= other.words[i];
+  }
+
+  /// Removes all the keys
+  void clear() { memset(words, 0, size_bytes()); }
+
+  size_t size_bytes() const { return num_blocks * BLOCK_BITS / 8; }
+
+  /// Returns the fraction of the bits which are set
+  double fill_ratio() const {
+    size_t set = 0;
+    for (size_t i = 0;i < num_blocks * BLOCK_WORDS; ++i) {
+      set += __builtin_popcountll(words[i]);
+    }
+    return double(set) / (num_blocks * BLOCK_BITS);
+  }
+
+  void save(oarchive& oarc) const {
+    oarc << num_blocks << num_probes;
+    oarc.write(reinterpret_cast<const char*>(words), size_bytes());
+  }
+
+  void load(iarchive& iarc) {
+    size_t blocks, probes;
+    iarc >> blocks >> probes;
+    resize(blocks, probes);
+    iarc.read(reinterpret_cast<char*>(words), size_bytes());
+  }
+
+ private:
+  uint64_t* words;
+  size_t num_blocks;
+  size_t num_probes;
+
+  // allocates num_blocks (at least 1) cleared, cache line aligned blocks
+  void resize(size_t blocks, size_t probes) {
+    blocks = std::max<size_t>(blocks, 1);
+    if (blocks != num_blocks) {
+      free(words);
+      words = NULL;
+      num_blocks = 0;
+      void* ptr = NULL;
+      if (posix_memalign(&ptr, 64, blocks * BLOCK_BITS / 8) != 0) {
+        throw std::bad_alloc();
+      }
+      words = reinterpret_cast<uint64_t*>(ptr);
+      num_blocks = blocks;
+    }
+    num_probes = probes;
+    clear();
+  }
+
+  // 64 bit finalizer of MurmurHash3, so that sequential keys spread
+  static inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  inline size_t block_of(uint64_t h) const {
+    return size_t(((h >> 32) * num_blocks) >> 32);
+  }
+
+  // 9 bits of g per probe, rehashing every 7 probes
+  static inline size_t probe(uint64_t& g, size_t i) {
+    if (i > 0 && i % 7 == 0) g = mix(g);
+    return size_t(g >> ((i % 7) * 9)) & (BLOCK_BITS - 1);
+  }
+};
+
+} // namespace graphlab
+
 #endif
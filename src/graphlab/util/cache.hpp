@@ -61,6 +61,11 @@ namespace graphlab {
     // }; // end of bind
 
 
+    /**
+     * A single threaded LRU cache bounded by nothing but evict() calls.
+     * Every get() reorders the list. Shared caches should use
+     * \ref graphlab::concurrent_cache instead.
+     */
     template<typename Key, typename Value>
     class lru {
     public:
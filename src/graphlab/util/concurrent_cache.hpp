@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_UTIL_CONCURRENT_CACHE_HPP
+#define GRAPHLAB_UTIL_CONCURRENT_CACHE_HPP
+#include <stdint.h>
+#include <sched.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+/**
+ * \ingroup util
+ * Default size function of a concurrent_cache: every entry costs the
+ * size of its key and value, i.e. the capacity is a number of entries
+ * times that size.
+ */
+template <typename Key, typename Value>
+struct cache_entry_size {
+  size_t operator()(const Key&, const Value&) const {
+    return sizeof(Key) + sizeof(Value);
+  }
+};
+
+/**
+ * \ingroup util
+ * Counters of a concurrent_cache. See concurrent_cache::stats().
+ */
+struct cache_stats {
+  size_t hits;
+  size_t misses;
+  size_t inserts;    ///< new entries stored by put()
+  size_t updates;    ///< put() on a key already in the cache
+  size_t rejects;    ///< new entries refused by the admission policy
+  size_t evictions;
+  cache_stats(): hits(0), misses(0), inserts(0), updates(0),
+                 rejects(0), evictions(0) { }
+  cache_stats& operator+=(const cache_stats& other) {
+    hits += other.hits; misses += other.misses;
+    inserts += other.inserts; updates += other.updates;
+    rejects += other.rejects; evictions += other.evictions;
+    return *this;
+  }
+  double hit_ratio() const {
+    return (hits + misses) == 0 ? 0.0 : double(hits) / (hits + misses);
+  }
+  /// Writes one "name{labels} value" line per counter
+  void print(std::ostream& out, const std::string& prefix,
+             const std::string& labels = "") const {
+    std::string l = "{" + labels + "} ";
+    out << prefix << "_hits" << l << hits << "\n";
+    out << prefix << "_misses" << l << misses << "\n";
+    out << prefix << "_inserts" << l << inserts << "\n";
+    out << prefix << "_updates" << l << updates << "\n";
+    out << prefix << "_rejects" << l << rejects << "\n";
+    out << prefix << "_evictions" << l << evictions << "\n";
+  }
+};
+
+/**
+ * \ingroup util
+ * A thread safe cache bounded by a size in bytes, meant to be shared by
+ * the threads of a client or server, e.g. for graph_rows or adjacency
+ * lists fetched from remote shards.
+ *
+ * Like concurrent_hash_map, the key space is split over a power of two
+ * number of shards, each with its own spinlock and its own share of the
+ * capacity, so that threads touching different keys rarely contend.
+ *
+ * Each shard evicts with the CLOCK algorithm: a hit only sets the
+ * referenced bit of the entry, instead of reordering a list as an LRU
+ * does, and eviction sweeps a hand over the entries, clearing the bits,
+ * until it finds an entry not referenced since the last sweep.
+ *
+ * New entries go through a TinyLFU style admission policy: the shard
+ * keeps a count-min sketch of the access frequency of recent keys (every
+ * get(), hit or miss), and when the shard is full, a new key is admitted
+ * only if it was accessed more often than the entry it would evict.
+ * This keeps one-off scans from flushing the frequently used entries.
+ * The counters are halved every 10 * (capacity in entries) accesses so
+ * that the frequencies follow changes in the workload. Admission can be
+ * disabled, in which case the cache is plain CLOCK.
+ *
+ * The size of an entry is given by SizeFn(key, value). Entries larger
+ * than the capacity of a shard are never stored.
+ *
+ * Values are copied in and out of the cache under the shard lock; for
+ * large values, store a boost::shared_ptr to a const value instead.
+ */
+template <typename Key, typename Value,
+          typename SizeFn = cache_entry_size<Key, Value>,
+          typename Hash = boost::hash<Key> >
+class concurrent_cache {
+ public:
+  typedef Key key_type;
+  typedef Value mapped_type;
+
+ private:
+  struct entry {
+    Key key;
+    Value value;
+    size_t bytes;
+    bool used;
+    bool referenced;
+    entry(): key(), value(), bytes(0), used(false), referenced(false) { }
+  };
+
+  /**
+   * Count-min sketch of 4 rows of saturating 4 bit counters (stored in
+   * bytes for simplicity), halved every sample_size additions. Rows are
+   * 4 times as wide as the expected number of entries (i.e. 16 bytes per
+   * entry) to keep the keys of a scan from colliding with the hot keys.
+   */
+  struct frequency_sketch {
+    std::vector<unsigned char> table;
+    size_t mask;
+    size_t additions;
+    size_t sample_size;
+
+    void resize(size_t width, size_t sample) {
+      size_t w = 16;
+      while (w < width) w *= 2;
+      table.assign(4 * w, 0);
+      mask = w - 1;
+      additions = 0;
+      sample_size = sample;
+    }
+
+    inline size_t index(uint64_t h, size_t row) const {
+      // double hashing over the two halves of the hash
+      uint64_t i = (h & 0xFFFFFFFFULL) + row * ((h >> 32) | 1);
+      return row * (mask + 1) + (size_t(i) & mask);
+    }
+
+    size_t frequency(uint64_t h) const {
+      unsigned char ret = 15;
+      for (size_t r = 0; r < 4; ++r) ret = std::min(ret, table[index(h, r)]);
+      return ret;
+    }
+
+    void increment(uint64_t h) {
+      for (size_t r = 0; r < 4; ++r) {
+        unsigned char& c = table[index(h, r)];
+        if (c < 15) ++c;
+      }
+      if (++additions >= sample_size) {
+        for (size_t i = 0; i < table.size(); ++i) table[i] >>= 1;
+        additions /= 2;
+      }
+    }
+  };
+
+  typedef boost::unordered_map<Key, size_t, Hash> index_type;
+
+  struct shard {
+    simple_spinlock lock;
+    index_type index;         // key -> position in entries
+    std::vector<entry> entries;
+    std::vector<size_t> free_entries;
+    size_t hand;
+    size_t bytes;
+    frequency_sketch sketch;
+    cache_stats stats;
+    char pad[64];
+    shard(): hand(0), bytes(0) { }
+  };
+
+  std::vector<shard> shards;
+  size_t shard_bits;
+  size_t shard_capacity;
+  bool admission;
+  SizeFn sizer;
+  Hash hasher;
+
+  // see concurrent_hash_map::lock_shard
+  static inline void lock_shard(const shard& s) {
+    size_t spins = 0;
+    while (!s.lock.try_lock()) {
+      if (++spins < 64) {
+        asm volatile("pause" ::: "memory");
+      } else {
+        sched_yield();
+        spins = 0;
+      }
+    }
+  }
+
+  inline uint64_t hash_of(const Key& key) const {
+    return uint64_t(hasher(key)) * 0x9E3779B97F4A7C15ULL;
+  }
+
+  inline shard& get_shard(uint64_t h) {
+    return shards[shard_bits == 0 ? 0 : size_t(h >> (64 - shard_bits))];
+  }
+
+  // Advances the hand to the next entry not referenced since the last
+  // sweep, passing over the entry at position skip. The shard must hold
+  // another entry.
+  size_t find_victim(shard& s, size_t skip = size_t(-1)) {
+    while (true) {
+      s.hand = (s.hand + 1 == s.entries.size()) ? 0 : s.hand + 1;
+      entry& e = s.entries[s.hand];
+      if (!e.used || s.hand == skip) continue;
+      if (e.referenced) e.referenced = false;
+      else return s.hand;
+    }
+  }
+
+  void remove_entry(shard& s, size_t pos) {
+    entry& e = s.entries[pos];
+    s.index.erase(e.key);
+    s.bytes -= e.bytes;
+    e.key = Key();
+    e.value = Value();
+    e.bytes = 0;
+    e.used = false;
+    e.referenced = false;
+    s.free_entries.push_back(pos);
+  }
+
+ public:
+  /**
+   * Creates a cache holding at most capacity_bytes, split over at least
+   * num_shards shards (rounded up to a power of two; 4 per cpu if 0).
+   * expected_entry_bytes sizes the frequency sketches.
+   */
+  concurrent_cache(size_t capacity_bytes, size_t num_shards = 0,
+                   bool use_admission = true,
+                   size_t expected_entry_bytes = sizeof(Key) + sizeof(Value))
+      : admission(use_admission) {
+    if (num_shards == 0) num_shards = 4 * thread::cpu_count();
+    shard_bits = 0;
+    while ((size_t(1) << shard_bits) < num_shards) ++shard_bits;
+    shards.resize(size_t(1) << shard_bits);
+    shard_capacity = capacity_bytes / shards.size();
+    size_t shard_entries = shard_capacity / std::max<size_t>(expected_entry_bytes, 1) + 1;
+    for (size_t i = 0; i < shards.size(); ++i) {
+      shards[i].sketch.resize(4 * shard_entries, 10 * shard_entries);
+    }
+  }
+
+  /// Returns the number of shards
+  size_t num_shards() const { return shards.size(); }
+
+  /// Returns the capacity in bytes
+  size_t capacity_bytes() const { return shard_capacity * shards.size(); }
+
+  /**
+   * Copies the value of key into value and marks the entry as recently
+   * used. Returns false (and leaves value unchanged) on a miss.
+   */
+  bool get(const Key& key, Value& value) {
+    uint64_t h = hash_of(key);
+    shard& s = get_shard(h);
+    lock_shard(s);
+    if (admission) s.sketch.increment(h);
+    typename index_type::const_iterator iter = s.index.find(key);
+    bool ret = (iter != s.index.end());
+    if (ret) {
+      entry& e = s.entries[iter->second];
+      e.referenced = true;
+      value = e.value;
+      ++s.stats.hits;
+    } else {
+      ++s.stats.misses;
+    }
+    s.lock.unlock();
+    return ret;
+  }
+
+  /**
+   * Stores (key, value), evicting entries of the shard as needed.
+   * Returns false if the entry was not stored: it is larger than a shard,
+   * or the admission policy preferred the entry it would have evicted.
+   * Updating a key already in the cache always succeeds unless the new
+   * value is too large, in which case the key is removed.
+   */
+  bool put(const Key& key, const Value& value) {
+    uint64_t h = hash_of(key);
+    shard& s = get_shard(h);
+    size_t bytes = sizer(key, value);
+    lock_shard(s);
+    typename index_type::iterator iter = s.index.find(key);
+    if (iter != s.index.end()) {
+      size_t pos = iter->second;
+      if (bytes > shard_capacity) {
+        remove_entry(s, pos);
+        ++s.stats.rejects;
+        s.lock.unlock();
+        return false;
+      }
+      entry& e = s.entries[pos];
+      s.bytes = s.bytes - e.bytes + bytes;
+      e.value = value;
+      e.bytes = bytes;
+      e.referenced = true;
+      ++s.stats.updates;
+      // make room among the other entries. There are some, as the entry
+      // fits in the shard on its own.
+      while (s.bytes > shard_capacity) {
+        remove_entry(s, find_victim(s, pos));
+        ++s.stats.evictions;
+      }
+      s.lock.unlock();
+      return true;
+    }
+    if (bytes > shard_capacity) {
+      ++s.stats.rejects;
+      s.lock.unlock();
+      return false;
+    }
+    if (s.bytes + bytes > shard_capacity && admission) {
+      // TinyLFU: compare with the first victim of the sweep
+      size_t victim = find_victim(s);
+      if (s.sketch.frequency(h) <= s.sketch.frequency(hash_of(s.entries[victim].key))) {
+        ++s.stats.rejects;
+        s.lock.unlock();
+        return false;
+      }
+      remove_entry(s, victim);
+      ++s.stats.evictions;
+    }
+    while (s.bytes + bytes > shard_capacity) {
+      remove_entry(s, find_victim(s));
+      ++s.stats.evictions;
+    }
+    size_t pos;
+    if (s.free_entries.empty()) {
+      pos = s.entries.size();
+      s.entries.push_back(entry());
+    } else {
+      pos = s.free_entries.back();
+      s.free_entries.pop_back();
+    }
+    entry& e = s.entries[pos];
+    e.key = key;
+    e.value = value;
+    e.bytes = bytes;
+    e.used = true;
+    // a new entry has to be hit once to survive a sweep
+    e.referenced = false;
+    s.index[key] = pos;
+    s.bytes += bytes;
+    ++s.stats.inserts;
+    s.lock.unlock();
+    return true;
+  }
+
+  /// Returns true if the key is in the cache. Does not count as a use.
+  bool contains(const Key& key) const {
+    uint64_t h = hash_of(key);
+    const shard& s = shards[shard_bits == 0 ? 0 : size_t(h >> (64 - shard_bits))];
+    lock_shard(s);
+    bool ret = s.index.find(key) != s.index.end();
+    s.lock.unlock();
+    return ret;
+  }
+
+  /// Removes key from the cache. Returns true if it was present.
+  bool erase(const Key& key) {
+    uint64_t h = hash_of(key);
+    shard& s = get_shard(h);
+    lock_shard(s);
+    typename index_type::iterator iter = s.index.find(key);
+    bool ret = (iter != s.index.end());
+    if (ret) remove_entry(s, iter->second);
+    s.lock.unlock();
+    return ret;
+  }
+
+  /// Returns the number of entries. Approximate under concurrent writes.
+  size_t size() const {
+    size_t ret = 0;
+    for (size_t i = 0;i < shards.size(); ++i) {
+      lock_shard(shards[i]);
+      ret += shards[i].index.size();
+      shards[i].lock.unlock();
+    }
+    return ret;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  /// Returns the sum of the sizes of the entries
+  size_t bytes() const {
+    size_t ret = 0;
+    for (size_t i = 0;i < shards.size(); ++i) {
+      lock_shard(shards[i]);
+      ret += shards[i].bytes;
+      shards[i].lock.unlock();
+    }
+    return ret;
+  }
+
+  /// Returns the counters summed over the shards
+  cache_stats stats() const {
+    cache_stats ret;
+    for (size_t i = 0;i < shards.size(); ++i) {
+      lock_shard(shards[i]);
+      ret += shards[i].stats;
+      shards[i].lock.unlock();
+    }
+    return ret;
+  }
+
+  /// Removes all the entries. Keeps the counters and the frequencies.
+  void clear() {
+    for (size_t i = 0;i < shards.size(); ++i) {
+      shard& s = shards[i];
+      lock_shard(s);
+      s.index.clear();
+      s.entries.clear();
+      s.free_entries.clear();
+      s.hand = 0;
+      s.bytes = 0;
+      s.lock.unlock();
+    }
+  }
+
+  /// Resets the counters
+  void clear_stats() {
+    for (size_t i = 0;i < shards.size(); ++i) {
+      lock_shard(shards[i]);
+      shards[i].stats = cache_stats();
+      shards[i].lock.unlock();
+    }
+  }
+}; // end of concurrent_cache
+
+} // namespace graphlab
+#endif
@@ -0,0 +1,362 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_UTIL_CONCURRENT_HASH_MAP_HPP
+#define GRAPHLAB_UTIL_CONCURRENT_HASH_MAP_HPP
+#include <stdint.h>
+#include <sched.h>
+#include <vector>
+#include <utility>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/thread_pool.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+
+namespace graphlab {
+
+/**
+ * \ingroup util
+ * A hash map which scales concurrent writers by lock striping.
+ *
+ * The key space is split over a power of two number of shards, each an
+ * independent boost::unordered_map protected by its own spinlock and
+ * padded to a cache line, so that threads touching different keys
+ * rarely contend on the same lock or the same cache line. The shard is
+ * chosen from the high bits of a multiplicatively mixed hash, so keys
+ * which share low bits (e.g. vertex ids already partitioned by
+ * vid % num_shards) still spread evenly.
+ *
+ * All operations are thread safe. Values are never exposed by
+ * reference outside of a shard lock: find() copies the value out, and
+ * in place modification goes through update() / upsert() which run a
+ * functor while the shard is locked. Functors must be short and must
+ * not call back into the map.
+ *
+ * for_each() and parallel_for_each() visit shards one at a time, each
+ * under its lock. They observe a consistent view of each shard but not
+ * of the whole map if writers run concurrently.
+ *
+ * The serialized format is the same as for a boost::unordered_map of the
+ * same key and value type.
+ */
+template <typename Key, typename Value, typename Hash = boost::hash<Key> >
+class concurrent_hash_map {
+ public:
+  typedef Key key_type;
+  typedef Value mapped_type;
+  typedef boost::unordered_map<Key, Value, Hash> container_type;
+
+ private:
+  struct shard {
+    simple_spinlock lock;
+    container_type map;
+    char pad[64];
+  };
+
+  std::vector<shard> shards;
+  size_t shard_bits;
+  Hash hasher;
+
+  /**
+   * Spins briefly on the shard lock, then yields the processor so that
+   * a preempted lock holder can make progress when threads outnumber
+   * cores.
+   */
+  static inline void lock_shard(const shard& s) {
+    size_t spins = 0;
+    while (!s.lock.try_lock()) {
+      if (++spins < 64) {
+        asm volatile("pause" ::: "memory");
+      } else {
+        sched_yield();
+        spins = 0;
+      }
+    }
+  }
+
+  inline shard& get_shard(const Key& key) {
+    return shards[shard_id(key)];
+  }
+  inline const shard& get_shard(const Key& key) const {
+    return shards[shard_id(key)];
+  }
+  inline size_t shard_id(const Key& key) const {
+    if (shard_bits == 0) return 0;
+    uint64_t h = uint64_t(hasher(key)) * 0x9E3779B97F4A7C15ULL;
+    return size_t(h >> (64 - shard_bits));
+  }
+
+  // an element node holds the element, the next pointer and the hash
+  static size_t node_bytes() {
+    return sizeof(typename container_type::value_type) + 2 * sizeof(void*);
+  }
+
+  template <typename Fn>
+  static void visit_shard(shard* s, Fn* fn) {
+    lock_shard(*s);
+    typename container_type::iterator iter = s->map.begin();
+    for (; iter != s->map.end(); ++iter) (*fn)(iter->first, iter->second);
+    s->lock.unlock();
+  }
+
+  template <typename Fn>
+  void visit_shard_range(Fn* fn, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) visit_shard(&shards[i], fn);
+  }
+
+ public:
+  /**
+   * Creates a map with at least num_shards shards (rounded up to a power
+   * of two). If num_shards is 0, 16 shards per cpu are used. Every shard
+   * takes sizeof(shard) bytes (a lock, an empty unordered_map and a cache
+   * line of padding, about 128 bytes) even when it holds no element, so
+   * maps which are numerous or small should ask for fewer shards.
+   */
+  concurrent_hash_map(size_t num_shards = 0) {
+    if (num_shards == 0) num_shards = 16 * thread::cpu_count();
+    shard_bits = 0;
+    while ((size_t(1) << shard_bits) < num_shards) ++shard_bits;
+    shards.resize(size_t(1) << shard_bits);
+  }
+
+  /// Returns the number of shards
+  size_t num_shards() const { return shards.size(); }
+
+  /**
+   * Inserts (key, value) if key is not present.
+   * Returns true if the value was inserted.
+   */
+  bool insert(const Key& key, const Value& value) {
+    shard& s = get_shard(key);
+    lock_shard(s);
+    bool ret = s.map.insert(std::make_pair(key, value)).second;
+    s.lock.unlock();
+    return ret;
+  }
+
+  /// Sets the value of key, inserting it if not present
+  void set(const Key& key, const Value& value) {
+    shard& s = get_shard(key);
+    lock_shard(s);
+    s.map[key] = value;
+    s.lock.unlock();
+  }
+
+  /// Returns true if the key is present
+  bool contains(const Key& key) const {
+    const shard& s = get_shard(key);
+    lock_shard(s);
+    bool ret = s.map.find(key) != s.map.end();
+    s.lock.unlock();
+    return ret;
+  }
+
+  /**
+   * Copies the value of key into value.
+   * Returns false (and leaves value unchanged) if the key is not present.
+   */
+  bool find(const Key& key, Value& value) const {
+    const shard& s = get_shard(key);
+    lock_shard(s);
+    typename container_type::const_iterator iter = s.map.find(key);
+    bool ret = (iter != s.map.end());
+    if (ret) value = iter->second;
+    s.lock.unlock();
+    return ret;
+  }
+
+  /**
+   * Calls fn(const value&) on the value of key under the shard lock.
+   * Returns false if the key is not present.
+   */
+  template <typename Fn>
+  bool visit(const Key& key, Fn fn) const {
+    const shard& s = get_shard(key);
+    lock_shard(s);
+    typename container_type::const_iterator iter = s.map.find(key);
+    bool ret = (iter != s.map.end());
+    if (ret) fn(iter->second);
+    s.lock.unlock();
+    return ret;
+  }
+
+  /**
+   * Calls fn(value) on the value of key under the shard lock.
+   * Returns false if the key is not present.
+   */
+  template <typename Fn>
+  bool update(const Key& key, Fn fn) {
+    shard& s = get_shard(key);
+    lock_shard(s);
+    typename container_type::iterator iter = s.map.find(key);
+    bool ret = (iter != s.map.end());
+    if (ret) fn(iter->second);
+    s.lock.unlock();
+    return ret;
+  }
+
+  /**
+   * Calls fn(value) on the value of key under the shard lock, inserting
+   * init first if the key is not present.
+   * Returns true if the key was inserted.
+   */
+  template <typename Fn>
+  bool upsert(const Key& key, const Value& init, Fn fn) {
+    shard& s = get_shard(key);
+    lock_shard(s);
+    std::pair<typename container_type::iterator, bool> ret =
+        s.map.insert(std::make_pair(key, init));
+    fn(ret.first->second);
+    s.lock.unlock();
+    return ret.second;
+  }
+
+  /**
+   * Removes key from the map. Returns true if it was present.
+   */
+  bool erase(const Key& key) {
+    shard& s = get_shard(key);
+    lock_shard(s);
+    bool ret = s.map.erase(key) > 0;
+    s.lock.unlock();
+    return ret;
+  }
+
+  /// Returns the number of elements. Approximate under concurrent writes.
+  size_t size() const {
+    size_t ret = 0;
+    for (size_t i = 0;i < shards.size(); ++i) {
+      lock_shard(shards[i]);
+      ret += shards[i].map.size();
+      shards[i].lock.unlock();
+    }
+    return ret;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  /// Removes all elements
+  void clear() {
+    for (size_t i = 0;i < shards.size(); ++i) {
+      lock_shard(shards[i]);
+      shards[i].map.clear();
+      shards[i].lock.unlock();
+    }
+  }
+
+  /**
+   * Returns an estimate of the memory used by the map: the shards, the
+   * bucket arrays and one node per element. Memory owned by the values
+   * is not included. See memory_bytes(value_bytes).
+   */
+  size_t memory_bytes() const {
+    size_t ret = shards.capacity() * sizeof(shard);
+    for (size_t i = 0;i < shards.size(); ++i) {
+      lock_shard(shards[i]);
+      ret += shards[i].map.bucket_count() * sizeof(void*) +
+          shards[i].map.size() * node_bytes();
+      shards[i].lock.unlock();
+    }
+    return ret;
+  }
+
+  /**
+   * Same as memory_bytes(), plus value_bytes(value) for every element,
+   * for the memory owned by the values (e.g. the contents of a vector).
+   */
+  template <typename Fn>
+  size_t memory_bytes(Fn value_bytes) const {
+    size_t ret = memory_bytes();
+    for (size_t i = 0;i < shards.size(); ++i) {
+      lock_shard(shards[i]);
+      typename container_type::const_iterator iter = shards[i].map.begin();
+      for (; iter != shards[i].map.end(); ++iter) ret += value_bytes(iter->second);
+      shards[i].lock.unlock();
+    }
+    return ret;
+  }
+
+  /// Reserves space for n elements spread evenly over the shards
+  void reserve(size_t n) {
+    for (size_t i = 0;i < shards.size(); ++i) {
+      lock_shard(shards[i]);
+      shards[i].map.rehash(n / shards.size() + 1);
+      shards[i].lock.unlock();
+    }
+  }
+
+  /**
+   * Calls fn(key, value) on every element, one shard at a time.
+   * fn must not call back into the map.
+   */
+  template <typename Fn>
+  void for_each(Fn fn) {
+    visit_shard_range(&fn, 0, shards.size());
+  }
+
+  /**
+   * Calls fn(key, value) on every element, visiting shards in parallel on
+   * the thread pool. fn must be thread safe and must not call back into
+   * the map.
+   */
+  template <typename Fn>
+  void parallel_for_each(thread_pool& pool, Fn fn) {
+    pool.parallel_for(0, shards.size(),
+                      boost::bind(&concurrent_hash_map::template visit_shard_range<Fn>,
+                                  this, &fn, _1, _2));
+  }
+
+  void save(oarchive& oarc) const {
+    // lock everything to write a consistent snapshot
+    for (size_t i = 0;i < shards.size(); ++i) lock_shard(shards[i]);
+    size_t count = 0;
+    for (size_t i = 0;i < shards.size(); ++i) count += shards[i].map.size();
+    oarc << count;
+    for (size_t i = 0;i < shards.size(); ++i) {
+      typename container_type::const_iterator iter = shards[i].map.begin();
+      for (; iter != shards[i].map.end(); ++iter) {
+        oarc << iter->first << iter->second;
+      }
+    }
+    for (size_t i = 0;i < shards.size(); ++i) shards[i].lock.unlock();
+  }
+
+  void load(iarchive& iarc) {
+    clear();
+    size_t count = 0;
+    iarc >> count;
+    for (size_t i = 0;i < count; ++i) {
+      Key key;
+      Value value;
+      iarc >> key >> value;
+      set(key, value);
+    }
+  }
+}; // end of concurrent_hash_map
+
+} // namespace graphlab
+#endif
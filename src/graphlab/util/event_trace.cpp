@@ -0,0 +1,250 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cstdio>
+#include <algorithm>
+#include <sys/time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <graphlab/util/event_trace.hpp>
+#include <graphlab/parallel/atomic.hpp>
+
+namespace graphlab {
+
+namespace {
+  uint64_t wall_clock_ns() {
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return uint64_t(tv.tv_sec) * 1000000000 + uint64_t(tv.tv_usec) * 1000;
+  }
+
+  void request_id_destructor(void* v) {
+    delete reinterpret_cast<uint64_t*>(v);
+  }
+
+  struct request_id_key {
+    pthread_key_t key;
+    request_id_key() { pthread_key_create(&key, request_id_destructor); }
+  };
+
+  request_id_key& get_request_id_key() {
+    static request_id_key k;
+    return k;
+  }
+
+  /**
+   * Ring slots of the recording threads, shared by all the event traces.
+   * A thread keeps its slot (plus one, so that it is not NULL) in a
+   * thread specific key whose destructor returns the slot on exit.
+   */
+  struct slot_allocator {
+    pthread_key_t key;
+    pthread_mutex_t mut;
+    std::vector<size_t> free_slots;
+    size_t next_slot;
+    slot_allocator(): next_slot(0) {
+      pthread_mutex_init(&mut, NULL);
+      pthread_key_create(&key, release_slot);
+    }
+    static void release_slot(void* v);
+  };
+
+  slot_allocator& get_slot_allocator() {
+    static slot_allocator a;
+    return a;
+  }
+
+  // threads beyond MAX_THREADS keep this, so that they do not retry
+  const size_t NO_SLOT = event_trace::MAX_THREADS;
+
+  void slot_allocator::release_slot(void* v) {
+    size_t slot = reinterpret_cast<size_t>(v) - 1;
+    if (slot == NO_SLOT) return;
+    slot_allocator& a = get_slot_allocator();
+    pthread_mutex_lock(&a.mut);
+    a.free_slots.push_back(slot);
+    pthread_mutex_unlock(&a.mut);
+  }
+
+  /// Returns the ring slot of the calling thread, NO_SLOT if there is none
+  size_t thread_slot() {
+    slot_allocator& a = get_slot_allocator();
+    void* v = pthread_getspecific(a.key);
+    if (__likely__(v != NULL)) return reinterpret_cast<size_t>(v) - 1;
+    size_t slot = NO_SLOT;
+    pthread_mutex_lock(&a.mut);
+    if (!a.free_slots.empty()) {
+      slot = a.free_slots.back();
+      a.free_slots.pop_back();
+    } else if (a.next_slot < event_trace::MAX_THREADS) {
+      slot = a.next_slot++;
+    }
+    pthread_mutex_unlock(&a.mut);
+    pthread_setspecific(a.key, reinterpret_cast<void*>(slot + 1));
+    return slot;
+  }
+} // anonymous namespace
+
+
+event_trace::event_trace(size_t ring_size): enabled(false) {
+  size_t size = 1;
+  while (size < ring_size) size *= 2;
+  ring_mask = size - 1;
+  for (size_t i = 0;i < MAX_THREADS; ++i) rings[i] = NULL;
+  start_ticks = rdtsc();
+  start_ns = wall_clock_ns();
+}
+
+event_trace::~event_trace() {
+  for (size_t i = 0;i < MAX_THREADS; ++i) {
+    if (rings[i] != NULL) {
+      delete [] rings[i]->events;
+      delete rings[i];
+    }
+  }
+}
+
+void event_trace::enable(bool e) {
+  enabled = e;
+}
+
+event_trace::ring* event_trace::get_ring() {
+  size_t idx = thread_slot();
+  if (idx == NO_SLOT) return NULL;
+  // only the thread owning the slot writes rings[idx]. A previous owner
+  // handed the slot over through the allocator's mutex.
+  if (rings[idx] == NULL) {
+    ring* r = new ring;
+    r->events = new event[ring_mask + 1];
+    r->head = 0;
+    rings[idx] = r;
+  }
+  return rings[idx];
+}
+
+void event_trace::record(const char* name, uint64_t request_id, char phase) {
+  ring* r = get_ring();
+  if (r == NULL) return;
+  event& e = r->events[r->head & ring_mask];
+  e.ticks = rdtsc();
+  e.request_id = request_id;
+  e.name = name;
+  e.phase = phase;
+  // the event must be written before it is published
+  asm volatile("" : : : "memory");
+  r->head = r->head + 1;
+}
+
+void event_trace::collect(std::vector<trace_record>& out,
+                          uint32_t process) const {
+  // interpolate between the start and now to convert ticks to wall
+  // clock time
+  unsigned long long now_ticks = rdtsc();
+  uint64_t now_ns = wall_clock_ns();
+  double ns_per_tick = 0;
+  if (now_ns - start_ns > 1000000 && now_ticks > start_ticks) {
+    ns_per_tick = double(now_ns - start_ns) / double(now_ticks - start_ticks);
+  } else if (estimate_ticks_per_second() > 0) {
+    ns_per_tick = 1e9 / double(estimate_ticks_per_second());
+  }
+  for (size_t t = 0;t < MAX_THREADS; ++t) {
+    const ring* r = rings[t];
+    if (r == NULL) continue;
+    size_t head = r->head;
+    size_t n = std::min(head, ring_mask + 1);
+    for (size_t i = head - n;i < head; ++i) {
+      const event& e = r->events[i & ring_mask];
+      trace_record rec;
+      rec.name = e.name;
+      rec.time_ns = start_ns + uint64_t(double(e.ticks - start_ticks) * ns_per_tick);
+      rec.request_id = e.request_id;
+      rec.process = process;
+      rec.thread = t;
+      rec.phase = e.phase;
+      out.push_back(rec);
+    }
+  }
+}
+
+void event_trace::clear() {
+  for (size_t t = 0;t < MAX_THREADS; ++t) {
+    if (rings[t] != NULL) rings[t]->head = 0;
+  }
+}
+
+uint64_t event_trace::new_request_id() {
+  // the high bits identify the process, the low bits count requests
+  static uint64_t prefix = ((uint64_t(getpid()) * 2654435761ULL) ^ wall_clock_ns()) << 40;
+  static atomic<uint64_t> counter;
+  return prefix | (counter.inc() & ((1ULL << 40) - 1));
+}
+
+uint64_t event_trace::current_request_id() {
+  uint64_t* id = reinterpret_cast<uint64_t*>(
+      pthread_getspecific(get_request_id_key().key));
+  return id == NULL ? 0 : *id;
+}
+
+void event_trace::set_current_request_id(uint64_t request_id) {
+  pthread_key_t key = get_request_id_key().key;
+  uint64_t* id = reinterpret_cast<uint64_t*>(pthread_getspecific(key));
+  if (id == NULL) {
+    if (request_id == 0) return;
+    id = new uint64_t;
+    pthread_setspecific(key, id);
+  }
+  *id = request_id;
+}
+
+void event_trace::write_chrome_trace(std::ostream& out,
+                                     const std::vector<trace_record>& records) {
+  out << "{\"traceEvents\":[\n";
+  char buf[64];
+  for (size_t i = 0;i < records.size(); ++i) {
+    const trace_record& rec = records[i];
+    if (i > 0) out << ",\n";
+    out << "{\"name\":\"";
+    for (size_t j = 0;j < rec.name.length(); ++j) {
+      char c = rec.name[j];
+      if (c == '"' || c == '\\') out << '\\';
+      out << c;
+    }
+    // timestamps are in microseconds
+    sprintf(buf, "%llu.%03llu",
+            (unsigned long long)(rec.time_ns / 1000),
+            (unsigned long long)(rec.time_ns % 1000));
+    out << "\",\"ph\":\"" << rec.phase << "\",\"ts\":" << buf
+        << ",\"pid\":" << rec.process << ",\"tid\":" << rec.thread;
+    if (rec.phase == 'i') out << ",\"s\":\"t\"";
+    sprintf(buf, "%llx", (unsigned long long)rec.request_id);
+    out << ",\"args\":{\"request_id\":\"" << buf << "\"}}";
+  }
+  out << "\n]}\n";
+}
+
+event_trace& global_event_trace() {
+  static event_trace trace;
+  return trace;
+}
+
+} // namespace graphlab
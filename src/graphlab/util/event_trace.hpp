@@ -0,0 +1,245 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_UTIL_EVENT_TRACE_HPP
+#define GRAPHLAB_UTIL_EVENT_TRACE_HPP
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/util/branch_hints.hpp>
+#include <graphlab/parallel/reducer.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+
+namespace graphlab {
+
+/**
+ * A trace event as returned by \ref event_trace::collect. Unlike the
+ * events in the ring buffers, it is serializable so that the traces of
+ * several machines can be gathered and written into one timeline.
+ */
+struct trace_record {
+  std::string name;
+  /// wall clock time in nanoseconds since the epoch
+  uint64_t time_ns;
+  uint64_t request_id;
+  /// process (e.g. machine or shard) and thread the event was recorded on
+  uint32_t process;
+  uint32_t thread;
+  /// 'B' begin of a span, 'E' end of a span, 'i' instant
+  char phase;
+
+  void save(oarchive& oarc) const {
+    oarc << name << time_ns << request_id << process << thread << phase;
+  }
+  void load(iarchive& iarc) {
+    iarc >> name >> time_ns >> request_id >> process >> thread >> phase;
+  }
+};
+
+/**
+ * \ingroup util
+ * Binary event trace recorder, for timelines of single requests across
+ * client, comm and server threads and machines.
+ *
+ * Each thread records timestamped begin / end / instant events into its
+ * own ring buffer, so recording takes no lock and writes no shared cache
+ * line. Only the latest ring_size events of each thread are kept. Event
+ * names must be string literals (or live as long as the recorder), as
+ * only the pointer is stored. Recording is off until enable(true), and
+ * then costs a branch.
+ *
+ * Events carry the id of the request they belong to. The current request
+ * id of a thread is set with \ref trace_request_scope and is propagated
+ * by QueryMessage and by comm_rpc, so that spans on other machines can
+ * be matched to the request which caused them.
+ *
+ * \ref collect returns the events as \ref trace_record "trace_records",
+ * which \ref write_chrome_trace writes in the Chrome trace event JSON
+ * format, loaded by chrome://tracing and Perfetto.
+ *
+ * \code
+ * global_event_trace().enable(true);
+ * {
+ *   trace_request_scope request;      // starts a new request id
+ *   trace_span span("get_vertices");
+ *   ...
+ * }
+ * std::vector<trace_record> records;
+ * global_event_trace().collect(records, machine_id);
+ * event_trace::write_chrome_trace(out, records);
+ * \endcode
+ */
+class event_trace {
+ public:
+  /**
+   * Number of threads which may record at the same time. A thread takes
+   * a ring slot when it first records and gives it back when it exits,
+   * so the ring (and its timeline lane) is then reused by a later thread.
+   * Events of the threads beyond MAX_THREADS are dropped.
+   */
+  static const size_t MAX_THREADS = 256;
+
+  explicit event_trace(size_t ring_size = 65536);
+
+  ~event_trace();
+
+  /// Starts or stops recording
+  void enable(bool enabled);
+
+  inline bool is_enabled() const { return enabled; }
+
+  /// Records the beginning of a span
+  inline void begin(const char* name, uint64_t request_id) {
+    if (__unlikely__(enabled)) record(name, request_id, 'B');
+  }
+
+  /// Records the end of a span. Must be recorded on the thread which began it
+  inline void end(const char* name, uint64_t request_id) {
+    if (__unlikely__(enabled)) record(name, request_id, 'E');
+  }
+
+  /// Records a point in time
+  inline void instant(const char* name, uint64_t request_id) {
+    if (__unlikely__(enabled)) record(name, request_id, 'i');
+  }
+
+  /**
+   * Appends the recorded events, oldest first within each thread, to out.
+   * process identifies this process in the merged timeline.
+   * Events recorded concurrently with collect() may be missed or torn.
+   */
+  void collect(std::vector<trace_record>& out, uint32_t process) const;
+
+  /// Drops the recorded events
+  void clear();
+
+  /// Returns a new request id, unique with high probability across processes
+  static uint64_t new_request_id();
+
+  /// Returns the request id of the calling thread. 0 if there is none.
+  static uint64_t current_request_id();
+
+  /// Sets the request id of the calling thread
+  static void set_current_request_id(uint64_t request_id);
+
+  /**
+   * Writes the records in the Chrome trace event JSON format.
+   * Records of several processes may be concatenated.
+   */
+  static void write_chrome_trace(std::ostream& out,
+                                 const std::vector<trace_record>& records);
+
+ private:
+  struct event {
+    unsigned long long ticks;
+    uint64_t request_id;
+    const char* name;
+    char phase;
+  };
+
+  struct ring {
+    event* events;
+    // number of events ever written. Only written by the thread owning
+    // the slot.
+    volatile size_t head;
+  };
+
+  void record(const char* name, uint64_t request_id, char phase);
+
+  ring* get_ring();
+
+  size_t ring_mask;
+  volatile bool enabled;
+  // indexed by the slot of the thread, see thread_slot() in the .cpp
+  ring* volatile rings[MAX_THREADS];
+  // rdtsc and wall clock time when recording started, to convert ticks
+  unsigned long long start_ticks;
+  uint64_t start_ns;
+
+  // not copyable
+  event_trace(const event_trace&);
+  event_trace& operator=(const event_trace&);
+};
+
+/// The event trace of the process, used by trace_span, QueryMessage and comm_rpc
+event_trace& global_event_trace();
+
+/**
+ * Sets the request id of the calling thread for its lifetime, and
+ * restores the previous one on destruction.
+ */
+class trace_request_scope {
+ public:
+  /**
+   * Starts a new request if the thread is not already in one and the
+   * global trace is enabled. Otherwise keeps the current request id.
+   */
+  trace_request_scope(): prev(event_trace::current_request_id()) {
+    if (prev == 0 && global_event_trace().is_enabled()) {
+      event_trace::set_current_request_id(event_trace::new_request_id());
+    }
+  }
+
+  /// Joins the request with the given id (e.g. received from another machine)
+  explicit trace_request_scope(uint64_t request_id):
+      prev(event_trace::current_request_id()) {
+    event_trace::set_current_request_id(request_id);
+  }
+
+  ~trace_request_scope() {
+    event_trace::set_current_request_id(prev);
+  }
+
+ private:
+  uint64_t prev;
+  trace_request_scope(const trace_request_scope&);
+  trace_request_scope& operator=(const trace_request_scope&);
+};
+
+/**
+ * Records a span of the global event trace, from construction to
+ * destruction, for the current request of the thread.
+ */
+class trace_span {
+ public:
+  explicit trace_span(const char* name):
+      name(name), request_id(event_trace::current_request_id()) {
+    global_event_trace().begin(name, request_id);
+  }
+
+  ~trace_span() {
+    global_event_trace().end(name, request_id);
+  }
+
+ private:
+  const char* name;
+  uint64_t request_id;
+  trace_span(const trace_span&);
+  trace_span& operator=(const trace_span&);
+};
+
+} // namespace graphlab
+#endif
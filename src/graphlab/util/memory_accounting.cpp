@@ -0,0 +1,88 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <graphlab/util/memory_accounting.hpp>
+#include <graphlab/parallel/atomic.hpp>
+
+namespace graphlab {
+  namespace memory_accounting {
+
+    static const char* subsystem_names[NUM_SUBSYSTEMS] = {
+      "shard_columns", "shard_rows", "vertex_index", "edge_index",
+      "vertex_mirrors", "comm_buffers", "ingress_buffers"
+    };
+
+    // one cache line per counter, as they are updated by many threads
+    struct padded_counter {
+      atomic<size_t> value;
+      char pad[64 - sizeof(atomic<size_t>)];
+    };
+
+    static padded_counter counters[NUM_SUBSYSTEMS];
+
+    const char* subsystem_name(subsystem s) {
+      return subsystem_names[s];
+    }
+
+    usage::usage() {
+      for (size_t i = 0;i < NUM_SUBSYSTEMS; ++i) bytes[i] = 0;
+    }
+
+    usage& usage::operator+=(const usage& other) {
+      for (size_t i = 0;i < NUM_SUBSYSTEMS; ++i) bytes[i] += other.bytes[i];
+      return *this;
+    }
+
+    size_t usage::total() const {
+      size_t ret = 0;
+      for (size_t i = 0;i < NUM_SUBSYSTEMS; ++i) ret += bytes[i];
+      return ret;
+    }
+
+    void usage::print(std::ostream& out, const std::string& name,
+                      const std::string& labels) const {
+      for (size_t i = 0;i < NUM_SUBSYSTEMS; ++i) {
+        out << name << "{" << labels << (labels.empty() ? "" : ",")
+            << "subsystem=\"" << subsystem_names[i] << "\"} "
+            << bytes[i] << "\n";
+      }
+    }
+
+    void add(subsystem s, ptrdiff_t bytes) {
+      // wraps around for negative values
+      counters[s].value.inc(size_t(bytes));
+    }
+
+    usage counted() {
+      usage ret;
+      for (size_t i = 0;i < NUM_SUBSYSTEMS; ++i) {
+        size_t val = counters[i].value.value;
+        // a free may be counted before the matching allocation
+        ret.bytes[i] = (ptrdiff_t(val) < 0) ? 0 : val;
+      }
+      return ret;
+    }
+
+  }; // end of namespace memory_accounting
+
+}; // end of graphlab namespace
@@ -0,0 +1,97 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_MEMORY_ACCOUNTING_HPP
+#define GRAPHLAB_MEMORY_ACCOUNTING_HPP
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+namespace graphlab {
+  /**
+   * \internal \brief Memory accounting namespace contains the memory
+   * used by each subsystem, to tell which of them a process's memory
+   * belongs to.
+   *
+   * Subsystems with short lived or transferred buffers (comm, ingress)
+   * count their allocations with add() as they happen. Long lived
+   * structures (shard columns, rows, indexes and mirror sets) are
+   * measured when reported, e.g. by graph_shard::memory_usage(), since
+   * counting them would slow down every insertion.
+   */
+  namespace memory_accounting {
+
+    enum subsystem {
+      SHARD_COLUMNS,    ///< vertex ids, edge ids and edge endpoints
+      SHARD_ROWS,       ///< vertex and edge data
+      VERTEX_INDEX,
+      EDGE_INDEX,
+      VERTEX_MIRRORS,
+      COMM_BUFFERS,     ///< messages queued for sending or receiving
+      INGRESS_BUFFERS,  ///< lines read by the graph loader, not yet parsed
+      NUM_SUBSYSTEMS
+    };
+
+    /// Returns the name of the subsystem, e.g. "vertex_index"
+    const char* subsystem_name(subsystem s);
+
+    /**
+     * \internal
+     *
+     * \brief Bytes used by each subsystem.
+     */
+    struct usage {
+      size_t bytes[NUM_SUBSYSTEMS];
+
+      usage();
+
+      usage& operator+=(const usage& other);
+
+      size_t total() const;
+
+      /**
+       * Writes one "name{labels,subsystem="..."} bytes" line per
+       * subsystem. labels (e.g. "shard=\"3\"") may be empty.
+       */
+      void print(std::ostream& out, const std::string& name,
+                 const std::string& labels = "") const;
+    };
+
+    /**
+     * \internal
+     *
+     * \brief Counts bytes allocated (positive) or freed (negative)
+     * by a subsystem. Safe to call from any thread.
+     */
+    void add(subsystem s, ptrdiff_t bytes);
+
+    /**
+     * \internal
+     *
+     * \brief Returns the bytes counted with add() for every subsystem.
+     */
+    usage counted();
+  } // end of namespace memory_accounting
+};
+
+#endif
@@ -35,6 +35,7 @@
 #include <graphlab/util/timer.hpp>
 
 #include <graphlab/util/random.hpp>
+#include <graphlab/util/random_stream.hpp>
 
 
 
@@ -183,6 +184,47 @@ namespace graphlab {
     // source_registry registry;
 
 
+    /**
+     * The registry of the thread streams. Assigns a distinct id to
+     * every stream, and reseeds them all.
+     */
+    struct stream_registry {
+      std::set<philox_stream*> streams;
+      uint64_t seed_value;
+      uint64_t next_id;
+      mutex mut;
+
+      stream_registry() : seed_value(graphlab::timer::usec_of_day()), next_id(0) { }
+
+      static stream_registry& global() {
+        static stream_registry registry;
+        return registry;
+      }
+
+      void seed(uint64_t value) {
+        mut.lock();
+        seed_value = value;
+        foreach(philox_stream* stream, streams) {
+          stream->seed(seed_value, stream->stream_id());
+        }
+        mut.unlock();
+      }
+
+      void register_stream(philox_stream* stream) {
+        mut.lock();
+        stream->seed(seed_value, next_id++);
+        streams.insert(stream);
+        mut.unlock();
+      }
+
+      void unregister_stream(philox_stream* stream) {
+        mut.lock();
+        streams.erase(stream);
+        mut.unlock();
+      }
+    };
+
+
 
 
 
@@ -226,6 +268,27 @@ namespace graphlab {
     // This forces __init_keys__ to be called prior to main.
     static pthread_key_t __unused_init_keys__(get_random_source_key());
 
+    void destroy_stream_tls_data(void* ptr) {
+      philox_stream* stream = reinterpret_cast<philox_stream*>(ptr);
+      if (stream != NULL) {
+        stream_registry::global().unregister_stream(stream);
+        delete stream;
+      }
+    }
+
+    struct stream_tls_key_creator {
+      pthread_key_t TLS_RANDOM_STREAM_KEY;
+      stream_tls_key_creator() : TLS_RANDOM_STREAM_KEY(0) {
+        pthread_key_create(&TLS_RANDOM_STREAM_KEY,
+                           destroy_stream_tls_data);
+      }
+    };
+    static pthread_key_t get_random_stream_key() {
+      static const stream_tls_key_creator key;
+      return key.TLS_RANDOM_STREAM_KEY;
+    }
+    static pthread_key_t __unused_init_stream_keys__(get_random_stream_key());
+
   // the combination of the two mechanisms above will force the
   // thread local store to be initialized
   // 1: before main
@@ -259,14 +322,42 @@ namespace graphlab {
 
 
 
-    void seed() { source_registry::global().seed();  } 
+    philox_stream& get_stream() {
+      philox_stream* stream = 
+        reinterpret_cast<philox_stream*>
+        (pthread_getspecific(get_random_stream_key()));
+      if (stream == NULL) {
+        stream = new philox_stream();
+        // This assigns its stream id and seed
+        stream_registry::global().register_stream(stream);
+        pthread_setspecific(get_random_stream_key(), stream);
+      }
+      return *stream;
+    }
 
-    void nondet_seed() { source_registry::global().nondet_seed(); } 
+    void seed_streams(uint64_t seed_value) {
+      stream_registry::global().seed(seed_value);
+    }
 
-    void time_seed() { source_registry::global().time_seed(); } 
+
+    void seed() { 
+      source_registry::global().seed();  
+      seed_streams(0);
+    } 
+
+    void nondet_seed() { 
+      source_registry::global().nondet_seed(); 
+      seed_streams(nondet_generator::global()());
+    } 
+
+    void time_seed() { 
+      source_registry::global().time_seed(); 
+      seed_streams(graphlab::timer::usec_of_day());
+    } 
 
     void seed(const size_t seed_value) { 
       source_registry::global().seed(seed_value);  
+      seed_streams(seed_value);
     } 
 
 
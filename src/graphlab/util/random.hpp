@@ -327,25 +327,29 @@ namespace graphlab {
 
     /**
      * \ingroup random
-     * Seed all generators using the default seed
+     * Seed all generators, and the streams of random_stream.hpp,
+     * using the default seed
      */
     void seed();
 
     /**
      * \ingroup random
-     * Seed all generators using an integer
+     * Seed all generators, and the streams of random_stream.hpp,
+     * using an integer
      */
     void seed(size_t seed_value);
 
     /**
      * \ingroup random
-     * Seed all generators using a nondeterministic source
+     * Seed all generators, and the streams of random_stream.hpp,
+     * using a nondeterministic source
      */
     void nondet_seed();
 
     /**
      * \ingroup random
-     * Seed all generators using the current time in microseconds
+     * Seed all generators, and the streams of random_stream.hpp,
+     * using the current time in microseconds
      */
     void time_seed();
     
@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_RANDOM_STREAM_HPP
+#define GRAPHLAB_RANDOM_STREAM_HPP
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <boost/config.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+  namespace random {
+
+    class alias_table;
+
+    /**
+     * \ingroup random
+     * A counter based random number stream (Philox4x32-10, Salmon et
+     * al., "Parallel random numbers: as easy as 1, 2, 3").
+     *
+     * The n-th block of 128 random bits is a function of (seed, stream
+     * id, n) only, so any number of streams with the same seed and
+     * distinct ids are independent, reproducible, and can be created
+     * anywhere without coordination: e.g. one stream per thread, per
+     * vertex or per random walk. The state is 48 bytes and there is no
+     * locking, unlike the generators of random.hpp.
+     *
+     * The fill_* functions draw n values at once, one block of four 32
+     * bit words at a time, which is much faster than one call per value.
+     * They start at the next block, so they do not draw the same values
+     * as n single calls.
+     *
+     * The stream is also a boost random engine (operator(), min(), max())
+     * and can be used with the boost distributions.
+     */
+    class philox_stream {
+    public:
+      typedef uint64_t result_type;
+
+      explicit philox_stream(uint64_t seed_value = 0, uint64_t stream_id = 0) {
+        seed(seed_value, stream_id);
+      }
+
+      //! Restarts the stream at block 0 of (seed_value, stream_id)
+      void seed(uint64_t seed_value, uint64_t stream_id = 0) {
+        key[0] = (uint32_t)seed_value;
+        key[1] = (uint32_t)(seed_value >> 32);
+        id = stream_id;
+        counter = 0;
+        available = 0;
+      }
+
+      uint64_t stream_id() const { return id; }
+
+      //! Skips the next n blocks of 128 bits
+      void skip_blocks(uint64_t n) { counter += n; available = 0; }
+
+      //! Returns 64 random bits
+      inline uint64_t next() {
+        if (available == 0) {
+          next_block(buffer);
+          available = 4;
+        }
+        available -= 2;
+        return ((uint64_t)buffer[available + 1] << 32) | buffer[available];
+      }
+
+      inline result_type operator()() { return next(); }
+      result_type min BOOST_PREVENT_MACRO_SUBSTITUTION () const { return 0; }
+      result_type max BOOST_PREVENT_MACRO_SUBSTITUTION () const { return ~uint64_t(0); }
+
+      //! Returns a double uniformly distributed in [0, 1)
+      inline double uniform01() { return to_double(next()); }
+
+      //! Returns an integer uniformly distributed in [0, n). n must be positive.
+      inline uint64_t uniform_int(uint64_t n) {
+        // Lemire's multiply and reject: exact, and rarely rejects
+        unsigned __int128 m = (unsigned __int128)next() * n;
+        uint64_t low = (uint64_t)m;
+        if (low < n) {
+          uint64_t threshold = (0 - n) % n;
+          while (low < threshold) {
+            m = (unsigned __int128)next() * n;
+            low = (uint64_t)m;
+          }
+        }
+        return (uint64_t)(m >> 64);
+      }
+
+      //! Returns a normally distributed double
+      inline double normal(double mean = 0, double stdev = 1) {
+        double out[2];
+        box_muller(next(), next(), out);
+        return mean + stdev * out[0];
+      }
+
+      //! Returns an index drawn from table
+      inline size_t discrete(const alias_table& table);
+
+      //! Fills out[0..n) with random bits
+      void fill(uint64_t* out, size_t n) {
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2) next_words(out + i);
+        if (i < n) out[i] = next();
+      }
+
+      //! Fills out[0..n) with doubles uniformly distributed in [min, max)
+      void fill_uniform(double* out, size_t n, double min = 0, double max = 1) {
+        const double scale = max - min;
+        uint64_t words[2];
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+          next_words(words);
+          out[i] = min + scale * to_double(words[0]);
+          out[i + 1] = min + scale * to_double(words[1]);
+        }
+        if (i < n) out[i] = min + scale * uniform01();
+      }
+
+      /**
+       * Fills out[0..n) with integers uniformly distributed in [0, bound).
+       * bound must be positive and at most 2^32. The draws are biased by
+       * at most bound / 2^32, which is below 2^-12 for bounds below 2^20,
+       * in exchange for no rejection loop. Use uniform_int() for exact draws.
+       */
+      void fill_uniform_int(uint32_t* out, size_t n, uint64_t bound) {
+        ASSERT_GT(bound, 0);
+        ASSERT_LE(bound, uint64_t(1) << 32);
+        uint32_t block[4];
+        size_t i = 0;
+        while (i < n) {
+          next_block(block);
+          for (size_t j = 0; j < 4 && i < n; ++j, ++i) {
+            out[i] = (uint32_t)((block[j] * bound) >> 32);
+          }
+        }
+      }
+
+      //! Fills out[0..n) with normally distributed doubles
+      void fill_normal(double* out, size_t n, double mean = 0, double stdev = 1) {
+        uint64_t words[2];
+        double pair[2];
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+          next_words(words);
+          box_muller(words[0], words[1], pair);
+          out[i] = mean + stdev * pair[0];
+          out[i + 1] = mean + stdev * pair[1];
+        }
+        if (i < n) out[i] = normal(mean, stdev);
+      }
+
+      //! Fills out[0..n) with indices drawn from table
+      void fill_discrete(const alias_table& table, uint32_t* out, size_t n);
+
+      //! Computes one block of output at a given block number
+      static void philox(const uint32_t key[2], uint64_t block, uint64_t stream,
+                         uint32_t out[4]) {
+        uint32_t c0 = (uint32_t)block, c1 = (uint32_t)(block >> 32);
+        uint32_t c2 = (uint32_t)stream, c3 = (uint32_t)(stream >> 32);
+        uint32_t k0 = key[0], k1 = key[1];
+        for (size_t round = 0; round < 10; ++round) {
+          uint64_t p0 = (uint64_t)0xD2511F53 * c0;
+          uint64_t p1 = (uint64_t)0xCD9E8D57 * c2;
+          c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+          c1 = (uint32_t)p1;
+          c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+          c3 = (uint32_t)p0;
+          k0 += 0x9E3779B9;
+          k1 += 0xBB67AE85;
+        }
+        out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+      }
+
+    private:
+      uint32_t key[2];
+      uint64_t id;
+      uint64_t counter;
+      uint32_t buffer[4];
+      size_t available;
+
+      inline void next_block(uint32_t* out) {
+        philox(key, counter++, id, out);
+      }
+
+      inline void next_words(uint64_t* out) {
+        uint32_t block[4];
+        next_block(block);
+        out[0] = ((uint64_t)block[1] << 32) | block[0];
+        out[1] = ((uint64_t)block[3] << 32) | block[2];
+      }
+
+      static inline double to_double(uint64_t bits) {
+        return (bits >> 11) * (1.0 / 9007199254740992.0);
+      }
+
+      static inline void box_muller(uint64_t a, uint64_t b, double out[2]) {
+        // 1 - u is in (0, 1], so the log is finite
+        double r = std::sqrt(-2.0 * std::log(1.0 - to_double(a)));
+        double theta = 6.283185307179586 * to_double(b);
+        out[0] = r * std::cos(theta);
+        out[1] = r * std::sin(theta);
+      }
+    }; // end of class philox_stream
+
+
+    /**
+     * \ingroup random
+     * Walker's alias method (with Vose's construction): after O(n)
+     * preprocessing of n weights, draws an index with probability
+     * proportional to its weight in O(1), with one random 64 bit word
+     * and no floating point.
+     */
+    class alias_table {
+    public:
+      alias_table() { }
+
+      //! Builds a table from weights, which must be non negative with a positive sum
+      explicit alias_table(const std::vector<double>& weights) { init(weights); }
+
+      void init(const std::vector<double>& weights) {
+        prob.resize(weights.size());
+        alias.resize(weights.size());
+        if (!weights.empty()) build(&weights[0], weights.size(), &prob[0], &alias[0]);
+      }
+
+      size_t size() const { return prob.size(); }
+
+      bool empty() const { return prob.empty(); }
+
+      //! Draws an index from 64 random bits
+      inline size_t sample(uint64_t bits) const {
+        return sample(&prob[0], &alias[0], prob.size(), bits);
+      }
+
+      /**
+       * Fills prob[0..n) and alias[0..n) for weights[0..n). Lets callers
+       * store many tables in flat arrays, e.g. one per vertex.
+       */
+      static void build(const double* weights, size_t n, uint32_t* prob, uint32_t* alias) {
+        ASSERT_LT(n, uint64_t(1) << 32);
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+          ASSERT_GE(weights[i], 0);
+          sum += weights[i];
+        }
+        ASSERT_GT(sum, 0);
+        // scaled[i] is the weight of i in units of a column
+        std::vector<double> scaled(n);
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; ++i) {
+          scaled[i] = weights[i] * n / sum;
+          if (scaled[i] < 1) small.push_back(i);
+          else large.push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+          uint32_t s = small.back(), l = large.back();
+          small.pop_back();
+          prob[s] = to_threshold(scaled[s]);
+          alias[s] = l;
+          scaled[l] -= 1 - scaled[s];
+          if (scaled[l] < 1) {
+            large.pop_back();
+            small.push_back(l);
+          }
+        }
+        // the remaining columns are full, up to rounding errors
+        for (size_t i = 0; i < large.size(); ++i) { prob[large[i]] = ~uint32_t(0); alias[large[i]] = large[i]; }
+        for (size_t i = 0; i < small.size(); ++i) { prob[small[i]] = ~uint32_t(0); alias[small[i]] = small[i]; }
+      }
+
+      //! Draws an index from a table built by build()
+      static inline size_t sample(const uint32_t* prob, const uint32_t* alias,
+                                  size_t n, uint64_t bits) {
+        // the low half picks the column, the high half the side of it
+        size_t column = (size_t)(((bits & 0xFFFFFFFFULL) * n) >> 32);
+        return (uint32_t)(bits >> 32) < prob[column] ? column : alias[column];
+      }
+
+    private:
+      // prob[i] is the probability to keep column i, scaled to 2^32
+      std::vector<uint32_t> prob;
+      std::vector<uint32_t> alias;
+
+      static inline uint32_t to_threshold(double p) {
+        // p may be slightly out of [0, 1] after rounding errors
+        double t = p * 4294967296.0;
+        if (t <= 0) return 0;
+        return t >= 4294967295.0 ? ~uint32_t(0) : (uint32_t)t;
+      }
+    }; // end of class alias_table
+
+
+    inline size_t philox_stream::discrete(const alias_table& table) {
+      return table.sample(next());
+    }
+
+    inline void philox_stream::fill_discrete(const alias_table& table, uint32_t* out, size_t n) {
+      uint64_t block[2];
+      size_t i = 0;
+      for (; i + 2 <= n; i += 2) {
+        next_words(block);
+        out[i] = table.sample(block[0]);
+        out[i + 1] = table.sample(block[1]);
+      }
+      if (i < n) out[i] = table.sample(next());
+    }
+
+
+    /**
+     * \ingroup random
+     * Returns the stream of the calling thread. Every thread gets its own
+     * stream id, and all the streams share the seed set by seed_streams()
+     * (or by the seed functions of random.hpp), so threads draw
+     * independent numbers without locking.
+     */
+    philox_stream& get_stream();
+
+    /**
+     * \ingroup random
+     * Sets the seed of all the thread streams, and restarts them. Should
+     * not be called while other threads draw from their streams.
+     */
+    void seed_streams(uint64_t seed_value);
+
+  }; // end of random
+}; // end of graphlab
+
+#endif
@@ -23,6 +23,8 @@
 
 #include <limits>
 #include <string>
+#include <cstring>
+#include <algorithm>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
@@ -56,6 +58,145 @@ void trace_count::print(std::ostream& out, unsigned long long tpersec) const {
 }
 
 
+trace_histogram::histogram::histogram() {
+  clear();
+}
+
+void trace_histogram::histogram::clear() {
+  count = 0;
+  total = 0;
+  minimum = std::numeric_limits<unsigned long long>::max();
+  maximum = 0;
+  memset(counts, 0, sizeof(counts));
+}
+
+trace_histogram::histogram& trace_histogram::allocate_histogram(size_t slot) {
+  histogram* h = new histogram;
+  if (!atomic_compare_and_swap(slots[slot], (histogram*)NULL, h)) {
+    // another thread sharing the slot got there first
+    delete h;
+  }
+  return *slots[slot];
+}
+
+void trace_histogram::merge(histogram& out) const {
+  for (size_t i = 0;i < slots.size(); ++i) {
+    const histogram* h = slots[i];
+    if (h == NULL) continue;
+    h->lock.lock();
+    out.count += h->count;
+    out.total += h->total;
+    out.minimum = std::min(out.minimum, h->minimum);
+    out.maximum = std::max(out.maximum, h->maximum);
+    for (size_t b = 0;b < NUM_BUCKETS; ++b) out.counts[b] += h->counts[b];
+    h->lock.unlock();
+  }
+}
+
+void trace_histogram::incorporate(const trace_histogram& val) {
+  histogram merged;
+  val.merge(merged);
+  histogram& h = local_histogram();
+  h.lock.lock();
+  h.count += merged.count;
+  h.total += merged.total;
+  h.minimum = std::min(h.minimum, merged.minimum);
+  h.maximum = std::max(h.maximum, merged.maximum);
+  for (size_t b = 0;b < NUM_BUCKETS; ++b) h.counts[b] += merged.counts[b];
+  h.lock.unlock();
+}
+
+unsigned long long trace_histogram::count() const {
+  unsigned long long ret = 0;
+  for (size_t i = 0;i < slots.size(); ++i) {
+    if (slots[i] != NULL) ret += slots[i]->count;
+  }
+  return ret;
+}
+
+unsigned long long trace_histogram::total() const {
+  unsigned long long ret = 0;
+  for (size_t i = 0;i < slots.size(); ++i) {
+    if (slots[i] != NULL) ret += slots[i]->total;
+  }
+  return ret;
+}
+
+unsigned long long trace_histogram::minimum() const {
+  histogram merged;
+  merge(merged);
+  return merged.count == 0 ? 0 : merged.minimum;
+}
+
+unsigned long long trace_histogram::maximum() const {
+  histogram merged;
+  merge(merged);
+  return merged.maximum;
+}
+
+/// Finds the upper end of the bucket holding the quantile of h
+static unsigned long long histogram_percentile(
+    const unsigned long long* counts, size_t numbuckets,
+    unsigned long long count, unsigned long long maximum, double quantile) {
+  if (count == 0) return 0;
+  // rank of the event, counting from 1
+  unsigned long long rank = (unsigned long long)(quantile * count + 0.5);
+  if (rank == 0) rank = 1;
+  if (rank > count) rank = count;
+  unsigned long long seen = 0;
+  for (size_t b = 0;b < numbuckets; ++b) {
+    seen += counts[b];
+    if (seen >= rank) return std::min(trace_histogram::bucket_max(b), maximum);
+  }
+  return maximum;
+}
+
+unsigned long long trace_histogram::percentile(double quantile) const {
+  histogram merged;
+  merge(merged);
+  return histogram_percentile(merged.counts, NUM_BUCKETS,
+                              merged.count, merged.maximum, quantile);
+}
+
+void trace_histogram::clear() {
+  for (size_t i = 0;i < slots.size(); ++i) {
+    histogram* h = slots[i];
+    if (h == NULL) continue;
+    h->lock.lock();
+    h->clear();
+    h->lock.unlock();
+  }
+}
+
+/// Prints a time in ticks, or in ms if the tick rate is known
+static void print_ticks(std::ostream& out, unsigned long long ticks,
+                        unsigned long long tpersec) {
+  if (tpersec == 0) out << ticks << " ticks \n";
+  else out << (double)ticks / ((double)tpersec / 1000) << " ms \n";
+}
+
+void trace_histogram::print(std::ostream& out, unsigned long long tpersec) const {
+  histogram merged;
+  merge(merged);
+  const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  const char* labels[] = {"p50", "p90", "p99", "p99.9"};
+  out << name << ": " << description << "\n";
+  out << "Events:\t" << merged.count << "\n";
+  out << "Total:\t"; print_ticks(out, merged.total, tpersec);
+  if (merged.count > 0) {
+    out << "Mean:\t"; print_ticks(out, merged.total / merged.count, tpersec);
+    out << "Min:\t"; print_ticks(out, merged.minimum, tpersec);
+    for (size_t i = 0;i < 4; ++i) {
+      out << labels[i] << ":\t";
+      print_ticks(out, histogram_percentile(merged.counts, NUM_BUCKETS,
+                                            merged.count, merged.maximum,
+                                            quantiles[i]), tpersec);
+    }
+    out << "Max:\t"; print_ticks(out, merged.maximum, tpersec);
+  }
+}
+
+
 static mutex printlock;
 
 trace_count::~trace_count() {
@@ -67,5 +208,16 @@ trace_count::~trace_count() {
 #endif
 }
 
-} // namespace graphlab
+trace_histogram::~trace_histogram() {
+#ifdef USE_TRACEPOINT
+  if (print_on_destruct) {
+    printlock.lock();
+    print(std::cout, estimate_ticks_per_second());
+    std::cout.flush();
+    printlock.unlock();
+  }
+#endif
+  for (size_t i = 0;i < slots.size(); ++i) delete slots[i];
+}
 
+} // namespace graphlab
@@ -30,6 +30,8 @@
 #include <graphlab/util/branch_hints.hpp>
 #include <graphlab/parallel/atomic.hpp>
 #include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/reducer.hpp>
 
 namespace graphlab{
 
@@ -116,6 +118,173 @@ struct trace_count{
   void print(std::ostream& out, unsigned long long tpersec = 0) const;
 };
 
+
+/**
+ * A tracer which records the distribution of the event times in addition
+ * to count/total/min/max, so that tail latencies can be reported.
+ *
+ * Values are counted in log-linear buckets as in an HDR histogram: every
+ * power of two range is split into 32 sub-buckets, so a reported
+ * percentile is within about 3% of the true value. Every thread counts
+ * into its own histogram (the slot is picked as in \ref reducer), which
+ * avoids the shared cache lines and CAS loops of trace_count on the hot
+ * path; the histograms are merged when read.
+ *
+ * It has the same interface as trace_count and is declared with
+ * DECLARE_HISTOGRAM_TRACER(name). It can also be used directly:
+ * \code
+ * trace_histogram latency("query_latency", "query time", false);
+ * unsigned long long start = rdtsc();
+ * ...
+ * latency.incorporate(rdtsc() - start);
+ * latency.percentile(0.99); // in ticks
+ * \endcode
+ */
+struct trace_histogram {
+  /// Number of sub-buckets per power of two is 2^SUB_BUCKET_BITS
+  static const size_t SUB_BUCKET_BITS = 5;
+  static const size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  /// Values below SUB_BUCKETS are exact, the rest is logarithmic up to 2^64
+  static const size_t NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  std::string name;
+  std::string description;
+  bool print_on_destruct;
+
+  inline trace_histogram(std::string name = "",
+                         std::string description = "",
+                         bool print_on_destruct = true,
+                         size_t num_slots = 0):
+      name(name), description(description),
+      print_on_destruct(print_on_destruct) {
+    if (num_slots == 0) num_slots = 2 * thread::cpu_count();
+    size_t n = 1;
+    while (n < num_slots) n *= 2;
+    slots.resize(n, NULL);
+    mask = n - 1;
+  }
+
+  /**
+   * Initializes the tracer with a name, a description
+   * and whether to print on destruction
+   */
+  inline void initialize(std::string n,
+                         std::string desc,
+                         bool print_out = true) {
+    name = n;
+    description = desc;
+    print_on_destruct = print_out;
+  }
+
+  /// Returns the bucket counting the value
+  static inline size_t bucket_of(unsigned long long val) {
+    if (val < SUB_BUCKETS) return val;
+    size_t exponent = 63 - __builtin_clzll(val);
+    size_t shift = exponent - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + ((val >> shift) & (SUB_BUCKETS - 1));
+  }
+
+  /// Returns the largest value counted by the bucket
+  static inline unsigned long long bucket_max(size_t bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    size_t shift = bucket / SUB_BUCKETS - 1;
+    unsigned long long low =
+        (unsigned long long)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return low + ((1ULL << shift) - 1);
+  }
+
+  /**
+   * Adds an event time to the trace
+   */
+  inline void incorporate(unsigned long long val)  __attribute__((always_inline)) {
+    histogram& h = local_histogram();
+    h.lock.lock();
+    ++h.counts[bucket_of(val)];
+    ++h.count;
+    h.total += val;
+    if (val < h.minimum) h.minimum = val;
+    if (val > h.maximum) h.maximum = val;
+    h.lock.unlock();
+  }
+
+  /**
+   * Adds the events in a second tracer to the current tracer.
+   */
+  void incorporate(const trace_histogram& val);
+
+  /**
+   * Adds the events in a second tracer to the current tracer.
+   */
+  inline trace_histogram& operator+=(const trace_histogram& val) {
+    incorporate(val);
+    return *this;
+  }
+
+  /// Number of events
+  unsigned long long count() const;
+
+  /// Sum of the event times
+  unsigned long long total() const;
+
+  /// Smallest event time. 0 if there are no events.
+  unsigned long long minimum() const;
+
+  /// Largest event time. 0 if there are no events.
+  unsigned long long maximum() const;
+
+  /**
+   * Returns the event time at the given quantile (e.g. 0.99 for p99),
+   * as the upper end of the bucket holding it. 0 if there are no events.
+   */
+  unsigned long long percentile(double quantile) const;
+
+  /// Removes all events
+  void clear();
+
+  /**
+   * Destructor. Will print to cout if initialize() is called
+   * with "true" as the 3rd argument
+   */
+  ~trace_histogram();
+
+  /**
+   * Prints the tracer counts and the p50, p90, p99 and p99.9 times.
+   * Times are converted to ms if tpersec is not 0.
+   */
+  void print(std::ostream& out, unsigned long long tpersec = 0) const;
+
+ private:
+  struct histogram {
+    mutable simple_spinlock lock;
+    unsigned long long count;
+    unsigned long long total;
+    unsigned long long minimum;
+    unsigned long long maximum;
+    unsigned long long counts[NUM_BUCKETS];
+    histogram();
+    void clear();
+  };
+  // slot i is allocated on first use by a thread of index i
+  std::vector<histogram*> slots;
+  size_t mask;
+
+  histogram& allocate_histogram(size_t slot);
+
+  inline histogram& local_histogram() {
+    size_t i = reducer_impl::thread_index() & mask;
+    histogram* h = slots[i];
+    if (__unlikely__(h == NULL)) return allocate_histogram(i);
+    return *h;
+  }
+
+  /// Merges all the slots into out
+  void merge(histogram& out) const;
+
+  // not copyable
+  trace_histogram(const trace_histogram&);
+  trace_histogram& operator=(const trace_histogram&);
+};
+
 } // namespace
 
 /**
@@ -141,6 +310,11 @@ struct trace_count{
  * This initializes the tracer "name" with a description, and
  * configures the tracer to NOT print when the tracer "name" is destroyed.
  *
+ * DECLARE_HISTOGRAM_TRACER(name)
+ * Same as DECLARE_TRACER but creates a graphlab::trace_histogram, which
+ * also reports latency percentiles. All the macros below work with either.
+ *
+ *
  * BEGIN_TRACEPOINT(name)
  * END_TRACEPOINT(name)
  * The object with name "name" created by DECLARE_TRACER must be in scope.
@@ -162,6 +336,7 @@ Example Usage:
 
 #ifdef USE_TRACEPOINT
 #define DECLARE_TRACER(name) graphlab::trace_count name;
+#define DECLARE_HISTOGRAM_TRACER(name) graphlab::trace_histogram name;
 
 #define INITIALIZE_TRACER(name, description) name.initialize(#name, description);
 #define INITIALIZE_TRACER_NO_PRINT(name, description) name.initialize(#name, description, false);
@@ -182,6 +357,7 @@ Example Usage:
 #define STORE_ACCUMULATING_TRACEPOINT(name) name.incorporate(__ ## name ## _acc_trace_);
 #else
 #define DECLARE_TRACER(name)
+#define DECLARE_HISTOGRAM_TRACER(name)
 #define INITIALIZE_TRACER(name, description)
 #define INITIALIZE_TRACER_NO_PRINT(name, description) 
 
@@ -25,6 +25,8 @@
 #define GRAPHLAB_UTIL_UNION_FIND_HPP
 #include <vector>
 #include <utility>
+#include <algorithm>
+#include <stdint.h>
 #include <graphlab/parallel/atomic.hpp>
 
 namespace graphlab {
@@ -88,74 +90,72 @@ class union_find {
 };
 
 
+/**
+ * A union-find which supports concurrent merge() and find() without
+ * locks (Anderson and Woll; Jayanti and Tarjan).
+ *
+ * Sets are linked by index: merge() hooks the larger of the two roots
+ * under the smaller one with a compare and swap, retrying if either root
+ * was hooked elsewhere meanwhile. The root of a set is therefore always
+ * its smallest element, whatever the order of the merges. find() does
+ * path splitting: every element on the path is pointed to its
+ * grandparent with a compare and swap, which may fail harmlessly.
+ *
+ * IDType must be an unsigned integer type. init() and size() must not
+ * run concurrently with the other operations.
+ */
+template <typename IDType = uint32_t>
 class concurrent_union_find {
   private:
-    union elem{
-      struct {
-        uint32_t next;
-        uint32_t rank;
-      } d;
-      uint64_t val;
-    };
-    
-    std::vector<elem> setid;
+    std::vector<IDType> parent;
 
-    bool is_root(uint32_t i) {
-      return setid[i].d.next == i;
-    }
-
-    bool updateroot(uint32_t x, uint32_t oldrank,
-                    uint32_t y, uint32_t newrank) {
-      elem old; old.d.next = x; old.d.rank = oldrank;
-      elem newval; newval.d.next = y; newval.d.rank = newrank;
-      return atomic_compare_and_swap(setid[x].val, old.val, newval.val);
-    }
-    
   public:
     concurrent_union_find() { }
-    void init(uint32_t s) {
-      setid.resize((size_t)s);
-      for (size_t i = 0; i < setid.size() ;++i) {
-        setid[i].d.next = (uint32_t)(i);
-        setid[i].d.rank = 0;
-      }
-    }
 
-    void merge(uint32_t x, uint32_t y) {
+    explicit concurrent_union_find(size_t s) { init(s); }
 
-      uint32_t xr, yr;
-      while(1) {
-        x = find(x);
-        y = find(y);
-        if (x == y) return;
-        xr = setid[x].d.rank;
-        yr = setid[y].d.rank;
+    void init(size_t s) {
+      parent.resize(s);
+      for (size_t i = 0; i < parent.size(); ++i) parent[i] = (IDType)i;
+    }
 
-        if (xr > yr || (xr == yr && x > y)) {
-          std::swap(x,y); std::swap(xr, yr);
-        }
+    size_t size() const { return parent.size(); }
 
-        if (updateroot(x, xr, y, xr)) break;
-      }
-      if (xr == yr) {
-        __sync_add_and_fetch(&(setid[y].d.rank), 1);
+    /// Returns true if x is the root, i.e. the smallest element, of its set
+    bool is_root(IDType x) const { return parent[x] == x; }
+
+    /// Returns the root of the set of x
+    IDType find(IDType x) {
+      while (true) {
+        IDType p = parent[x];
+        if (p == x) return x;
+        IDType gp = parent[p];
+        if (p != gp) atomic_compare_and_swap(parent[x], p, gp);
+        x = p;
       }
     }
 
-    uint32_t find(uint32_t x) {
-      if (is_root(x)) return x;
-      
-      uint32_t y = x;
-      // get the id of the root element
-      while (!is_root(x)) { x = setid[x].d.next; }
+    /// Merges the sets of x and y. Returns false if they were already merged.
+    bool merge(IDType x, IDType y) {
+      while (true) {
+        x = find(x);
+        y = find(y);
+        if (x == y) return false;
+        if (x < y) std::swap(x, y);
+        // x may have been hooked since find(); the swap fails then
+        if (atomic_compare_and_swap(parent[x], x, y)) return true;
+      }
+    }
 
-      // update the parents and ranks all the way up
-      while (setid[y].d.rank < setid[x].d.rank) {
-        uint32_t t = setid[y].d.next;
-        atomic_compare_and_swap(setid[y].d.next, t, x);
-        y = setid[t].d.next;
+    /// Returns true if x and y are in the same set
+    bool same_set(IDType x, IDType y) {
+      while (true) {
+        x = find(x);
+        y = find(y);
+        if (x == y) return true;
+        // x is still a root: the sets were disjoint when y was found
+        if (parent[x] == x) return false;
       }
-      return x;
     }
 };
 }
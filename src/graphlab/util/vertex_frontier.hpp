@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_UTIL_VERTEX_FRONTIER_HPP
+#define GRAPHLAB_UTIL_VERTEX_FRONTIER_HPP
+#include <vector>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/thread_pool.hpp>
+
+namespace graphlab {
+
+/**
+ * \ingroup util
+ * A set of active vertices (local ids in [0, num_vertices)), e.g. the
+ * frontier of a BFS or the vertices to run in the next iteration of an
+ * engine.
+ *
+ * Like the vertex subsets of direction optimizing BFS, the frontier is
+ * sparse (a list of ids) while it is small, and dense (a bitset scanned
+ * word by word) once it holds more than a fraction dense_threshold of
+ * the vertices. An engine can then pick a push (sparse) or pull (dense)
+ * strategy with is_dense().
+ *
+ * The bitset is maintained in both cases, so that add() deduplicates
+ * and contains() is O(1). The id list is preallocated up to the
+ * threshold, so add() is lock free and safe from any thread: it sets
+ * the bit and, in sparse mode, appends the id with an atomic counter.
+ * When the list overflows, the frontier turns dense. The other
+ * operations must not run concurrently with add().
+ */
+class vertex_frontier {
+ public:
+  /**
+   * Creates an empty frontier over num_vertices vertices, which turns
+   * dense above dense_threshold * num_vertices vertices.
+   */
+  explicit vertex_frontier(size_t num_vertices = 0, double dense_threshold = 0.05)
+      : threshold(dense_threshold) {
+    resize(num_vertices);
+  }
+
+  /// Resizes the frontier to num_vertices vertices and clears it
+  void resize(size_t num_vertices) {
+    bits.resize(num_vertices);
+    bits.clear();
+    max_sparse = size_t(threshold * num_vertices) + 1;
+    ids.resize(max_sparse);
+    count.value = 0;
+    dense = false;
+  }
+
+  size_t num_vertices() const { return bits.size(); }
+
+  /// Returns the number of vertices in the frontier
+  size_t size() const { return count.value; }
+
+  bool empty() const { return count.value == 0; }
+
+  /// Returns true if the frontier is represented as a bitset
+  bool is_dense() const { return dense; }
+
+  bool contains(size_t vid) const { return bits.get(vid); }
+
+  /**
+   * Adds vid to the frontier. Returns true if it was not already in.
+   * Safe to call concurrently.
+   */
+  inline bool add(size_t vid) {
+    if (bits.set_bit(vid)) return false;
+    size_t pos = count.inc_ret_last();
+    if (pos < max_sparse) ids[pos] = vid;
+    else dense = true;
+    return true;
+  }
+
+  /// Removes all the vertices
+  void clear() {
+    if (dense) {
+      bits.clear();
+    } else {
+      for (size_t i = 0; i < count.value; ++i) bits.clear_bit_unsync(ids[i]);
+    }
+    count.value = 0;
+    dense = false;
+  }
+
+  /// Removes all the vertices, clearing a dense bitset in parallel
+  void clear(thread_pool& pool) {
+    if (dense) {
+      pool.parallel_for(0, num_blocks(),
+                        boost::bind(&vertex_frontier::clear_blocks, this, _1, _2));
+      count.value = 0;
+      dense = false;
+    } else {
+      clear();
+    }
+  }
+
+  /// Adds all the vertices
+  void fill() {
+    bits.fill();
+    count.value = num_vertices();
+    dense = count.value >= max_sparse;
+    if (!dense) {
+      for (size_t i = 0; i < count.value; ++i) ids[i] = i;
+    }
+  }
+
+  /**
+   * Calls fn(vid) on every vertex of the frontier: in the order they were
+   * added if sparse, in increasing order if dense.
+   */
+  template <typename Fn>
+  void foreach(Fn fn) const {
+    if (dense) {
+      bits.foreach_set_bit(fn);
+    } else {
+      for (size_t i = 0; i < count.value; ++i) fn(ids[i]);
+    }
+  }
+
+  /**
+   * Calls fn(vid) on every vertex of the frontier in parallel on the pool.
+   * fn must be thread safe. It may add vertices to another frontier.
+   */
+  template <typename Fn>
+  void parallel_foreach(thread_pool& pool, Fn fn) const {
+    if (dense) {
+      pool.parallel_for(0, num_blocks(),
+                        boost::bind(&vertex_frontier::template foreach_dense_blocks<Fn>,
+                                    this, &fn, _1, _2));
+    } else {
+      pool.parallel_for(0, count.value,
+                        boost::bind(&vertex_frontier::template foreach_sparse<Fn>,
+                                    this, &fn, _1, _2));
+    }
+  }
+
+  /**
+   * Turns a dense frontier which holds fewer vertices than the threshold
+   * back into a sparse one, listing the ids in increasing order.
+   */
+  void update_representation() {
+    if (dense && count.value < max_sparse) {
+      size_t n = 0;
+      bits.foreach_set_bit(append_id(&ids[0], &n));
+      dense = false;
+    }
+  }
+
+  /// Sorts the ids of a sparse frontier, e.g. for locality
+  void sort() {
+    if (!dense) std::sort(ids.begin(), ids.begin() + count.value);
+  }
+
+  /// Returns the bitset of the frontier, valid in both representations
+  const dense_bitset& get_bitset() const { return bits; }
+
+  void swap(vertex_frontier& other) {
+    bits.swap(other.bits);
+    ids.swap(other.ids);
+    std::swap(count.value, other.count.value);
+    std::swap(max_sparse, other.max_sparse);
+    std::swap(threshold, other.threshold);
+    std::swap(dense, other.dense);
+  }
+
+ private:
+  // parallel operations on the bitset work on blocks of 4096 bits
+  static const size_t BLOCK_BITS = 4096;
+
+  dense_bitset bits;
+  std::vector<size_t> ids;
+  atomic<size_t> count;
+  size_t max_sparse;
+  double threshold;
+  bool dense;
+
+  struct append_id {
+    size_t* out; size_t* n;
+    append_id(size_t* out, size_t* n): out(out), n(n) { }
+    void operator()(size_t b) const { out[(*n)++] = b; }
+  };
+
+  size_t num_blocks() const {
+    return (num_vertices() + BLOCK_BITS - 1) / BLOCK_BITS;
+  }
+
+  void clear_blocks(size_t begin, size_t end) {
+    bits.clear(begin * BLOCK_BITS, std::min(end * BLOCK_BITS, num_vertices()));
+  }
+
+  template <typename Fn>
+  void foreach_dense_blocks(Fn* fn, size_t begin, size_t end) const {
+    bits.foreach_set_bit(begin * BLOCK_BITS, std::min(end * BLOCK_BITS, num_vertices()), *fn);
+  }
+
+  template <typename Fn>
+  void foreach_sparse(Fn* fn, size_t begin, size_t end) const {
+    for (size_t i = begin; i < end; ++i) (*fn)(ids[i]);
+  }
+
+  // not copyable
+  vertex_frontier(const vertex_frontier&);
+  vertex_frontier& operator=(const vertex_frontier&);
+};
+
+} // namespace graphlab
+#endif
@@ -0,0 +1,72 @@
+#include <iostream>
+#include <cstdlib>
+#include <graphlab/util/bloom_filter.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks that bloom_filter has no false negatives, a false positive rate
+ * close to the expected one, and survives merging and serialization.
+ * Measures the lookup throughput.
+ * Usage: bloom_filter_test [num_keys]
+ */
+
+int main(int argc, char** argv) {
+  size_t n = 1000000;
+  if (argc > 1) n = atol(argv[1]);
+
+  // keys 0, 2, 4, ... go to a, 1, 3, 5, ... to b
+  bloom_filter a(n), b(n);
+  for (size_t i = 0;i < n; ++i) {
+    a.insert(2 * i);
+    b.insert(2 * i + 1);
+  }
+  size_t false_positives = 0;
+  for (size_t i = 0;i < n; ++i) {
+    ASSERT_TRUE(a.may_contain(2 * i));
+    ASSERT_TRUE(b.may_contain(2 * i + 1));
+    false_positives += a.may_contain(2 * i + 1);
+  }
+  double fpp = double(false_positives) / n;
+  std::cout << "10 bits per key: " << a.size_bytes() << " bytes, "
+            << "false positive rate " << fpp << "\n";
+  ASSERT_LT(fpp, 0.02);
+  ASSERT_LT(a.fill_ratio(), 0.6);
+
+  // the merged filter holds both sets
+  bloom_filter merged = a;
+  merged.merge(b);
+  for (size_t i = 0;i < 2 * n; ++i) ASSERT_TRUE(merged.may_contain(i));
+
+  // serialization keeps the geometry and the bits
+  std::stringstream strm;
+  oarchive oarc(strm);
+  oarc << b;
+  strm.flush();
+  iarchive iarc(strm);
+  bloom_filter loaded;
+  iarc >> loaded;
+  ASSERT_EQ(loaded.size_bytes(), b.size_bytes());
+  for (size_t i = 0;i < n; ++i) {
+    ASSERT_TRUE(loaded.may_contain(2 * i + 1));
+    ASSERT_EQ(loaded.may_contain(2 * i), b.may_contain(2 * i));
+  }
+
+  a.clear();
+  ASSERT_EQ(a.fill_ratio(), 0);
+  ASSERT_FALSE(a.may_contain(0));
+
+  // an empty filter is one block and rejects everything
+  bloom_filter empty;
+  ASSERT_EQ(empty.size_bytes(), 64);
+  ASSERT_FALSE(empty.may_contain(42));
+
+  timer ti; ti.start();
+  size_t found = 0;
+  for (size_t i = 0;i < 4 * n; ++i) found += merged.may_contain(i * 7);
+  double elapsed = ti.current_time();
+  std::cout << 4 * n / elapsed / 1e6 << " M lookups/s (" << found << " found)\n";
+  std::cout << "Done\n";
+}
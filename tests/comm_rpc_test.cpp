@@ -0,0 +1,168 @@
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <boost/bind.hpp>
+#include <graphlab/comm/comm_base.hpp>
+#include <graphlab/comm/comm_rpc.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/event_trace.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks comm_rpc messages, request / reply round trips (plain and
+ * scatter-gather replies) and the request id carried by traced messages,
+ * over a single machine comm which delivers every message to itself.
+ */
+
+class loopback_comm: public comm_base {
+ private:
+  mutex lock;
+  std::deque<std::pair<char*, size_t> > messages;
+ public:
+  ~loopback_comm() {
+    for (size_t i = 0; i < messages.size(); ++i) free(messages[i].first);
+  }
+  void send(int targetmachine, void* data, size_t length) {
+    char* copy = (char*)malloc(length);
+    memcpy(copy, data, length);
+    send_relinquish(targetmachine, copy, length);
+  }
+  void send_relinquish(int targetmachine, void* data, size_t length) {
+    ASSERT_EQ(targetmachine, 0);
+    lock.lock();
+    messages.push_back(std::make_pair((char*)data, length));
+    lock.unlock();
+  }
+  void* receive(int* sourcemachine, size_t* length) {
+    lock.lock();
+    char* ret = NULL;
+    if (!messages.empty()) {
+      ret = messages.front().first;
+      *length = messages.front().second;
+      messages.pop_front();
+    }
+    lock.unlock();
+    *sourcemachine = 0;
+    return ret;
+  }
+  void flush() { }
+  void barrier() { }
+  int size() const { return 1; }
+  int rank() const { return 0; }
+  bool has_efficient_send() const { return true; }
+};
+
+enum { NOTIFY = 1, SQUARE = 2, ECHO = 3, REQUEST_ID = 4 };
+
+atomic<size_t> notified;
+
+void notify_handler(comm_rpc* rpc, int source, const char* msg, size_t len) {
+  iarchive iarc(msg, len);
+  size_t value;
+  iarc >> value;
+  notified.inc(value);
+}
+
+void square_handler(comm_rpc* rpc, int source, const char* msg, size_t len) {
+  iarchive iarc(msg, len);
+  size_t handle, value;
+  iarc >> handle >> value;
+  oarchive* oarc = rpc->prepare_reply(handle);
+  (*oarc) << value * value;
+  rpc->complete_message(source, oarc);
+}
+
+atomic<size_t> echo_sent;
+void count_sent() { echo_sent.inc(); }
+
+void echo_handler(comm_rpc* rpc, int source, const char* msg, size_t len) {
+  // the reply references the strings of the request until it is sent
+  iarchive iarc(msg, len);
+  size_t handle;
+  std::vector<std::string> strs;
+  iarc >> handle >> strs;
+  oarchive* oarc = rpc->prepare_scatter_reply(handle);
+  (*oarc) << strs;
+  rpc->complete_message(source, oarc, count_sent);
+}
+
+void request_id_handler(comm_rpc* rpc, int source, const char* msg, size_t len) {
+  iarchive iarc(msg, len);
+  size_t handle;
+  iarc >> handle;
+  uint64_t request_id = event_trace::current_request_id();
+  oarchive* oarc = rpc->prepare_reply(handle);
+  (*oarc) << request_id;
+  rpc->complete_message(source, oarc);
+}
+
+template <typename T>
+T parse_reply(const future<std::string>& reply) {
+  const std::string& str = reply.get();
+  iarchive iarc(str.c_str(), str.length());
+  T ret;
+  iarc >> ret;
+  return ret;
+}
+
+int main(int argc, char** argv) {
+  loopback_comm comm;
+  comm_rpc rpc(&comm);
+  rpc.register_handler(NOTIFY, notify_handler);
+  rpc.register_handler(SQUARE, square_handler);
+  rpc.register_handler(ECHO, echo_handler);
+  rpc.register_handler(REQUEST_ID, request_id_handler);
+
+  // messages without replies
+  for (size_t i = 1; i <= 100; ++i) {
+    oarchive* oarc = rpc.prepare_message(NOTIFY);
+    (*oarc) << i;
+    rpc.complete_message(0, oarc);
+  }
+  size_t copied = 1000;
+  rpc.send_message(0, NOTIFY, reinterpret_cast<const char*>(&copied), sizeof(copied));
+
+  // many requests in flight
+  const size_t nrequests = 1000;
+  std::vector<future<std::string> > replies(nrequests);
+  for (size_t i = 0; i < nrequests; ++i) {
+    oarchive* oarc = rpc.prepare_request(SQUARE, replies[i]);
+    (*oarc) << i;
+    rpc.complete_message(0, oarc);
+  }
+  for (size_t i = 0; i < nrequests; ++i) {
+    ASSERT_EQ(parse_reply<size_t>(replies[i]), i * i);
+  }
+  while (notified.value != 6050) usleep(1000);
+
+  // a scatter-gather reply of large strings
+  std::vector<std::string> strs;
+  for (size_t i = 0; i < 100; ++i) strs.push_back(std::string(100 + i, 'a' + i % 26));
+  future<std::string> echo;
+  oarchive* oarc = rpc.prepare_request(ECHO, echo);
+  (*oarc) << strs;
+  rpc.complete_message(0, oarc);
+  ASSERT_TRUE(parse_reply<std::vector<std::string> >(echo) == strs);
+  while (echo_sent.value != 1) usleep(1000);
+
+  // the handler runs within the request of the sender
+  future<std::string> untraced, traced;
+  oarc = rpc.prepare_request(REQUEST_ID, untraced);
+  rpc.complete_message(0, oarc);
+  ASSERT_EQ(parse_reply<uint64_t>(untraced), 0);
+  uint64_t request_id;
+  {
+    request_id = event_trace::new_request_id();
+    trace_request_scope request(request_id);
+    oarc = rpc.prepare_request(REQUEST_ID, traced);
+    rpc.complete_message(0, oarc);
+  }
+  ASSERT_NE(request_id, 0);
+  ASSERT_EQ(parse_reply<uint64_t>(traced), request_id);
+  std::cout << "Done\n";
+}
@@ -0,0 +1,161 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/util/concurrent_cache.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks the CLOCK eviction, the size accounting and the admission policy
+ * of concurrent_cache, then measures the throughput and hit ratio of
+ * threads sharing a cache under a skewed workload (get, put on miss).
+ * Usage: concurrent_cache_test [nthreads] [ops_per_thread]
+ */
+
+typedef concurrent_cache<size_t, size_t> cache_type;
+
+struct string_size {
+  size_t operator()(size_t, const std::string& s) const { return s.size(); }
+};
+
+const size_t NUM_KEYS = 1000000;
+const size_t NUM_HOT = 1000;
+
+// 90% of the accesses go to NUM_HOT keys
+inline size_t next_key(size_t& state) {
+  state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+  return (state % 10 < 9) ? (state >> 8) % NUM_HOT : (state >> 8) % NUM_KEYS;
+}
+
+void run_workload(cache_type* cache, size_t nops, size_t seed) {
+  size_t state = seed * 0x9E3779B97F4A7C15ULL + 1;
+  for (size_t i = 0;i < nops; ++i) {
+    size_t key = next_key(state), value;
+    if (cache->get(key, value)) {
+      ASSERT_EQ(value, key * 2);
+    } else {
+      cache->put(key, key * 2);
+    }
+  }
+}
+
+// scans many keys once each, interleaved with accesses to the hot keys,
+// in a cache which fits only the hot keys. Returns the number of hot keys
+// left in the cache.
+size_t scan_resistance(bool admission) {
+  cache_type cache(NUM_HOT * 2 * sizeof(size_t), 1, admission);
+  size_t value;
+  for (size_t i = 0;i < NUM_HOT; ++i) {
+    if (!cache.get(i, value)) cache.put(i, i * 2);
+  }
+  for (size_t i = NUM_HOT; i < 100 * NUM_HOT; ++i) {
+    if (!cache.get(i, value)) cache.put(i, i * 2);
+    size_t hot = i % NUM_HOT;
+    if (!cache.get(hot, value)) cache.put(hot, hot * 2);
+  }
+  size_t ret = 0;
+  for (size_t i = 0;i < NUM_HOT; ++i) ret += cache.contains(i);
+  return ret;
+}
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  size_t nops = 1000000;
+  if (argc > 1) nthreads = atoi(argv[1]);
+  if (argc > 2) nops = atol(argv[2]);
+  const size_t entry = 2 * sizeof(size_t);
+
+  // CLOCK: a hit protects an entry from the next sweep
+  {
+    cache_type cache(10 * entry, 1, false);
+    for (size_t i = 0;i < 10; ++i) ASSERT_TRUE(cache.put(i, i * 2));
+    ASSERT_EQ(cache.size(), 10);
+    ASSERT_EQ(cache.bytes(), 10 * entry);
+    size_t value;
+    for (size_t i = 0;i < 9; ++i) ASSERT_TRUE(cache.get(i, value));
+    ASSERT_TRUE(cache.put(10, 20));
+    ASSERT_EQ(cache.size(), 10);
+    ASSERT_FALSE(cache.contains(9));
+    ASSERT_TRUE(cache.get(10, value));
+    ASSERT_EQ(value, 20);
+    // updates keep the size
+    ASSERT_TRUE(cache.put(0, 100));
+    ASSERT_TRUE(cache.get(0, value));
+    ASSERT_EQ(value, 100);
+    ASSERT_EQ(cache.size(), 10);
+    ASSERT_TRUE(cache.erase(0));
+    ASSERT_FALSE(cache.erase(0));
+    ASSERT_EQ(cache.bytes(), 9 * entry);
+    cache_stats stats = cache.stats();
+    ASSERT_EQ(stats.hits, 11);
+    ASSERT_EQ(stats.inserts, 11);
+    ASSERT_EQ(stats.updates, 1);
+    ASSERT_EQ(stats.evictions, 1);
+    cache.clear();
+    ASSERT_TRUE(cache.empty());
+    ASSERT_EQ(cache.bytes(), 0);
+  }
+
+  // size in bytes
+  {
+    concurrent_cache<size_t, std::string, string_size> cache(100, 1, false);
+    ASSERT_FALSE(cache.put(0, std::string(101, 'a')));
+    ASSERT_TRUE(cache.put(1, std::string(60, 'a')));
+    ASSERT_TRUE(cache.put(2, std::string(30, 'a')));
+    ASSERT_EQ(cache.bytes(), 90);
+    ASSERT_TRUE(cache.put(3, std::string(50, 'a')));
+    ASSERT_LE(cache.bytes(), 100);
+    ASSERT_TRUE(cache.contains(3));
+    // growing an entry evicts others
+    ASSERT_TRUE(cache.put(3, std::string(90, 'a')));
+    ASSERT_EQ(cache.size(), 1);
+    ASSERT_EQ(cache.bytes(), 90);
+    ASSERT_EQ(cache.stats().rejects, 1);
+  }
+  // an update never evicts the entry it stores, even when the sweep has
+  // to clear every referenced bit first
+  for (size_t first = 0; first < 2; ++first) {
+    concurrent_cache<size_t, std::string, string_size> cache(100, 1, false);
+    ASSERT_TRUE(cache.put(1, std::string(40, 'a')));
+    ASSERT_TRUE(cache.put(2, std::string(40, 'a')));
+    std::string value;
+    ASSERT_TRUE(cache.get(1, value));
+    ASSERT_TRUE(cache.get(2, value));
+    size_t key = first ? 1 : 2;
+    ASSERT_TRUE(cache.put(key, std::string(70, 'b')));
+    ASSERT_TRUE(cache.get(key, value));
+    ASSERT_EQ(value, std::string(70, 'b'));
+    ASSERT_EQ(cache.size(), 1);
+    ASSERT_EQ(cache.bytes(), 70);
+  }
+
+  // admission keeps the frequently used keys through a scan
+  size_t kept_clock = scan_resistance(false);
+  size_t kept_tinylfu = scan_resistance(true);
+  std::cout << "hot keys kept after a scan: clock " << kept_clock
+            << ", clock + tinylfu " << kept_tinylfu << " of " << NUM_HOT << "\n";
+  ASSERT_GE(kept_tinylfu, NUM_HOT * 8 / 10);
+  ASSERT_GT(kept_tinylfu, kept_clock);
+
+  for (size_t admission = 0; admission < 2; ++admission) {
+    size_t capacity = 2 * NUM_HOT * entry;
+    cache_type cache(capacity, 0, admission);
+    thread_group group;
+    timer ti; ti.start();
+    for (size_t i = 0;i < nthreads; ++i) {
+      group.launch(boost::bind(run_workload, &cache, nops, i));
+    }
+    group.join();
+    double elapsed = ti.current_time();
+    cache_stats stats = cache.stats();
+    ASSERT_EQ(stats.hits + stats.misses, nthreads * nops);
+    ASSERT_LE(cache.bytes(), capacity);
+    std::cout << (admission ? "clock + tinylfu: " : "clock: ")
+              << nthreads * nops / elapsed / 1e6 << " M ops/s, hit ratio "
+              << stats.hit_ratio() << "\n";
+  }
+  std::cout << "Done\n";
+}
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <boost/unordered_map.hpp>
+#include <graphlab/util/concurrent_hash_map.hpp>
+#include <graphlab/util/synchronized_unordered_map.hpp>
+#include <graphlab/util/hopscotch_map.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Measures insert and mixed read/write throughput of the hash maps usable
+ * as concurrent indexes, for an increasing number of threads.
+ * Usage: concurrent_hash_map_bench [max_threads] [num_keys]
+ */
+
+size_t NUM_KEYS;
+
+// keys are strided as vertex ids within one shard would be
+inline size_t key_of(size_t i) { return i * 16 + 3; }
+
+// ---- adapters giving each map the same insert / find interface ----
+
+struct locked_unordered_map {
+  mutex lock;
+  boost::unordered_map<size_t, size_t> map;
+  void insert(size_t k, size_t v) {
+    lock.lock(); map[k] = v; lock.unlock();
+  }
+  bool find(size_t k, size_t& v) {
+    lock.lock();
+    boost::unordered_map<size_t, size_t>::iterator iter = map.find(k);
+    bool ret = iter != map.end();
+    if (ret) v = iter->second;
+    lock.unlock();
+    return ret;
+  }
+  static const char* name() { return "unordered_map + mutex"; }
+};
+
+struct striped_unordered_map {
+  synchronized_unordered_map<size_t> map;
+  striped_unordered_map(): map(64) { }
+  void insert(size_t k, size_t v) { map.insert(k, v); }
+  bool find(size_t k, size_t& v) {
+    std::pair<bool, size_t*> ret = map.find(k);
+    if (ret.first) v = *ret.second;
+    return ret.first;
+  }
+  static const char* name() { return "synchronized_unordered_map(64)"; }
+};
+
+struct sync_hopscotch_map {
+  hopscotch_map<size_t, size_t, true> map;
+  void insert(size_t k, size_t v) { map.put_sync(k, v); }
+  bool find(size_t k, size_t& v) {
+    std::pair<bool, size_t> ret = map.get_sync(k);
+    if (ret.first) v = ret.second;
+    return ret.first;
+  }
+  static const char* name() { return "hopscotch_map<Synchronized>"; }
+};
+
+struct sharded_map {
+  concurrent_hash_map<size_t, size_t> map;
+  void insert(size_t k, size_t v) { map.set(k, v); }
+  bool find(size_t k, size_t& v) { return map.find(k, v); }
+  static const char* name() { return "concurrent_hash_map"; }
+};
+
+template <typename MapType>
+void insert_range(MapType* map, size_t id, size_t nthreads) {
+  for (size_t i = id; i < NUM_KEYS; i += nthreads) map->insert(key_of(i), i);
+}
+
+template <typename MapType>
+void mixed_range(MapType* map, size_t id, size_t nthreads) {
+  // 90% lookups, 10% overwrites
+  size_t x = id * 2654435761u + 1;
+  for (size_t i = 0; i < NUM_KEYS / nthreads; ++i) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    size_t k = (x >> 17) % NUM_KEYS;
+    if ((x >> 7) % 10 == 0) {
+      map->insert(key_of(k), k);
+    } else {
+      size_t v = 0;
+      bool found = map->find(key_of(k), v);
+      ASSERT_TRUE(found);
+      ASSERT_TRUE(v == k);
+    }
+  }
+}
+
+template <typename MapType>
+double run_phase(MapType* map, size_t nthreads,
+                 void (*fn)(MapType*, size_t, size_t)) {
+  timer ti; ti.start();
+  thread_group group;
+  for (size_t i = 0;i < nthreads; ++i) {
+    group.launch(boost::bind(fn, map, i, nthreads));
+  }
+  group.join();
+  return NUM_KEYS / ti.current_time() / 1e6;
+}
+
+template <typename MapType>
+void bench(size_t max_threads) {
+  std::cout << MapType::name() << "\n";
+  for (size_t nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+    MapType* map = new MapType;
+    double insert_rate = run_phase(map, nthreads, insert_range<MapType>);
+    double mixed_rate = run_phase(map, nthreads, mixed_range<MapType>);
+    std::cout << "  " << nthreads << " threads: "
+              << insert_rate << " M inserts/s, "
+              << mixed_rate << " M ops/s (90% find)\n";
+    delete map;
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t max_threads = thread::cpu_count();
+  NUM_KEYS = 4000000;
+  if (argc > 1) max_threads = atoi(argv[1]);
+  if (argc > 2) NUM_KEYS = atol(argv[2]);
+  std::cout << NUM_KEYS << " keys, up to " << max_threads << " threads\n";
+  bench<locked_unordered_map>(max_threads);
+  bench<striped_unordered_map>(max_threads);
+  bench<sync_hopscotch_map>(max_threads);
+  bench<sharded_map>(max_threads);
+}
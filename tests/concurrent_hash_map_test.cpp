@@ -0,0 +1,155 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <boost/unordered_map.hpp>
+#include <graphlab/util/concurrent_hash_map.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/thread_pool.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks concurrent_hash_map under contention: concurrent inserts, finds,
+ * upserts and erases of the same keys, with few shards so that they
+ * rehash while other threads use them, then for_each and serialization.
+ * Usage: concurrent_hash_map_test [num_threads] [num_keys]
+ */
+
+typedef concurrent_hash_map<size_t, size_t> map_type;
+
+size_t NUM_THREADS;
+size_t NUM_KEYS;
+atomic<size_t> inserted, erased, bad_values;
+
+// every thread inserts every key; exactly one insert per key succeeds
+void insert_all(map_type* map, size_t thread_id) {
+  for (size_t i = 0; i < NUM_KEYS; ++i) {
+    size_t key = (i + thread_id * 7919) % NUM_KEYS;
+    if (map->insert(key, key * 3)) inserted.inc();
+  }
+}
+
+// finds run concurrently with the inserts and must see whole values
+void find_all(map_type* map, size_t rounds) {
+  for (size_t r = 0; r < rounds; ++r) {
+    for (size_t key = 0; key < NUM_KEYS; ++key) {
+      size_t value = 0;
+      if (map->find(key, value) && value != key * 3) bad_values.inc();
+    }
+  }
+}
+
+struct increment {
+  void operator()(size_t& value) const { ++value; }
+};
+
+void upsert_all(map_type* map) {
+  for (size_t key = 0; key < NUM_KEYS; ++key) map->upsert(key, 0, increment());
+}
+
+void erase_all(map_type* map, size_t thread_id) {
+  for (size_t i = 0; i < NUM_KEYS; ++i) {
+    size_t key = (i + thread_id * 104729) % NUM_KEYS;
+    if (map->erase(key)) erased.inc();
+  }
+}
+
+void grow(map_type* map) {
+  for (size_t n = 1; n < NUM_KEYS; n *= 2) map->reserve(n);
+}
+
+struct sum_values {
+  atomic<size_t>* sum;
+  sum_values(atomic<size_t>* sum): sum(sum) { }
+  void operator()(const size_t& key, size_t& value) const { sum->inc(value); }
+};
+
+void test_contention(size_t num_shards) {
+  map_type map(num_shards);
+  ASSERT_EQ(map.num_shards(), num_shards);
+  inserted.value = erased.value = bad_values.value = 0;
+
+  // concurrent insert and find of the same keys, with forced rehashes
+  thread_group group;
+  for (size_t t = 0; t < NUM_THREADS; ++t) {
+    group.launch(boost::bind(insert_all, &map, t));
+    group.launch(boost::bind(find_all, &map, 2));
+  }
+  group.launch(boost::bind(grow, &map));
+  group.join();
+  ASSERT_EQ(inserted.value, NUM_KEYS);
+  ASSERT_EQ(bad_values.value, 0);
+  ASSERT_EQ(map.size(), NUM_KEYS);
+  for (size_t key = 0; key < NUM_KEYS; ++key) {
+    size_t value = 0;
+    ASSERT_TRUE(map.find(key, value));
+    ASSERT_EQ(value, key * 3);
+  }
+
+  // concurrent erase of the same keys; exactly one succeeds per key
+  for (size_t t = 0; t < NUM_THREADS; ++t) {
+    group.launch(boost::bind(erase_all, &map, t));
+  }
+  group.join();
+  ASSERT_EQ(erased.value, NUM_KEYS);
+  ASSERT_TRUE(map.empty());
+
+  // concurrent upserts of the same keys count every call
+  for (size_t t = 0; t < NUM_THREADS; ++t) group.launch(boost::bind(upsert_all, &map));
+  group.join();
+  ASSERT_EQ(map.size(), NUM_KEYS);
+  atomic<size_t> sum;
+  map.for_each(sum_values(&sum));
+  ASSERT_EQ(sum.value, NUM_THREADS * NUM_KEYS);
+  thread_pool pool(NUM_THREADS);
+  sum.value = 0;
+  map.parallel_for_each(pool, sum_values(&sum));
+  ASSERT_EQ(sum.value, NUM_THREADS * NUM_KEYS);
+}
+
+void test_serialization() {
+  map_type map(4);
+  boost::unordered_map<size_t, size_t> reference;
+  for (size_t i = 0; i < 1000; ++i) {
+    map.set(i * 17, i);
+    reference[i * 17] = i;
+  }
+  // the format is the one of boost::unordered_map
+  oarchive oarc;
+  map.save(oarc);
+  iarchive iarc(oarc.buf, oarc.off);
+  boost::unordered_map<size_t, size_t> loaded;
+  iarc >> loaded;
+  ASSERT_TRUE(loaded == reference);
+
+  oarchive oarc2;
+  oarc2 << reference;
+  iarchive iarc2(oarc2.buf, oarc2.off);
+  map_type map2(2);
+  map2.set(1, 1);
+  map2.load(iarc2);
+  ASSERT_EQ(map2.size(), 1000);
+  for (size_t i = 0; i < 1000; ++i) {
+    size_t value;
+    ASSERT_TRUE(map2.find(i * 17, value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_FALSE(map2.contains(1));
+  free(oarc.buf);
+  free(oarc2.buf);
+}
+
+int main(int argc, char** argv) {
+  NUM_THREADS = 8;
+  NUM_KEYS = 20000;
+  if (argc > 1) NUM_THREADS = atoi(argv[1]);
+  if (argc > 2) NUM_KEYS = atoi(argv[2]);
+  // a single shard contends the most, more shards rehash concurrently
+  test_contention(1);
+  test_contention(8);
+  test_serialization();
+  std::cout << "Done\n";
+}
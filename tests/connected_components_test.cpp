@@ -0,0 +1,127 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <boost/unordered_map.hpp>
+#include <graphlab/util/union_find.hpp>
+#include <graphlab/database/graph_components.hpp>
+#include <graphlab/parallel/thread_pool.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks concurrent_union_find against the sequential union_find, and
+ * the components computed by graph_components over several shards against
+ * a sequential union find over all the edges. Measures both union finds.
+ * Usage: connected_components_test [nthreads] [num_vertices]
+ */
+
+typedef std::vector<std::pair<size_t, size_t> > edge_list;
+
+// a forest of small trees joined by a few random edges
+void make_edges(size_t n, size_t nedges, edge_list& edges) {
+  edges.resize(nedges);
+  for (size_t i = 0;i < nedges; ++i) {
+    size_t u = rand() % n;
+    size_t v = (i % 8 == 0) ? size_t(rand()) % n : (u / 16) * 16 + rand() % 16;
+    edges[i] = std::make_pair(u, std::min(v, n - 1));
+  }
+}
+
+void merge_range(concurrent_union_find<size_t>* uf, const edge_list* edges,
+                 size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) uf->merge((*edges)[i].first, (*edges)[i].second);
+}
+
+// smallest element of the set of each element, computed sequentially
+std::vector<size_t> serial_components(size_t n, const edge_list& edges) {
+  union_find<size_t, size_t> uf;
+  uf.init(n);
+  for (size_t i = 0;i < edges.size(); ++i) uf.merge(edges[i].first, edges[i].second);
+  std::vector<size_t> min_elem(n, n);
+  for (size_t i = 0;i < n; ++i) {
+    size_t r = uf.find(i);
+    min_elem[r] = std::min(min_elem[r], i);
+  }
+  std::vector<size_t> ret(n);
+  for (size_t i = 0;i < n; ++i) ret[i] = min_elem[uf.find(i)];
+  return ret;
+}
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  size_t n = 1000000;
+  if (argc > 1) nthreads = atoi(argv[1]);
+  if (argc > 2) n = atol(argv[2]);
+  thread_pool pool(nthreads);
+
+  {
+    concurrent_union_find<> uf(10);
+    ASSERT_TRUE(uf.merge(3, 7));
+    ASSERT_TRUE(uf.merge(7, 5));
+    ASSERT_FALSE(uf.merge(5, 3));
+    ASSERT_EQ(uf.find(7), 3);
+    ASSERT_TRUE(uf.same_set(5, 3));
+    ASSERT_FALSE(uf.same_set(5, 4));
+    ASSERT_TRUE(uf.is_root(4));
+  }
+
+  edge_list edges;
+  make_edges(n, n / 2, edges);
+  timer ti; ti.start();
+  std::vector<size_t> expected = serial_components(n, edges);
+  double serial_time = ti.current_time();
+
+  concurrent_union_find<size_t> uf(n);
+  ti.start();
+  pool.parallel_for(0, edges.size(), boost::bind(merge_range, &uf, &edges, _1, _2));
+  double parallel_time = ti.current_time();
+  for (size_t i = 0;i < n; ++i) ASSERT_EQ(uf.find(i), expected[i]);
+  std::cout << "union find: sequential " << serial_time << " s, "
+            << nthreads << " threads " << parallel_time << " s\n";
+
+  // the same graph over shards, with sparse vertex ids, and one isolated
+  // vertex in every shard
+  const size_t nshards = 4;
+  const graph_vid_t stride = 1000003;
+  std::vector<graph_shard*> shards;
+  for (size_t s = 0; s < nshards; ++s) {
+    shards.push_back(new graph_shard(s));
+    shards[s]->add_vertex((n + s) * stride, graph_row());
+  }
+  for (size_t i = 0;i < edges.size(); ++i) {
+    graph_vid_t u = edges[i].first * stride, v = edges[i].second * stride;
+    shards[(u + v) % nshards]->add_edge(u, v, graph_row());
+  }
+  ti.start();
+  std::vector<graph_components::label_vector> shard_labels(nshards);
+  for (size_t s = 0; s < nshards; ++s) {
+    graph_components::label_shard(*shards[s], pool, shard_labels[s]);
+  }
+  graph_components::label_vector labels;
+  graph_components::merge(shard_labels, pool, labels);
+  std::cout << "graph_components over " << nshards << " shards: " << ti.current_time() << " s\n";
+
+  boost::unordered_map<graph_vid_t, graph_vid_t> label_map(labels.begin(), labels.end());
+  ASSERT_EQ(label_map.size(), labels.size());
+  std::vector<bool> seen(n, false);
+  for (size_t i = 0;i < edges.size(); ++i) {
+    seen[edges[i].first] = seen[edges[i].second] = true;
+  }
+  size_t expected_components = nshards, expected_vertices = nshards;
+  for (size_t i = 0;i < n; ++i) {
+    if (!seen[i]) continue;
+    ++expected_vertices;
+    expected_components += (expected[i] == i);
+    ASSERT_EQ(label_map[i * stride], expected[i] * stride);
+  }
+  for (size_t s = 0; s < nshards; ++s) {
+    ASSERT_EQ(label_map[(n + s) * stride], (n + s) * stride);
+    delete shards[s];
+  }
+  ASSERT_EQ(labels.size(), expected_vertices);
+  ASSERT_EQ(graph_components::num_components(labels), expected_components);
+  std::cout << graph_components::num_components(labels) << " components\n";
+  std::cout << "Done\n";
+}
@@ -0,0 +1,270 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <utility>
+#include <boost/bind.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/vertex_frontier.hpp>
+#include <graphlab/parallel/thread_pool.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks the bulk and range operations of dense_bitset against a
+ * vector<bool>, and a direction optimizing BFS on vertex_frontier
+ * against a sequential BFS. Measures set-bit iteration and bulk ops.
+ * Usage: dense_bitset_test [nthreads] [num_vertices]
+ */
+
+struct collect_bits {
+  std::vector<size_t>* out;
+  collect_bits(std::vector<size_t>* out): out(out) { }
+  void operator()(size_t b) const { out->push_back(b); }
+};
+
+void check_equal(const dense_bitset& bits, const std::vector<bool>& ref) {
+  std::vector<size_t> found;
+  bits.foreach_set_bit(collect_bits(&found));
+  size_t j = 0;
+  for (size_t i = 0;i < ref.size(); ++i) {
+    ASSERT_EQ(bits.get(i), ref[i]);
+    if (ref[i]) ASSERT_EQ(found[j++], i);
+  }
+  ASSERT_EQ(found.size(), j);
+  ASSERT_EQ(bits.popcount(), j);
+}
+
+void random_bits(dense_bitset& bits, std::vector<bool>& ref, size_t one_in) {
+  for (size_t i = 0;i < ref.size(); ++i) {
+    ref[i] = (rand() % one_in == 0);
+    bits.set_unsync(i, ref[i]);
+  }
+}
+
+void add_range(vertex_frontier* f, size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) f->add(i);
+}
+
+// ---- BFS over a random graph in CSR form ----
+std::vector<size_t> offsets, neighbors;
+
+// a ring plus random edges, both directions of every edge stored, so
+// that the bottom up steps can look for parents among the neighbors
+void make_graph(size_t n, size_t degree) {
+  std::vector<std::pair<size_t, size_t> > edges;
+  for (size_t v = 0; v < n; ++v) {
+    edges.push_back(std::make_pair(v, (v + 1) % n));
+    for (size_t j = 1; j < degree / 2; ++j) edges.push_back(std::make_pair(v, size_t(rand()) % n));
+  }
+  offsets.assign(n + 1, 0);
+  for (size_t i = 0;i < edges.size(); ++i) {
+    ++offsets[edges[i].first + 1];
+    ++offsets[edges[i].second + 1];
+  }
+  for (size_t v = 0; v < n; ++v) offsets[v + 1] += offsets[v];
+  std::vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+  neighbors.resize(2 * edges.size());
+  for (size_t i = 0;i < edges.size(); ++i) {
+    neighbors[pos[edges[i].first]++] = edges[i].second;
+    neighbors[pos[edges[i].second]++] = edges[i].first;
+  }
+}
+
+std::vector<size_t> serial_bfs(size_t n, size_t root) {
+  std::vector<size_t> level(n, size_t(-1));
+  std::vector<size_t> queue(1, root);
+  level[root] = 0;
+  for (size_t i = 0;i < queue.size(); ++i) {
+    size_t v = queue[i];
+    for (size_t e = offsets[v]; e < offsets[v + 1]; ++e) {
+      if (level[neighbors[e]] == size_t(-1)) {
+        level[neighbors[e]] = level[v] + 1;
+        queue.push_back(neighbors[e]);
+      }
+    }
+  }
+  return level;
+}
+
+// top down: push from the frontier to unvisited neighbors
+struct push_step {
+  std::vector<size_t>* level; vertex_frontier* next; size_t depth;
+  void operator()(size_t v) const {
+    for (size_t e = offsets[v]; e < offsets[v + 1]; ++e) {
+      size_t u = neighbors[e];
+      if ((*level)[u] == size_t(-1) &&
+          __sync_bool_compare_and_swap(&(*level)[u], size_t(-1), depth)) {
+        next->add(u);
+      }
+    }
+  }
+};
+
+// bottom up: every unvisited vertex looks for a parent in the frontier
+struct pull_step {
+  std::vector<size_t>* level; const vertex_frontier* frontier;
+  vertex_frontier* next; size_t depth;
+  void operator()(size_t begin, size_t end) const {
+    for (size_t u = begin; u < end; ++u) {
+      if ((*level)[u] != size_t(-1)) continue;
+      for (size_t e = offsets[u]; e < offsets[u + 1]; ++e) {
+        if (frontier->contains(neighbors[e])) {
+          (*level)[u] = depth;
+          next->add(u);
+          break;
+        }
+      }
+    }
+  }
+};
+
+std::vector<size_t> frontier_bfs(thread_pool& pool, size_t n, size_t root,
+                                 size_t& pull_steps) {
+  std::vector<size_t> level(n, size_t(-1));
+  vertex_frontier frontier(n), next(n);
+  level[root] = 0;
+  frontier.add(root);
+  pull_steps = 0;
+  for (size_t depth = 1; !frontier.empty(); ++depth) {
+    if (frontier.is_dense()) {
+      pull_step step = {&level, &frontier, &next, depth};
+      pool.parallel_for(0, n, step, 4096);
+      ++pull_steps;
+    } else {
+      push_step step = {&level, &next, depth};
+      frontier.parallel_foreach(pool, step);
+    }
+    next.update_representation();
+    frontier.swap(next);
+    next.clear(pool);
+  }
+  return level;
+}
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  size_t n = 1000000;
+  if (argc > 1) nthreads = atoi(argv[1]);
+  if (argc > 2) n = atol(argv[2]);
+
+  // bulk operations
+  const size_t len = 10007;
+  dense_bitset a(len), b(len);
+  std::vector<bool> ra(len), rb(len);
+  random_bits(a, ra, 3);
+  random_bits(b, rb, 5);
+  check_equal(a, ra);
+  {
+    std::vector<bool> r(len);
+    size_t both = 0;
+    for (size_t i = 0;i < len; ++i) { r[i] = ra[i] && rb[i]; both += r[i]; }
+    check_equal(a & b, r);
+    ASSERT_EQ(a.popcount_and(b), both);
+    for (size_t i = 0;i < len; ++i) r[i] = ra[i] || rb[i];
+    check_equal(a | b, r);
+    for (size_t i = 0;i < len; ++i) r[i] = ra[i] && !rb[i];
+    check_equal(a - b, r);
+
+    // with itself
+    dense_bitset c = a;
+    c &= c;
+    check_equal(c, ra);
+    c |= c;
+    check_equal(c, ra);
+    c = c;
+    check_equal(c, ra);
+    c -= c;
+    ASSERT_TRUE(c.empty());
+  }
+
+  // growing clears the new bits, shrinking drops the bits past the end
+  {
+    dense_bitset c(70);
+    c.fill();
+    c.resize(200);
+    ASSERT_EQ(c.popcount(), 70);
+    c.resize(65);
+    ASSERT_EQ(c.popcount(), 65);
+    c.resize(130);
+    ASSERT_EQ(c.popcount(), 65);
+  }
+
+  // range operations, across and within words
+  size_t ranges[][2] = {{0, len}, {3, 61}, {64, 128}, {65, 4000}, {100, 101}, {500, 500}};
+  for (size_t k = 0;k < sizeof(ranges) / sizeof(ranges[0]); ++k) {
+    size_t begin = ranges[k][0], end = ranges[k][1];
+    size_t expected = 0;
+    std::vector<size_t> found, ref_found;
+    for (size_t i = begin; i < end; ++i) if (ra[i]) { ++expected; ref_found.push_back(i); }
+    ASSERT_EQ(a.popcount(begin, end), expected);
+    a.foreach_set_bit(begin, end, collect_bits(&found));
+    ASSERT_TRUE(found == ref_found);
+
+    dense_bitset c = a;
+    std::vector<bool> rc = ra;
+    c.clear(begin, end);
+    for (size_t i = begin; i < end; ++i) rc[i] = false;
+    check_equal(c, rc);
+    c.fill(begin, end);
+    for (size_t i = begin; i < end; ++i) rc[i] = true;
+    check_equal(c, rc);
+  }
+
+  // frontier: parallel adds turn it dense
+  thread_pool pool(nthreads);
+  {
+    vertex_frontier f(n, 0.05);
+    f.parallel_foreach(pool, boost::bind(&vertex_frontier::add, &f, _1));
+    ASSERT_TRUE(f.empty());
+    for (size_t i = 0;i < n / 100; ++i) ASSERT_TRUE(f.add(i * 100));
+    ASSERT_FALSE(f.add(0));
+    ASSERT_FALSE(f.is_dense());
+    ASSERT_EQ(f.size(), n / 100);
+    vertex_frontier g(n, 0.05);
+    pool.parallel_for(0, n / 5, boost::bind(add_range, &g, _1, _2), 1024);
+    ASSERT_TRUE(g.is_dense());
+    ASSERT_EQ(g.size(), n / 5);
+    ASSERT_EQ(g.get_bitset().popcount(), n / 5);
+    g.clear(pool);
+    ASSERT_TRUE(g.get_bitset().empty());
+    for (size_t i = 0;i < 10; ++i) g.add(n - 1 - i);
+    g.update_representation();
+    ASSERT_FALSE(g.is_dense());
+    f.clear();
+    ASSERT_TRUE(f.get_bitset().empty());
+  }
+
+  make_graph(n, 8);
+  std::vector<size_t> expected = serial_bfs(n, 0);
+  size_t pull_steps;
+  timer ti; ti.start();
+  std::vector<size_t> level = frontier_bfs(pool, n, 0, pull_steps);
+  double bfs_time = ti.current_time();
+  ASSERT_TRUE(level == expected);
+  ASSERT_GT(pull_steps, 0);
+  std::cout << "bfs: " << bfs_time << " s, " << pull_steps << " bottom up steps\n";
+
+  // iteration over a sparse bitset: next_bit against foreach_set_bit
+  dense_bitset sparse(64 * n);
+  for (size_t i = 0;i < n / 10; ++i) sparse.set_bit_unsync((size_t(rand()) * 641) % (64 * n));
+  ti.start();
+  size_t sum = 0;
+  for (dense_bitset::iterator it = sparse.begin(); it != sparse.end(); ++it) sum += *it;
+  double t_iter = ti.current_time();
+  std::vector<size_t> found;
+  found.reserve(n);
+  ti.start();
+  sparse.foreach_set_bit(collect_bits(&found));
+  double t_foreach = ti.current_time();
+  size_t sum2 = 0;
+  for (size_t i = 0;i < found.size(); ++i) sum2 += found[i];
+  ASSERT_EQ(sum, sum2);
+  ti.start();
+  dense_bitset other(64 * n);
+  for (size_t r = 0; r < 10; ++r) other |= sparse;
+  double t_or = ti.current_time() / 10;
+  std::cout << "iterator: " << t_iter << " s, foreach_set_bit: " << t_foreach
+            << " s, or: " << (64 * n / 8) / t_or / 1e9 << " GB/s\n";
+  std::cout << "Done\n";
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/epoch.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+// A Treiber stack whose popped nodes are reclaimed through the epoch
+// manager while other threads traverse the stack.
+
+const size_t LIVE = 0x600DF00D;
+const size_t DEAD = 0xDEADBEEF;
+
+atomic<size_t> num_deleted;
+
+struct node {
+  volatile size_t magic;
+  size_t value;
+  node* next;
+  node(size_t value): magic(LIVE), value(value), next(NULL) { }
+  ~node() { magic = DEAD; num_deleted.inc(); }
+};
+
+node* volatile head = NULL;
+epoch_manager* epochs;
+volatile bool done = false;
+
+void push(size_t value) {
+  node* n = new node(value);
+  do {
+    n->next = head;
+  } while(!atomic_compare_and_swap(head, n->next, n));
+}
+
+bool pop() {
+  epoch_manager::guard g(*epochs);
+  while(1) {
+    node* n = head;
+    if (n == NULL) return false;
+    if (atomic_compare_and_swap(head, n, n->next)) {
+      epochs->retire(n);
+      return true;
+    }
+  }
+}
+
+void writer(size_t id, size_t iterations) {
+  for (size_t i = 0;i < iterations; ++i) {
+    push(id * iterations + i);
+    push(id * iterations + i);
+    pop();
+  }
+}
+
+void reader() {
+  size_t traversals = 0;
+  while (!done) {
+    epoch_manager::guard g(*epochs);
+    size_t count = 0;
+    for (node* n = head; n != NULL && count < 1000; n = n->next, ++count) {
+      // a node reachable inside the guard must not have been freed
+      ASSERT_TRUE(n->magic == LIVE);
+    }
+    ++traversals;
+  }
+  ASSERT_GT(traversals, 0);
+}
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  if (argc > 1) nthreads = atoi(argv[1]);
+  const size_t ITERATIONS = 100000;
+  epoch_manager manager(64);
+  epochs = &manager;
+
+  timer ti; ti.start();
+  thread_group readers, writers;
+  for (size_t i = 0;i < nthreads; ++i) readers.launch(reader);
+  for (size_t i = 0;i < nthreads; ++i) {
+    writers.launch(boost::bind(writer, i, ITERATIONS));
+  }
+  writers.join();
+  done = true;
+  readers.join();
+  std::cout << "Concurrent push/pop/traverse: " << ti.current_time() << " seconds\n";
+
+  // drain the stack. Exited threads left their retired nodes behind
+  // and reclaim() frees them once no thread is in a guard.
+  size_t remaining = 0;
+  while (pop()) ++remaining;
+  ASSERT_EQ(remaining, nthreads * ITERATIONS);
+  manager.reclaim();
+  ASSERT_EQ(manager.num_pending(), 0);
+  ASSERT_EQ(num_deleted.value, 2 * nthreads * ITERATIONS);
+
+  // nested guards
+  {
+    epoch_manager::guard g1(manager);
+    epoch_manager::guard g2(manager);
+    ASSERT_TRUE(manager.in_critical_section());
+  }
+  ASSERT_FALSE(manager.in_critical_section());
+  std::cout << "epoch_test passed" << std::endl;
+}
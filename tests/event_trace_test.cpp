@@ -0,0 +1,148 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/util/event_trace.hpp>
+#include <graphlab/database/query_message.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+// Every thread runs requests made of nested spans. The collected events
+// of each thread must be in order, balanced, and tagged with the request
+// ids, also after the id went through a QueryMessage. Threads started
+// after others exited reuse their ring buffers.
+
+const size_t NREQUESTS = 1000;
+
+void run_requests(barrier* done) {
+  for (size_t i = 0;i < NREQUESTS; ++i) {
+    trace_request_scope request;
+    ASSERT_NE(event_trace::current_request_id(), 0);
+    trace_span span("request");
+    {
+      trace_span inner("inner");
+      global_event_trace().instant("point", event_trace::current_request_id());
+    }
+  }
+  ASSERT_EQ(event_trace::current_request_id(), 0);
+  // stay alive, so that every thread keeps a ring of its own
+  done->wait();
+}
+
+void record_one(event_trace* trace, uint64_t request_id) {
+  trace->instant("point", request_id);
+}
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  if (argc > 1) nthreads = atoi(argv[1]);
+
+  // nothing is recorded while disabled
+  {
+    trace_request_scope request;
+    ASSERT_EQ(event_trace::current_request_id(), 0);
+    trace_span span("disabled");
+  }
+  std::vector<trace_record> records;
+  global_event_trace().collect(records, 0);
+  ASSERT_EQ(records.size(), 0);
+
+  global_event_trace().enable(true);
+  thread_group group;
+  timer ti; ti.start();
+  barrier done(nthreads);
+  for (size_t i = 0;i < nthreads; ++i) {
+    group.launch(boost::bind(run_requests, &done));
+  }
+  group.join();
+  double elapsed = ti.current_time();
+  global_event_trace().enable(false);
+
+  global_event_trace().collect(records, 7);
+  ASSERT_EQ(records.size(), nthreads * NREQUESTS * 5);
+  std::map<uint32_t, std::vector<trace_record> > by_thread;
+  for (size_t i = 0;i < records.size(); ++i) {
+    ASSERT_EQ(records[i].process, 7);
+    by_thread[records[i].thread].push_back(records[i]);
+  }
+  ASSERT_EQ(by_thread.size(), nthreads);
+  std::map<uint64_t, size_t> request_events;
+  for (std::map<uint32_t, std::vector<trace_record> >::iterator it = by_thread.begin();
+       it != by_thread.end(); ++it) {
+    std::vector<trace_record>& events = it->second;
+    for (size_t i = 0;i < events.size(); i += 5) {
+      ASSERT_EQ(events[i].name, std::string("request"));
+      ASSERT_EQ(events[i].phase, 'B');
+      ASSERT_EQ(events[i + 1].name, std::string("inner"));
+      ASSERT_EQ(events[i + 2].phase, 'i');
+      ASSERT_EQ(events[i + 3].phase, 'E');
+      ASSERT_EQ(events[i + 4].name, std::string("request"));
+      ASSERT_EQ(events[i + 4].phase, 'E');
+      for (size_t j = 0;j < 5; ++j) {
+        ASSERT_EQ(events[i + j].request_id, events[i].request_id);
+        if (i + j > 0) ASSERT_GE(events[i + j].time_ns, events[i + j - 1].time_ns);
+      }
+      request_events[events[i].request_id] += 5;
+    }
+  }
+  // request ids are unique
+  ASSERT_EQ(request_events.size(), nthreads * NREQUESTS);
+
+  // the ring keeps the latest events
+  event_trace small(16);
+  small.enable(true);
+  for (size_t i = 0;i < 100; ++i) small.instant("point", i);
+  std::vector<trace_record> latest;
+  small.collect(latest, 0);
+  ASSERT_EQ(latest.size(), 16);
+  ASSERT_EQ(latest[0].request_id, 84);
+  ASSERT_EQ(latest[15].request_id, 99);
+
+  // more threads than MAX_THREADS over time, a few at a time
+  event_trace recycled(1024);
+  recycled.enable(true);
+  const size_t nrecorders = 2 * event_trace::MAX_THREADS;
+  for (size_t i = 0;i < nrecorders; i += 8) {
+    thread_group recorders;
+    for (size_t j = i;j < i + 8; ++j) {
+      recorders.launch(boost::bind(record_one, &recycled, j));
+    }
+    recorders.join();
+  }
+  std::vector<trace_record> recorded;
+  recycled.collect(recorded, 0);
+  ASSERT_EQ(recorded.size(), nrecorders);
+  std::vector<bool> seen(nrecorders, false);
+  for (size_t i = 0;i < recorded.size(); ++i) {
+    ASSERT_LT(recorded[i].request_id, nrecorders);
+    ASSERT_LT(recorded[i].thread, event_trace::MAX_THREADS);
+    seen[recorded[i].request_id] = true;
+  }
+  for (size_t i = 0;i < nrecorders; ++i) ASSERT_TRUE(seen[i]);
+
+  // the request id goes through QueryMessage
+  {
+    trace_request_scope request(0x1234);
+    QueryMessage qm(QueryMessage::GET, QueryMessage::VERTEX);
+    qm << size_t(42);
+    QueryMessage received(qm.message(), qm.length());
+    ASSERT_EQ(received.get_request_id(), 0x1234);
+    size_t vid;
+    received >> vid;
+    ASSERT_EQ(vid, 42);
+    free(qm.message());
+  }
+
+  std::stringstream strm;
+  event_trace::write_chrome_trace(strm, latest);
+  std::string json = strm.str();
+  ASSERT_EQ(json.substr(0, 15), std::string("{\"traceEvents\":"));
+  ASSERT_NE(json.find("\"request_id\":\"63\""), std::string::npos);
+
+  std::cout << records.size() / elapsed / 1e6 << " M events/s\n";
+  std::cout << "Done\n";
+}
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/fiber_scheduler.hpp>
+#include <graphlab/parallel/future.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+// simulates a remote machine: requests are queued and answered in
+// batches by a separate thread
+mutex request_lock;
+std::vector<std::pair<size_t, promise<size_t> > > requests;
+bool responder_done = false;
+atomic<size_t> completed;
+
+future<size_t> remote_square(size_t i) {
+  promise<size_t> p;
+  request_lock.lock();
+  requests.push_back(std::make_pair(i, p));
+  request_lock.unlock();
+  return p.get_future();
+}
+
+void responder() {
+  while(1) {
+    std::vector<std::pair<size_t, promise<size_t> > > batch;
+    request_lock.lock();
+    batch.swap(requests);
+    bool done = responder_done;
+    request_lock.unlock();
+    for (size_t i = 0;i < batch.size(); ++i) {
+      batch[i].second.set_value(batch[i].first * batch[i].first);
+    }
+    if (batch.empty()) {
+      if (done) break;
+      usleep(100);
+    }
+  }
+}
+
+void request_task(size_t i) {
+  // straight line code across several remote round trips
+  size_t a = fiber_scheduler::get(remote_square(i));
+  size_t b = fiber_scheduler::get(remote_square(i + 1));
+  ASSERT_EQ(b - a, 2 * i + 1);
+  completed.inc();
+}
+
+void yield_task(size_t n) {
+  for (size_t i = 0;i < n; ++i) fiber_scheduler::yield();
+  completed.inc();
+}
+
+size_t count_completed() { return completed.value; }
+
+void throw_task() { throw "fiber_scheduler_test exception"; }
+
+int main(int argc, char** argv) {
+  size_t nthreads = thread::cpu_count();
+  if (argc > 1) nthreads = atoi(argv[1]);
+  std::cout << "Using " << nthreads << " workers\n";
+  fiber_scheduler sched(nthreads, 16 * 1024);
+  ASSERT_FALSE(fiber_scheduler::in_fiber());
+
+  thread responder_thread;
+  responder_thread.launch(responder);
+
+  // many fibers blocked on outstanding requests at once
+  timer ti; ti.start();
+  const size_t NUM_FIBERS = 10000;
+  for (size_t i = 0;i < NUM_FIBERS; ++i) {
+    sched.launch(boost::bind(request_task, i));
+  }
+  sched.join();
+  ASSERT_EQ(completed.value, NUM_FIBERS);
+  ASSERT_EQ(sched.num_active(), 0);
+  std::cout << NUM_FIBERS << " fibers x 2 requests: "
+            << ti.current_time() << " seconds\n";
+
+  request_lock.lock();
+  responder_done = true;
+  request_lock.unlock();
+  responder_thread.join();
+
+  // cooperative yielding
+  completed.value = 0;
+  for (size_t i = 0;i < 100; ++i) sched.launch(boost::bind(yield_task, 100));
+  sched.join();
+  ASSERT_EQ(completed.value, 100);
+
+  // fibers as an executor
+  future<size_t> f = async<size_t>(sched, count_completed);
+  ASSERT_EQ(f.get(), 100);
+  sched.join();
+
+  // exceptions are forwarded to join
+  sched.launch(throw_task);
+  bool caught = false;
+  try {
+    sched.join();
+  } catch (const char* c) {
+    caught = true;
+  }
+  ASSERT_TRUE(caught);
+  sched.join();
+  std::cout << "Done" << std::endl;
+}
@@ -0,0 +1,168 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/future.hpp>
+#include <graphlab/parallel/thread_pool.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks future / promise: values, continuations on the completing thread
+ * and on an executor, when_all, when_any, async, and the propagation of
+ * errors through all of them.
+ */
+
+int twice(const int& i) { return 2 * i; }
+int fail_int(const int& i) { throw "continuation failed"; return i; }
+size_t length(const std::string& s) { return s.size(); }
+int forty_two() { return 42; }
+int fail_async() { throw "async failed"; return 0; }
+
+atomic<size_t> callbacks;
+void count_callback() { callbacks.inc(); }
+
+// copies of a promise share their result, so vector(n, promise) would not do
+std::vector<promise<int> > make_promises(size_t n) {
+  std::vector<promise<int> > ret;
+  for (size_t i = 0; i < n; ++i) ret.push_back(promise<int>());
+  return ret;
+}
+
+void fulfill(promise<int> p, int value) { p.set_value(value); }
+void fail(promise<int> p, const char* error) { p.set_error(error); }
+
+void test_basic() {
+  future<int> invalid;
+  ASSERT_FALSE(invalid.valid());
+
+  promise<int> p;
+  future<int> f = p.get_future();
+  ASSERT_TRUE(f.valid());
+  ASSERT_FALSE(f.is_ready());
+  // continuations registered before and after completion both run
+  f.on_ready(count_callback);
+  p.set_value(21);
+  f.on_ready(count_callback);
+  ASSERT_EQ(callbacks.value, 2);
+  ASSERT_TRUE(f.is_ready());
+  ASSERT_FALSE(f.has_error());
+  ASSERT_EQ(f.get(), 21);
+  ASSERT_TRUE(f.get_error() == NULL);
+
+  ASSERT_EQ(make_ready_future(std::string("abc")).then<size_t>(length).get(), 3);
+
+  promise<int> e;
+  e.set_error("failed");
+  ASSERT_TRUE(e.get_future().has_error());
+  bool caught = false;
+  try { e.get_future().get(); } catch (const char* err) { caught = true; }
+  ASSERT_TRUE(caught);
+}
+
+void test_then(executor* exec) {
+  // a chain built before the value is available
+  promise<int> p;
+  future<int> f = p.get_future().then<int>(twice, exec).then<int>(twice, exec);
+  p.set_value(5);
+  ASSERT_EQ(f.get(), 20);
+
+  // a failing continuation skips the rest of the chain
+  promise<int> q;
+  future<int> g = q.get_future().then<int>(fail_int, exec).then<int>(twice, exec);
+  q.set_value(1);
+  ASSERT_TRUE(std::string(g.get_error()) == "continuation failed");
+
+  // so does a failed promise
+  promise<int> r;
+  future<int> h = r.get_future().then<int>(twice, exec);
+  r.set_error("promise failed");
+  ASSERT_TRUE(std::string(h.get_error()) == "promise failed");
+}
+
+void test_when_all(thread_pool& pool) {
+  ASSERT_TRUE(when_all(std::vector<future<int> >()).get().empty());
+
+  // promises fulfilled concurrently by the pool
+  const size_t n = 1000;
+  std::vector<promise<int> > promises = make_promises(n);
+  std::vector<future<int> > futures;
+  for (size_t i = 0; i < n; ++i) futures.push_back(promises[i].get_future());
+  future<std::vector<int> > all = when_all(futures);
+  for (size_t i = 0; i < n; ++i) pool.launch(boost::bind(fulfill, promises[i], int(i)));
+  const std::vector<int>& values = all.get();
+  ASSERT_EQ(values.size(), n);
+  for (size_t i = 0; i < n; ++i) ASSERT_EQ(values[i], int(i));
+  pool.join();
+
+  // the first error in input order wins
+  std::vector<promise<int> > failing = make_promises(3);
+  futures.clear();
+  for (size_t i = 0; i < 3; ++i) futures.push_back(failing[i].get_future());
+  all = when_all(futures);
+  failing[2].set_error("third");
+  failing[0].set_value(0);
+  ASSERT_FALSE(all.is_ready());
+  failing[1].set_error("second");
+  ASSERT_TRUE(std::string(all.get_error()) == "second");
+}
+
+void test_when_any(thread_pool& pool) {
+  std::vector<promise<int> > promises = make_promises(3);
+  std::vector<future<int> > futures;
+  for (size_t i = 0; i < 3; ++i) futures.push_back(promises[i].get_future());
+  future<std::pair<size_t, int> > any = when_any(futures);
+  ASSERT_FALSE(any.is_ready());
+  promises[1].set_value(7);
+  ASSERT_EQ(any.get().first, 1);
+  ASSERT_EQ(any.get().second, 7);
+  // later completions are ignored
+  promises[0].set_value(3);
+  promises[2].set_error("late");
+  ASSERT_EQ(any.get().first, 1);
+
+  // an input which is already ready
+  futures[1] = make_ready_future(9);
+  promise<int> pending;
+  futures[0] = pending.get_future();
+  ASSERT_EQ(when_any(futures).get().second, 9);
+  pending.set_value(0);
+
+  // the first input to complete fails
+  std::vector<promise<int> > failing = make_promises(2);
+  futures.clear();
+  for (size_t i = 0; i < 2; ++i) futures.push_back(failing[i].get_future());
+  any = when_any(futures);
+  pool.launch(boost::bind(fail, failing[0], "first"));
+  ASSERT_TRUE(std::string(any.get_error()) == "first");
+  pool.join();
+  failing[1].set_value(1);
+}
+
+void test_async(thread_pool& pool) {
+  thread_pool_executor exec(pool);
+  ASSERT_EQ(async<int>(exec, forty_two).then<int>(twice, &exec).get(), 84);
+  future<int> failed = async<int>(exec, fail_async);
+  ASSERT_TRUE(std::string(failed.get_error()) == "async failed");
+  inline_executor now;
+  future<int> f = async<int>(now, forty_two);
+  ASSERT_TRUE(f.is_ready());
+  pool.join();
+}
+
+int main(int argc, char** argv) {
+  thread_pool pool(4);
+  test_basic();
+  test_then(NULL);
+  thread_pool_executor exec(pool);
+  test_then(&exec);
+  inline_executor now;
+  test_then(&now);
+  pool.join();
+  test_when_all(pool);
+  test_when_any(pool);
+  test_async(pool);
+  std::cout << "Done\n";
+}
@@ -61,8 +61,9 @@ namespace graphlab {
         case VID_TYPE:
           eq = (lhs._data.vid_value == rhs._data.vid_value); break;
         case BLOB_TYPE:
+        case DOUBLE_VEC_TYPE:
         case STRING_TYPE:
-          eq = ((memcmp(lhs._data.bytes, rhs._data.bytes, lhs._len)) == 0); break;
+          eq = ((memcmp(lhs.bytes(), rhs.bytes(), lhs._len)) == 0); break;
         default:
           eq = false;
        }
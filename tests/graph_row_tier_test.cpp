@@ -0,0 +1,186 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <graphlab/database/server/graph_shard_server.hpp>
+#include <graphlab/database/kvstore_local.hpp>
+#include <graphlab/database/errno.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks graph_shard_server with tiered rows: reads and writes of evicted
+ * rows, batched fetches, schema changes, the memory budget and concurrent
+ * queries, then measures a skewed workload.
+ * Usage: graph_row_tier_test [nverts] [budget_bytes] [queries]
+ */
+
+std::string url_of(size_t i, size_t version) {
+  return "http://www.example.com/" + boost::lexical_cast<std::string>(i) +
+         "/v" + boost::lexical_cast<std::string>(version) + "/some/longer/path";
+}
+
+graph_row vertex_row_of(const std::vector<graph_field>& fields, size_t i, size_t version) {
+  graph_row row(fields, true);
+  row.get_field(0)->set_double(i);
+  row.get_field(1)->set_string(url_of(i, version));
+  return row;
+}
+
+void check_vertex(graph_shard_server& server, size_t i, size_t version) {
+  graph_row row;
+  ASSERT_EQ(server.get_vertex(i, row), 0);
+  graph_string_t url;
+  ASSERT_TRUE(row.get_field(1)->get_string(&url));
+  ASSERT_TRUE(url == url_of(i, version));
+}
+
+void check_budget(graph_shard_server& server, size_t budget) {
+  ASSERT_LE(server.get_tier_stats().resident_bytes, budget);
+}
+
+// reads random vertices and rewrites some of them with the same values,
+// which fetches and evicts rows from many threads, and reads the sizes of
+// the shard
+void query_thread(graph_shard_server* server, const std::vector<graph_field>* fields,
+                  size_t nverts, size_t nqueries, unsigned int seed) {
+  for (size_t i = 0; i < nqueries; ++i) {
+    size_t vid = rand_r(&seed) % nverts;
+    size_t version = vid % 3 == 0 ? 1 : 0;
+    if (i % 1000 == 0) {
+      // the statistics of ADMIN STATS, while rows are evicted
+      ASSERT_GT(server->data_bytes(), 0);
+      memory_accounting::usage usage;
+      server->memory_usage(usage);
+    } else if (i % 4 == 0) {
+      ASSERT_EQ(server->set_vertex(vid, vertex_row_of(*fields, vid, version)), 0);
+    } else {
+      graph_row row;
+      ASSERT_EQ(server->get_vertex(vid, row), 0);
+      graph_string_t url;
+      ASSERT_TRUE(row.get_field(1)->get_string(&url));
+      ASSERT_TRUE(url == url_of(vid, version));
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t nverts = 20000;
+  size_t budget = 200000;
+  size_t nqueries = 200000;
+  if (argc > 1) nverts = atol(argv[1]);
+  if (argc > 2) budget = atol(argv[2]);
+  if (argc > 3) nqueries = atol(argv[3]);
+
+  char dirname[] = "/tmp/graph_row_tier_test.XXXXXX";
+  ASSERT_TRUE(mkdtemp(dirname) != NULL);
+  std::string dir(dirname);
+  {
+    kvstore_local store(dir);
+    std::vector<graph_field> vfields, efields;
+    vfields.push_back(graph_field("rank", DOUBLE_TYPE));
+    vfields.push_back(graph_field("url", STRING_TYPE));
+    efields.push_back(graph_field("label", STRING_TYPE));
+    graph_shard_server server(0, vfields, efields);
+    server.enable_tiering(store, budget);
+
+    for (size_t i = 0; i < nverts; ++i) {
+      ASSERT_EQ(server.add_vertex(i, vertex_row_of(vfields, i, 0)), 0);
+      graph_row edata(efields, false);
+      edata.get_field(0)->set_string(url_of(i, 0));
+      ASSERT_EQ(server.add_edge(i, (i + 1) % nverts, edata), 0);
+    }
+    check_budget(server, budget);
+    ASSERT_GT(server.get_tier_stats().evicted_rows, 0);
+
+    // evicted rows read back, and can not be added again
+    for (size_t i = 0; i < nverts; i += 7) check_vertex(server, i, 0);
+    ASSERT_EQ(server.add_vertex(0, vertex_row_of(vfields, 0, 0)), EDUP);
+    check_budget(server, budget);
+
+    // writes survive the eviction
+    for (size_t i = 0; i < nverts; i += 3) {
+      ASSERT_EQ(server.set_vertex(i, vertex_row_of(vfields, i, 1)), 0);
+    }
+    for (size_t i = 0; i < nverts; ++i) check_vertex(server, i, i % 3 == 0 ? 1 : 0);
+    check_budget(server, budget);
+
+    // the batches fetch their evicted rows at once
+    std::vector<graph_vid_t> vids;
+    for (size_t i = 0; i < 500; ++i) vids.push_back((i * 37) % nverts);
+    graph_row_tier::stats before = server.get_tier_stats();
+    std::vector<graph_row> rows;
+    std::vector<int> errorcodes;
+    ASSERT_TRUE(server.get_vertices(vids, rows, errorcodes));
+    graph_row_tier::stats after = server.get_tier_stats();
+    ASSERT_LE(after.fetch_batches - before.fetch_batches, 1);
+    for (size_t i = 0; i < vids.size(); ++i) {
+      graph_string_t url;
+      ASSERT_TRUE(rows[i].get_field(1)->get_string(&url));
+      ASSERT_TRUE(url == url_of(vids[i], vids[i] % 3 == 0 ? 1 : 0));
+    }
+    std::vector<graph_eid_t> eids;
+    for (size_t i = 0; i < 500; ++i) eids.push_back(make_eid(0, (i * 41) % nverts));
+    errorcodes.clear();
+    ASSERT_TRUE(server.get_edges(eids, rows, errorcodes));
+    errorcodes.clear();
+    eids.push_back(make_eid(1, 0));
+    ASSERT_FALSE(server.get_edges(eids, rows, errorcodes));
+    ASSERT_EQ(errorcodes.back(), EINVID);
+    check_budget(server, budget);
+
+    // schema changes reach the evicted rows
+    ASSERT_EQ(server.add_vertex_field(graph_field("degree", INT_TYPE)), 0);
+    for (size_t i = 0; i < nverts; i += 11) {
+      graph_row row;
+      ASSERT_EQ(server.get_vertex(i, row), 0);
+      ASSERT_EQ(row.num_fields(), 3);
+    }
+    check_budget(server, budget);
+
+    // a skewed workload mostly hits the resident rows
+    before = server.get_tier_stats();
+    srand(42);
+    timer ti; ti.start();
+    graph_row row;
+    for (size_t i = 0; i < nqueries; ++i) {
+      // about 90% of the queries go to 5% of the vertices
+      size_t hot = nverts / 20;
+      size_t vid = rand() % 10 ? rand() % hot : rand() % nverts;
+      ASSERT_EQ(server.get_vertex(vid, row), 0);
+    }
+    double elapsed = ti.current_time();
+    after = server.get_tier_stats();
+    size_t misses = after.fetches - before.fetches;
+    std::cout << nqueries << " gets: " << 1 - double(misses) / nqueries << " hit rate, "
+              << elapsed / nqueries * 1e6 << " us/get\n";
+    std::cout << after.resident_rows << " resident rows (" << after.resident_bytes
+              << " bytes), " << after.evicted_rows << " evicted, "
+              << after.evictions << " evictions, " << after.writes << " writes\n";
+    ASSERT_GT(nqueries, misses * 2);
+    check_budget(server, budget);
+
+    // concurrent queries, whose rows are fetched and evicted meanwhile
+    std::vector<graph_field> fields = server.get_vertex_fields();
+    thread_group group;
+    for (size_t i = 0; i < 4; ++i) {
+      group.launch(boost::bind(query_thread, &server, &fields, nverts, nqueries / 20, i + 1));
+    }
+    group.join();
+    check_budget(server, budget);
+
+    // all the rows are back in the shard
+    server.fetch_all_rows();
+    ASSERT_EQ(server.get_tier_stats().evicted_rows, 0);
+    graph_shard& shard = server.get_shard();
+    for (size_t i = 0; i < shard.num_edges(); ++i) {
+      ASSERT_FALSE(shard.edge_data(i)->is_null());
+    }
+  }
+  int ret = system(("rm -rf " + dir).c_str());
+  ASSERT_EQ(ret, 0);
+  std::cout << "Done\n";
+}
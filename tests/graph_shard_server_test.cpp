@@ -192,9 +192,36 @@ void testEdgeAPI() {
 }
 
 
+/**
+ * Test the adjacency filters: every vertex with edges of the direction
+ * must be in the filter, and few of the others.
+ */
+void testAdjacencyFilter() {
+  cout << "Test adjacency filters...." << endl;
+  vector<graphlab::graph_field> fields;
+  graphlab::graph_shard_server server(0, fields, fields);
+  graphlab::graph_row empty_data(fields, false);
+  // edges i -> i + 5000 for i in [0, 5000)
+  size_t nedges = 5000;
+  for (size_t i = 0; i < nedges; i++) {
+    ASSERT_EQ(server.add_edge(i, i + nedges, empty_data), 0);
+  }
+  graphlab::bloom_filter in_filter, out_filter;
+  server.get_vertex_adj_filter(true, in_filter);
+  server.get_vertex_adj_filter(false, out_filter);
+  size_t false_positives = 0;
+  for (size_t i = 0; i < nedges; i++) {
+    ASSERT_TRUE(out_filter.may_contain(i));
+    ASSERT_TRUE(in_filter.may_contain(i + nedges));
+    false_positives += in_filter.may_contain(i) + out_filter.may_contain(i + nedges);
+  }
+  ASSERT_LT(false_positives, 2 * nedges / 50);
+}
+
 int main(int argc, char** argv) {
   testFieldAPI();
   testVertexAPI();
   testEdgeAPI();
+  testAdjacencyFilter();
   return 0;
 }
@@ -0,0 +1,264 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <graphlab/database/graph_shard_impl.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks the storage of string / blob values (inline, heap and arena)
+ * through copies, assignments and serialization, and that corrupt arrays
+ * of rows are rejected, then measures setting short strings and loading a
+ * shard of labelled rows.
+ * Usage: graph_value_test [num_vertices]
+ */
+
+std::string string_of(const graph_value& v) {
+  std::string ret;
+  ASSERT_TRUE(v.get_string(&ret));
+  return ret;
+}
+
+std::string label_of(size_t i) {
+  std::stringstream strm; strm << "v" << i;
+  return strm.str();
+}
+
+std::string url_of(size_t i) {
+  std::stringstream strm; strm << "http://www.example.com/pages/" << i;
+  return strm.str();
+}
+
+void test_storage() {
+  const std::string small(graph_value::INLINE_CAPACITY, 's');
+  const std::string large(graph_value::INLINE_CAPACITY + 1, 'l');
+
+  graph_value v(STRING_TYPE);
+  ASSERT_TRUE(v.is_null());
+  v.set_string(small);
+  ASSERT_EQ(v._storage, graph_value::INLINE_STORAGE);
+  ASSERT_EQ(v.heap_bytes(), 0);
+  ASSERT_TRUE(string_of(v) == small);
+  v.set_string(large);
+  ASSERT_EQ(v._storage, graph_value::HEAP_STORAGE);
+  ASSERT_EQ(v.heap_bytes(), large.size());
+  ASSERT_TRUE(string_of(v) == large);
+  v.set_string("");
+  ASSERT_EQ(v._storage, graph_value::INLINE_STORAGE);
+  ASSERT_FALSE(v.is_null());
+  ASSERT_TRUE(string_of(v) == "");
+
+  // copies and assignments between storages and types
+  graph_value s(STRING_TYPE), d(DOUBLE_TYPE), b(BLOB_TYPE);
+  s.set_string(large);
+  d.set_double(2.5);
+  b.set_blob(small.c_str(), small.size());
+  graph_value t(s);
+  ASSERT_TRUE(string_of(t) == large);
+  t = d;
+  graph_double_t dval;
+  ASSERT_TRUE(t.get_double(&dval));
+  ASSERT_EQ(dval, 2.5);
+  ASSERT_EQ(t.heap_bytes(), 0);
+  t = s;
+  ASSERT_TRUE(string_of(t) == large);
+  t = b;
+  graph_blob_t blob;
+  ASSERT_TRUE(t.get_blob(&blob));
+  ASSERT_TRUE(blob == small);
+  t = t;
+  ASSERT_TRUE(t.get_blob(&blob));
+  ASSERT_TRUE(blob == small);
+  ASSERT_TRUE(t.set_val(b));
+  ASSERT_FALSE(t.set_val(s));
+
+  // arena values are copied to the heap, and written in place
+  graph_value_arena arena(1024);
+  {
+    graph_value a(STRING_TYPE);
+    memcpy(a.reserve_bytes(large.size(), &arena), large.c_str(), large.size());
+    a._null_value = false;
+    ASSERT_EQ(a._storage, graph_value::ARENA_STORAGE);
+    ASSERT_EQ(a.heap_bytes(), 0);
+    graph_value c(a);
+    ASSERT_EQ(c._storage, graph_value::HEAP_STORAGE);
+    ASSERT_TRUE(string_of(c) == large);
+    const char* data = a.bytes();
+    std::string other(large.size(), 'o');
+    a.set_string(other);
+    ASSERT_TRUE(a.bytes() == data);
+    ASSERT_TRUE(string_of(a) == other);
+    ASSERT_TRUE(string_of(c) == large);
+    a.set_string(large + large);
+    ASSERT_EQ(a._storage, graph_value::HEAP_STORAGE);
+  }
+  ASSERT_GE(arena.memory_bytes(), 1024);
+  arena.clear();
+
+  // serialization, through memory and through a stream
+  std::vector<graph_value> values(4);
+  values[0].init(STRING_TYPE);
+  values[1].init(STRING_TYPE); values[1].set_string(small);
+  values[2].init(STRING_TYPE); values[2].set_string(large);
+  values[3].init(INT_TYPE); values[3].set_integer(42);
+  std::stringstream strm;
+  oarchive oarc(strm);
+  oarc << values;
+  strm.flush();
+  std::vector<graph_value> loaded(4);
+  loaded[0].init(STRING_TYPE); loaded[0].set_string(large);
+  loaded[3].init(STRING_TYPE); loaded[3].set_string(large);
+  iarchive iarc(strm);
+  iarc >> loaded;
+  ASSERT_TRUE(loaded[0].is_null());
+  ASSERT_EQ(loaded[0].heap_bytes(), 0);
+  ASSERT_TRUE(string_of(loaded[1]) == small);
+  ASSERT_TRUE(string_of(loaded[2]) == large);
+  graph_int_t ival;
+  ASSERT_TRUE(loaded[3].get_integer(&ival));
+  ASSERT_EQ(ival, 42);
+  ASSERT_EQ(loaded[3].heap_bytes(), 0);
+}
+
+bool load_fails(const char* buf, size_t len) {
+  std::vector<graph_row> rows;
+  iarchive iarc(buf, len);
+  try {
+    iarc >> rows;
+  } catch (const char*) {
+    return true;
+  }
+  return false;
+}
+
+void test_corrupt_rows() {
+  std::vector<graph_field> fields;
+  fields.push_back(graph_field("label", STRING_TYPE));
+  fields.push_back(graph_field("weight", DOUBLE_TYPE));
+  std::vector<graph_row> rows(3, graph_row(fields, true));
+  for (size_t i = 0; i < rows.size(); ++i) {
+    rows[i]._data[0].set_string(url_of(i));
+    rows[i]._data[1].set_double(i);
+  }
+  oarchive oarc;
+  oarc << rows;
+  ASSERT_FALSE(load_fails(oarc.buf, oarc.off));
+
+  // truncated rows are rejected (the row count itself is read unchecked)
+  const size_t truncated[] = {2 * sizeof(size_t), 30, oarc.off / 2, oarc.off - 1};
+  for (size_t i = 0; i < 4; ++i) ASSERT_TRUE(load_fails(oarc.buf, truncated[i]));
+  // as are row counts and lengths beyond the end of the buffer
+  std::string bytes(oarc.buf, oarc.off);
+  size_t huge = size_t(1) << 40;
+  memcpy(&bytes[0], &huge, sizeof(size_t));
+  memcpy(&bytes[sizeof(size_t)], &huge, sizeof(size_t));
+  ASSERT_TRUE(load_fails(bytes.c_str(), bytes.size()));
+  // the length of the first value, after the row count and the row header
+  size_t len_pos = 2 * sizeof(size_t) + sizeof(bool) + 2 * sizeof(size_t) +
+                   sizeof(graph_datatypes_enum) + sizeof(bool);
+  bytes.assign(oarc.buf, oarc.off);
+  memcpy(&bytes[len_pos], &huge, sizeof(size_t));
+  ASSERT_TRUE(load_fails(bytes.c_str(), bytes.size()));
+  // a scalar longer than the value
+  size_t double_len_pos = len_pos + sizeof(size_t) + url_of(0).size() +
+                          sizeof(graph_datatypes_enum) + sizeof(bool);
+  bytes.assign(oarc.buf, oarc.off);
+  size_t long_scalar = 64;
+  memcpy(&bytes[double_len_pos], &long_scalar, sizeof(size_t));
+  ASSERT_TRUE(load_fails(bytes.c_str(), bytes.size()));
+  free(oarc.buf);
+}
+
+void build_shard(graph_shard_impl& shard, size_t nverts) {
+  std::vector<graph_field> fields;
+  fields.push_back(graph_field("label", STRING_TYPE));
+  fields.push_back(graph_field("url", STRING_TYPE));
+  shard.shard_id = 0;
+  for (size_t i = 0; i < nverts; ++i) {
+    graph_row row(fields, true);
+    row._data[0].set_string(label_of(i));
+    row._data[1].set_string(url_of(i));
+    shard.add_vertex(i, row);
+  }
+}
+
+void check_shard(const graph_shard_impl& shard, size_t nverts) {
+  ASSERT_EQ(shard.vertex_data.size(), nverts);
+  for (size_t i = 0; i < nverts; ++i) {
+    ASSERT_TRUE(string_of(shard.vertex_data[i]._data[0]) == label_of(i));
+    ASSERT_TRUE(string_of(shard.vertex_data[i]._data[1]) == url_of(i));
+  }
+}
+
+size_t row_heap_bytes(const graph_shard_impl& shard) {
+  size_t ret = 0;
+  for (size_t i = 0; i < shard.vertex_data.size(); ++i) {
+    for (size_t j = 0; j < shard.vertex_data[i]._data.size(); ++j) {
+      ret += shard.vertex_data[i]._data[j].heap_bytes();
+    }
+  }
+  return ret;
+}
+
+int main(int argc, char** argv) {
+  size_t nverts = 200000;
+  if (argc > 1) nverts = atol(argv[1]);
+
+  test_storage();
+  test_corrupt_rows();
+
+  // setting short labels does not allocate
+  std::vector<std::string> labels(1000);
+  for (size_t i = 0; i < labels.size(); ++i) labels[i] = label_of(i * 1000003);
+  graph_value v(STRING_TYPE);
+  timer ti; ti.start();
+  const size_t nsets = 10000000;
+  for (size_t i = 0; i < nsets; ++i) v.set_string(labels[i % labels.size()]);
+  std::cout << "set_string of short labels: " << ti.current_time() / nsets * 1e9 << " ns\n";
+  ASSERT_EQ(v.heap_bytes(), 0);
+
+  // the long strings of a loaded shard are in its arena
+  graph_shard_impl shard;
+  build_shard(shard, nverts);
+  oarchive oarc;
+  oarc << shard;
+  for (size_t round = 0; round < 2; ++round) {
+    graph_shard_impl loaded;
+    ti.start();
+    iarchive iarc(oarc.buf, oarc.off);
+    iarc >> loaded;
+    std::cout << "load of " << nverts << " rows: " << ti.current_time() << " s\n";
+    check_shard(loaded, nverts);
+    ASSERT_EQ(row_heap_bytes(loaded), 0);
+    ASSERT_GT(loaded.arena.memory_bytes(), 0);
+    memory_accounting::usage usage;
+    loaded.memory_usage(usage);
+    std::cout << "rows: " << usage.bytes[memory_accounting::SHARD_ROWS] << " bytes, arena: "
+              << loaded.arena.memory_bytes() << " bytes\n";
+
+    // modified rows leave the arena, and loading again reuses it
+    loaded.vertex_data[0]._data[1].set_string(url_of(0) + "/changed");
+    ASSERT_EQ(row_heap_bytes(loaded), url_of(0).size() + 8);
+    iarchive iarc2(oarc.buf, oarc.off);
+    iarc2 >> loaded;
+    check_shard(loaded, nverts);
+    loaded.clear();
+    ASSERT_EQ(loaded.arena.memory_bytes(), 0);
+  }
+
+  // the stream path fills the arena too
+  std::stringstream strm;
+  oarchive soarc(strm);
+  soarc << shard;
+  strm.flush();
+  graph_shard_impl streamed;
+  iarchive siarc(strm);
+  siarc >> streamed;
+  check_shard(streamed, nverts);
+  ASSERT_EQ(row_heap_bytes(streamed), 0);
+  free(oarc.buf);
+  std::cout << "Done\n";
+}
@@ -0,0 +1,226 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <graphlab/database/graph_vector_ops.hpp>
+#include <graphlab/database/graph_shard_impl.hpp>
+#include <graphlab/database/server/graph_shard_server.hpp>
+#include <graphlab/database/errno.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks the vector kernels and the DOUBLE_VEC_TYPE values: storage,
+ * deltas, parsing, serialization and fixed dimension fields, then
+ * measures the kernels and a matrix factorization style update loop.
+ * Usage: graph_vector_test [num_vectors] [dim]
+ */
+
+graph_double_t naive_dot(const graph_double_t* a, const graph_double_t* b, size_t n) {
+  graph_double_t s = 0;
+  for (size_t i = 0; i < n; ++i) s += a[i] * b[i];
+  return s;
+}
+
+graph_d_vector_t random_vec(size_t n) {
+  graph_d_vector_t ret(n);
+  for (size_t i = 0; i < n; ++i) ret[i] = double(rand()) / RAND_MAX - 0.5;
+  return ret;
+}
+
+void test_kernels() {
+  for (size_t n = 0; n < 40; ++n) {
+    graph_d_vector_t a = random_vec(n), b = random_vec(n);
+    const graph_double_t* pa = n ? &a[0] : NULL;
+    const graph_double_t* pb = n ? &b[0] : NULL;
+    ASSERT_LT(std::fabs(vector_ops::dot(pa, pb, n) - naive_dot(pa, pb, n)), 1e-12);
+    ASSERT_LT(std::fabs(vector_ops::norm(pa, n) - std::sqrt(naive_dot(pa, pa, n))), 1e-12);
+    graph_d_vector_t y = b;
+    vector_ops::axpy(0.5, pa, n ? &y[0] : NULL, n);
+    for (size_t i = 0; i < n; ++i) ASSERT_EQ(y[i], b[i] + 0.5 * a[i]);
+    // in place
+    y = a;
+    vector_ops::axpy(2, n ? &y[0] : NULL, n ? &y[0] : NULL, n);
+    for (size_t i = 0; i < n; ++i) ASSERT_EQ(y[i], 3 * a[i]);
+  }
+}
+
+void test_values() {
+  graph_value v(DOUBLE_VEC_TYPE);
+  ASSERT_TRUE(v.is_null());
+  graph_d_vector_t out;
+  ASSERT_FALSE(v.get_double_vec(&out));
+
+  // short vectors are inline, long ones on the heap
+  graph_d_vector_t small(2, 1.5), large = random_vec(20);
+  ASSERT_TRUE(v.set_double_vec(small));
+  ASSERT_EQ(v.heap_bytes(), 0);
+  ASSERT_EQ(v.vec_dim(), 2);
+  ASSERT_TRUE(v.set_double_vec(large));
+  ASSERT_EQ(v.heap_bytes(), 20 * sizeof(graph_double_t));
+  ASSERT_EQ(reinterpret_cast<size_t>(v.vec_data()) % sizeof(graph_double_t), 0);
+  ASSERT_TRUE(v.get_double_vec(&out));
+  ASSERT_TRUE(out == large);
+
+  // deltas add, and must have the same dimension
+  graph_value delta(DOUBLE_VEC_TYPE);
+  delta.set_double_vec(graph_d_vector_t(20, 1.0));
+  ASSERT_TRUE(v.set_val(delta, true));
+  ASSERT_TRUE(v.get_double_vec(&out));
+  for (size_t i = 0; i < 20; ++i) ASSERT_EQ(out[i], large[i] + 1.0);
+  ASSERT_FALSE(v.set_double_vec(small, true));
+  graph_value d;
+  v.diff(delta, d);
+  ASSERT_TRUE(d.get_double_vec(&out));
+  for (size_t i = 0; i < 20; ++i) ASSERT_LT(std::fabs(out[i] - large[i]), 1e-12);
+  graph_value fresh(DOUBLE_VEC_TYPE);
+  ASSERT_TRUE(fresh.set_val(delta, true));
+  ASSERT_TRUE(fresh.get_double_vec(&out));
+  ASSERT_TRUE(out == graph_d_vector_t(20, 1.0));
+
+  // dot, axpy and norm
+  graph_double_t result;
+  ASSERT_TRUE(fresh.dot(delta, &result));
+  ASSERT_EQ(result, 20.0);
+  ASSERT_TRUE(fresh.axpy(-2, delta));
+  ASSERT_TRUE(fresh.norm(&result));
+  ASSERT_EQ(result, std::sqrt(20.0));
+  graph_value other(DOUBLE_VEC_TYPE), str(STRING_TYPE);
+  other.set_double_vec(small);
+  ASSERT_FALSE(fresh.dot(other, &result));
+  ASSERT_FALSE(fresh.axpy(1, other));
+  ASSERT_FALSE(str.norm(&result));
+  ASSERT_FALSE(str.set_double_vec(small));
+
+  // text form
+  ASSERT_TRUE(other.set_val(std::string("[1, 2.5,-3]")));
+  ASSERT_TRUE(other.get_double_vec(&out));
+  ASSERT_EQ(out.size(), 3);
+  ASSERT_EQ(out[1], 2.5);
+  ASSERT_EQ(out[2], -3);
+  ASSERT_TRUE(other.set_val(std::string("1 1 1"), true));
+  ASSERT_TRUE(other.get_double_vec(&out));
+  ASSERT_EQ(out[0], 2);
+  ASSERT_FALSE(other.set_val(std::string("1 x")));
+  std::stringstream text;
+  text << other;
+  ASSERT_TRUE(text.str() == "[2, 3.5, -2]: DOUBLE_VEC");
+
+  // rows of vectors through a loaded shard, whose vectors are in its arena
+  std::vector<graph_field> fields;
+  fields.push_back(graph_field("factor", DOUBLE_VEC_TYPE));
+  graph_shard_impl shard;
+  shard.shard_id = 0;
+  for (size_t i = 0; i < 100; ++i) {
+    graph_row row(fields, true);
+    row._data[0].set_double_vec(graph_d_vector_t(i % 5 ? 20 : 1, double(i)));
+    shard.add_vertex(i, row);
+  }
+  oarchive oarc;
+  oarc << shard;
+  graph_shard_impl loaded;
+  iarchive iarc(oarc.buf, oarc.off);
+  iarc >> loaded;
+  for (size_t i = 0; i < 100; ++i) {
+    graph_value& value = loaded.vertex_data[i]._data[0];
+    ASSERT_EQ(value.heap_bytes(), 0);
+    ASSERT_EQ(reinterpret_cast<size_t>(value.vec_data()) % sizeof(graph_double_t), 0);
+    ASSERT_TRUE(value.get_double_vec(&out));
+    ASSERT_TRUE(out == graph_d_vector_t(i % 5 ? 20 : 1, double(i)));
+    // an update in place stays in the arena
+    ASSERT_TRUE(value.set_val(shard.vertex_data[i]._data[0], true));
+    ASSERT_EQ(value.heap_bytes(), 0);
+    ASSERT_EQ(value.vec_data()[0], 2.0 * i);
+  }
+  free(oarc.buf);
+
+  // fixed dimension fields
+  std::vector<graph_field> vfields, efields;
+  vfields.push_back(graph_field("factor", DOUBLE_VEC_TYPE, 4));
+  graph_shard_server server(0, vfields, efields);
+  graph_row row(vfields, true);
+  ASSERT_EQ(server.add_vertex(1, row), 0);
+  // the adds check the dimension too
+  graph_row bad(vfields, true);
+  bad._data[0].set_double_vec(graph_d_vector_t(3, 1.0));
+  ASSERT_EQ(server.add_vertex(2, bad), EINVTYPE);
+  ASSERT_EQ(server.add_vertex(1, bad), EINVTYPE);
+  efields.push_back(graph_field("weights", DOUBLE_VEC_TYPE, 2));
+  graph_shard_server edge_server(0, vfields, efields);
+  graph_row edge(efields, false);
+  edge._data[0].set_double_vec(graph_d_vector_t(3, 1.0));
+  ASSERT_EQ(edge_server.add_edge(1, 2, edge), EINVTYPE);
+  ASSERT_EQ(edge_server.num_edges(), 0);
+  edge._data[0].set_double_vec(graph_d_vector_t(2, 1.0));
+  ASSERT_EQ(edge_server.add_edge(1, 2, edge), 0);
+  row._data[0].set_double_vec(graph_d_vector_t(3, 1.0));
+  ASSERT_EQ(server.set_vertex(1, row), EINVTYPE);
+  row._data[0].set_double_vec(graph_d_vector_t(4, 1.0));
+  ASSERT_EQ(server.set_vertex(1, row), 0);
+  graph_row got;
+  ASSERT_EQ(server.get_vertex(1, got), 0);
+  ASSERT_TRUE(got._data[0].get_double_vec(&out));
+  ASSERT_TRUE(out == graph_d_vector_t(4, 1.0));
+  // a NULL value clears the field
+  ASSERT_EQ(server.set_vertex(1, graph_row(vfields, true)), 0);
+  ASSERT_EQ(server.get_vertex(1, got), 0);
+  ASSERT_TRUE(got._data[0].is_null());
+}
+
+int main(int argc, char** argv) {
+  size_t nvecs = 1000000;
+  size_t dim = 20;
+  if (argc > 1) nvecs = atol(argv[1]);
+  if (argc > 2) dim = atol(argv[2]);
+
+  test_kernels();
+  test_values();
+
+  // kernels against the single accumulator loop
+  const size_t dims[] = {20, 128, 1024};
+  for (size_t d = 0; d < 3; ++d) {
+    size_t n = dims[d];
+    size_t rounds = 100000000 / n;
+    graph_d_vector_t a = random_vec(n), b = random_vec(n);
+    timer ti; ti.start();
+    graph_double_t sum = 0;
+    for (size_t r = 0; r < rounds; ++r) { sum += naive_dot(&a[0], &b[0], n); a[r % n] += 1e-9; }
+    double naive = ti.current_time();
+    ti.start();
+    for (size_t r = 0; r < rounds; ++r) { sum += vector_ops::dot(&a[0], &b[0], n); a[r % n] += 1e-9; }
+    double fast = ti.current_time();
+    ti.start();
+    for (size_t r = 0; r < rounds; ++r) vector_ops::axpy(1e-9, &a[0], &b[0], n);
+    double axpy = ti.current_time();
+    std::cout << "dim " << n << ": dot " << rounds * n / naive / 1e9 << " -> "
+              << rounds * n / fast / 1e9 << " Gflop/2, axpy " << rounds * n / axpy / 1e9
+              << " G/s (" << sum << ")\n";
+  }
+
+  // SGD on factor vectors: predict with dot, update both with axpy deltas
+  std::vector<graph_value> factors(nvecs, graph_value(DOUBLE_VEC_TYPE));
+  for (size_t i = 0; i < nvecs; ++i) factors[i].set_double_vec(random_vec(dim));
+  graph_value grad(DOUBLE_VEC_TYPE);
+  grad.set_double_vec(graph_d_vector_t(dim, 0));
+  const size_t nupdates = 4 * nvecs;
+  timer ti; ti.start();
+  for (size_t i = 0; i < nupdates; ++i) {
+    graph_value& u = factors[rand() % nvecs];
+    graph_value& v = factors[rand() % nvecs];
+    graph_double_t pred;
+    ASSERT_TRUE(u.dot(v, &pred));
+    graph_double_t err = 1.0 - pred;
+    // delta = 0.01 * err * v, sent as a delta update of u
+    vector_ops::scale(0, grad.vec_data(), dim);
+    vector_ops::axpy(0.01 * err, v.vec_data(), grad.vec_data(), dim);
+    u.set_val(grad, true);
+    v.axpy(0.01 * err, u);
+  }
+  double elapsed = ti.current_time();
+  std::cout << nupdates << " updates of " << dim << "-dim factors: "
+            << 2 * nupdates / elapsed / 1e6 << " M vectors/s\n";
+  std::cout << "Done\n";
+}
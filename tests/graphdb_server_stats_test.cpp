@@ -0,0 +1,138 @@
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <string>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/database/server/graphdb_server_stats.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks that graphdb_server_stats merges the requests recorded by many
+ * threads, that its latency and batch size percentiles are within the
+ * histogram precision, and the "name{labels} value" format of print()
+ * returned by ADMIN STATS.
+ * Usage: graphdb_server_stats_test [num_threads]
+ */
+
+const size_t NUM_REQUESTS = 1000;
+
+typedef std::map<std::string, double> metrics;
+
+// parses the output of print() into a map from "name{labels}" to value
+metrics parse(const std::string& text) {
+  metrics ret;
+  std::stringstream strm(text);
+  std::string line;
+  while (std::getline(strm, line)) {
+    size_t space = line.rfind(' ');
+    ASSERT_NE(space, std::string::npos);
+    std::string key = line.substr(0, space);
+    ASSERT_EQ(key[key.size() - 1], '}');
+    ASSERT_EQ(ret.count(key), 0);
+    ret[key] = atof(line.substr(space + 1).c_str());
+  }
+  return ret;
+}
+
+double get(const metrics& m, const std::string& key) {
+  metrics::const_iterator it = m.find(key);
+  if (it == m.end()) {
+    std::cout << "missing " << key << std::endl;
+    ASSERT_TRUE(false);
+  }
+  return it->second;
+}
+
+void check_close(double val, double expected) {
+  // the buckets are 1/32 of a power of two wide
+  ASSERT_GE(val, expected * 0.99);
+  ASSERT_LE(val, expected * 1.07);
+}
+
+// records batch gets of vertices taking 1..NUM_REQUESTS us, of which
+// every tenth fails, and with batches of 1..NUM_REQUESTS items
+void record(graphdb_server_stats* stats, double ticks_per_us) {
+  QueryMessage::header h(QueryMessage::BGET, QueryMessage::VERTEX);
+  for (size_t i = 1; i <= NUM_REQUESTS; ++i) {
+    stats->record_request(h, i % 10 != 0, 100, 1000,
+                          (unsigned long long)(i * ticks_per_us));
+    stats->record_batch(h, i);
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  if (argc > 1) nthreads = atol(argv[1]);
+  double ticks_per_us = estimate_ticks_per_second() / 1e6;
+  ASSERT_GT(ticks_per_us, 0);
+
+  graphdb_server_stats stats;
+  std::stringstream empty;
+  stats.print(empty);
+  ASSERT_TRUE(empty.str().empty());
+
+  thread_group group;
+  for (size_t i = 0; i < nthreads; ++i) {
+    group.launch(boost::bind(record, &stats, ticks_per_us));
+  }
+  group.join();
+  // a single request of another command, and headers off the wire which
+  // are out of range
+  stats.record_request(QueryMessage::header(QueryMessage::GET, QueryMessage::EDGE),
+                       true, 10, 20, (unsigned long long)(5 * ticks_per_us));
+  QueryMessage::header bad;
+  bad.cmd = QueryMessage::qm_cmd_type(QueryMessage::NUM_CMD_TYPE);
+  bad.obj = QueryMessage::VERTEX;
+  stats.record_request(bad, true, 1, 1, 1);
+  bad.cmd = QueryMessage::GET;
+  bad.obj = QueryMessage::qm_obj_type(QueryMessage::NUM_OBJ_TYPE + 3);
+  stats.record_batch(bad, 1);
+
+  std::stringstream out;
+  stats.print(out, "shard=\"3\"");
+  std::cout << out.str();
+  metrics m = parse(out.str());
+
+  const std::string bget = "{cmd=\"batch_get\",obj=\"vertex\",shard=\"3\"";
+  const double total = nthreads * NUM_REQUESTS;
+  ASSERT_EQ(get(m, "graphdb_requests" + bget + "}"), total);
+  ASSERT_EQ(get(m, "graphdb_failures" + bget + "}"), total / 10);
+  ASSERT_EQ(get(m, "graphdb_bytes_in" + bget + "}"), total * 100);
+  ASSERT_EQ(get(m, "graphdb_bytes_out" + bget + "}"), total * 1000);
+  ASSERT_EQ(get(m, "graphdb_batch_items" + bget + "}"),
+            nthreads * NUM_REQUESTS * (NUM_REQUESTS + 1) / 2);
+  const char* quantiles[] = {"0.5", "0.9", "0.99", "0.999"};
+  const double expected[] = {500, 900, 990, 999};
+  for (size_t i = 0; i < 4; ++i) {
+    std::string q = std::string(",quantile=\"") + quantiles[i] + "\"}";
+    check_close(get(m, "graphdb_latency_us" + bget + q), expected[i]);
+    check_close(get(m, "graphdb_batch_size" + bget + q), expected[i]);
+  }
+  check_close(get(m, "graphdb_latency_us_max" + bget + "}"), NUM_REQUESTS);
+
+  // the single get: no batch lines
+  const std::string get_edge = "{cmd=\"get\",obj=\"edge\",shard=\"3\"";
+  ASSERT_EQ(get(m, "graphdb_requests" + get_edge + "}"), 1);
+  ASSERT_EQ(get(m, "graphdb_failures" + get_edge + "}"), 0);
+  check_close(get(m, "graphdb_latency_us" + get_edge + ",quantile=\"0.5\"}"), 5);
+  ASSERT_EQ(m.count("graphdb_batch_items" + get_edge + "}"), 0);
+  // 4 counters, 5 latency and 5 batch lines for the batch get, and
+  // 4 counters and 5 latency lines for the get
+  ASSERT_EQ(m.size(), 14 + 9);
+
+  // without labels
+  std::stringstream unlabelled;
+  stats.print(unlabelled);
+  metrics u = parse(unlabelled.str());
+  ASSERT_EQ(get(u, "graphdb_requests{cmd=\"get\",obj=\"edge\"}"), 1);
+
+  stats.clear();
+  std::stringstream cleared;
+  stats.print(cleared);
+  ASSERT_TRUE(cleared.str().empty());
+  std::cout << "Done\n";
+}
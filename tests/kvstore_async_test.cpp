@@ -0,0 +1,231 @@
+#include <iostream>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/database/kvstore_async.hpp>
+#include <graphlab/database/kvstore_local.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks the background requests of kvstore_base: results, ordering of
+ * the sets, coalescing into bulk calls, the bound on the queue and the
+ * errors of the store, then
+ * measures them on kvstore_local against the synchronous calls.
+ * Usage: kvstore_async_test [nthreads] [requests_per_thread]
+ */
+
+// an in memory store which counts its calls, and can be made slow or
+// failing
+class counting_store : public kvstore_base {
+public:
+  size_t bulk_gets, bulk_sets, max_batch;
+  size_t delay_us;
+  bool failing;
+
+  counting_store() : bulk_gets(0), bulk_sets(0), max_batch(0), delay_us(0),
+                     failing(false) { }
+  ~counting_store() { stop_background_requests(); }
+
+  void set(const key_type key, const value_type &value) {
+    _lock.lock();
+    _data[key] = value;
+    _lock.unlock();
+  }
+
+  void bulk_set(const std::vector<std::pair<key_type, value_type> > &pairs) {
+    if (delay_us) usleep(delay_us);
+    if (failing) throw "store failure";
+    _lock.lock();
+    for (size_t i = 0; i < pairs.size(); ++i) _data[pairs[i].first] = pairs[i].second;
+    ++bulk_sets;
+    max_batch = std::max(max_batch, pairs.size());
+    _lock.unlock();
+  }
+
+  bool get(const key_type key, value_type &value) {
+    _lock.lock();
+    std::map<key_type, value_type>::const_iterator iter = _data.find(key);
+    bool found = iter != _data.end();
+    if (found) value = iter->second;
+    _lock.unlock();
+    return found;
+  }
+
+  std::vector<std::pair<bool, value_type> > bulk_get(const std::vector<key_type> &keys) {
+    if (delay_us) usleep(delay_us);
+    if (failing) throw "store failure";
+    _lock.lock();
+    ++bulk_gets;
+    max_batch = std::max(max_batch, keys.size());
+    _lock.unlock();
+    return kvstore_base::bulk_get(keys);
+  }
+
+  std::vector<value_type> range_get(const key_type key_lo, const key_type key_hi) {
+    if (failing) throw "store failure";
+    std::vector<value_type> result;
+    _lock.lock();
+    for (std::map<key_type, value_type>::const_iterator iter = _data.lower_bound(key_lo);
+         iter != _data.end() && iter->first < key_hi; ++iter) {
+      result.push_back(iter->second);
+    }
+    _lock.unlock();
+    return result;
+  }
+
+  void remove_all() {
+    _lock.lock();
+    _data.clear();
+    _lock.unlock();
+  }
+
+private:
+  mutex _lock;
+  std::map<key_type, value_type> _data;
+};
+
+std::string value_of(key_type key) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "value %llu", (unsigned long long)key);
+  return buf;
+}
+
+void async_getter(kvstore_base* store, size_t id, size_t nthreads, size_t n) {
+  // many requests in flight, then their results
+  std::vector<boost::shared_ptr<boost::unique_future<std::pair<bool, value_type> > > > futures(n);
+  for (size_t i = 0; i < n; ++i) {
+    futures[i].reset(new boost::unique_future<std::pair<bool, value_type> >(
+        store->background_get((i * nthreads + id) % 1000)));
+  }
+  for (size_t i = 0; i < n; ++i) {
+    key_type key = (i * nthreads + id) % 1000;
+    std::pair<bool, value_type> result = futures[i]->get();
+    ASSERT_TRUE(result.first);
+    ASSERT_TRUE(result.second == value_of(key));
+  }
+}
+
+void sync_getter(kvstore_base* store, size_t id, size_t nthreads, size_t n) {
+  value_type value;
+  for (size_t i = 0; i < n; ++i) {
+    key_type key = (i * nthreads + id) % 1000;
+    ASSERT_TRUE(store->get(key, value));
+  }
+}
+
+void setter(kvstore_base* store, size_t id, size_t nthreads, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    key_type key = (i * nthreads + id) % 1000;
+    store->background_set(key, value_of(key));
+  }
+}
+
+double run(void (*fn)(kvstore_base*, size_t, size_t, size_t), kvstore_base* store,
+           size_t nthreads, size_t n) {
+  timer ti; ti.start();
+  thread_group group;
+  for (size_t i = 0; i < nthreads; ++i) group.launch(boost::bind(fn, store, i, nthreads, n));
+  group.join();
+  return nthreads * n / ti.current_time() / 1e6;
+}
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  size_t n = 20000;
+  if (argc > 1) nthreads = atoi(argv[1]);
+  if (argc > 2) n = atol(argv[2]);
+
+  {
+    counting_store store;
+    kvstore_base::async_options opts;
+    opts.num_workers = 2;
+    opts.max_pending = 64;
+    opts.max_batch = 16;
+    store.set_async_options(opts);
+    store.delay_us = 100;
+
+    // sets of the same key are applied in order
+    for (size_t i = 0; i < 1000; ++i) store.background_set(7, value_of(i));
+    for (key_type key = 0; key < 1000; ++key) store.background_set(key, value_of(key));
+    store.wait_background();
+    ASSERT_LT(store.bulk_sets, 2000);
+    ASSERT_LE(store.max_batch, 16);
+
+    value_type value;
+    ASSERT_TRUE(store.get(7, value));
+    ASSERT_TRUE(value == value_of(7));
+
+    // concurrent gets are coalesced
+    run(async_getter, &store, nthreads, 1000);
+    ASSERT_LT(store.bulk_gets, nthreads * 1000);
+    ASSERT_LE(store.max_batch, 16);
+    std::cout << nthreads * 1000 << " gets in " << store.bulk_gets << " bulk gets\n";
+
+    std::vector<key_type> keys;
+    keys.push_back(3); keys.push_back(5000); keys.push_back(1);
+    boost::unique_future<std::vector<std::pair<bool, value_type> > > bulk(store.background_bulk_get(keys));
+    std::vector<std::pair<bool, value_type> > results = bulk.get();
+    ASSERT_EQ(results.size(), 3);
+    ASSERT_TRUE(results[0].first && results[0].second == value_of(3));
+    ASSERT_FALSE(results[1].first);
+    ASSERT_TRUE(results[2].first && results[2].second == value_of(1));
+
+    boost::unique_future<std::vector<value_type> > range(store.background_range_get(10, 20));
+    ASSERT_EQ(range.get().size(), 10);
+
+    // the errors reach the futures, and the workers survive them
+    store.failing = true;
+    for (key_type key = 0; key < 100; ++key) store.background_set(key, "lost");
+    std::vector<boost::shared_ptr<boost::unique_future<std::pair<bool, value_type> > > > futures;
+    for (key_type key = 0; key < 100; ++key) {
+      futures.push_back(boost::shared_ptr<boost::unique_future<std::pair<bool, value_type> > >(
+          new boost::unique_future<std::pair<bool, value_type> >(store.background_get(key))));
+    }
+    boost::unique_future<std::vector<std::pair<bool, value_type> > >
+        failed_bulk(store.background_bulk_get(keys));
+    boost::unique_future<std::vector<value_type> > failed_range(store.background_range_get(10, 20));
+    store.wait_background();
+    for (size_t i = 0; i < futures.size(); ++i) {
+      futures[i]->wait();
+      ASSERT_TRUE(futures[i]->has_exception());
+    }
+    failed_bulk.wait();
+    ASSERT_TRUE(failed_bulk.has_exception());
+    failed_range.wait();
+    ASSERT_TRUE(failed_range.has_exception());
+    bool thrown = false;
+    try {
+      failed_range.get();
+    } catch (...) {
+      thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+    store.failing = false;
+    ASSERT_TRUE(store.background_get(7).get().second == value_of(7));
+  }
+
+  // kvstore_local, with many writers and readers in flight
+  {
+    char dirname[] = "/tmp/kvstore_async_test.XXXXXX";
+    ASSERT_TRUE(mkdtemp(dirname) != NULL);
+    std::string dir(dirname);
+    {
+      kvstore_local store(dir);
+      double rate = run(setter, &store, nthreads, n);
+      store.wait_background();
+      std::cout << "background_set: " << rate << " M/s\n";
+      store.flush();
+      rate = run(async_getter, &store, nthreads, n);
+      std::cout << "background_get: " << rate << " M/s\n";
+      rate = run(sync_getter, &store, nthreads, n);
+      std::cout << "get: " << rate << " M/s\n";
+    }
+    int ret = system(("rm -rf " + dir).c_str());
+    ASSERT_EQ(ret, 0);
+  }
+  std::cout << "Done\n";
+}
@@ -0,0 +1,262 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <graphlab/database/kvstore_local.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/util/fs_util.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks kvstore_local against a std::map through flushes, compactions,
+ * reopens and concurrent access, that the compactions merge tables of
+ * similar sizes and keep the removals which hide older tables, and that
+ * corrupt blocks are detected, then measures its throughput.
+ * Usage: kvstore_local_test [nthreads] [keys_per_thread]
+ */
+
+std::string value_of(key_type key, size_t version) {
+  std::stringstream strm;
+  strm << "value " << key << " " << version;
+  return strm.str();
+}
+
+void check_equal(kvstore_local& store, const std::map<key_type, std::string>& expected,
+                 key_type max_key) {
+  value_type value;
+  std::vector<key_type> keys;
+  for (key_type key = 0; key < max_key; ++key) {
+    std::map<key_type, std::string>::const_iterator iter = expected.find(key);
+    bool found = store.get(key, value);
+    ASSERT_TRUE(found == (iter != expected.end()));
+    if (found) ASSERT_EQ(value, iter->second);
+    keys.push_back(max_key - 1 - key);
+  }
+  std::vector<std::pair<bool, value_type> > bulk = store.bulk_get(keys);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    std::map<key_type, std::string>::const_iterator iter = expected.find(keys[i]);
+    ASSERT_TRUE(bulk[i].first == (iter != expected.end()));
+    if (bulk[i].first) ASSERT_EQ(bulk[i].second, iter->second);
+  }
+  std::vector<std::pair<key_type, value_type> > range;
+  store.range_get(max_key / 4, max_key / 2, range);
+  std::map<key_type, std::string>::const_iterator iter = expected.lower_bound(max_key / 4);
+  for (size_t i = 0; i < range.size(); ++i, ++iter) {
+    ASSERT_TRUE(iter != expected.end());
+    ASSERT_EQ(range[i].first, iter->first);
+    ASSERT_EQ(range[i].second, iter->second);
+  }
+  ASSERT_TRUE(iter == expected.end() || iter->first >= max_key / 2);
+}
+
+// waits for the background compactions to leave ntables tables
+void wait_for_tables(kvstore_local& store, size_t ntables) {
+  timer ti; ti.start();
+  while (store.num_tables() != ntables) {
+    ASSERT_LT(ti.current_time(), 30);
+    usleep(1000);
+  }
+}
+
+void test_size_tiers(const std::string& dir, kvstore_local::options opts) {
+  opts.compaction_trigger = 4;
+  kvstore_local store(dir, opts);
+  // a large table, then small ones which are merged without it
+  for (key_type key = 0; key < 20000; ++key) store.set(key, value_of(key, 0));
+  store.compact();
+  ASSERT_EQ(store.num_tables(), 1);
+  for (size_t i = 0; i < 4; ++i) {
+    for (key_type key = 20000 + i * 100; key < 20000 + (i + 1) * 100; ++key) {
+      store.set(key, value_of(key, i));
+    }
+    // the removals must hide the values of the large table
+    store.remove(7 + i);
+    store.flush();
+  }
+  wait_for_tables(store, 2);
+  value_type value;
+  for (size_t i = 0; i < 4; ++i) ASSERT_FALSE(store.get(7 + i, value));
+  ASSERT_TRUE(store.get(20301, value));
+  ASSERT_EQ(value, value_of(20301, 3));
+  ASSERT_TRUE(store.get(19999, value));
+  ASSERT_EQ(value, value_of(19999, 0));
+  std::vector<std::pair<key_type, value_type> > range;
+  store.range_get(0, 30000, range);
+  ASSERT_EQ(range.size(), 20000 + 400 - 4);
+  store.compact();
+  ASSERT_EQ(store.num_tables(), 1);
+  ASSERT_FALSE(store.get(8, value));
+  store.remove_all();
+}
+
+void test_corrupt_block(const std::string& dir, const kvstore_local::options& opts) {
+  {
+    kvstore_local store(dir, opts);
+    for (key_type key = 0; key < 1000; ++key) store.set(key, value_of(key, 0));
+    store.flush();
+  }
+  std::vector<std::string> files;
+  fs_util::list_files_with_suffix(dir, ".sst", files);
+  ASSERT_EQ(files.size(), 1);
+  // flip a byte of the value of the first record
+  std::string path = dir + "/" + files[0];
+  FILE* f = fopen(path.c_str(), "r+b");
+  ASSERT_TRUE(f != NULL);
+  ASSERT_EQ(fseek(f, 16, SEEK_SET), 0);
+  int c = fgetc(f);
+  ASSERT_EQ(fseek(f, 16, SEEK_SET), 0);
+  fputc(c ^ 1, f);
+  fclose(f);
+
+  kvstore_local store(dir, opts);
+  value_type value;
+  ASSERT_TRUE(store.get(999, value));
+  bool failed = false;
+  try {
+    store.get(0, value);
+  } catch (const char*) {
+    failed = true;
+  }
+  ASSERT_TRUE(failed);
+  store.remove_all();
+}
+
+void writer(kvstore_local* store, size_t id, size_t nthreads, size_t nkeys) {
+  for (size_t i = 0; i < nkeys; ++i) {
+    key_type key = i * nthreads + id;
+    store->set(key, value_of(key, 0));
+  }
+}
+
+void reader(kvstore_local* store, size_t nkeys, size_t* hits) {
+  value_type value;
+  unsigned int seed = 1;
+  for (size_t i = 0; i < nkeys; ++i) {
+    key_type key = rand_r(&seed) % nkeys;
+    if (store->get(key, value)) {
+      ASSERT_EQ(value, value_of(key, 0));
+      ++*hits;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  size_t nkeys = 100000;
+  if (argc > 1) nthreads = atoi(argv[1]);
+  if (argc > 2) nkeys = atol(argv[2]);
+
+  char dirname[] = "/tmp/kvstore_local_test.XXXXXX";
+  ASSERT_TRUE(mkdtemp(dirname) != NULL);
+  std::string dir(dirname);
+
+  // small memtables and blocks, so that there are many tables and blocks
+  kvstore_local::options opts;
+  opts.memtable_bytes = 64 << 10;
+  opts.block_bytes = 512;
+  opts.cache_bytes = 1 << 20;
+  const key_type max_key = 5000;
+  std::map<key_type, std::string> expected;
+  {
+    kvstore_local store(dir, opts);
+    value_type value;
+    ASSERT_FALSE(store.get(1, value));
+    for (size_t version = 0; version < 4; ++version) {
+      for (key_type key = version; key < max_key; key += version + 1) {
+        store.set(key, value_of(key, version));
+        expected[key] = value_of(key, version);
+      }
+      for (key_type key = version; key < max_key; key += 7) {
+        store.remove(key);
+        expected.erase(key);
+      }
+      check_equal(store, expected, max_key);
+    }
+    store.flush();
+    ASSERT_GT(store.num_tables(), 0);
+    check_equal(store, expected, max_key);
+    // these stay in the log
+    store.set(max_key + 1, "unflushed");
+    expected[max_key + 1] = "unflushed";
+    store.remove(2);
+    expected.erase(2);
+  }
+
+  // reopen from the tables and the log
+  {
+    kvstore_local store(dir, opts);
+    check_equal(store, expected, max_key + 2);
+    store.compact();
+    ASSERT_EQ(store.num_tables(), 1);
+    check_equal(store, expected, max_key + 2);
+    ASSERT_GT(store.block_cache_stats().hits, 0);
+
+    std::vector<value_type> values = store.range_get(max_key, max_key + 2);
+    ASSERT_EQ(values.size(), 1);
+    ASSERT_TRUE(values[0] == "unflushed");
+
+    // removing everything leaves an empty table out
+    for (key_type key = 0; key < max_key + 2; ++key) store.remove(key);
+    store.compact();
+    ASSERT_EQ(store.num_tables(), 0);
+    expected.clear();
+    check_equal(store, expected, max_key + 2);
+
+    store.set(3, "three");
+    store.flush();
+    store.remove_all();
+    check_equal(store, expected, max_key + 2);
+  }
+  {
+    kvstore_local store(dir, opts);
+    check_equal(store, expected, max_key + 2);
+  }
+
+  test_size_tiers(dir, opts);
+  test_corrupt_block(dir, opts);
+
+  // concurrent writers, then concurrent readers
+  {
+    opts.memtable_bytes = 4 << 20;
+    opts.block_bytes = 4096;
+    opts.cache_bytes = 64 << 20;
+    kvstore_local store(dir, opts);
+    timer ti; ti.start();
+    thread_group group;
+    for (size_t i = 0; i < nthreads; ++i) {
+      group.launch(boost::bind(writer, &store, i, nthreads, nkeys));
+    }
+    group.join();
+    double write_time = ti.current_time();
+    store.flush();
+    std::cout << "set: " << nthreads * nkeys / write_time / 1e6 << " M/s, "
+              << store.num_tables() << " tables\n";
+
+    std::vector<size_t> hits(nthreads, 0);
+    ti.start();
+    for (size_t i = 0; i < nthreads; ++i) {
+      group.launch(boost::bind(reader, &store, nthreads * nkeys, &hits[i]));
+    }
+    group.join();
+    double read_time = ti.current_time();
+    for (size_t i = 0; i < nthreads; ++i) ASSERT_EQ(hits[i], nthreads * nkeys);
+    std::cout << "get: " << nthreads * nthreads * nkeys / read_time / 1e6 << " M/s, "
+              << "cache hit rate " << store.block_cache_stats().hit_ratio() << "\n";
+
+    std::vector<key_type> keys(nthreads * nkeys);
+    for (size_t i = 0; i < keys.size(); ++i) keys[i] = keys.size() - 1 - i;
+    ti.start();
+    std::vector<std::pair<bool, value_type> > bulk = store.bulk_get(keys);
+    std::cout << "bulk_get: " << keys.size() / ti.current_time() / 1e6 << " M/s\n";
+    for (size_t i = 0; i < keys.size(); ++i) ASSERT_TRUE(bulk[i].first);
+    store.remove_all();
+  }
+  int ret = system(("rm -rf " + dir).c_str());
+  ASSERT_EQ(ret, 0);
+  std::cout << "Done\n";
+}
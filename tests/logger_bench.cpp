@@ -0,0 +1,111 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+using namespace graphlab;
+
+/*
+ * Measures the cost of a per request log line through the locked
+ * logstream() and logger() calls against the buffered, sampled and rate
+ * limited calls, and against calls disabled at runtime and at compile
+ * time. Checks the number of lines each one writes.
+ * Usage: logger_bench [nthreads] [calls_per_thread]
+ */
+
+size_t NTHREADS;
+size_t NCALLS;
+
+void log_stream(size_t n) {
+  for (size_t i = 0;i < n; ++i) {
+    logstream(LOG_EMPH) << "cmd=get obj=vertex bytes_in=" << i
+                        << " success=1" << std::endl;
+  }
+}
+
+void log_printf(size_t n) {
+  for (size_t i = 0;i < n; ++i) {
+    logger(LOG_EMPH, "cmd=get obj=vertex bytes_in=%lu success=1", i);
+  }
+}
+
+void log_buffered(size_t n) {
+  for (size_t i = 0;i < n; ++i) {
+    logger_buffered(LOG_EMPH, "cmd=get obj=vertex bytes_in=%lu success=1", i);
+  }
+}
+
+void log_sampled(size_t n) {
+  for (size_t i = 0;i < n; ++i) {
+    logger_sampled(1024, LOG_EMPH, "cmd=get obj=vertex bytes_in=%lu success=1", i);
+  }
+}
+
+void log_ratelimit(size_t n) {
+  for (size_t i = 0;i < n; ++i) {
+    logger_ratelimit(100, LOG_EMPH, "cmd=get obj=vertex bytes_in=%lu success=1", i);
+  }
+}
+
+// LOG_INFO is below the default OUTPUTLEVEL
+void log_compiled_out(size_t n) {
+  for (size_t i = 0;i < n; ++i) {
+    logger_buffered(LOG_INFO, "cmd=get obj=vertex bytes_in=%lu success=1", i);
+  }
+}
+
+size_t count_lines(const std::string& fname) {
+  std::ifstream fin(fname.c_str());
+  std::string line;
+  size_t lines = 0;
+  while (std::getline(fin, line)) ++lines;
+  return lines;
+}
+
+// returns the number of lines written
+size_t bench(const char* name, void (*fn)(size_t)) {
+  std::string fname = "logger_bench.log";
+  global_logger().set_log_file(fname);
+  thread_group group;
+  timer ti; ti.start();
+  for (size_t i = 0;i < NTHREADS; ++i) {
+    group.launch(boost::bind(fn, NCALLS));
+  }
+  // the log buffers are written out when the threads exit
+  group.join();
+  double elapsed = ti.current_time();
+  global_logger().set_log_file("");
+  size_t lines = count_lines(fname);
+  remove(fname.c_str());
+  std::cout << name << ": "
+            << elapsed * 1e9 / (NTHREADS * NCALLS) << " ns/call, "
+            << lines << " lines\n";
+  return lines;
+}
+
+int main(int argc, char** argv) {
+  NTHREADS = 4;
+  NCALLS = 200000;
+  if (argc > 1) NTHREADS = atoi(argv[1]);
+  if (argc > 2) NCALLS = atol(argv[2]);
+  size_t total = NTHREADS * NCALLS;
+
+  global_logger().set_log_to_console(false);
+  ASSERT_EQ(bench("logstream", log_stream), total);
+  ASSERT_EQ(bench("logger", log_printf), total);
+  ASSERT_EQ(bench("logger_buffered", log_buffered), total);
+  ASSERT_EQ(bench("logger_sampled 1/1024", log_sampled), (total + 1023) / 1024);
+  size_t ratelimited = bench("logger_ratelimit 100/s", log_ratelimit);
+  ASSERT_GE(ratelimited, 1);
+  ASSERT_LT(ratelimited, total);
+  ASSERT_EQ(bench("compiled out", log_compiled_out), 0);
+
+  global_logger().set_log_level(LOG_WARNING);
+  ASSERT_EQ(bench("disabled at runtime", log_buffered), 0);
+  global_logger().set_log_level(LOG_EMPH);
+  global_logger().set_log_to_console(true);
+}
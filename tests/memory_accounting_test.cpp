@@ -0,0 +1,86 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/util/memory_accounting.hpp>
+#include <graphlab/database/graph_shard_impl.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+// The counters must balance out when every thread frees what it
+// allocated, and the measured shard usage must grow with its contents.
+
+const size_t N = 100000;
+
+void alloc_and_free() {
+  for (size_t i = 0;i < N; ++i) {
+    memory_accounting::add(memory_accounting::COMM_BUFFERS, 100);
+    memory_accounting::add(memory_accounting::INGRESS_BUFFERS, 10);
+    memory_accounting::add(memory_accounting::COMM_BUFFERS, -100);
+  }
+}
+
+void add_vertices(graph_shard_impl& shard, size_t begin, size_t end) {
+  std::vector<graph_field> fields;
+  fields.push_back(graph_field("rank", DOUBLE_TYPE));
+  fields.push_back(graph_field("name", STRING_TYPE));
+  for (size_t i = begin; i < end; ++i) {
+    graph_row row(fields, true);
+    row._data[0].set_double(1.0);
+    std::stringstream name; name << "vertex_" << i;
+    row._data[1].set_string(name.str());
+    shard.add_vertex(i, row);
+    shard.add_vertex_mirror(i, (i + 1) % 4);
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  if (argc > 1) nthreads = atoi(argv[1]);
+
+  thread_group group;
+  for (size_t i = 0;i < nthreads; ++i) {
+    group.launch(alloc_and_free);
+  }
+  group.join();
+  memory_accounting::usage counted = memory_accounting::counted();
+  ASSERT_EQ(counted.bytes[memory_accounting::COMM_BUFFERS], 0);
+  ASSERT_EQ(counted.bytes[memory_accounting::INGRESS_BUFFERS], 10 * N * nthreads);
+  memory_accounting::add(memory_accounting::INGRESS_BUFFERS, -(ptrdiff_t)(10 * N * nthreads));
+
+  // a free counted before its allocation does not show up as negative
+  memory_accounting::add(memory_accounting::COMM_BUFFERS, -10);
+  ASSERT_EQ(memory_accounting::counted().bytes[memory_accounting::COMM_BUFFERS], 0);
+  memory_accounting::add(memory_accounting::COMM_BUFFERS, 10);
+
+  graph_shard_impl shard;
+  memory_accounting::usage empty;
+  shard.memory_usage(empty);
+
+  add_vertices(shard, 0, 1000);
+  memory_accounting::usage small;
+  shard.memory_usage(small);
+  ASSERT_GT(small.bytes[memory_accounting::SHARD_COLUMNS], empty.bytes[memory_accounting::SHARD_COLUMNS]);
+  ASSERT_GE(small.bytes[memory_accounting::SHARD_ROWS], 1000 * sizeof(graph_row));
+  ASSERT_GT(small.bytes[memory_accounting::VERTEX_INDEX], empty.bytes[memory_accounting::VERTEX_INDEX]);
+  ASSERT_GT(small.bytes[memory_accounting::VERTEX_MIRRORS], empty.bytes[memory_accounting::VERTEX_MIRRORS]);
+  ASSERT_EQ(small.bytes[memory_accounting::COMM_BUFFERS], 0);
+
+  add_vertices(shard, 1000, 10000);
+  memory_accounting::usage large;
+  shard.memory_usage(large);
+  ASSERT_GT(large.total(), 5 * small.total());
+
+  memory_accounting::usage sum = small;
+  sum += large;
+  ASSERT_EQ(sum.total(), small.total() + large.total());
+
+  std::stringstream strm;
+  large.print(strm, "test_memory_bytes", "shard=\"0\"");
+  ASSERT_NE(strm.str().find("test_memory_bytes{shard=\"0\",subsystem=\"vertex_index\"} "),
+            std::string::npos);
+  std::cout << strm.str();
+  std::cout << "Done\n";
+}
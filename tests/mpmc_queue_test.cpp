@@ -0,0 +1,154 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/mpmc_queue.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks mpmc_queue at its full and empty boundaries, that close() wakes
+ * up sleeping producers and consumers, and that with many blocking
+ * producers and consumers every element arrives exactly once.
+ * Usage: mpmc_queue_test [num_threads]
+ */
+
+const size_t NUM_ELEMENTS = 200000;
+
+void test_boundaries() {
+  mpmc_queue<size_t> q(5);
+  ASSERT_EQ(q.capacity(), 8);
+  size_t val = 0;
+  ASSERT_FALSE(q.try_dequeue(val));
+  for (size_t i = 0; i < 8; ++i) ASSERT_TRUE(q.try_enqueue(i));
+  ASSERT_FALSE(q.try_enqueue(8));
+  ASSERT_EQ(q.size(), 8);
+  ASSERT_TRUE(q.try_dequeue(val));
+  ASSERT_EQ(val, 0);
+  ASSERT_TRUE(q.try_enqueue(8));
+
+  // bulk calls return partial counts at the boundaries
+  size_t out[16];
+  ASSERT_EQ(q.try_dequeue_bulk(out, 3), 3);
+  for (size_t i = 0; i < 3; ++i) ASSERT_EQ(out[i], i + 1);
+  size_t in[16];
+  for (size_t i = 0; i < 16; ++i) in[i] = 100 + i;
+  ASSERT_EQ(q.try_enqueue_bulk(in, 16), 3);
+  ASSERT_EQ(q.try_enqueue_bulk(in, 16), 0);
+  ASSERT_EQ(q.try_dequeue_bulk(out, 16), 8);
+  for (size_t i = 0; i < 5; ++i) ASSERT_EQ(out[i], i + 4);
+  for (size_t i = 0; i < 3; ++i) ASSERT_EQ(out[5 + i], 100 + i);
+  ASSERT_EQ(q.try_dequeue_bulk(out, 16), 0);
+  ASSERT_TRUE(q.empty());
+
+  // many laps around the ring
+  for (size_t i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(q.try_enqueue(i));
+    ASSERT_TRUE(q.try_dequeue(val));
+    ASSERT_EQ(val, i);
+  }
+}
+
+void consume_one(mpmc_queue<size_t>* q, atomic<size_t>* got) {
+  size_t val;
+  while (q->dequeue(val)) got->inc();
+}
+
+void produce_one(mpmc_queue<size_t>* q, atomic<size_t>* rejected) {
+  if (!q->enqueue(1)) rejected->inc();
+}
+
+void test_close() {
+  // consumers sleeping on an empty queue drain it and return
+  {
+    mpmc_queue<size_t> q(4, true);
+    atomic<size_t> got(0);
+    thread_group group;
+    for (size_t i = 0; i < 4; ++i) {
+      group.launch(boost::bind(consume_one, &q, &got));
+    }
+    usleep(50000);
+    ASSERT_TRUE(q.enqueue(1));
+    ASSERT_TRUE(q.enqueue(2));
+    q.close();
+    group.join();
+    ASSERT_EQ(got.value, 2);
+    size_t val;
+    ASSERT_FALSE(q.dequeue(val));
+    ASSERT_FALSE(q.enqueue(3));
+    ASSERT_TRUE(q.is_closed());
+  }
+  // producers sleeping on a full queue fail
+  {
+    mpmc_queue<size_t> q(2, true);
+    ASSERT_TRUE(q.enqueue(1));
+    ASSERT_TRUE(q.enqueue(2));
+    atomic<size_t> rejected(0);
+    thread_group group;
+    for (size_t i = 0; i < 4; ++i) {
+      group.launch(boost::bind(produce_one, &q, &rejected));
+    }
+    usleep(50000);
+    q.close();
+    group.join();
+    ASSERT_EQ(rejected.value, 4);
+    // the elements queued before close() can still be read
+    size_t out[4];
+    ASSERT_EQ(q.dequeue_bulk(out, 4), 2);
+    ASSERT_EQ(q.dequeue_bulk(out, 4), 0);
+  }
+}
+
+void produce(mpmc_queue<size_t>* q, size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    if (i % 3 == 0) {
+      ASSERT_TRUE(q->enqueue(i));
+    } else {
+      // bulk inserts of two, falling back to blocking ones when full
+      size_t elems[2] = {i, i + 1 < end ? i + 1 : i};
+      size_t n = i + 1 < end ? 2 : 1;
+      size_t sent = q->try_enqueue_bulk(elems, n);
+      for (size_t j = sent; j < n; ++j) ASSERT_TRUE(q->enqueue(elems[j]));
+      i += n - 1;
+    }
+  }
+}
+
+void consume(mpmc_queue<size_t>* q, std::vector<atomic<size_t> >* seen) {
+  size_t out[8];
+  while (true) {
+    size_t n = q->dequeue_bulk(out, 8);
+    if (n == 0) break;
+    for (size_t i = 0; i < n; ++i) (*seen)[out[i]].inc();
+  }
+}
+
+void test_threads(size_t nthreads) {
+  mpmc_queue<size_t> q(64, true);
+  std::vector<atomic<size_t> > seen(NUM_ELEMENTS);
+  thread_group consumers, producers;
+  for (size_t i = 0; i < nthreads; ++i) {
+    consumers.launch(boost::bind(consume, &q, &seen));
+  }
+  for (size_t i = 0; i < nthreads; ++i) {
+    producers.launch(boost::bind(produce, &q, NUM_ELEMENTS * i / nthreads,
+                                 NUM_ELEMENTS * (i + 1) / nthreads));
+  }
+  producers.join();
+  q.close();
+  consumers.join();
+  for (size_t i = 0; i < NUM_ELEMENTS; ++i) ASSERT_EQ(seen[i].value, 1);
+}
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  if (argc > 1) nthreads = atol(argv[1]);
+  test_boundaries();
+  test_close();
+  test_threads(nthreads);
+  test_threads(1);
+  std::cout << "Done\n";
+}
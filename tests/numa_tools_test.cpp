@@ -0,0 +1,107 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <boost/lexical_cast.hpp>
+#include <graphlab/parallel/numa_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks the cpulist parsing, the node discovery on a fake sysfs tree and
+ * its single node fallback, and the topology and pools of this machine.
+ */
+
+std::vector<size_t> parse(const std::string& str) {
+  std::vector<size_t> cpus;
+  numa_tools::parse_cpulist(str, cpus);
+  return cpus;
+}
+
+void write_node(const std::string& dir, size_t node, const std::string& cpulist) {
+  std::string node_dir = dir + "/node" + boost::lexical_cast<std::string>(node);
+  ASSERT_EQ(mkdir(node_dir.c_str(), 0755), 0);
+  std::ofstream fout((node_dir + "/cpulist").c_str());
+  fout << cpulist << "\n";
+}
+
+void test_parse_cpulist() {
+  ASSERT_TRUE(parse("").empty());
+  ASSERT_TRUE(parse("3") == std::vector<size_t>(1, 3));
+  std::vector<size_t> cpus = parse("0-3,8,10-11");
+  ASSERT_EQ(cpus.size(), 7);
+  ASSERT_EQ(cpus[3], 3);
+  ASSERT_EQ(cpus[4], 8);
+  ASSERT_EQ(cpus[6], 11);
+  // malformed ranges are skipped
+  cpus = parse("x,2,,-,5-5");
+  ASSERT_EQ(cpus.size(), 2);
+  ASSERT_EQ(cpus[0], 2);
+  ASSERT_EQ(cpus[1], 5);
+}
+
+void test_discover_nodes() {
+  char dirname[] = "/tmp/numa_tools_test.XXXXXX";
+  ASSERT_TRUE(mkdtemp(dirname) != NULL);
+  std::string dir(dirname);
+
+  // no nodes: one node with every cpu
+  std::vector<std::vector<size_t> > nodes = numa_tools::discover_nodes(dir, 4);
+  ASSERT_EQ(nodes.size(), 1);
+  ASSERT_EQ(nodes[0].size(), 4);
+  ASSERT_EQ(nodes[0][3], 3);
+  nodes = numa_tools::discover_nodes(dir + "/missing", 0);
+  ASSERT_EQ(nodes.size(), 1);
+  ASSERT_EQ(nodes[0].size(), 1);
+
+  // two nodes with cpus and a trailing memory only node
+  write_node(dir, 0, "0-1,4-5");
+  write_node(dir, 1, "2-3,6-7");
+  write_node(dir, 2, "");
+  nodes = numa_tools::discover_nodes(dir, 8);
+  ASSERT_EQ(nodes.size(), 2);
+  ASSERT_TRUE(nodes[0] == parse("0,1,4,5"));
+  ASSERT_TRUE(nodes[1] == parse("2,3,6,7"));
+
+  int ret = system(("rm -rf " + dir).c_str());
+  ASSERT_EQ(ret, 0);
+}
+
+atomic<size_t> counter;
+void count() { counter.inc(); }
+
+void test_machine() {
+  size_t nnodes = numa_tools::num_nodes();
+  ASSERT_GE(nnodes, 1);
+  size_t ncpus = 0;
+  for (size_t n = 0; n < nnodes; ++n) {
+    const std::vector<size_t>& cpus = numa_tools::node_cpus(n);
+    ncpus += cpus.size();
+    for (size_t i = 0; i < cpus.size(); ++i) {
+      ASSERT_EQ(numa_tools::cpu_to_node(cpus[i]), n);
+    }
+    ASSERT_EQ(numa_tools::partition_to_node(n), n);
+  }
+  ASSERT_GE(ncpus, 1);
+  ASSERT_LT(numa_tools::current_node(), nnodes);
+  std::cout << nnodes << " nodes, " << ncpus << " cpus\n";
+
+  numa_thread_pools pools(2);
+  ASSERT_EQ(pools.size(), nnodes);
+  for (size_t n = 0; n < nnodes; ++n) {
+    for (size_t i = 0; i < 100; ++i) pools.launch(n, count);
+    pools.run_on_node(n, count);
+  }
+  pools.join();
+  ASSERT_EQ(counter.value, 101 * nnodes);
+}
+
+int main(int argc, char** argv) {
+  test_parse_cpulist();
+  test_discover_nodes();
+  test_machine();
+  std::cout << "Done\n";
+}
@@ -14,7 +14,9 @@
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/parallel/qthread_tools.hpp>
 #include <graphlab/parallel/atomic.hpp>
-#include <graphlab/parallel/qthread_future.hpp>
+#include <graphlab/parallel/reducer.hpp>
+#include <graphlab/parallel/future.hpp>
+#include <graphlab/parallel/qthread_executor.hpp>
 #include <graphlab/comm/comm_rpc.hpp>
 
 #define WEIGHT_REQUEST (0)
@@ -32,10 +34,10 @@ size_t datapoints_so_far;
 
 graphlab::comm_base* comm;
 graphlab::comm_rpc* rpc;
-graphlab::atomic<size_t> loss01;
-graphlab::atomic<size_t> global_loss01;
-graphlab::atomic<double> lossl2;
-graphlab::atomic<double> global_lossl2;
+graphlab::reducer<size_t> loss01;
+graphlab::reducer<size_t> global_loss01;
+graphlab::reducer<double> lossl2;
+graphlab::reducer<double> global_lossl2;
 graphlab::atomic<size_t> loss_count;
 graphlab::atomic<size_t> weight_sync;
 struct feature: public graphlab::IS_POD_TYPE {
@@ -47,11 +49,9 @@ struct feature: public graphlab::IS_POD_TYPE {
 
 
 
-struct request_future_result {
-  graphlab::atomic<unsigned short> num_requests;
-  boost::unordered_map<size_t, double> store;
-  graphlab::mutex lock;
-};
+// each outstanding weight request is a heap allocated promise whose
+// address is carried in the message and fulfilled by process_reply
+typedef graphlab::promise<std::vector<feature> > request_promise;
 
 
 struct request_message {
@@ -111,36 +111,34 @@ struct update_reply_message {
 
 
 /**
- * Sends out a request for all weights required for a data point
+ * Sends out a request for all weights required for a data point.
+ * Weights stored locally are written to local_weights immediately.
+ * Returns a future for the weights held by the other machines.
  */
-void send_requests(const std::vector<feature>& x, 
-                   request_future_result* result) {
+graphlab::future<std::vector<std::vector<feature> > >
+send_requests(const std::vector<feature>& x,
+              boost::unordered_map<size_t, double>& local_weights) {
   std::vector<request_message> message;
   message.resize(comm->size());
   for (size_t i = 0; i < x.size(); ++i) {
     size_t targetmachine = x[i].id % comm->size();
-    if (targetmachine == comm->rank()) result->store[x[i].id] = weights[x[i].id];
+    if (targetmachine == comm->rank()) local_weights[x[i].id] = weights[x[i].id];
     else message[targetmachine].ids.push_back(x[i].id);
   }
-  // figure out the number of requests we are making
-  size_t numrequests = 0;
-  for (size_t i = 0;i < comm->size(); ++i) numrequests += (message[i].ids.size() > 0);
-  result->num_requests.value = numrequests;
-  if (numrequests == 0) {
-    graphlab::qthread_future<request_future_result>::signal(result);
-    return;
-  }
-  //printf("Req 0x%lx\n", result);
   // fill in the request_handle_pointer in the message
   // and send it out
+  std::vector<graphlab::future<std::vector<feature> > > replies;
   for (size_t i = 0;i < comm->size(); ++i) {
     if (message[i].ids.size() > 0) {
+      request_promise* result = new request_promise;
+      replies.push_back(result->get_future());
       message[i].request_handle_ptr = reinterpret_cast<size_t>(result);
       graphlab::oarchive* oarc = rpc->prepare_message(WEIGHT_REQUEST);
       (*oarc) << message[i];
       rpc->complete_message(i, oarc);
     }
   }
+  return graphlab::when_all(replies);
 }
 
 
@@ -173,18 +171,10 @@ void process_reply(graphlab::comm_rpc* comm,
   iarc >> reply;
 
   // get the request pointer back
-  request_future_result* req = 
-      reinterpret_cast<request_future_result*>(reply.request_handle_ptr);
-
-  //printf("Req Rep 0x%lx\n", req);
-  req->lock.lock();
-  for (size_t i = 0; i < reply.res.size(); ++i) {
-    req->store[reply.res[i].id] = reply.res[i].value;
-  }
-  req->lock.unlock();
-  if (req->num_requests.dec() == 0) {
-    graphlab::qthread_future<request_future_result>::signal(req);
-  }
+  request_promise* req = 
+      reinterpret_cast<request_promise*>(reply.request_handle_ptr);
+  req->set_value(reply.res);
+  delete req;
 }
 
 void send_update(const boost::unordered_map<size_t, double>& updates) {
@@ -225,13 +215,13 @@ void process_loss_update(graphlab::comm_rpc* rpc,
   graphlab::iarchive iarc(c, len);
   size_t loss; double dloss;
   iarc >> loss >> dloss;
-  global_loss01.inc(loss);
-  global_lossl2.inc(dloss);
+  global_loss01 += loss;
+  global_lossl2 += dloss;
   if (loss_count.value == rpc->get_comm()->size() - 1) {
     std::cout << "Average Loss01 = " 
-              << global_loss01.value << " / " << datapoints_so_far << ": " 
-              << (double)(global_loss01.value) / datapoints_so_far << std::endl;
-    std::cout << "Average LossL2 = " << global_lossl2.value / datapoints_so_far << std::endl;
+              << global_loss01.value() << " / " << datapoints_so_far << ": " 
+              << (double)(global_loss01.value()) / datapoints_so_far << std::endl;
+    std::cout << "Average LossL2 = " << global_lossl2.value() / datapoints_so_far << std::endl;
   }
   loss_count.inc();
 }
@@ -256,11 +246,16 @@ void process_weight_sync(graphlab::comm_rpc* rpc,
 double logistic_sgd_step(const std::vector<feature>& x, double y) {
   // compute predicted value of y
   double linear_predictor = 0;
-  graphlab::qthread_future<request_future_result> qfuture;
-  send_requests(x, &qfuture.get());
-  qfuture.wait();
-  assert(qfuture.get().num_requests == 0);
-  boost::unordered_map<size_t, double>& w = qfuture.get().store;
+  boost::unordered_map<size_t, double> w;
+  graphlab::future<std::vector<std::vector<feature> > > replies =
+      send_requests(x, w);
+  const std::vector<std::vector<feature> >& remote =
+      graphlab::qthread_get(replies);
+  for (size_t i = 0; i < remote.size(); ++i) {
+    for (size_t j = 0; j < remote[i].size(); ++j) {
+      w[remote[i][j].id] = remote[i][j].value;
+    }
+  }
   for (size_t i = 0; i < x.size(); ++i) {
     linear_predictor += x[i].value * w[x[i].id];
   } 
@@ -341,8 +336,8 @@ void data_loop(size_t num_points) {
   for (size_t i = 0; i < num_points; ++i) {
     generate_datapoint(x,y,num_features_per_x);
     double ret = logistic_sgd_step(x,y);
-    lossl2.inc((y - ret) * (y - ret));
-    loss01.inc(y != (ret >= 0.5));
+    lossl2 += (y - ret) * (y - ret);
+    loss01 += (y != (ret >= 0.5));
   }
 }
 
@@ -427,7 +422,7 @@ int main(int argc, char** argv) {
     if (comm->rank() == 0) std::cout << ti.current_time() << std::endl;
 
     graphlab::oarchive* oarc = rpc->prepare_message(LOSS_INCREMENT);
-    (*oarc) << loss01.value << lossl2.value;
+    (*oarc) << loss01.value() << lossl2.value();
     rpc->complete_message(0, oarc);
 
     if (comm->rank() == 0) {
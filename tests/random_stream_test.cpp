@@ -0,0 +1,192 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/util/random_stream.hpp>
+#include <graphlab/database/graph_neighbor_sampler.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks philox_stream against the published Philox4x32-10 answers, the
+ * moments of its distributions, the frequencies of alias_table and of
+ * graph_neighbor_sampler, then measures the batch fills against the
+ * generators of random.hpp.
+ * Usage: random_stream_test [nthreads] [draws_per_thread]
+ */
+
+void check_block(uint32_t k0, uint32_t k1, uint64_t block, uint64_t stream,
+                 uint32_t o0, uint32_t o1, uint32_t o2, uint32_t o3) {
+  uint32_t key[2] = {k0, k1};
+  uint32_t out[4];
+  random::philox_stream::philox(key, block, stream, out);
+  ASSERT_TRUE(out[0] == o0 && out[1] == o1 && out[2] == o2 && out[3] == o3);
+}
+
+void mean_var(const double* x, size_t n, double& mean, double& var) {
+  mean = 0; var = 0;
+  for (size_t i = 0;i < n; ++i) mean += x[i];
+  mean /= n;
+  for (size_t i = 0;i < n; ++i) var += (x[i] - mean) * (x[i] - mean);
+  var /= n;
+}
+
+double fill_throughput(size_t n) {
+  std::vector<double> buf(4096);
+  random::philox_stream& stream = random::get_stream();
+  double sum = 0;
+  for (size_t i = 0;i < n; i += buf.size()) {
+    stream.fill_uniform(&buf[0], buf.size());
+    sum += buf[0];
+  }
+  return sum;
+}
+
+double locked_throughput(size_t n) {
+  double sum = 0;
+  for (size_t i = 0;i < n; ++i) sum += random::rand01();
+  return sum;
+}
+
+void get_stream_id(uint64_t* out) { *out = random::get_stream().stream_id(); }
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  size_t ndraws = 20000000;
+  if (argc > 1) nthreads = atoi(argv[1]);
+  if (argc > 2) ndraws = atol(argv[2]);
+
+  // Random123 known answers: counter (c0, c1, c2, c3) is (block, stream)
+  check_block(0, 0, 0, 0, 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8);
+  check_block(0xffffffff, 0xffffffff, ~uint64_t(0), ~uint64_t(0),
+              0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd);
+  check_block(0xa4093822, 0x299f31d0, 0x85a308d3243f6a88ULL, 0x0370734413198a2eULL,
+              0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1);
+
+  // streams are reproducible, distinct, and can skip ahead
+  {
+    random::philox_stream a(42, 1), b(42, 1), c(42, 2);
+    uint64_t first = a.next();
+    ASSERT_EQ(first, b.next());
+    ASSERT_NE(first, c.next());
+    a.next(); a.next(); a.next();
+    b.skip_blocks(1);
+    ASSERT_EQ(a.next(), b.next());
+    a.seed(42, 1);
+    ASSERT_EQ(a.next(), first);
+  }
+
+  // distributions
+  const size_t n = 1000000;
+  std::vector<double> x(n);
+  random::philox_stream stream(7, 0);
+  double mean, var;
+  stream.fill_uniform(&x[0], n, 2, 4);
+  for (size_t i = 0;i < n; ++i) ASSERT_TRUE(x[i] >= 2 && x[i] < 4);
+  mean_var(&x[0], n, mean, var);
+  ASSERT_LT(std::fabs(mean - 3), 0.01);
+  ASSERT_LT(std::fabs(var - 1.0 / 3), 0.01);
+  stream.fill_normal(&x[0], n, 1, 2);
+  mean_var(&x[0], n, mean, var);
+  ASSERT_LT(std::fabs(mean - 1), 0.01);
+  ASSERT_LT(std::fabs(var - 4), 0.05);
+  {
+    std::vector<uint32_t> ints(n + 3);
+    stream.fill_uniform_int(&ints[0], ints.size(), 10);
+    std::vector<size_t> counts(10, 0);
+    for (size_t i = 0;i < ints.size(); ++i) { ASSERT_TRUE(ints[i] < 10); ++counts[ints[i]]; }
+    for (size_t i = 0;i < 10; ++i) ASSERT_LT(std::fabs(counts[i] / double(n) - 0.1), 0.005);
+    for (size_t i = 0;i < 1000; ++i) ASSERT_LT(stream.uniform_int(3), 3);
+  }
+
+  // alias table frequencies
+  {
+    std::vector<double> weights;
+    weights.push_back(1); weights.push_back(0); weights.push_back(5);
+    weights.push_back(2); weights.push_back(2);
+    random::alias_table table(weights);
+    std::vector<uint32_t> draws(n);
+    stream.fill_discrete(table, &draws[0], n);
+    std::vector<size_t> counts(weights.size(), 0);
+    for (size_t i = 0;i < n; ++i) ++counts[draws[i]];
+    ASSERT_TRUE(counts[1] == 0);
+    for (size_t i = 0;i < weights.size(); ++i) {
+      ASSERT_LT(std::fabs(counts[i] / double(n) - weights[i] / 10), 0.005);
+    }
+  }
+
+  // neighbor sampling: vertex 0 has neighbors 1, 2, 3 with weights 1, 2, 0
+  {
+    std::vector<graph_field> fields;
+    fields.push_back(graph_field("weight", DOUBLE_TYPE));
+    graph_shard shard(0);
+    for (size_t i = 1;i <= 3; ++i) {
+      graph_row row(fields, false);
+      row._data[0].set_double(i == 3 ? 0 : i);
+      shard.add_edge(0, i, row);
+    }
+    graph_row row(fields, false);
+    row._data[0].set_double(1);
+    shard.add_edge(1, 0, row);
+    shard.add_edge(4, 0, row);
+
+    graph_neighbor_sampler sampler;
+    sampler.init(shard, false, graph_neighbor_sampler::EDGE_FIELD, 0);
+    ASSERT_EQ(sampler.num_neighbors(0), 3);
+    ASSERT_EQ(sampler.num_neighbors(2), 0);
+    std::vector<size_t> counts(4, 0);
+    graph_vid_t out;
+    for (size_t i = 0;i < 30000; ++i) {
+      ASSERT_TRUE(sampler.sample(0, stream, out));
+      ++counts[out];
+    }
+    ASSERT_TRUE(counts[3] == 0);
+    ASSERT_LT(std::fabs(counts[2] / 30000.0 - 2.0 / 3), 0.02);
+    ASSERT_FALSE(sampler.sample(2, stream, out));
+
+    // in neighbors of 0 weighted by their degree: 1 has 2 edges, 4 has 1
+    sampler.init(shard, true, graph_neighbor_sampler::NEIGHBOR_DEGREE);
+    counts.assign(5, 0);
+    for (size_t i = 0;i < 30000; ++i) {
+      ASSERT_TRUE(sampler.sample(0, stream, out));
+      ++counts[out];
+    }
+    ASSERT_LT(std::fabs(counts[1] / 30000.0 - 2.0 / 3), 0.02);
+
+    sampler.init(shard, false);
+    std::vector<graph_vid_t> path;
+    size_t steps = sampler.random_walk(4, 10, stream, path);
+    ASSERT_EQ(path.size(), steps + 1);
+    ASSERT_TRUE(path[0] == 4);
+    ASSERT_TRUE(path[1] == 0);
+  }
+
+  // every thread gets its own stream
+  {
+    std::vector<uint64_t> ids(nthreads);
+    thread_group group;
+    for (size_t i = 0;i < nthreads; ++i) group.launch(boost::bind(get_stream_id, &ids[i]));
+    group.join();
+    std::sort(ids.begin(), ids.end());
+    ASSERT_TRUE(std::unique(ids.begin(), ids.end()) == ids.end());
+  }
+
+  for (size_t locked = 0; locked < 2; ++locked) {
+    size_t draws = locked ? ndraws / 10 : ndraws;
+    thread_group group;
+    timer ti; ti.start();
+    for (size_t i = 0;i < nthreads; ++i) {
+      if (locked) group.launch(boost::bind(locked_throughput, draws));
+      else group.launch(boost::bind(fill_throughput, draws));
+    }
+    group.join();
+    std::cout << (locked ? "random::rand01: " : "philox_stream::fill_uniform: ")
+              << nthreads * draws / ti.current_time() / 1e6 << " M draws/s\n";
+  }
+  std::cout << "Done\n";
+}
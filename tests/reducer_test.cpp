@@ -0,0 +1,79 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/reducer.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Checks that reducer combines the contributions of many threads, with
+ * as many slots as threads and with fewer, for the provided and a custom
+ * reduction operation.
+ * Usage: reducer_test [num_threads]
+ */
+
+const size_t NUM_UPDATES = 100000;
+
+// combines the bits of the values
+struct reducer_or {
+  static size_t identity() { return 0; }
+  static void combine(size_t& acc, const size_t& val) { acc |= val; }
+};
+
+struct reducers {
+  reducer<size_t> count;
+  reducer<double> sum;
+  reducer<int, reducer_min<int> > min;
+  reducer<int, reducer_max<int> > max;
+  reducer<size_t, reducer_or> bits;
+  reducers(size_t num_slots): count(num_slots), sum(num_slots), min(num_slots),
+                              max(num_slots), bits(num_slots) { }
+};
+
+void contribute(reducers* r, size_t thread_id) {
+  for (size_t i = 0; i < NUM_UPDATES; ++i) {
+    r->count += 1;
+    r->sum += 0.5;
+    r->min.reduce(int(i) - int(thread_id));
+    r->max.reduce(int(i + thread_id));
+  }
+  r->bits.reduce(size_t(1) << (thread_id % 64));
+}
+
+void test_threads(size_t num_threads, size_t num_slots) {
+  reducers r(num_slots);
+  thread_group group;
+  for (size_t t = 0; t < num_threads; ++t) group.launch(boost::bind(contribute, &r, t));
+  group.join();
+  ASSERT_EQ(r.count.value(), num_threads * NUM_UPDATES);
+  ASSERT_EQ(r.sum.value(), 0.5 * num_threads * NUM_UPDATES);
+  ASSERT_EQ(r.min.value(), -int(num_threads - 1));
+  ASSERT_EQ(r.max.value(), int(NUM_UPDATES - 1 + num_threads - 1));
+  size_t expected_bits = 0;
+  for (size_t t = 0; t < num_threads; ++t) expected_bits |= size_t(1) << (t % 64);
+  ASSERT_EQ(r.bits.value(), expected_bits);
+
+  // clear and assignment reset every slot
+  r.count.clear();
+  ASSERT_EQ(r.count.value(), 0);
+  r.sum = 2.0;
+  ASSERT_EQ(double(r.sum), 2.0);
+}
+
+int main(int argc, char** argv) {
+  size_t num_threads = 8;
+  if (argc > 1) num_threads = atoi(argv[1]);
+  // the identities
+  reducer<int, reducer_min<int> > min;
+  reducer<double, reducer_max<double> > max;
+  ASSERT_EQ(min.value(), std::numeric_limits<int>::max());
+  ASSERT_LT(max.value(), -1e308);
+
+  test_threads(num_threads, 0);
+  // threads share slots
+  test_threads(num_threads, 1);
+  test_threads(num_threads, 2);
+  std::cout << "Done\n";
+}
@@ -0,0 +1,175 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <graphlab/database/graph_shard_impl.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+/*
+ * Measures shard save/load throughput of the bulk serialization paths
+ * (packed edge list, batched row encoder, pre-sized buffer) against the
+ * generic element by element serializers, and checks that both produce
+ * the same bytes, also when gathered from a scatter-gather archive.
+ * Usage: shard_serialization_bench [num_vertices] [edges_per_vertex]
+ */
+
+size_t NUM_VERTICES;
+size_t EDGES_PER_VERTEX;
+const size_t ROUNDS = 5;
+
+void build_shard(graph_shard_impl& shard) {
+  std::vector<graph_field> vfields, efields;
+  vfields.push_back(graph_field("rank", DOUBLE_TYPE));
+  vfields.push_back(graph_field("degree", INT_TYPE));
+  vfields.push_back(graph_field("name", STRING_TYPE));
+  efields.push_back(graph_field("weight", DOUBLE_TYPE));
+  shard.shard_id = 0;
+  for (size_t i = 0; i < NUM_VERTICES; ++i) {
+    graph_row row(vfields, true);
+    row._data[0].set_double(1.0 / (i + 1));
+    row._data[1].set_integer(EDGES_PER_VERTEX);
+    std::stringstream name; name << "vertex_" << i;
+    row._data[2].set_string(name.str());
+    shard.add_vertex(i, row);
+  }
+  for (size_t i = 0; i < NUM_VERTICES; ++i) {
+    for (size_t j = 1; j <= EDGES_PER_VERTEX; ++j) {
+      graph_row row(efields, false);
+      row._data[0].set_double(double(j));
+      shard.add_edge(i, (i * 7 + j) % NUM_VERTICES, row);
+    }
+  }
+}
+
+// graph_shard_impl::save / load using only the generic element serializers
+void generic_save(oarchive& oarc, const graph_shard_impl& shard) {
+  oarc << shard.shard_id;
+  oarc << shard.vertex;
+  oarc << shard.vertex_data.size();
+  serialize_iterator(oarc, shard.vertex_data.begin(), shard.vertex_data.end());
+  oarc << shard.edgeid;
+  oarc << shard.edge.size();
+  serialize_iterator(oarc, shard.edge.begin(), shard.edge.end());
+  oarc << shard.edge_data.size();
+  serialize_iterator(oarc, shard.edge_data.begin(), shard.edge_data.end());
+  oarc << shard.vertex_index << shard.edge_index << shard.vertex_mirrors;
+}
+
+void generic_load(iarchive& iarc, graph_shard_impl& shard) {
+  size_t len;
+  iarc >> shard.shard_id;
+  iarc >> shard.vertex;
+  iarc >> len;
+  shard.vertex_data.clear(); shard.vertex_data.reserve(len);
+  deserialize_iterator<iarchive, graph_row>(iarc, std::back_inserter(shard.vertex_data));
+  iarc >> shard.edgeid;
+  iarc >> len;
+  shard.edge.clear(); shard.edge.reserve(len);
+  deserialize_iterator<iarchive, std::pair<graph_vid_t, graph_vid_t> >
+      (iarc, std::back_inserter(shard.edge));
+  iarc >> len;
+  shard.edge_data.clear(); shard.edge_data.reserve(len);
+  deserialize_iterator<iarchive, graph_row>(iarc, std::back_inserter(shard.edge_data));
+  iarc >> shard.vertex_index >> shard.edge_index >> shard.vertex_mirrors;
+}
+
+void fast_save(oarchive& oarc, const graph_shard_impl& shard) { oarc << shard; }
+void fast_load(iarchive& iarc, graph_shard_impl& shard) { iarc >> shard; }
+
+void report(const char* what, size_t bytes, double secs) {
+  std::cout << "  " << what << ": "
+            << bytes * ROUNDS / secs / (1024 * 1024) << " MB/s\n";
+}
+
+void bench(const char* name, const graph_shard_impl& shard,
+           void (*save)(oarchive&, const graph_shard_impl&),
+           void (*load)(iarchive&, graph_shard_impl&),
+           std::string& out_bytes) {
+  std::cout << name << "\n";
+  timer ti;
+  oarchive oarc;
+  ti.start();
+  for (size_t r = 0; r < ROUNDS; ++r) {
+    free(oarc.buf);
+    oarc.buf = NULL; oarc.off = 0; oarc.len = 0;
+    save(oarc, shard);
+  }
+  report("save to memory", oarc.off, ti.current_time());
+  out_bytes.assign(oarc.buf, oarc.off);
+  free(oarc.buf);
+
+  ti.start();
+  for (size_t r = 0; r < ROUNDS; ++r) {
+    std::stringstream strm;
+    oarchive soarc(strm);
+    save(soarc, shard);
+  }
+  report("save to stream", out_bytes.size(), ti.current_time());
+
+  ti.start();
+  for (size_t r = 0; r < ROUNDS; ++r) {
+    graph_shard_impl loaded;
+    iarchive iarc(out_bytes.c_str(), out_bytes.size());
+    load(iarc, loaded);
+    ASSERT_EQ(loaded.vertex.size(), shard.vertex.size());
+    ASSERT_EQ(loaded.edge_data.size(), shard.edge_data.size());
+  }
+  report("load from memory", out_bytes.size(), ti.current_time());
+}
+
+int main(int argc, char** argv) {
+  NUM_VERTICES = 200000;
+  EDGES_PER_VERTEX = 8;
+  if (argc > 1) NUM_VERTICES = atol(argv[1]);
+  if (argc > 2) EDGES_PER_VERTEX = atol(argv[2]);
+  graph_shard_impl shard;
+  build_shard(shard);
+  std::cout << NUM_VERTICES << " vertices, "
+            << NUM_VERTICES * EDGES_PER_VERTEX << " edges\n";
+
+  std::string generic_bytes, fast_bytes;
+  bench("generic", shard, generic_save, generic_load, generic_bytes);
+  bench("bulk", shard, fast_save, fast_load, fast_bytes);
+  ASSERT_EQ(generic_bytes.size(), fast_bytes.size());
+  ASSERT_TRUE(generic_bytes == fast_bytes);
+
+  // the bulk decoder must read what the generic encoder wrote
+  graph_shard_impl loaded;
+  iarchive iarc(generic_bytes.c_str(), generic_bytes.size());
+  fast_load(iarc, loaded);
+  ASSERT_EQ(loaded.edge.size(), shard.edge.size());
+  for (size_t i = 0; i < shard.edge.size(); ++i) {
+    ASSERT_TRUE(loaded.edge[i] == shard.edge[i]);
+  }
+  for (size_t i = 0; i < shard.vertex_data.size(); ++i) {
+    graph_string_t name;
+    ASSERT_TRUE(loaded.vertex_data[i]._data[2].get_string(&name));
+    std::stringstream expected; expected << "vertex_" << i;
+    ASSERT_EQ(name, expected.str());
+  }
+  std::cout << "encodings match\n";
+
+  // scatter-gather: the names are referenced in place, the gathered
+  // output must be the same bytes
+  std::vector<oarchive_segment> segments;
+  oarchive sgarc(segments, 8);
+  timer ti; ti.start();
+  sgarc << shard;
+  std::vector<iovec> iov;
+  sgarc.gather(iov);
+  double sgtime = ti.current_time();
+  ASSERT_EQ(segments.size(), shard.vertex_data.size());
+  ASSERT_EQ(sgarc.total_length(), fast_bytes.size());
+  std::string gathered;
+  for (size_t i = 0; i < iov.size(); ++i) {
+    gathered.append((const char*)iov[i].iov_base, iov[i].iov_len);
+  }
+  ASSERT_TRUE(gathered == fast_bytes);
+  free(sgarc.buf);
+  std::cout << "scatter-gather: " << iov.size() << " iovecs, "
+            << sgarc.total_length() / sgtime / (1024 * 1024) << " MB/s\n";
+}
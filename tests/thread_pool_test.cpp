@@ -0,0 +1,87 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/thread_pool.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+thread_pool* pool;
+atomic<size_t> counter;
+std::vector<size_t> data;
+std::vector<atomic<size_t> > counts;
+
+void leaf() { counter.inc(); }
+
+// spawns a binary tree of tasks from inside the pool
+void spawn_tree(size_t depth) {
+  if (depth == 0) { leaf(); return; }
+  pool->launch(boost::bind(spawn_tree, depth - 1));
+  pool->launch(boost::bind(spawn_tree, depth - 1));
+}
+
+void increment_range(size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) data[i] += 1;
+}
+
+// the nested loops overlap, so they count atomically
+void count_range(size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) counts[i].inc();
+}
+
+void nested_parallel_for(size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    pool->parallel_for(0, counts.size(), count_range, 16);
+  }
+}
+
+void throw_task() { throw "thread_pool_test exception"; }
+
+int main(int argc, char** argv) {
+  size_t nthreads = thread::cpu_count();
+  if (argc > 1) nthreads = atoi(argv[1]);
+  thread_pool tp(nthreads);
+  pool = &tp;
+  std::cout << "Using " << nthreads << " threads\n";
+
+  // external launches and recursive spawning
+  timer ti; ti.start();
+  for (size_t r = 0; r < 20; ++r) {
+    counter.value = 0;
+    for (size_t i = 0; i < 10000; ++i) tp.launch(leaf);
+    tp.launch(boost::bind(spawn_tree, 14));
+    tp.join();
+    ASSERT_EQ(counter.value, 10000 + (1 << 14));
+  }
+  std::cout << "Launch/join: " << ti.current_time() << " seconds\n";
+
+  // parallel_for over a large range
+  ti.start();
+  data.assign(10000000, 0);
+  for (size_t r = 0; r < 10; ++r) {
+    tp.parallel_for(0, data.size(), increment_range);
+  }
+  for (size_t i = 0; i < data.size(); ++i) ASSERT_TRUE(data[i] == 10);
+  std::cout << "parallel_for: " << ti.current_time() << " seconds\n";
+
+  // parallel_for called from within tasks of the same pool
+  counts.assign(1000, atomic<size_t>(0));
+  tp.parallel_for(0, 64, nested_parallel_for, 1);
+  for (size_t i = 0; i < counts.size(); ++i) ASSERT_EQ(counts[i].value, 64);
+
+  // exception forwarding
+  tp.launch(throw_task);
+  bool caught = false;
+  try { tp.join(); } catch (const char* c) { caught = true; }
+  ASSERT_TRUE(caught);
+
+  // resizing keeps the pool usable
+  tp.resize(nthreads / 2 + 1);
+  counter.value = 0;
+  for (size_t i = 0; i < 1000; ++i) tp.launch(leaf);
+  tp.join();
+  ASSERT_EQ(counter.value, 1000);
+  std::cout << "thread_pool_test passed\n";
+}
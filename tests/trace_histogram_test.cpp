@@ -0,0 +1,67 @@
+#include <iostream>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <graphlab/util/tracepoint.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/assertions.hpp>
+using namespace graphlab;
+
+// Every thread records the values 1..N into one tracer. The merged
+// percentiles must be within the bucket precision of the exact ones.
+
+const size_t N = 100000;
+
+void record(trace_histogram* tracer) {
+  for (size_t i = 1;i <= N; ++i) tracer->incorporate(i * 1000);
+}
+
+void check_close(unsigned long long val, unsigned long long expected) {
+  // buckets are 1/32 of a power of two wide
+  ASSERT_GE(val, expected);
+  ASSERT_LE(val, expected + expected / 16);
+}
+
+int main(int argc, char** argv) {
+  size_t nthreads = 4;
+  if (argc > 1) nthreads = atoi(argv[1]);
+
+  // bucket bounds
+  for (unsigned long long v = 0; v < 1000000; v = v * 3 / 2 + 1) {
+    size_t b = trace_histogram::bucket_of(v);
+    ASSERT_LE(v, trace_histogram::bucket_max(b));
+    if (b > 0) ASSERT_GT(v, trace_histogram::bucket_max(b - 1));
+  }
+  ASSERT_LT(trace_histogram::bucket_of(~0ULL), trace_histogram::NUM_BUCKETS);
+  ASSERT_EQ(trace_histogram::bucket_max(trace_histogram::NUM_BUCKETS - 1), ~0ULL);
+
+  trace_histogram tracer("test", "values 1000..N*1000", false);
+  ASSERT_EQ(tracer.percentile(0.5), 0);
+  thread_group group;
+  timer ti; ti.start();
+  for (size_t i = 0;i < nthreads; ++i) {
+    group.launch(boost::bind(record, &tracer));
+  }
+  group.join();
+  double elapsed = ti.current_time();
+
+  ASSERT_EQ(tracer.count(), N * nthreads);
+  ASSERT_EQ(tracer.minimum(), 1000);
+  ASSERT_EQ(tracer.maximum(), N * 1000);
+  check_close(tracer.percentile(0.5), N * 1000 / 2);
+  check_close(tracer.percentile(0.99), N * 1000 * 99 / 100);
+  check_close(tracer.percentile(0.999), N * 1000 * 999 / 1000);
+  ASSERT_EQ(tracer.percentile(1.0), N * 1000);
+
+  trace_histogram sum("sum", "merged", false);
+  sum += tracer;
+  sum += tracer;
+  ASSERT_EQ(sum.count(), 2 * N * nthreads);
+  check_close(sum.percentile(0.9), N * 1000 * 9 / 10);
+
+  tracer.print(std::cout);
+  std::cout << nthreads * N / elapsed / 1e6 << " M events/s\n";
+  tracer.clear();
+  ASSERT_EQ(tracer.count(), 0);
+  std::cout << "Done\n";
+}